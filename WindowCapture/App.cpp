@@ -24,6 +24,18 @@ using namespace Windows::Graphics::Capture;
 
 void App::Initialize(
     ContainerVisual const& root)
+{
+    auto d3dDevice = CreateD3DDevice();
+    auto dxgiDevice = d3dDevice.as<IDXGIDevice>();
+    auto device = CreateDirect3DDevice(dxgiDevice.get());
+    if (device == NULL)
+        OutputDebugStringA("CreateDirect3DDevice(dxgiDevice.get()); return NULL!!! \r\n");
+    Initialize(root, device);
+}
+
+void App::Initialize(
+    ContainerVisual const& root,
+    winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device)
 {
     auto queue = DispatcherQueue::GetForCurrentThread();
 
@@ -48,17 +60,15 @@ void App::Initialize(
     m_content.Shadow(shadow);
     m_root.Children().InsertAtTop(m_content);
 
-    auto d3dDevice = CreateD3DDevice();
-    auto dxgiDevice = d3dDevice.as<IDXGIDevice>();
-    m_device = CreateDirect3DDevice(dxgiDevice.get());
-    if (m_device == NULL)
-        OutputDebugStringA("CreateDirect3DDevice(dxgiDevice.get()); return NULL!!! \r\n");
+    m_device = device;
 }
 
 void App::StartCapture(HWND hwnd)
 {
+    std::lock_guard<std::mutex> lock(m_serveMutex);
 	if (m_capture)
 	{
+		DetachReadback();
 		m_capture->Close();
 		m_capture = nullptr;
 	}
@@ -83,7 +93,16 @@ void App::StartCapture(HWND hwnd)
         if (windowMinimized) return;
         auto item = CreateCaptureItemForWindow(hwnd);
 
-        m_capture = std::make_unique<SimpleCapture>(m_device, item);
+        m_capture = std::make_unique<SimpleCapture>(m_device, item, &m_dispatcher, hwnd);
+        m_capture->SetOutputFormat(m_convert);
+        m_capture->SetStripCopier(m_strips.get());
+        m_capture->SetScale(m_scale);
+        m_capture->SetFrameRate(m_frameRate);
+        m_capture->EnableDirtyRegions(m_dirtyRegions);
+        m_capture->SetFrameTrace(m_trace, m_traceTrack);
+        m_capture->SetDrawCursor(m_drawCursor);
+        m_capture->SetFramePolicy(m_queueDepth, m_framePolicy);
+        AttachReadback();
 
         auto surface = m_capture->CreateSurface(m_compositor);
         m_brush.Surface(surface);
@@ -103,7 +122,354 @@ winrt::Windows::Graphics::SizeInt32 App::GetFrameSize()
     return m_capture != nullptr ? m_capture->GetLastSize() : size;
 }
 
+void App::SetOutputFormat(ConvertParams const& params)
+{
+    std::lock_guard<std::mutex> lock(m_serveMutex);
+    m_convert = params;
+    if (m_capture)
+        m_capture->SetOutputFormat(params);
+}
+
+void App::SetParallelCopy(StripCopierConfig const* config)
+{
+    auto strips = config != nullptr ? std::make_unique<StripCopier>(*config) : nullptr;
+    // Off the old pool before it goes; the switch waits out a copy using it.
+    if (m_capture)
+        m_capture->SetStripCopier(strips.get());
+    m_strips = std::move(strips);
+}
+
+void App::SetScale(ScaleParams const& params)
+{
+    m_scale = params;
+    if (m_capture)
+        m_capture->SetScale(params);
+}
+
+void App::SetFrameRate(double fps)
+{
+    m_frameRate = fps;
+    if (m_capture)
+        m_capture->SetFrameRate(fps);
+}
+
+bool App::GetFrameTiming(FrameTiming& timing)
+{
+    if (m_capture == nullptr)
+        return false;
+    timing = m_capture->GetFrameTiming();
+    return true;
+}
+
+void App::SetFrameTrace(FrameTraceWriter* trace, uint32_t track)
+{
+    m_trace = trace;
+    m_traceTrack = track;
+    if (m_capture)
+        m_capture->SetFrameTrace(trace, track);
+}
+
+void App::EnableDirtyRegions(bool enable)
+{
+    m_dirtyRegions = enable;
+    if (m_capture)
+        m_capture->EnableDirtyRegions(enable);
+}
+
+void App::SetDrawCursor(bool draw)
+{
+    m_drawCursor = draw;
+    if (m_capture)
+        m_capture->SetDrawCursor(draw);
+}
+
+bool App::GetCursorState(CursorState& cursor)
+{
+    if (m_capture == nullptr)
+        return false;
+    cursor = m_capture->GetCursorState();
+    return true;
+}
+
+bool App::GetDirtyRegions(std::vector<DirtyRect>& rects, bool& identical)
+{
+    return m_capture == nullptr ? false : m_capture->GetDirtyRegions(rects, identical);
+}
+
+void App::SetAsyncReadback(ReadbackEngine* engine, uint32_t id)
+{
+    DetachReadback();
+    m_engine = engine;
+    m_engineId = id;
+    AttachReadback();
+}
+
+void App::AttachReadback()
+{
+    if (m_engine == nullptr || m_capture == nullptr)
+        return;
+    auto engine = m_engine;
+    auto id = m_engineId;
+    engine->Add(id, *m_capture);
+    m_capture->SetAsyncReadback([engine, id]() { engine->Kick(id); });
+    // Frames may have landed before the kick was installed.
+    engine->Kick(id);
+}
+
+void App::DetachReadback()
+{
+    if (m_engine == nullptr || m_capture == nullptr)
+        return;
+    // Out of the engine first, so no step is running when the capture goes
+    // back to reading back on the caller's thread.
+    m_engine->Remove(m_engineId);
+    m_capture->SetAsyncReadback(nullptr);
+}
+
+void App::SetFramePolicy(uint32_t depth, FramePolicy policy)
+{
+    m_queueDepth = depth;
+    m_framePolicy = policy;
+    if (m_capture)
+        m_capture->SetFramePolicy(depth, policy);
+}
+
+FrameQueueStats App::GetFrameQueueStats()
+{
+    return m_capture == nullptr ? FrameQueueStats() : m_capture->GetFrameQueueStats();
+}
+
+CaptureStatsSnapshot App::GetCaptureStats(bool reset)
+{
+    return m_capture == nullptr ? CaptureStatsSnapshot() : m_capture->GetCaptureStats(reset);
+}
+
 bool App::CopyImage(unsigned char* buf)
 {    
     return m_capture == nullptr ? false : m_capture->CopyImage(buf);
+}
+
+CopyResult App::CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height)
+{
+    OutputFormat format = OutputFormat::Bgra;
+    return CopyImage(buf, bufSize, dstStride, width, height, format);
+}
+
+CopyResult App::CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format)
+{
+    if (m_capture == nullptr)
+        return CopyResult::NoFrame;
+    auto result = m_capture->CopyImage(buf, bufSize, dstStride, width, height, format);
+    if (result == CopyResult::Ok && m_recorder && m_recorder->IsOpen())
+        RecordFrame(buf, dstStride, format, width, height);
+    return result;
+}
+
+void App::SubmitBatch()
+{
+    if (m_capture != nullptr)
+        m_capture->SubmitBatch();
+}
+
+bool App::CollectBatch(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, CopyResult& result)
+{
+    result = CopyResult::NoFrame;
+    if (m_capture == nullptr)
+        return true;
+    OutputFormat format = OutputFormat::Bgra;
+    if (!m_capture->CollectBatch(buf, bufSize, dstStride, width, height, format, result))
+        return false;
+    if (result == CopyResult::Ok && m_recorder && m_recorder->IsOpen())
+        RecordFrame(buf, dstStride, format, width, height);
+    return true;
+}
+
+CopyResult App::CopyCompressed(unsigned char* buf, size_t bufSize, size_t& encodedSize, EncodedFrameHeader& header)
+{
+    if (!m_packetPending)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        OutputFormat format = OutputFormat::Bgra;
+        auto result = CopyImage(m_codecFrame.data(), m_codecFrame.size(), 0, width, height, format);
+        if (result == CopyResult::BufferTooSmall)
+        {
+            m_codecFrame.resize(GetOutputFrameSize(format, width, height, 0));
+            result = CopyImage(m_codecFrame.data(), m_codecFrame.size(), 0, width, height, format);
+        }
+        if (result != CopyResult::Ok ||
+            !m_encoder.Encode(m_codecFrame.data(), GetOutputRowBytes(format, width), format, width, height, m_packet))
+            return CopyResult::NoFrame;
+        m_packetPending = true;
+    }
+
+    encodedSize = m_packet.size();
+    FrameDecoder::ReadHeader(m_packet.data(), m_packet.size(), header);
+    if (buf == nullptr || bufSize < m_packet.size())
+        return CopyResult::BufferTooSmall;
+    memcpy(buf, m_packet.data(), m_packet.size());
+    m_packetPending = false;
+    return CopyResult::Ok;
+}
+
+bool App::StartRecording(std::string const& path, uint32_t maxWidth, uint32_t maxHeight, uint32_t maxFrames)
+{
+    StopRecording();
+    DefaultMaxSize(maxWidth, maxHeight);
+
+    RecordingConfig config;
+    config.Format = m_convert.Format;
+    config.MaxWidth = maxWidth;
+    config.MaxHeight = maxHeight;
+    config.MaxFrames = maxFrames;
+    auto recorder = std::make_unique<FrameRecorder>();
+    if (!recorder->Open(path, config))
+        return false;
+    m_recorder = std::move(recorder);
+    return true;
+}
+
+bool App::StopRecording()
+{
+    return m_recorder ? m_recorder->Close() : false;
+}
+
+bool App::GetRecordingStats(uint64_t& recorded, uint64_t& dropped)
+{
+    if (!m_recorder)
+        return false;
+    recorded = m_recorder->Recorded();
+    dropped = m_recorder->Dropped();
+    return true;
+}
+
+void App::RecordFrame(const unsigned char* buf, size_t dstStride, OutputFormat format, uint32_t width, uint32_t height)
+{
+    uint32_t flags = RecordedFrameDirty;
+    bool identical = false;
+    if (m_dirtyRegions && m_capture->GetDirtyRegions(m_recordRects, identical))
+        flags = RecordedFrameTracked | (identical ? 0 : RecordedFrameDirty);
+    if (dstStride == 0)
+        dstStride = GetOutputRowBytes(format, width);
+    m_recorder->Append(buf, dstStride, format, width, height, m_capture->GetFrameTiming(), flags);
+}
+
+void App::DefaultMaxSize(uint32_t& maxWidth, uint32_t& maxHeight)
+{
+    if (maxWidth != 0 && maxHeight != 0)
+        return;
+    auto size = GetFrameSize();
+    auto crop = ClampCrop(m_scale.Crop, static_cast<uint32_t>(size.Width), static_cast<uint32_t>(size.Height));
+    uint32_t width = 0;
+    uint32_t height = 0;
+    GetScaledSize(m_scale, crop.Width, crop.Height, width, height);
+    if (maxWidth == 0)
+        maxWidth = width;
+    if (maxHeight == 0)
+        maxHeight = height;
+}
+
+bool App::StartFrameServer(std::string const& name, uint32_t maxWidth, uint32_t maxHeight, uint32_t slots)
+{
+    StopFrameServer();
+    DefaultMaxSize(maxWidth, maxHeight);
+
+    SharedRingConfig config;
+    config.Format = m_convert.Format;
+    config.MaxWidth = maxWidth;
+    config.MaxHeight = maxHeight;
+    if (slots != 0)
+        config.Slots = slots;
+    auto server = std::make_unique<SharedFrameWriter>();
+    if (!server->Create(name, config))
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(m_serveMutex);
+        m_server = std::move(server);
+    }
+    m_serveStop = false;
+    m_serveThread = std::thread([this] { ServeLoop(); });
+    return true;
+}
+
+bool App::StopFrameServer()
+{
+    if (!m_serveThread.joinable())
+        return false;
+    m_serveStop = true;
+    m_serveThread.join();
+    std::lock_guard<std::mutex> lock(m_serveMutex);
+    m_server->Close();
+    return true;
+}
+
+bool App::GetFrameServerStats(uint64_t& published, uint64_t& dropped, uint64_t& overwrites)
+{
+    std::lock_guard<std::mutex> lock(m_serveMutex);
+    if (!m_server)
+        return false;
+    published = m_server->Published();
+    dropped = m_server->Dropped();
+    overwrites = m_server->Overwrites();
+    return true;
+}
+
+void App::ServeLoop()
+{
+    while (!m_serveStop)
+    {
+        // Woken by frames, and at least often enough to keep the heartbeat
+        // well inside the reader timeout while the window sits still.
+        m_dispatcher.Wait(100);
+        std::lock_guard<std::mutex> lock(m_serveMutex);
+        m_server->Heartbeat();
+        if (m_capture != nullptr && m_convert.Format == m_server->Format())
+            ServeFrames();
+    }
+}
+
+void App::ServeFrames()
+{
+    for (;;)
+    {
+        // Straight from staging into the shared slot, with no copy between.
+        SharedWriteSlot slot;
+        if (!m_server->BeginWrite(slot))
+            return;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        OutputFormat format = OutputFormat::Bgra;
+        auto result = m_capture->CopyImage(slot.Data, slot.Capacity, slot.Stride, width, height, format);
+        if (result == CopyResult::Ok && format == m_server->Format())
+        {
+            m_server->CommitWrite(slot, width, height, m_capture->GetFrameTiming());
+            continue;
+        }
+        m_server->AbortWrite(slot);
+        if (result == CopyResult::Ok)
+        {
+            // Read back before the output format changed to the ring's.
+            m_server->CountDropped();
+            continue;
+        }
+        if (result != CopyResult::BufferTooSmall)
+            return;
+
+        // Bigger than the ring takes: still consume it, so it doesn't block
+        // the frames behind it.
+        m_serveScratch.resize(GetOutputFrameSize(format, width, height, 0));
+        if (m_capture->CopyImage(m_serveScratch.data(), m_serveScratch.size(), 0, width, height, format) != CopyResult::Ok)
+            return;
+        m_server->CountDropped();
+    }
+}
+
+bool App::AcquireFrame(FrameLease& lease)
+{
+    return m_capture == nullptr ? false : m_capture->LeaseFrame(lease);
+}
+
+bool App::ReleaseFrame(uint64_t frameIndex)
+{
+    return m_capture == nullptr ? false : m_capture->ReturnFrame(frameIndex);
 }
\ No newline at end of file
@@ -1,16 +1,79 @@
 #pragma once
+#include "FrameCodec.h"
+#include "FrameRecording.h"
+#include "SharedFrameRing.h"
 #include "SimpleCapture.h"
+#include "StripCopier.h"
 
 class App
 {
 public:
     App() {}
-    ~App() {}
+    ~App()
+    {
+        StopFrameServer();
+        SetAsyncReadback(nullptr, 0);
+    }
 
     void Initialize(winrt::Windows::UI::Composition::ContainerVisual const& root);
+    // Initialize against a device shared with other App instances.
+    void Initialize(
+        winrt::Windows::UI::Composition::ContainerVisual const& root,
+        winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device);
     void StartCapture(HWND hwnd);
     bool CopyImage(unsigned char* buf);
+    CopyResult CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height);
+    // format receives the format the frame came in; see SimpleCapture.
+    CopyResult CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format);
+    // CopyImage in two halves for a batch of captures; see SimpleCapture.
+    void SubmitBatch();
+    bool CollectBatch(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, CopyResult& result);
+    // CopyImage run through FrameEncoder into buf. A packet that doesn't fit
+    // stays pending, encodedSize reporting its size, and is what the next
+    // call returns.
+    CopyResult CopyCompressed(unsigned char* buf, size_t bufSize, size_t& encodedSize, EncodedFrameHeader& header);
+    void SetKeyframeInterval(uint32_t interval) { m_encoder.SetKeyframeInterval(interval); }
+    void RequestKeyframe() { m_encoder.RequestKeyframe(); }
+    bool AcquireFrame(FrameLease& lease);
+    bool ReleaseFrame(uint64_t frameIndex);
     winrt::Windows::Graphics::SizeInt32 GetFrameSize();
+    void SetOutputFormat(ConvertParams const& params);
+    // Copy large frames in strips on a pool of config's threads, nullptr to
+    // copy on the calling thread alone.
+    void SetParallelCopy(StripCopierConfig const* config);
+    void SetScale(ScaleParams const& params);
+    void SetFrameRate(double fps);
+    bool GetFrameTiming(FrameTiming& timing);
+    // Record delivered frames to trace under track, nullptr to stop. The
+    // trace must stay open while set.
+    void SetFrameTrace(FrameTraceWriter* trace, uint32_t track);
+    void EnableDirtyRegions(bool enable);
+    void SetDrawCursor(bool draw);
+    bool GetCursorState(CursorState& cursor);
+    bool GetDirtyRegions(std::vector<DirtyRect>& rects, bool& identical);
+    void SetFrameCallback(FrameDispatcher::Callback callback) { m_dispatcher.SetCallback(std::move(callback)); }
+    bool WaitForFrame(uint32_t timeoutMs) { return m_dispatcher.Wait(timeoutMs); }
+    void SetFrameNotifyHook(FrameDispatcher::Callback hook) { m_dispatcher.SetNotifyHook(std::move(hook)); }
+    void SetFramePolicy(uint32_t depth, FramePolicy policy);
+    // Read back on engine's workers under id rather than on the thread that
+    // copies; nullptr turns it off. The engine must outlive the setting.
+    void SetAsyncReadback(ReadbackEngine* engine, uint32_t id);
+    // Append every frame CopyImage returns to a recording container at path,
+    // in the output format at the time. A zero max size takes the current
+    // output size; larger frames are left out and counted as dropped.
+    bool StartRecording(std::string const& path, uint32_t maxWidth, uint32_t maxHeight, uint32_t maxFrames);
+    bool StopRecording();
+    // Counts for the current recording, or the last one once stopped.
+    bool GetRecordingStats(uint64_t& recorded, uint64_t& dropped);
+    // Publish frames to a shared-memory ring under name for other processes
+    // to read in place, from a thread that takes over the frame notifications
+    // and the copying. Sizes are as for StartRecording; the format is the
+    // output format at the start, and frames in any other are left alone.
+    bool StartFrameServer(std::string const& name, uint32_t maxWidth, uint32_t maxHeight, uint32_t slots);
+    bool StopFrameServer();
+    bool GetFrameServerStats(uint64_t& published, uint64_t& dropped, uint64_t& overwrites);
+    FrameQueueStats GetFrameQueueStats();
+    CaptureStatsSnapshot GetCaptureStats(bool reset);
 private:
     winrt::Windows::UI::Composition::Compositor m_compositor{ nullptr };
     winrt::Windows::UI::Composition::ContainerVisual m_root{ nullptr };
@@ -18,5 +81,41 @@ private:
     winrt::Windows::UI::Composition::CompositionSurfaceBrush m_brush{ nullptr };
 
     winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice m_device{ nullptr };
-    std::unique_ptr<SimpleCapture> m_capture{ nullptr };    
+    // Declared before m_capture so it outlives the frame arrived handler.
+    FrameDispatcher m_dispatcher;
+    // Likewise, so it outlives the capture copying through it.
+    std::unique_ptr<StripCopier> m_strips;
+    std::unique_ptr<SimpleCapture> m_capture{ nullptr };
+    ConvertParams m_convert;
+    ScaleParams m_scale;
+    double m_frameRate = 0;
+    bool m_dirtyRegions = false;
+    FrameTraceWriter* m_trace = nullptr;
+    uint32_t m_traceTrack = 0;
+    // On by default, as frames used to come with the cursor composed in.
+    bool m_drawCursor = true;
+    uint32_t m_queueDepth = 1;
+    FramePolicy m_framePolicy = FramePolicy::LatestWins;    
+    ReadbackEngine* m_engine = nullptr;
+    uint32_t m_engineId = 0;
+    std::unique_ptr<FrameRecorder> m_recorder;
+    std::vector<DirtyRect> m_recordRects;
+    FrameEncoder m_encoder;
+    std::vector<uint8_t> m_codecFrame;
+    std::vector<uint8_t> m_packet;
+    bool m_packetPending = false;
+    // Held by the serving thread while it copies, and by whatever replaces
+    // the capture or its output format underneath it.
+    std::mutex m_serveMutex;
+    std::unique_ptr<SharedFrameWriter> m_server;
+    std::thread m_serveThread;
+    std::atomic<bool> m_serveStop{ false };
+    std::vector<uint8_t> m_serveScratch;
+
+    void AttachReadback();
+    void DetachReadback();
+    void RecordFrame(const unsigned char* buf, size_t dstStride, OutputFormat format, uint32_t width, uint32_t height);
+    void DefaultMaxSize(uint32_t& maxWidth, uint32_t& maxHeight);
+    void ServeLoop();
+    void ServeFrames();
 };
\ No newline at end of file
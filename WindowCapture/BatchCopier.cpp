@@ -0,0 +1,119 @@
+#include "BatchCopier.h"
+#include <algorithm>
+
+BatchCopier::BatchCopier(uint32_t threads, std::chrono::microseconds pollInterval) :
+    m_pollInterval(pollInterval)
+{
+    if (threads == 0)
+        threads = std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+    for (uint32_t i = 1; i < threads; i++)
+        m_threads.emplace_back([this] { WorkerLoop(); });
+}
+
+BatchCopier::~BatchCopier()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void BatchCopier::Run(IBatchJob* const* jobs, size_t count)
+{
+    if (count == 0)
+        return;
+    std::lock_guard<std::mutex> runLock(m_runMutex);
+
+    // All copies in flight before the first Map.
+    for (size_t i = 0; i < count; i++)
+        jobs[i]->Submit();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobs = jobs;
+    m_count = count;
+    m_next = 0;
+    m_remaining = count;
+    m_retries.clear();
+    m_stats.Batches++;
+    m_stats.Jobs += count;
+    m_cv.notify_all();
+
+    while (m_remaining > 0)
+    {
+        Work(lock);
+        if (m_remaining > 0)
+            m_cv.wait(lock);
+    }
+    m_jobs = nullptr;
+    m_count = 0;
+    m_next = 0;
+}
+
+BatchCopierStats BatchCopier::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void BatchCopier::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        if (m_stop)
+            return;
+        if (!HasWork())
+        {
+            m_cv.wait(lock);
+            continue;
+        }
+        Work(lock);
+    }
+}
+
+void BatchCopier::Work(std::unique_lock<std::mutex>& lock)
+{
+    while (!m_stop && HasWork())
+    {
+        size_t index;
+        if (m_next < m_count)
+        {
+            index = m_next++;
+        }
+        else
+        {
+            auto pollAt = m_retries.front().PollAt;
+            if (pollAt > Clock::now())
+            {
+                m_cv.wait_until(lock, pollAt);
+                continue;
+            }
+            index = m_retries.front().Index;
+            m_retries.pop_front();
+        }
+
+        auto job = m_jobs[index];
+        m_running++;
+        m_stats.MaxConcurrent = std::max(m_stats.MaxConcurrent, m_running);
+        lock.unlock();
+        bool collected = job->Collect();
+        lock.lock();
+        m_running--;
+
+        if (collected)
+        {
+            if (--m_remaining == 0)
+                m_cv.notify_all();
+            continue;
+        }
+        m_stats.Polls++;
+        Retry retry;
+        retry.Index = index;
+        retry.PollAt = Clock::now() + m_pollInterval;
+        m_retries.push_back(retry);
+        m_cv.notify_one();
+    }
+}
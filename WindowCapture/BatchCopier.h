@@ -0,0 +1,88 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One capture in a batch.
+class IBatchJob
+{
+public:
+    virtual ~IBatchJob() = default;
+
+    // Issue the copy of the newest frame to staging, without waiting for it.
+    // Called on the thread running the batch, for every job in turn, before
+    // any job is collected.
+    virtual void Submit() = 0;
+    // If the copy has landed, map it and copy it out; return false while it
+    // is still in flight. Called on any thread of the copier, never for the
+    // same job from two threads at once.
+    virtual bool Collect() = 0;
+};
+
+struct BatchCopierStats
+{
+    uint64_t Batches = 0;
+    uint64_t Jobs = 0;
+    uint64_t Polls = 0;         // collects that found the copy still in flight
+    uint32_t MaxConcurrent = 0; // most jobs collecting at the same time
+};
+
+// Captures many sources in one go: every GPU copy is issued first, so they
+// overlap on the GPU instead of each paying its own Map stall, and then the
+// jobs are collected on a pool of threads, the CPU copies of different jobs
+// running in parallel. A job whose copy is still in flight is put back and
+// polled again after the poll interval while the threads get on with the
+// others. The calling thread copies too.
+class BatchCopier
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::microseconds DefaultPollInterval{ 100 };
+
+    // threads counts the caller; 0 picks the hardware threads, at most 8.
+    explicit BatchCopier(uint32_t threads = 0, std::chrono::microseconds pollInterval = DefaultPollInterval);
+    ~BatchCopier();
+
+    BatchCopier(BatchCopier const&) = delete;
+    BatchCopier& operator=(BatchCopier const&) = delete;
+
+    // Submit and collect every job, returning once all are collected. Runs
+    // from several threads are taken one after another.
+    void Run(IBatchJob* const* jobs, size_t count);
+
+    uint32_t Threads() const noexcept { return static_cast<uint32_t>(m_threads.size()) + 1; }
+    BatchCopierStats Stats();
+
+private:
+    struct Retry
+    {
+        size_t Index = 0;
+        Clock::time_point PollAt;
+    };
+
+    void WorkerLoop();
+    // Collect jobs of the current batch until none is left to take, the rest
+    // being collected elsewhere.
+    void Work(std::unique_lock<std::mutex>& lock);
+    bool HasWork() const { return m_next < m_count || !m_retries.empty(); }
+
+    std::chrono::microseconds m_pollInterval;
+    std::mutex m_runMutex;              // one batch at a time
+    std::mutex m_mutex;
+    std::condition_variable m_cv;       // work for the threads, or the batch finished
+    IBatchJob* const* m_jobs = nullptr;
+    size_t m_count = 0;
+    size_t m_next = 0;                  // first job not yet collected once
+    size_t m_remaining = 0;
+    std::deque<Retry> m_retries;        // in poll order, as the interval is fixed
+    uint32_t m_running = 0;
+    BatchCopierStats m_stats;
+    bool m_stop = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,1421 @@
+#include "CaptureBenchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <thread>
+#include "BatchCopier.h"
+#include "CapturePipeline.h"
+#include "FrameBufferPool.h"
+#include "FrameRecording.h"
+#include "RowCopy.h"
+#include "StripCopier.h"
+#include "SyntheticCaptureSource.h"
+#include "TileDiff.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Frames a consumer may lease at once, as in SimpleCapture.
+    constexpr uint32_t BenchmarkLeases = 2;
+
+    std::vector<BenchmarkResolution> StandardResolutions()
+    {
+        return {
+            { "720p", 1280, 720 },
+            { "1080p", 1920, 1080 },
+            { "1440p", 2560, 1440 },
+            { "4k", 3840, 2160 },
+            { "8k", 7680, 4320 },
+        };
+    }
+
+    const char* FormatName(OutputFormat format)
+    {
+        switch (format)
+        {
+        case OutputFormat::Bgra: return "bgra";
+        case OutputFormat::Rgba: return "rgba";
+        case OutputFormat::Rgb24: return "rgb24";
+        case OutputFormat::Nv12: return "nv12";
+        case OutputFormat::I420: return "i420";
+        }
+        return "unknown";
+    }
+
+    const char* FilterName(ScaleFilter filter)
+    {
+        return filter == ScaleFilter::Bilinear ? "bilinear" : "box";
+    }
+
+    const char* SequenceName(TileDiffSequence sequence)
+    {
+        switch (sequence)
+        {
+        case TileDiffSequence::Static: return "static";
+        case TileDiffSequence::MostlyStatic: return "mostly_static";
+        case TileDiffSequence::Changing: return "changing";
+        }
+        return "unknown";
+    }
+
+    const char* PolicyName(FramePolicy policy)
+    {
+        switch (policy)
+        {
+        case FramePolicy::LatestWins: return "latest_wins";
+        case FramePolicy::Fifo: return "fifo";
+        case FramePolicy::DropOldest: return "drop_oldest";
+        }
+        return "unknown";
+    }
+
+    StageStats Summarize(LatencyHistogram const& histogram)
+    {
+        StageStats stats;
+        stats.Count = histogram.Count();
+        stats.MeanNs = histogram.Mean();
+        stats.P50Ns = histogram.Percentile(50);
+        stats.P95Ns = histogram.Percentile(95);
+        stats.P99Ns = histogram.Percentile(99);
+        stats.MaxNs = histogram.Max();
+        return stats;
+    }
+
+    CaptureBenchmarkResult RunCase(CaptureBenchmarkConfig const& config, BenchmarkResolution const& resolution, double consumerRate)
+    {
+        CaptureBenchmarkResult result;
+        result.Resolution = resolution;
+        result.ConsumerRate = consumerRate;
+        result.SourceRate = consumerRate > 0 ? config.SourceRate : 0;
+
+        SyntheticSourceConfig sourceConfig;
+        sourceConfig.Width = resolution.Width;
+        sourceConfig.Height = resolution.Height;
+        sourceConfig.FrameRate = result.SourceRate;
+        sourceConfig.QueueDepth = config.QueueDepth;
+        sourceConfig.Policy = config.Policy;
+        sourceConfig.Cursor = config.DrawCursor;
+
+        CaptureStats stats;
+        FrameDispatcher dispatcher;
+        SyntheticCaptureSource source(sourceConfig, &stats, &dispatcher);
+        CapturePipeline pipeline(source, stats, BenchmarkLeases);
+        pipeline.SetOutputFormat(config.Convert);
+        pipeline.SetScale(config.Scale);
+        pipeline.EnableDirtyRegions(config.DirtyRegions);
+        pipeline.SetDrawCursor(config.DrawCursor);
+        pipeline.SetTargetFrameRate(config.TargetFrameRate);
+
+        std::vector<uint8_t> output(GetOutputFrameSize(config.Convert.Format, resolution.Width, resolution.Height, 0));
+        uint64_t allocations = 1;
+        LatencyHistogram latency;
+        FrameEncoder encoder;
+        FrameDecoder decoder;
+        encoder.SetKeyframeInterval(config.KeyframeInterval);
+        std::vector<uint8_t> packet;
+        uint64_t encodedBytes = 0;
+        LatencyHistogram encodeLatency;
+        LatencyHistogram decodeLatency;
+
+        // Rate-limited cases give up after twice the time the frames should take.
+        double effectiveRate = consumerRate;
+        if (result.SourceRate > 0 && result.SourceRate < effectiveRate)
+            effectiveRate = result.SourceRate;
+        auto deadline = Clock::time_point::max();
+        if (effectiveRate > 0)
+            deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(2.0 * (config.FramesPerCase + config.WarmupFrames) / effectiveRate + 1.0));
+        auto period = consumerRate > 0 ?
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / consumerRate)) :
+            Clock::duration::zero();
+
+        source.StartCapture();
+        auto start = Clock::now();
+        auto next = start;
+        uint32_t warmup = config.WarmupFrames;
+        while (result.Frames < config.FramesPerCase && Clock::now() < deadline)
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            auto copyStart = Clock::now();
+            auto copied = pipeline.CopyImage(output.data(), output.size(), 0, width, height);
+            auto copyEnd = Clock::now();
+            if (copied == CopyResult::BufferTooSmall)
+            {
+                output.resize(GetOutputFrameSize(config.Convert.Format, width, height, 0));
+                allocations++;
+                continue;
+            }
+            if (warmup > 0)
+            {
+                if (copied == CopyResult::Ok && --warmup == 0)
+                {
+                    stats.Snapshot(true);
+                    start = Clock::now();
+                }
+            }
+            else
+            {
+                result.Polls++;
+                if (copied == CopyResult::Ok)
+                {
+                    result.Frames++;
+                    latency.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(copyEnd - copyStart).count()));
+                    if (config.Compress)
+                    {
+                        auto encodeStart = Clock::now();
+                        encoder.Encode(output.data(), GetOutputRowBytes(config.Convert.Format, width), config.Convert.Format, width, height, packet);
+                        auto decodeStart = Clock::now();
+                        decoder.Decode(packet.data(), packet.size());
+                        auto decodeEnd = Clock::now();
+                        encodedBytes += packet.size();
+                        encodeLatency.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(decodeStart - encodeStart).count()));
+                        decodeLatency.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(decodeEnd - decodeStart).count()));
+                    }
+                }
+            }
+
+            if (consumerRate > 0)
+            {
+                next += period;
+                auto now = Clock::now();
+                if (next < now)
+                    next = now;
+                std::this_thread::sleep_until(next);
+            }
+        }
+        result.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        pipeline.Reset();
+        source.Close();
+
+        result.FramesPerSecond = result.Seconds > 0 ? result.Frames / result.Seconds : 0;
+        result.FrameLatency = Summarize(latency);
+        result.Stats = stats.Snapshot();
+        result.Queue = source.GetFrameQueueStats();
+        result.BytesPerFrame = result.Frames == 0 ? 0 : result.Stats.BytesCopied / result.Frames;
+        result.Allocations = allocations + source.GetAllocations();
+        result.EncodedBytesPerFrame = result.Frames == 0 ? 0 : encodedBytes / result.Frames;
+        result.Encode = Summarize(encodeLatency);
+        result.Decode = Summarize(decodeLatency);
+        return result;
+    }
+
+    // A synthetic source and its pipeline, as one session of a batch.
+    class SyntheticBatchJob : public IBatchJob
+    {
+    public:
+        SyntheticBatchJob(SyntheticSourceConfig const& config, ConvertParams const& convert) :
+            m_source(config, &m_stats),
+            m_pipeline(m_source, m_stats, BenchmarkLeases)
+        {
+            m_pipeline.SetOutputFormat(convert);
+            m_output.resize(GetOutputFrameSize(convert.Format, config.Width, config.Height, 0));
+        }
+
+        CopyResult Copy()
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            return m_pipeline.CopyImage(m_output.data(), m_output.size(), 0, width, height);
+        }
+
+        void Submit() override { m_source.IssueCopy(); }
+
+        bool Collect() override
+        {
+            m_source.SetNonBlocking(true);
+            m_result = Copy();
+            bool pending = m_source.MapPending();
+            m_source.SetNonBlocking(false);
+            return m_result != CopyResult::NoFrame || !pending;
+        }
+
+        CopyResult Result() const { return m_result; }
+
+    private:
+        CaptureStats m_stats;
+        SyntheticCaptureSource m_source;
+        CapturePipeline m_pipeline;
+        std::vector<uint8_t> m_output;
+        CopyResult m_result = CopyResult::NoFrame;
+    };
+
+    BatchBenchmarkResult RunBatchCase(BatchBenchmarkConfig const& config, uint32_t sources, BatchCopier& copier)
+    {
+        BatchBenchmarkResult result;
+        result.Sources = sources;
+        result.Threads = copier.Threads();
+
+        SyntheticSourceConfig sourceConfig;
+        sourceConfig.Width = config.Resolution.Width;
+        sourceConfig.Height = config.Resolution.Height;
+        sourceConfig.ReadbackLatency = config.ReadbackLatency;
+        // One frame queued, one in the copy and one being rendered is all an
+        // on-demand source needs, and keeps 32 of them within reason.
+        sourceConfig.PoolBuffers = 3;
+
+        std::vector<std::unique_ptr<SyntheticBatchJob>> jobs;
+        std::vector<IBatchJob*> batch;
+        for (uint32_t i = 0; i < sources; i++)
+        {
+            jobs.push_back(std::make_unique<SyntheticBatchJob>(sourceConfig, config.Convert));
+            batch.push_back(jobs.back().get());
+        }
+
+        LatencyHistogram sequential;
+        uint64_t sequentialFrames = 0;
+        double sequentialSeconds = 0;
+        for (uint32_t round = 0; round < config.WarmupRounds + config.Rounds; round++)
+        {
+            uint64_t frames = 0;
+            auto start = Clock::now();
+            for (auto& job : jobs)
+                frames += job->Copy() == CopyResult::Ok ? 1 : 0;
+            auto elapsed = Clock::now() - start;
+            if (round < config.WarmupRounds)
+                continue;
+            sequential.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            sequentialFrames += frames;
+            sequentialSeconds += std::chrono::duration<double>(elapsed).count();
+        }
+
+        LatencyHistogram batched;
+        uint64_t batchFrames = 0;
+        double batchSeconds = 0;
+        auto before = copier.Stats();
+        for (uint32_t round = 0; round < config.WarmupRounds + config.Rounds; round++)
+        {
+            auto start = Clock::now();
+            copier.Run(batch.data(), batch.size());
+            auto elapsed = Clock::now() - start;
+            if (round < config.WarmupRounds)
+                continue;
+            batched.Record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            for (auto& job : jobs)
+                batchFrames += job->Result() == CopyResult::Ok ? 1 : 0;
+            batchSeconds += std::chrono::duration<double>(elapsed).count();
+        }
+        auto after = copier.Stats();
+
+        result.Sequential = Summarize(sequential);
+        result.Batch = Summarize(batched);
+        result.SequentialFramesPerSecond = sequentialSeconds > 0 ? sequentialFrames / sequentialSeconds : 0;
+        result.BatchFramesPerSecond = batchSeconds > 0 ? batchFrames / batchSeconds : 0;
+        result.Speedup = result.SequentialFramesPerSecond > 0 ? result.BatchFramesPerSecond / result.SequentialFramesPerSecond : 0;
+        result.Polls = after.Polls - before.Polls;
+        result.MaxConcurrent = after.MaxConcurrent;
+        return result;
+    }
+
+    constexpr size_t BufferPoolHeldBytes = 512u << 20;
+
+    // Where written heap buffers escape to, so the writes can't be optimised out.
+    uint8_t* volatile g_written = nullptr;
+
+    uint64_t ElapsedNs(Clock::time_point start)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    }
+
+    BufferPoolBenchmarkResult RunBufferPoolCase(BufferPoolBenchmarkConfig const& config, BenchmarkResolution const& resolution)
+    {
+        BufferPoolBenchmarkResult result;
+        result.Resolution = resolution;
+        size_t bytes = GetOutputFrameSize(OutputFormat::Bgra, resolution.Width, resolution.Height, 0);
+        result.FrameBytes = bytes;
+
+        LatencyHistogram heapWrite;
+        LatencyHistogram poolAllocate;
+        LatencyHistogram poolWrite;
+        LatencyHistogram poolReuse;
+        LatencyHistogram reuseWrite;
+        // Buffers are held on to for a while, or the allocator would hand
+        // the one just freed straight back, faulted in already.
+        std::vector<std::unique_ptr<uint8_t[]>> held;
+        for (uint32_t i = 0; i < config.Iterations; i++)
+        {
+            if ((held.size() + 1) * bytes > BufferPoolHeldBytes)
+                held.clear();
+            auto start = Clock::now();
+            held.emplace_back(new uint8_t[bytes]);
+            std::memset(held.back().get(), static_cast<int>(i), bytes);
+            g_written = held.back().get();
+            heapWrite.Record(ElapsedNs(start));
+        }
+        held.clear();
+        for (uint32_t i = 0; i < config.Iterations; i++)
+        {
+            // A pool of its own each time, so nothing is cached.
+            FrameBufferPool pool(config.LargePages);
+            size_t capacity = 0;
+            auto start = Clock::now();
+            auto buffer = pool.Acquire(bytes, &capacity);
+            poolAllocate.Record(ElapsedNs(start));
+            if (buffer == nullptr)
+                break;
+            start = Clock::now();
+            std::memset(buffer, static_cast<int>(i), bytes);
+            poolWrite.Record(ElapsedNs(start));
+            result.BufferBytes = capacity;
+            result.LargePages = pool.Stats().LargePageBuffers != 0;
+        }
+        FrameBufferPool pool(config.LargePages);
+        pool.Release(pool.Acquire(bytes));
+        for (uint32_t i = 0; i < config.Iterations; i++)
+        {
+            auto start = Clock::now();
+            auto buffer = pool.Acquire(bytes);
+            poolReuse.Record(ElapsedNs(start));
+            if (buffer == nullptr)
+                break;
+            start = Clock::now();
+            std::memset(buffer, static_cast<int>(i), bytes);
+            reuseWrite.Record(ElapsedNs(start));
+            pool.Release(buffer);
+        }
+
+        result.HeapFirstWrite = Summarize(heapWrite);
+        result.PoolAllocate = Summarize(poolAllocate);
+        result.PoolFirstWrite = Summarize(poolWrite);
+        result.PoolReuse = Summarize(poolReuse);
+        result.PoolReuseWrite = Summarize(reuseWrite);
+        return result;
+    }
+
+    StripBenchmarkResult RunStripCase(StripBenchmarkConfig const& config, BenchmarkResolution const& resolution, uint32_t threads)
+    {
+        StripBenchmarkResult result;
+        result.Resolution = resolution;
+
+        // Rows padded as staging textures are, and every byte written before
+        // timing starts so no page faults land in it.
+        size_t srcStride = (static_cast<size_t>(resolution.Width) * 4 + 255) / 256 * 256;
+        std::vector<uint8_t> src(srcStride * resolution.Height);
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = static_cast<uint8_t>(i * 7);
+        size_t dstStride = GetOutputRowBytes(config.Convert.Format, resolution.Width);
+        size_t bytes = GetOutputFrameSize(config.Convert.Format, resolution.Width, resolution.Height, dstStride);
+        std::vector<uint8_t> dst(bytes);
+
+        StripCopierConfig copierConfig;
+        copierConfig.Threads = threads;
+        copierConfig.MinParallelBytes = 0;
+        StripCopier copier(copierConfig);
+        result.Threads = copier.Threads();
+
+        // One frame first, so the workers have run once.
+        copier.Convert(dst.data(), dstStride, src.data(), srcStride, resolution.Width, resolution.Height, config.Convert);
+        auto warm = copier.Stats();
+        LatencyHistogram copy;
+        for (uint32_t i = 0; i < config.Frames; i++)
+        {
+            auto start = Clock::now();
+            copier.Convert(dst.data(), dstStride, src.data(), srcStride, resolution.Width, resolution.Height, config.Convert);
+            copy.Record(ElapsedNs(start));
+        }
+        g_written = dst.data();
+
+        auto stats = copier.Stats();
+        if (config.Frames != 0)
+            result.Strips = (stats.Strips - warm.Strips) / config.Frames;
+        result.Copy = Summarize(copy);
+        if (result.Copy.P50Ns != 0)
+        {
+            double moved = static_cast<double>(static_cast<size_t>(resolution.Width) * 4 * resolution.Height + bytes);
+            result.GigabytesPerSecond = moved / static_cast<double>(result.Copy.P50Ns);
+        }
+        return result;
+    }
+
+    RowCopyBenchmarkResult RunRowCopyCase(RowCopyBenchmarkConfig const& config, BenchmarkResolution const& resolution,
+        const char* kernel, bool memcpyRows)
+    {
+        RowCopyBenchmarkResult result;
+        result.Resolution = resolution;
+        result.Kernel = kernel;
+
+        size_t rowBytes = static_cast<size_t>(resolution.Width) * 4;
+        size_t srcStride = (rowBytes + 255) / 256 * 256;
+        std::vector<uint8_t> src(srcStride * resolution.Height);
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = static_cast<uint8_t>(i * 13);
+        std::vector<uint8_t> dst(rowBytes * resolution.Height);
+
+        LatencyHistogram copy;
+        // One round first, so neither buffer faults while timed.
+        for (uint32_t i = 0; i <= config.Iterations; i++)
+        {
+            auto start = Clock::now();
+            if (memcpyRows)
+            {
+                for (uint32_t y = 0; y < resolution.Height; y++)
+                    std::memcpy(dst.data() + y * rowBytes, src.data() + y * srcStride, rowBytes);
+            }
+            else
+            {
+                CopyRows(dst.data(), rowBytes, src.data(), srcStride, rowBytes, resolution.Height);
+            }
+            if (i != 0)
+                copy.Record(ElapsedNs(start));
+        }
+        g_written = dst.data();
+
+        result.Copy = Summarize(copy);
+        if (result.Copy.P50Ns != 0)
+            result.GigabytesPerSecond = static_cast<double>(dst.size()) / static_cast<double>(result.Copy.P50Ns);
+        return result;
+    }
+
+    ConvertBenchmarkResult RunConvertCase(ConvertBenchmarkConfig const& config, BenchmarkResolution const& resolution,
+        OutputFormat format)
+    {
+        ConvertBenchmarkResult result;
+        result.Resolution = resolution;
+        result.Format = format;
+        result.Kernel = GetRowCopyKernelName(GetRowCopyKernel());
+
+        size_t srcStride = (static_cast<size_t>(resolution.Width) * 4 + 255) / 256 * 256;
+        std::vector<uint8_t> src(srcStride * resolution.Height);
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = static_cast<uint8_t>(i * 13);
+        size_t dstStride = GetOutputRowBytes(format, resolution.Width);
+        std::vector<uint8_t> dst(GetOutputFrameSize(format, resolution.Width, resolution.Height, dstStride));
+
+        ConvertParams params;
+        params.Format = format;
+        params.Matrix = config.Matrix;
+        params.Range = config.Range;
+        LatencyHistogram convert;
+        // One round first, so neither buffer faults while timed.
+        for (uint32_t i = 0; i <= config.Iterations; i++)
+        {
+            auto start = Clock::now();
+            ConvertFrame(dst.data(), dstStride, src.data(), srcStride, resolution.Width, resolution.Height, params);
+            if (i != 0)
+                convert.Record(ElapsedNs(start));
+        }
+        g_written = dst.data();
+
+        result.Convert = Summarize(convert);
+        if (result.Convert.P50Ns != 0)
+        {
+            double moved = static_cast<double>(static_cast<size_t>(resolution.Width) * 4 * resolution.Height + dst.size());
+            result.GigabytesPerSecond = moved / static_cast<double>(result.Convert.P50Ns);
+        }
+        return result;
+    }
+
+    TileDiffBenchmarkResult RunTileDiffCase(TileDiffBenchmarkConfig const& config, BenchmarkResolution const& resolution,
+        TileDiffSequence sequence)
+    {
+        TileDiffBenchmarkResult result;
+        result.Resolution = resolution;
+        result.Sequence = sequence;
+        uint32_t tilesWide = (resolution.Width + TileDiffer::TileSize - 1) / TileDiffer::TileSize;
+        uint32_t tilesHigh = (resolution.Height + TileDiffer::TileSize - 1) / TileDiffer::TileSize;
+        result.Tiles = tilesWide * tilesHigh;
+
+        size_t rowBytes = static_cast<size_t>(resolution.Width) * 4;
+        size_t stride = (rowBytes + 255) / 256 * 256;
+        std::vector<uint8_t> frame(stride * resolution.Height);
+        SyntheticCaptureSource::RenderFrame(frame.data(), stride, resolution.Width, resolution.Height, config.BoxSize, 0);
+
+        TileDiffer differ;
+        // The first frame fills the reference and is all dirty; leave it out.
+        differ.Update(frame.data(), stride, resolution.Width, resolution.Height);
+        LatencyHistogram update;
+        uint64_t dirtyTiles = 0;
+        uint64_t dirtyRects = 0;
+        for (uint32_t i = 1; i <= config.Frames; i++)
+        {
+            if (sequence == TileDiffSequence::MostlyStatic)
+            {
+                SyntheticCaptureSource::RenderFrame(frame.data(), stride, resolution.Width, resolution.Height, config.BoxSize, i);
+            }
+            else if (sequence == TileDiffSequence::Changing)
+            {
+                for (uint32_t y = 0; y < resolution.Height; y++)
+                    std::memset(frame.data() + y * stride, static_cast<int>(i + y), rowBytes);
+            }
+            auto start = Clock::now();
+            bool identical = differ.Update(frame.data(), stride, resolution.Width, resolution.Height);
+            update.Record(ElapsedNs(start));
+            if (identical)
+                result.IdenticalFrames++;
+            dirtyTiles += differ.DirtyTileCount();
+            dirtyRects += differ.DirtyRects().size();
+        }
+
+        result.Update = Summarize(update);
+        if (result.Update.P50Ns != 0)
+            result.GigabytesPerSecond = static_cast<double>(rowBytes * resolution.Height) / static_cast<double>(result.Update.P50Ns);
+        if (config.Frames != 0)
+        {
+            result.DirtyTiles = static_cast<double>(dirtyTiles) / config.Frames;
+            result.DirtyRects = static_cast<double>(dirtyRects) / config.Frames;
+        }
+        return result;
+    }
+
+    struct ReferenceTap
+    {
+        uint32_t Index;
+        double Weight;
+    };
+
+    // Source pixels and weights behind each of dst outputs along one axis:
+    // the exact area for box, the two neighbours of the aligned centre for
+    // bilinear. Only for downscaling.
+    std::vector<std::vector<ReferenceTap>> ReferenceTaps(uint32_t dst, uint32_t src, ScaleFilter filter)
+    {
+        std::vector<std::vector<ReferenceTap>> taps(dst);
+        double ratio = static_cast<double>(src) / dst;
+        for (uint32_t i = 0; i < dst; i++)
+        {
+            if (filter == ScaleFilter::Box)
+            {
+                double start = i * ratio;
+                double end = (i + 1) * ratio;
+                for (uint32_t j = static_cast<uint32_t>(start); j < src && j < end; j++)
+                {
+                    double overlap = std::min<double>(j + 1, end) - std::max<double>(j, start);
+                    if (overlap > 0)
+                        taps[i].push_back({ j, overlap / ratio });
+                }
+            }
+            else
+            {
+                double pos = std::min(std::max((i + 0.5) * ratio - 0.5, 0.0), static_cast<double>(src - 1));
+                auto index = static_cast<uint32_t>(pos);
+                double weight = pos - index;
+                taps[i].push_back({ index, 1 - weight });
+                if (weight > 0)
+                    taps[i].push_back({ index + 1, weight });
+            }
+        }
+        return taps;
+    }
+
+    // Compare scaled against a double precision resampling of src into a
+    // dstWidth x dstHeight frame with packed rows.
+    void MeasureScaleError(ScaleBenchmarkResult& result, const uint8_t* scaled, const uint8_t* src, size_t srcStride,
+        uint32_t srcWidth, uint32_t srcHeight, uint32_t dstWidth, uint32_t dstHeight, ScaleFilter filter)
+    {
+        auto xTaps = ReferenceTaps(dstWidth, srcWidth, filter);
+        auto yTaps = ReferenceTaps(dstHeight, srcHeight, filter);
+        std::vector<double> row(static_cast<size_t>(srcWidth) * 4);
+        double squared = 0;
+        uint32_t maxError = 0;
+        for (uint32_t y = 0; y < dstHeight; y++)
+        {
+            std::fill(row.begin(), row.end(), 0.0);
+            for (auto const& tap : yTaps[y])
+            {
+                const uint8_t* line = src + tap.Index * srcStride;
+                for (size_t i = 0; i < row.size(); i++)
+                    row[i] += line[i] * tap.Weight;
+            }
+            const uint8_t* out = scaled + static_cast<size_t>(y) * dstWidth * 4;
+            for (uint32_t x = 0; x < dstWidth; x++)
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    double value = 0;
+                    for (auto const& tap : xTaps[x])
+                        value += row[tap.Index * 4 + c] * tap.Weight;
+                    double error = out[x * 4 + c] - value;
+                    squared += error * error;
+                    auto rounded = static_cast<uint32_t>(std::fabs(error) + 0.5);
+                    maxError = rounded > maxError ? rounded : maxError;
+                }
+            }
+        }
+        double mse = squared / (static_cast<double>(dstWidth) * dstHeight * 4);
+        // Capped, so an exact match still makes valid JSON.
+        result.Psnr = mse > 0 ? std::min(10 * std::log10(255.0 * 255.0 / mse), 100.0) : 100.0;
+        result.MaxError = maxError;
+    }
+
+    ScaleBenchmarkResult RunScaleCase(ScaleBenchmarkConfig const& config, BenchmarkResolution const& resolution,
+        BenchmarkResolution const& output, ScaleFilter filter)
+    {
+        ScaleBenchmarkResult result;
+        result.Resolution = resolution;
+        result.Output = output;
+        result.Filter = filter;
+
+        size_t srcStride = (static_cast<size_t>(resolution.Width) * 4 + 255) / 256 * 256;
+        std::vector<uint8_t> src(srcStride * resolution.Height);
+        SyntheticCaptureSource::RenderFrame(src.data(), srcStride, resolution.Width, resolution.Height, resolution.Height / 4, 1);
+        size_t dstStride = static_cast<size_t>(output.Width) * 4;
+        std::vector<uint8_t> dst(dstStride * output.Height);
+
+        FrameScaler scaler;
+        LatencyHistogram scale;
+        // One round first, so the buffers and filter tables are in place.
+        for (uint32_t i = 0; i <= config.Iterations; i++)
+        {
+            auto start = Clock::now();
+            scaler.Scale(dst.data(), dstStride, output.Width, output.Height,
+                src.data(), srcStride, resolution.Width, resolution.Height, filter);
+            if (i != 0)
+                scale.Record(ElapsedNs(start));
+        }
+        g_written = dst.data();
+
+        result.Scale = Summarize(scale);
+        if (result.Scale.P50Ns != 0)
+        {
+            double read = static_cast<double>(static_cast<size_t>(resolution.Width) * 4 * resolution.Height);
+            result.GigabytesPerSecond = read / static_cast<double>(result.Scale.P50Ns);
+        }
+        MeasureScaleError(result, dst.data(), src.data(), srcStride, resolution.Width, resolution.Height,
+            output.Width, output.Height, filter);
+        return result;
+    }
+
+    RecordingBenchmarkResult RunRecordingCase(RecordingBenchmarkConfig const& config, BenchmarkResolution const& resolution,
+        OutputFormat format, std::string const& path)
+    {
+        RecordingBenchmarkResult result;
+        result.Resolution = resolution;
+        result.Format = format;
+
+        // Two synthetic frames in the output format, alternated, with rows
+        // padded as staging textures are.
+        size_t srcStride = (GetOutputRowBytes(format, resolution.Width) + 255) / 256 * 256;
+        size_t srcBytes = GetOutputFrameSize(format, resolution.Width, resolution.Height, srcStride);
+        size_t bgraStride = static_cast<size_t>(resolution.Width) * 4;
+        std::vector<uint8_t> bgra(bgraStride * resolution.Height);
+        std::vector<uint8_t> frames[2];
+        ConvertParams convert;
+        convert.Format = format;
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            SyntheticCaptureSource::RenderFrame(bgra.data(), bgraStride, resolution.Width, resolution.Height, 128, i);
+            frames[i].resize(srcBytes);
+            ConvertFrame(frames[i].data(), srcStride, bgra.data(), bgraStride, resolution.Width, resolution.Height, convert);
+        }
+        result.FrameBytes = GetOutputFrameSize(format, resolution.Width, resolution.Height, 0);
+
+        RecordingConfig recordingConfig;
+        recordingConfig.Format = format;
+        recordingConfig.MaxWidth = resolution.Width;
+        recordingConfig.MaxHeight = resolution.Height;
+        recordingConfig.MaxFrames = config.Frames;
+        FrameRecorder recorder;
+        if (!recorder.Open(path, recordingConfig))
+            return result;
+
+        LatencyHistogram append;
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < config.Frames; i++)
+        {
+            FrameTiming timing;
+            timing.FrameIndex = i;
+            auto appendStart = Clock::now();
+            recorder.Append(frames[i % 2].data(), srcStride, format, resolution.Width, resolution.Height, timing, RecordedFrameDirty);
+            append.Record(ElapsedNs(appendStart));
+        }
+        result.Frames = recorder.Recorded();
+        bool closed = recorder.Close();
+        result.RecordSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::error_code error;
+        result.FileBytes = std::filesystem::file_size(path, error);
+        result.Append = Summarize(append);
+        if (result.Append.P50Ns != 0)
+            result.AppendGigabytesPerSecond = static_cast<double>(result.FrameBytes) / static_cast<double>(result.Append.P50Ns);
+        if (result.RecordSeconds > 0)
+            result.SustainedGigabytesPerSecond = static_cast<double>(result.FrameBytes * result.Frames) / result.RecordSeconds / 1e9;
+
+        // Read back in random order, checking each frame against what went in.
+        std::vector<uint64_t> order(result.Frames);
+        for (uint64_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), std::mt19937(7));
+        std::vector<uint8_t> packed[2];
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            packed[i].resize(static_cast<size_t>(result.FrameBytes));
+            CopyOutputFrame(packed[i].data(), GetOutputRowBytes(format, resolution.Width), frames[i].data(), srcStride,
+                format, resolution.Width, resolution.Height);
+        }
+        std::vector<uint8_t> dst(static_cast<size_t>(result.FrameBytes));
+        FrameRecordingReader reader;
+        bool verified = closed && reader.Open(path) && reader.Complete() && reader.FrameCount() == config.Frames;
+        LatencyHistogram read;
+        for (auto index : order)
+        {
+            RecordingIndexEntry entry;
+            auto readStart = Clock::now();
+            bool copied = reader.CopyFrame(index, dst.data(), dst.size(), 0, entry);
+            read.Record(ElapsedNs(readStart));
+            verified = verified && copied && entry.FrameIndex == index && dst == packed[index % 2];
+        }
+        reader.Close();
+        std::filesystem::remove(path, error);
+
+        result.Read = Summarize(read);
+        if (result.Read.P50Ns != 0)
+            result.ReadGigabytesPerSecond = static_cast<double>(result.FrameBytes) / static_cast<double>(result.Read.P50Ns);
+        result.Verified = verified;
+        return result;
+    }
+
+    CodecBenchmarkResult RunCodecCase(CodecBenchmarkConfig const& config, BenchmarkResolution const& resolution,
+        TileDiffSequence sequence)
+    {
+        CodecBenchmarkResult result;
+        result.Resolution = resolution;
+        result.Sequence = sequence;
+
+        size_t bgraStride = static_cast<size_t>(resolution.Width) * 4;
+        std::vector<uint8_t> bgra(bgraStride * resolution.Height);
+        size_t stride = GetOutputRowBytes(config.Format, resolution.Width);
+        size_t bytes = GetOutputFrameSize(config.Format, resolution.Width, resolution.Height, stride);
+        std::vector<uint8_t> frame(bytes);
+        std::vector<uint8_t> decoded(bytes);
+        ConvertParams convert;
+        convert.Format = config.Format;
+        result.FrameBytes = bytes;
+
+        FrameEncoder encoder;
+        encoder.SetKeyframeInterval(config.KeyframeInterval);
+        FrameDecoder decoder;
+        std::vector<uint8_t> packet;
+        packet.reserve(GetMaxEncodedSize(config.Format, resolution.Width, resolution.Height));
+        LatencyHistogram encode;
+        LatencyHistogram decode;
+        uint64_t keyBytes = 0;
+        uint64_t deltaBytes = 0;
+        uint32_t state = 0x9E3779B9u;
+        bool verified = true;
+        for (uint32_t i = 0; i < config.Frames; i++)
+        {
+            // Frames are drawn outside the timing.
+            if (i == 0 || sequence == TileDiffSequence::MostlyStatic)
+            {
+                SyntheticCaptureSource::RenderFrame(bgra.data(), bgraStride, resolution.Width, resolution.Height, config.BoxSize, i);
+                ConvertFrame(frame.data(), stride, bgra.data(), bgraStride, resolution.Width, resolution.Height, convert);
+            }
+            else if (sequence == TileDiffSequence::Changing)
+            {
+                for (auto& byte : frame)
+                {
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    byte = static_cast<uint8_t>(state);
+                }
+            }
+
+            auto start = Clock::now();
+            encoder.Encode(frame.data(), stride, config.Format, resolution.Width, resolution.Height, packet);
+            encode.Record(ElapsedNs(start));
+            EncodedFrameHeader header;
+            if (FrameDecoder::ReadHeader(packet.data(), packet.size(), header) && (header.Flags & EncodedKeyframe) != 0)
+                keyBytes += packet.size();
+            else
+                deltaBytes += packet.size();
+
+            start = Clock::now();
+            bool ok = decoder.Decode(packet.data(), packet.size()) == DecodeResult::Ok;
+            decode.Record(ElapsedNs(start));
+            verified = verified && ok && decoder.CopyFrame(decoded.data(), decoded.size(), 0) && decoded == frame;
+        }
+
+        result.Keyframes = encoder.Keyframes();
+        uint64_t deltas = encoder.Frames() - encoder.Keyframes();
+        result.KeyframeBytes = result.Keyframes != 0 ? keyBytes / result.Keyframes : 0;
+        result.DeltaBytes = deltas != 0 ? deltaBytes / deltas : 0;
+        if (keyBytes + deltaBytes != 0)
+            result.Ratio = static_cast<double>(bytes * encoder.Frames()) / static_cast<double>(keyBytes + deltaBytes);
+        result.Encode = Summarize(encode);
+        result.Decode = Summarize(decode);
+        if (result.Encode.P50Ns != 0)
+            result.EncodeGigabytesPerSecond = static_cast<double>(bytes) / static_cast<double>(result.Encode.P50Ns);
+        if (result.Decode.P50Ns != 0)
+            result.DecodeGigabytesPerSecond = static_cast<double>(bytes) / static_cast<double>(result.Decode.P50Ns);
+        result.Verified = verified && config.Frames != 0;
+        return result;
+    }
+
+    void AppendFormat(std::string& out, const char* format, ...)
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (written > 0)
+            out.append(buffer, written < static_cast<int>(sizeof(buffer)) ? written : sizeof(buffer) - 1);
+    }
+
+    void AppendStage(std::string& out, const char* name, StageStats const& stage)
+    {
+        AppendFormat(out, "\"%s\":{\"count\":%llu,\"mean\":%llu,\"p50\":%llu,\"p95\":%llu,\"p99\":%llu,\"max\":%llu}",
+            name,
+            static_cast<unsigned long long>(stage.Count),
+            static_cast<unsigned long long>(stage.MeanNs),
+            static_cast<unsigned long long>(stage.P50Ns),
+            static_cast<unsigned long long>(stage.P95Ns),
+            static_cast<unsigned long long>(stage.P99Ns),
+            static_cast<unsigned long long>(stage.MaxNs));
+    }
+}
+
+std::vector<CaptureBenchmarkResult> RunCaptureBenchmark(CaptureBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions.empty() ? StandardResolutions() : config.Resolutions;
+    auto rates = config.ConsumerRates.empty() ? std::vector<double>{ 0, 60, 30 } : config.ConsumerRates;
+
+    std::vector<CaptureBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        for (double rate : rates)
+            results.push_back(RunCase(config, resolution, rate));
+    }
+    return results;
+}
+
+std::vector<BatchBenchmarkResult> RunBatchBenchmark(BatchBenchmarkConfig const& config)
+{
+    auto counts = config.SourceCounts.empty() ? std::vector<uint32_t>{ 1, 2, 4, 8, 16, 32 } : config.SourceCounts;
+    BatchCopier copier(config.Threads);
+    std::vector<BatchBenchmarkResult> results;
+    for (auto count : counts)
+    {
+        if (count != 0)
+            results.push_back(RunBatchCase(config, count, copier));
+    }
+    return results;
+}
+
+std::string BatchBenchmarkToJson(BatchBenchmarkConfig const& config, std::vector<BatchBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"format\":\"%s\",\"readback_latency_us\":%lld,\"rounds\":%u,\"cases\":[",
+        config.Resolution.Name,
+        config.Resolution.Width,
+        config.Resolution.Height,
+        FormatName(config.Convert.Format),
+        static_cast<long long>(config.ReadbackLatency.count()),
+        config.Rounds);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"sources\":%u,\"threads\":%u,\"sequential_fps\":%.3f,\"batch_fps\":%.3f,\"speedup\":%.3f,\"polls\":%llu,\"max_concurrent\":%u,",
+            result.Sources,
+            result.Threads,
+            result.SequentialFramesPerSecond,
+            result.BatchFramesPerSecond,
+            result.Speedup,
+            static_cast<unsigned long long>(result.Polls),
+            result.MaxConcurrent);
+        AppendStage(out, "sequential_round_ns", result.Sequential);
+        out += ',';
+        AppendStage(out, "batch_round_ns", result.Batch);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<BufferPoolBenchmarkResult> RunBufferPoolBenchmark(BufferPoolBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions.empty() ? StandardResolutions() : config.Resolutions;
+    std::vector<BufferPoolBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+        results.push_back(RunBufferPoolCase(config, resolution));
+    return results;
+}
+
+std::string BufferPoolBenchmarkToJson(BufferPoolBenchmarkConfig const& config, std::vector<BufferPoolBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"iterations\":%u,\"large_pages_requested\":%s,\"large_page_size\":%llu,\"cases\":[",
+        config.Iterations,
+        config.LargePages ? "true" : "false",
+        static_cast<unsigned long long>(FrameBufferPool::LargePageSize()));
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"frame_bytes\":%llu,\"buffer_bytes\":%llu,\"large_pages\":%s,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            static_cast<unsigned long long>(result.FrameBytes),
+            static_cast<unsigned long long>(result.BufferBytes),
+            result.LargePages ? "true" : "false");
+        AppendStage(out, "heap_first_write_ns", result.HeapFirstWrite);
+        out += ',';
+        AppendStage(out, "pool_allocate_ns", result.PoolAllocate);
+        out += ',';
+        AppendStage(out, "pool_first_write_ns", result.PoolFirstWrite);
+        out += ',';
+        AppendStage(out, "pool_reuse_ns", result.PoolReuse);
+        out += ',';
+        AppendStage(out, "pool_reuse_write_ns", result.PoolReuseWrite);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<StripBenchmarkResult> RunStripBenchmark(StripBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions.empty() ? StandardResolutions() : config.Resolutions;
+    auto threadCounts = config.ThreadCounts.empty() ? std::vector<uint32_t>{ 1, 2, 4, 8, 16 } : config.ThreadCounts;
+    std::vector<StripBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        uint64_t baseline = 0;
+        for (auto threads : threadCounts)
+        {
+            auto result = RunStripCase(config, resolution, threads);
+            if (baseline == 0)
+                baseline = result.Copy.P50Ns;
+            if (result.Copy.P50Ns != 0)
+                result.Speedup = static_cast<double>(baseline) / static_cast<double>(result.Copy.P50Ns);
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+std::string StripBenchmarkToJson(StripBenchmarkConfig const& config, std::vector<StripBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"format\":\"%s\",\"frames\":%u,\"hardware_threads\":%u,\"cases\":[",
+        FormatName(config.Convert.Format),
+        config.Frames,
+        std::thread::hardware_concurrency());
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"threads\":%u,\"strips\":%llu,\"gb_per_s\":%.3f,\"speedup\":%.3f,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            result.Threads,
+            static_cast<unsigned long long>(result.Strips),
+            result.GigabytesPerSecond,
+            result.Speedup);
+        AppendStage(out, "copy_ns", result.Copy);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<RowCopyBenchmarkResult> RunRowCopyBenchmark(RowCopyBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions;
+    if (resolutions.empty())
+    {
+        auto standard = StandardResolutions();
+        resolutions.assign(standard.begin() + 1, standard.begin() + 4);
+    }
+    auto active = GetRowCopyKernel();
+    std::vector<RowCopyBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        auto baseline = RunRowCopyCase(config, resolution, "memcpy", true);
+        baseline.Speedup = 1;
+        results.push_back(baseline);
+        for (auto kernel : { RowCopyKernel::Scalar, RowCopyKernel::Sse41, RowCopyKernel::Avx2 })
+        {
+            // Kernels the CPU lacks fall back to another; skip them.
+            if (SetRowCopyKernel(kernel) != kernel)
+                continue;
+            auto result = RunRowCopyCase(config, resolution, GetRowCopyKernelName(kernel), false);
+            if (result.Copy.P50Ns != 0)
+                result.Speedup = static_cast<double>(baseline.Copy.P50Ns) / static_cast<double>(result.Copy.P50Ns);
+            results.push_back(result);
+        }
+    }
+    SetRowCopyKernel(active);
+    return results;
+}
+
+std::string RowCopyBenchmarkToJson(RowCopyBenchmarkConfig const& config, std::vector<RowCopyBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"iterations\":%u,\"active_kernel\":\"%s\",\"cases\":[",
+        config.Iterations,
+        GetRowCopyKernelName(GetRowCopyKernel()));
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"kernel\":\"%s\",\"gb_per_s\":%.3f,\"speedup\":%.3f,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            result.Kernel,
+            result.GigabytesPerSecond,
+            result.Speedup);
+        AppendStage(out, "copy_ns", result.Copy);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<ConvertBenchmarkResult> RunConvertBenchmark(ConvertBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions;
+    if (resolutions.empty())
+    {
+        auto standard = StandardResolutions();
+        resolutions.assign(standard.begin(), standard.begin() + 4);
+    }
+    auto formats = config.Formats;
+    if (formats.empty())
+        formats = { OutputFormat::Bgra, OutputFormat::Rgba, OutputFormat::Rgb24, OutputFormat::Nv12, OutputFormat::I420 };
+
+    auto active = GetRowCopyKernel();
+    auto best = SetRowCopyKernel(RowCopyKernel::Avx2);
+    std::vector<ConvertBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        for (auto format : formats)
+        {
+            SetRowCopyKernel(RowCopyKernel::Scalar);
+            auto scalar = RunConvertCase(config, resolution, format);
+            scalar.Speedup = 1;
+            results.push_back(scalar);
+            if (best == RowCopyKernel::Scalar)
+                continue;
+            SetRowCopyKernel(best);
+            auto result = RunConvertCase(config, resolution, format);
+            if (result.Convert.P50Ns != 0)
+                result.Speedup = static_cast<double>(scalar.Convert.P50Ns) / static_cast<double>(result.Convert.P50Ns);
+            results.push_back(result);
+        }
+    }
+    SetRowCopyKernel(active);
+    return results;
+}
+
+std::string ConvertBenchmarkToJson(ConvertBenchmarkConfig const& config, std::vector<ConvertBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"iterations\":%u,\"matrix\":\"%s\",\"range\":\"%s\",\"cases\":[",
+        config.Iterations,
+        config.Matrix == YuvMatrix::Bt709 ? "bt709" : "bt601",
+        config.Range == YuvRange::Full ? "full" : "limited");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"format\":\"%s\",\"kernel\":\"%s\",\"gb_per_s\":%.3f,\"speedup\":%.3f,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            FormatName(result.Format),
+            result.Kernel,
+            result.GigabytesPerSecond,
+            result.Speedup);
+        AppendStage(out, "convert_ns", result.Convert);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<TileDiffBenchmarkResult> RunTileDiffBenchmark(TileDiffBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions;
+    if (resolutions.empty())
+    {
+        auto standard = StandardResolutions();
+        resolutions.assign(standard.begin(), standard.begin() + 4);
+    }
+    auto sequences = config.Sequences;
+    if (sequences.empty())
+        sequences = { TileDiffSequence::Static, TileDiffSequence::MostlyStatic, TileDiffSequence::Changing };
+
+    std::vector<TileDiffBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        for (auto sequence : sequences)
+            results.push_back(RunTileDiffCase(config, resolution, sequence));
+    }
+    return results;
+}
+
+std::string TileDiffBenchmarkToJson(TileDiffBenchmarkConfig const& config, std::vector<TileDiffBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"frames\":%u,\"tile_size\":%u,\"box_size\":%u,\"cases\":[",
+        config.Frames,
+        TileDiffer::TileSize,
+        config.BoxSize);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"sequence\":\"%s\",\"gb_per_s\":%.3f,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            SequenceName(result.Sequence),
+            result.GigabytesPerSecond);
+        AppendFormat(out, "\"tiles\":%u,\"dirty_tiles\":%.2f,\"dirty_rects\":%.2f,\"identical_frames\":%llu,",
+            result.Tiles,
+            result.DirtyTiles,
+            result.DirtyRects,
+            static_cast<unsigned long long>(result.IdenticalFrames));
+        AppendStage(out, "update_ns", result.Update);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::string CaptureBenchmarkToJson(CaptureBenchmarkConfig const& config, std::vector<CaptureBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"format\":\"%s\",\"scale\":{\"width\":%u,\"height\":%u,\"filter\":\"%s\"},\"dirty_regions\":%s,\"cursor\":%s,\"target_rate\":%.3f,\"queue_depth\":%u,\"policy\":\"%s\",\"compress\":%s,\"keyframe_interval\":%u,\"row_copy_kernel\":\"%s\",\"cases\":[",
+        FormatName(config.Convert.Format),
+        config.Scale.Width,
+        config.Scale.Height,
+        FilterName(config.Scale.Filter),
+        config.DirtyRegions ? "true" : "false",
+        config.DrawCursor ? "true" : "false",
+        config.TargetFrameRate,
+        config.QueueDepth,
+        PolicyName(config.Policy),
+        config.Compress ? "true" : "false",
+        config.KeyframeInterval,
+        GetRowCopyKernelName(GetRowCopyKernel()));
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"consumer_rate\":%.3f,\"source_rate\":%.3f,",
+            result.Resolution.Name, result.Resolution.Width, result.Resolution.Height, result.ConsumerRate, result.SourceRate);
+        AppendFormat(out, "\"frames\":%llu,\"polls\":%llu,\"seconds\":%.6f,\"fps\":%.3f,\"bytes_per_frame\":%llu,\"allocations\":%llu,",
+            static_cast<unsigned long long>(result.Frames),
+            static_cast<unsigned long long>(result.Polls),
+            result.Seconds,
+            result.FramesPerSecond,
+            static_cast<unsigned long long>(result.BytesPerFrame),
+            static_cast<unsigned long long>(result.Allocations));
+        AppendStage(out, "latency_ns", result.FrameLatency);
+        out += ',';
+        AppendStage(out, "row_copy_ns", result.Stats.Stages[static_cast<size_t>(CaptureStage::RowCopy)]);
+        out += ',';
+        AppendStage(out, "scale_ns", result.Stats.Stages[static_cast<size_t>(CaptureStage::Scale)]);
+        out += ',';
+        AppendStage(out, "delivery_ns", result.Stats.Stages[static_cast<size_t>(CaptureStage::Delivery)]);
+        AppendFormat(out, ",\"decimated\":%llu", static_cast<unsigned long long>(result.Stats.Decimated));
+        if (config.Compress)
+        {
+            AppendFormat(out, ",\"encoded_bytes_per_frame\":%llu,\"compression_ratio\":%.3f,",
+                static_cast<unsigned long long>(result.EncodedBytesPerFrame),
+                result.EncodedBytesPerFrame == 0 ? 0.0 : static_cast<double>(result.BytesPerFrame) / result.EncodedBytesPerFrame);
+            AppendStage(out, "encode_ns", result.Encode);
+            out += ',';
+            AppendStage(out, "decode_ns", result.Decode);
+        }
+        AppendFormat(out, ",\"queue\":{\"arrived\":%llu,\"delivered\":%llu,\"dropped\":%llu,\"coalesced\":%llu}}",
+            static_cast<unsigned long long>(result.Queue.Arrived),
+            static_cast<unsigned long long>(result.Queue.Delivered),
+            static_cast<unsigned long long>(result.Queue.Dropped),
+            static_cast<unsigned long long>(result.Queue.Coalesced));
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<ScaleBenchmarkResult> RunScaleBenchmark(ScaleBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions;
+    if (resolutions.empty())
+    {
+        auto standard = StandardResolutions();
+        resolutions.assign(standard.begin() + 1, standard.end());
+    }
+    auto outputs = config.Outputs;
+    if (outputs.empty())
+        outputs = { { "1080p", 1920, 1080 }, { "720p", 1280, 720 }, { "360p", 640, 360 } };
+    auto filters = config.Filters;
+    if (filters.empty())
+        filters = { ScaleFilter::Box, ScaleFilter::Bilinear };
+
+    std::vector<ScaleBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        for (auto const& output : outputs)
+        {
+            if (output.Width >= resolution.Width || output.Height >= resolution.Height)
+                continue;
+            for (auto filter : filters)
+                results.push_back(RunScaleCase(config, resolution, output, filter));
+        }
+    }
+    return results;
+}
+
+std::string ScaleBenchmarkToJson(ScaleBenchmarkConfig const& config, std::vector<ScaleBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"iterations\":%u,\"cases\":[", config.Iterations);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"output\":\"%s\",\"output_width\":%u,\"output_height\":%u,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            result.Output.Name,
+            result.Output.Width,
+            result.Output.Height);
+        AppendFormat(out, "\"filter\":\"%s\",\"gb_per_s\":%.3f,\"psnr\":%.2f,\"max_error\":%u,",
+            FilterName(result.Filter),
+            result.GigabytesPerSecond,
+            result.Psnr,
+            result.MaxError);
+        AppendStage(out, "scale_ns", result.Scale);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<RecordingBenchmarkResult> RunRecordingBenchmark(RecordingBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions;
+    if (resolutions.empty())
+    {
+        auto standard = StandardResolutions();
+        resolutions.assign(standard.begin(), standard.begin() + 4);
+    }
+    auto formats = config.Formats.empty() ? std::vector<OutputFormat>{ OutputFormat::Bgra, OutputFormat::Nv12 } : config.Formats;
+    std::error_code error;
+    std::filesystem::path directory = config.Directory.empty() ? std::filesystem::temp_directory_path(error) : std::filesystem::path(config.Directory);
+    auto path = (directory / "WindowCaptureBenchmark.wcaprec").string();
+
+    std::vector<RecordingBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        for (auto format : formats)
+            results.push_back(RunRecordingCase(config, resolution, format, path));
+    }
+    return results;
+}
+
+std::string RecordingBenchmarkToJson(RecordingBenchmarkConfig const& config, std::vector<RecordingBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"frames\":%u,\"chunk_bytes\":%llu,\"cases\":[",
+        config.Frames,
+        static_cast<unsigned long long>(FrameRecorder::ChunkBytes));
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"format\":\"%s\",\"recorded\":%llu,\"frame_bytes\":%llu,\"file_bytes\":%llu,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            FormatName(result.Format),
+            static_cast<unsigned long long>(result.Frames),
+            static_cast<unsigned long long>(result.FrameBytes),
+            static_cast<unsigned long long>(result.FileBytes));
+        AppendFormat(out, "\"append_gb_per_s\":%.3f,\"record_seconds\":%.6f,\"sustained_gb_per_s\":%.3f,\"read_gb_per_s\":%.3f,\"verified\":%s,",
+            result.AppendGigabytesPerSecond,
+            result.RecordSeconds,
+            result.SustainedGigabytesPerSecond,
+            result.ReadGigabytesPerSecond,
+            result.Verified ? "true" : "false");
+        AppendStage(out, "append_ns", result.Append);
+        out += ',';
+        AppendStage(out, "read_ns", result.Read);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
+
+std::vector<CodecBenchmarkResult> RunCodecBenchmark(CodecBenchmarkConfig const& config)
+{
+    auto resolutions = config.Resolutions;
+    if (resolutions.empty())
+    {
+        auto standard = StandardResolutions();
+        resolutions.assign(standard.begin(), standard.begin() + 4);
+    }
+    auto sequences = config.Sequences;
+    if (sequences.empty())
+        sequences = { TileDiffSequence::Static, TileDiffSequence::MostlyStatic, TileDiffSequence::Changing };
+
+    std::vector<CodecBenchmarkResult> results;
+    for (auto const& resolution : resolutions)
+    {
+        for (auto sequence : sequences)
+            results.push_back(RunCodecCase(config, resolution, sequence));
+    }
+    return results;
+}
+
+std::string CodecBenchmarkToJson(CodecBenchmarkConfig const& config, std::vector<CodecBenchmarkResult> const& results)
+{
+    std::string out;
+    AppendFormat(out, "{\"format\":\"%s\",\"frames\":%u,\"keyframe_interval\":%u,\"box_size\":%u,\"cases\":[",
+        FormatName(config.Format),
+        config.Frames,
+        config.KeyframeInterval,
+        config.BoxSize);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        auto const& result = results[i];
+        if (i != 0)
+            out += ',';
+        AppendFormat(out, "{\"resolution\":\"%s\",\"width\":%u,\"height\":%u,\"sequence\":\"%s\",\"frame_bytes\":%llu,\"keyframes\":%llu,",
+            result.Resolution.Name,
+            result.Resolution.Width,
+            result.Resolution.Height,
+            SequenceName(result.Sequence),
+            static_cast<unsigned long long>(result.FrameBytes),
+            static_cast<unsigned long long>(result.Keyframes));
+        AppendFormat(out, "\"keyframe_bytes\":%llu,\"delta_bytes\":%llu,\"ratio\":%.3f,\"encode_gb_per_s\":%.3f,\"decode_gb_per_s\":%.3f,\"verified\":%s,",
+            static_cast<unsigned long long>(result.KeyframeBytes),
+            static_cast<unsigned long long>(result.DeltaBytes),
+            result.Ratio,
+            result.EncodeGigabytesPerSecond,
+            result.DecodeGigabytesPerSecond,
+            result.Verified ? "true" : "false");
+        AppendStage(out, "encode_ns", result.Encode);
+        out += ',';
+        AppendStage(out, "decode_ns", result.Decode);
+        out += '}';
+    }
+    out += "]}";
+    return out;
+}
@@ -0,0 +1,358 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CaptureStats.h"
+#include "FrameCodec.h"
+#include "FrameQueue.h"
+#include "FrameScaler.h"
+#include "PixelConvert.h"
+
+struct BenchmarkResolution
+{
+    const char* Name = "";
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+};
+
+struct CaptureBenchmarkConfig
+{
+    // Empty runs 720p, 1080p, 1440p, 4K and 8K.
+    std::vector<BenchmarkResolution> Resolutions;
+    // Rates the consumer polls at, in frames per second. 0 polls flat out
+    // against an on-demand source, which measures raw copy throughput. Empty
+    // runs 0, 60 and 30.
+    std::vector<double> ConsumerRates;
+    // Frame rate of the producer thread in the rate-limited cases.
+    double SourceRate = 60;
+    uint32_t FramesPerCase = 120;
+    // Frames copied before measuring starts, so every pooled buffer has been
+    // touched once and first-use page faults stay out of the numbers.
+    uint32_t WarmupFrames = 8;
+    ConvertParams Convert;
+    // Crop and output size; the synthetic source can't crop, so this measures
+    // the CPU fallback scaler.
+    ScaleParams Scale;
+    bool DirtyRegions = false;
+    // Have the source report a cursor and blend it into every copy.
+    bool DrawCursor = false;
+    // Frames per second the pipeline paces delivery to, 0 for no limit.
+    double TargetFrameRate = 0;
+    uint32_t QueueDepth = 1;
+    FramePolicy Policy = FramePolicy::LatestWins;
+    // Run every copied frame through FrameEncoder and FrameDecoder, as
+    // WindowCaptureCompressed and a consumer would.
+    bool Compress = false;
+    uint32_t KeyframeInterval = FrameEncoder::DefaultKeyframeInterval;
+};
+
+struct CaptureBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    double ConsumerRate = 0;
+    double SourceRate = 0;          // 0 for on-demand cases
+    uint64_t Frames = 0;            // successful copies
+    uint64_t Polls = 0;             // copy attempts, including ones that found no frame
+    double Seconds = 0;
+    double FramesPerSecond = 0;
+    StageStats FrameLatency;        // wall time of each successful copy
+    CaptureStatsSnapshot Stats;
+    FrameQueueStats Queue;          // includes the warmup frames
+    uint64_t BytesPerFrame = 0;
+    uint64_t Allocations = 0;       // frame and output buffer allocations during the case
+    uint64_t EncodedBytesPerFrame = 0;  // with Compress
+    StageStats Encode;
+    StageStats Decode;
+};
+
+// Drive the same CapturePipeline the WindowCapture export uses against a
+// synthetic source, once per resolution and consumer rate.
+std::vector<CaptureBenchmarkResult> RunCaptureBenchmark(CaptureBenchmarkConfig const& config);
+
+// Results as one JSON object, stable enough to diff against a stored baseline.
+std::string CaptureBenchmarkToJson(CaptureBenchmarkConfig const& config, std::vector<CaptureBenchmarkResult> const& results);
+
+struct BatchBenchmarkConfig
+{
+    BenchmarkResolution Resolution{ "720p", 1280, 720 };
+    // Sources captured together. Empty runs 1, 2, 4, 8, 16 and 32.
+    std::vector<uint32_t> SourceCounts;
+    // Copier threads, including the caller; 0 for BatchCopier's default.
+    uint32_t Threads = 0;
+    // Simulated staging copy time per frame, which a loop of single captures
+    // waits out once per source and a batch once in all.
+    std::chrono::microseconds ReadbackLatency{ 1000 };
+    uint32_t Rounds = 60;
+    uint32_t WarmupRounds = 4;
+    ConvertParams Convert;
+};
+
+struct BatchBenchmarkResult
+{
+    uint32_t Sources = 0;
+    uint32_t Threads = 0;
+    // Capturing every source once: a CopyImage loop, then one batch.
+    StageStats Sequential;
+    StageStats Batch;
+    double SequentialFramesPerSecond = 0;   // frames over all sources
+    double BatchFramesPerSecond = 0;
+    double Speedup = 0;
+    uint64_t Polls = 0;             // collects that found the copy in flight
+    uint32_t MaxConcurrent = 0;
+};
+
+// Capture N on-demand synthetic sources round after round, one CopyImage
+// after another and then through BatchCopier, as WindowCapture in a loop and
+// WindowCaptureBatch do.
+std::vector<BatchBenchmarkResult> RunBatchBenchmark(BatchBenchmarkConfig const& config);
+std::string BatchBenchmarkToJson(BatchBenchmarkConfig const& config, std::vector<BatchBenchmarkResult> const& results);
+
+struct BufferPoolBenchmarkConfig
+{
+    // Empty runs 720p, 1080p, 1440p, 4K and 8K.
+    std::vector<BenchmarkResolution> Resolutions;
+    uint32_t Iterations = 20;
+    bool LargePages = true;
+};
+
+struct BufferPoolBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    uint64_t FrameBytes = 0;        // BGRA frame
+    uint64_t BufferBytes = 0;       // as the pool hands it out
+    // A fresh heap buffer per frame: the allocation and the first write into
+    // it, page faults included, as callers sizing their own buffers pay.
+    StageStats HeapFirstWrite;
+    // A buffer the pool didn't have yet: the allocation, faults and all, and
+    // then the first write.
+    StageStats PoolAllocate;
+    StageStats PoolFirstWrite;
+    // A released buffer taken again, and a write into it.
+    StageStats PoolReuse;
+    StageStats PoolReuseWrite;
+    bool LargePages = false;
+};
+
+// Time getting a buffer for a frame and writing the frame into it, from the
+// heap and from FrameBufferPool, fresh and reused.
+std::vector<BufferPoolBenchmarkResult> RunBufferPoolBenchmark(BufferPoolBenchmarkConfig const& config);
+std::string BufferPoolBenchmarkToJson(BufferPoolBenchmarkConfig const& config, std::vector<BufferPoolBenchmarkResult> const& results);
+
+struct StripBenchmarkConfig
+{
+    // Empty runs 720p, 1080p, 1440p, 4K and 8K.
+    std::vector<BenchmarkResolution> Resolutions;
+    // StripCopier threads, the caller included. Empty runs 1, 2, 4, 8 and 16.
+    std::vector<uint32_t> ThreadCounts;
+    uint32_t Frames = 60;
+    ConvertParams Convert;
+};
+
+struct StripBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    uint32_t Threads = 0;
+    uint64_t Strips = 0;            // per frame
+    // Converting one frame out of a pitched BGRA source, as CopyImage does.
+    StageStats Copy;
+    double GigabytesPerSecond = 0;  // source read and output written, at the median
+    double Speedup = 0;             // median against the first thread count of the resolution
+};
+
+// Time StripCopier converting frames at every resolution and thread count,
+// with the size threshold off so even small frames are split.
+std::vector<StripBenchmarkResult> RunStripBenchmark(StripBenchmarkConfig const& config);
+std::string StripBenchmarkToJson(StripBenchmarkConfig const& config, std::vector<StripBenchmarkResult> const& results);
+
+struct RowCopyBenchmarkConfig
+{
+    // Empty runs 1080p, 1440p and 4K.
+    std::vector<BenchmarkResolution> Resolutions;
+    uint32_t Iterations = 50;
+};
+
+struct RowCopyBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    // "memcpy" for the per-row memcpy loop CopyRows replaced, otherwise the
+    // kernel's name.
+    const char* Kernel = "";
+    // One BGRA frame out of 256 byte aligned rows into packed ones.
+    StageStats Copy;
+    double GigabytesPerSecond = 0;  // bytes copied over the median
+    double Speedup = 0;             // median against memcpy
+};
+
+// Time CopyRows with every kernel the CPU supports against a memcpy per row.
+// Restores the kernel in use afterwards.
+std::vector<RowCopyBenchmarkResult> RunRowCopyBenchmark(RowCopyBenchmarkConfig const& config);
+std::string RowCopyBenchmarkToJson(RowCopyBenchmarkConfig const& config, std::vector<RowCopyBenchmarkResult> const& results);
+
+struct ConvertBenchmarkConfig
+{
+    // Empty runs 720p, 1080p, 1440p and 4K.
+    std::vector<BenchmarkResolution> Resolutions;
+    // Empty runs every output format.
+    std::vector<OutputFormat> Formats;
+    YuvMatrix Matrix = YuvMatrix::Bt709;
+    YuvRange Range = YuvRange::Limited;
+    uint32_t Iterations = 30;
+};
+
+struct ConvertBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    OutputFormat Format = OutputFormat::Bgra;
+    // Name of the row copy kernel, which also picks the convert kernels.
+    const char* Kernel = "";
+    // One frame out of 256 byte aligned BGRA rows into the packed output.
+    StageStats Convert;
+    double GigabytesPerSecond = 0;  // source read and output written, at the median
+    double Speedup = 0;             // median against the scalar kernels
+};
+
+// Time ConvertFrame into every format, with the scalar kernels and then the
+// best the CPU supports. Restores the kernel in use afterwards.
+std::vector<ConvertBenchmarkResult> RunConvertBenchmark(ConvertBenchmarkConfig const& config);
+std::string ConvertBenchmarkToJson(ConvertBenchmarkConfig const& config, std::vector<ConvertBenchmarkResult> const& results);
+
+enum class TileDiffSequence
+{
+    Static,         // the same frame over and over
+    MostlyStatic,   // the synthetic source's moving box on a still background
+    Changing,       // every pixel different from the frame before
+};
+
+struct TileDiffBenchmarkConfig
+{
+    // Empty runs 720p, 1080p, 1440p and 4K.
+    std::vector<BenchmarkResolution> Resolutions;
+    // Empty runs every sequence.
+    std::vector<TileDiffSequence> Sequences;
+    uint32_t Frames = 60;
+    uint32_t BoxSize = 64;
+};
+
+struct TileDiffBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    TileDiffSequence Sequence = TileDiffSequence::Static;
+    // TileDiffer::Update on one BGRA frame out of 256 byte aligned rows.
+    StageStats Update;
+    double GigabytesPerSecond = 0;  // frame bytes over the median
+    uint32_t Tiles = 0;             // per frame
+    double DirtyTiles = 0;          // mean per frame
+    double DirtyRects = 0;          // mean per frame
+    uint64_t IdenticalFrames = 0;
+};
+
+// Time TileDiffer on a still, a mostly still and a fully changing sequence
+// at every resolution. Frames are drawn before each timed Update.
+std::vector<TileDiffBenchmarkResult> RunTileDiffBenchmark(TileDiffBenchmarkConfig const& config);
+std::string TileDiffBenchmarkToJson(TileDiffBenchmarkConfig const& config, std::vector<TileDiffBenchmarkResult> const& results);
+
+struct ScaleBenchmarkConfig
+{
+    // Source sizes. Empty runs 1080p, 1440p, 4K and 8K.
+    std::vector<BenchmarkResolution> Resolutions;
+    // Output sizes; only the ones smaller than a source run against it. Empty
+    // runs 1080p, 720p and 360p, which takes 4K to 1080p down the 2:1 path.
+    std::vector<BenchmarkResolution> Outputs;
+    // Empty runs box and bilinear.
+    std::vector<ScaleFilter> Filters;
+    uint32_t Iterations = 30;
+};
+
+struct ScaleBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    BenchmarkResolution Output;
+    ScaleFilter Filter = ScaleFilter::Box;
+    // FrameScaler::Scale on one frame out of 256 byte aligned BGRA rows.
+    StageStats Scale;
+    double GigabytesPerSecond = 0;  // source bytes over the median
+    // Against a double precision resampling of the same frame, so the
+    // fixed point shortcuts show up as a drop here.
+    double Psnr = 0;
+    uint32_t MaxError = 0;
+};
+
+// Time the CPU fallback scaler on a synthetic frame for every source size,
+// smaller output size and filter, and measure how far it strays from an
+// exact reference.
+std::vector<ScaleBenchmarkResult> RunScaleBenchmark(ScaleBenchmarkConfig const& config);
+std::string ScaleBenchmarkToJson(ScaleBenchmarkConfig const& config, std::vector<ScaleBenchmarkResult> const& results);
+
+struct RecordingBenchmarkConfig
+{
+    // Empty runs 720p, 1080p, 1440p and 4K.
+    std::vector<BenchmarkResolution> Resolutions;
+    // Empty runs BGRA and NV12.
+    std::vector<OutputFormat> Formats;
+    uint32_t Frames = 120;
+    // Where the containers are written and deleted again; empty for the
+    // system temporary directory.
+    std::string Directory;
+};
+
+struct RecordingBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    OutputFormat Format = OutputFormat::Bgra;
+    uint64_t Frames = 0;            // recorded
+    uint64_t FrameBytes = 0;
+    uint64_t FileBytes = 0;         // once closed and trimmed
+    // FrameRecorder::Append of one frame out of 256 byte aligned rows,
+    // chunk mapping included.
+    StageStats Append;
+    double AppendGigabytesPerSecond = 0;    // frame bytes over the median
+    // Every frame appended and the container closed, so everything flushed.
+    double RecordSeconds = 0;
+    double SustainedGigabytesPerSecond = 0;
+    // FrameRecordingReader::CopyFrame of the frames in random order.
+    StageStats Read;
+    double ReadGigabytesPerSecond = 0;      // frame bytes over the median
+    bool Verified = false;          // every frame read back as written
+};
+
+// Record synthetic frames into a container and read them back in random
+// order, at every resolution and format.
+std::vector<RecordingBenchmarkResult> RunRecordingBenchmark(RecordingBenchmarkConfig const& config);
+std::string RecordingBenchmarkToJson(RecordingBenchmarkConfig const& config, std::vector<RecordingBenchmarkResult> const& results);
+
+struct CodecBenchmarkConfig
+{
+    // Empty runs 720p, 1080p, 1440p and 4K.
+    std::vector<BenchmarkResolution> Resolutions;
+    // Empty runs every sequence. Changing is noise here, which no run
+    // covers, so it shows the codec's worst case.
+    std::vector<TileDiffSequence> Sequences;
+    OutputFormat Format = OutputFormat::Bgra;
+    uint32_t Frames = 60;
+    uint32_t KeyframeInterval = FrameEncoder::DefaultKeyframeInterval;
+    uint32_t BoxSize = 64;
+};
+
+struct CodecBenchmarkResult
+{
+    BenchmarkResolution Resolution;
+    TileDiffSequence Sequence = TileDiffSequence::Static;
+    uint64_t FrameBytes = 0;
+    uint64_t Keyframes = 0;
+    uint64_t KeyframeBytes = 0;     // mean encoded size
+    uint64_t DeltaBytes = 0;        // mean encoded size
+    double Ratio = 0;               // frame bytes over encoded bytes, all frames
+    // FrameEncoder::Encode and FrameDecoder::Decode of one frame out of
+    // packed rows.
+    StageStats Encode;
+    StageStats Decode;
+    double EncodeGigabytesPerSecond = 0;    // frame bytes over the median
+    double DecodeGigabytesPerSecond = 0;
+    bool Verified = false;          // every frame decoded as it went in
+};
+
+// Encode and decode a still, a mostly still and a noise sequence at every
+// resolution, as WindowCaptureCompressed and a consumer would.
+std::vector<CodecBenchmarkResult> RunCodecBenchmark(CodecBenchmarkConfig const& config);
+std::string CodecBenchmarkToJson(CodecBenchmarkConfig const& config, std::vector<CodecBenchmarkResult> const& results);
@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "CaptureManager.h"
+
+using namespace winrt;
+using namespace Windows::UI::Composition;
+
+CaptureManager::CaptureManager()
+{
+    // Same threading model as InitWndCap: the queue belongs to the creating
+    // thread, which must pump messages. It is kept alive for every session.
+    m_controller = CreateDispatcherQueueController();
+    m_compositor = Compositor();
+    m_root = m_compositor.CreateContainerVisual();
+    m_root.RelativeSizeAdjustment({ 1.0f, 1.0f });
+
+    auto d3dDevice = CreateD3DDevice();
+    // Sessions may be read back from different threads through the one
+    // immediate context.
+    d3dDevice.as<ID3D11Multithread>()->SetMultithreadProtected(TRUE);
+    auto dxgiDevice = d3dDevice.as<IDXGIDevice>();
+    m_device = CreateDirect3DDevice(dxgiDevice.get());
+}
+
+CaptureManager::~CaptureManager()
+{
+    // Sessions may outlive the manager; stop them reporting into a dead scheduler.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& entry : m_sessions)
+    {
+        if (auto app = entry.second.lock())
+        {
+            app->SetFrameNotifyHook(nullptr);
+            app->SetAsyncReadback(nullptr, 0);
+        }
+    }
+}
+
+std::shared_ptr<App> CaptureManager::CreateSession(uint32_t& sessionId, std::chrono::nanoseconds minInterval)
+{
+    auto app = std::make_shared<App>();
+    app->Initialize(m_root, m_device);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    sessionId = m_nextSessionId++;
+    m_scheduler.Add(sessionId, minInterval);
+    auto id = sessionId;
+    app->SetFrameNotifyHook([this, id]() { m_scheduler.MarkReady(id, SessionScheduler::Clock::now()); });
+    m_sessions[sessionId] = app;
+    return app;
+}
+
+void CaptureManager::RemoveSession(uint32_t sessionId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(sessionId);
+    if (it == m_sessions.end())
+        return;
+    if (auto app = it->second.lock())
+    {
+        app->SetFrameNotifyHook(nullptr);
+        app->SetAsyncReadback(nullptr, 0);
+    }
+    m_sessions.erase(it);
+    m_scheduler.Remove(sessionId);
+}
+
+bool CaptureManager::WaitNextSession(uint32_t& sessionId, uint32_t timeoutMs)
+{
+    return m_scheduler.WaitNext(sessionId, std::chrono::milliseconds(timeoutMs));
+}
+
+bool CaptureManager::SetAsyncReadback(uint32_t sessionId, bool enable)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_sessions.find(sessionId);
+    if (it == m_sessions.end())
+        return false;
+    auto app = it->second.lock();
+    if (!app)
+        return false;
+    app->SetAsyncReadback(enable ? &m_readback : nullptr, sessionId);
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "App.h"
+#include "ReadbackEngine.h"
+#include "SessionScheduler.h"
+
+// Owns the D3D device, dispatcher queue and compositor shared by any number of
+// capture sessions, and schedules which session to read back next. Sessions
+// are ordinary App instances initialized against the shared objects.
+class CaptureManager
+{
+public:
+    CaptureManager();
+    ~CaptureManager();
+
+    // minInterval limits how often the scheduler hands out the session; zero
+    // serves it whenever it has a frame.
+    std::shared_ptr<App> CreateSession(uint32_t& sessionId, std::chrono::nanoseconds minInterval);
+    void RemoveSession(uint32_t sessionId);
+
+    // Wait for the next session that has a frame and is due for readback.
+    bool WaitNextSession(uint32_t& sessionId, uint32_t timeoutMs);
+    // Read the session back on the manager's worker threads, so its copies
+    // overlap with other sessions' and copying out never waits on the GPU.
+    bool SetAsyncReadback(uint32_t sessionId, bool enable);
+
+private:
+    winrt::Windows::System::DispatcherQueueController m_controller{ nullptr };
+    winrt::Windows::UI::Composition::Compositor m_compositor{ nullptr };
+    winrt::Windows::UI::Composition::ContainerVisual m_root{ nullptr };
+    winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice m_device{ nullptr };
+
+    SessionScheduler m_scheduler;
+    ReadbackEngine m_readback;
+    std::mutex m_mutex;
+    std::unordered_map<uint32_t, std::weak_ptr<App>> m_sessions;
+    uint32_t m_nextSessionId = 1;
+};
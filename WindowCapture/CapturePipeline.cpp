@@ -0,0 +1,292 @@
+#include "CapturePipeline.h"
+#include <cmath>
+
+CapturePipeline::CapturePipeline(ICaptureSource& source, CaptureStats& stats, uint32_t maxLeases) :
+    m_source(source),
+    m_stats(stats),
+    m_leases(maxLeases)
+{
+}
+
+CopyResult CapturePipeline::CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height)
+{
+    MappedSlot mapped;
+    if (!AcquireFrame(mapped))
+        return CopyResult::NoFrame;
+    auto copyStartNs = ToTimestampNs(FramePacer::Clock::now());
+
+    // Whatever crop the source didn't apply happens here, on the mapped rows.
+    auto region = ClampCrop(m_sourceCrops ? CropRect() : m_scale.Crop, mapped.Desc.Width, mapped.Desc.Height);
+    GetScaledSize(m_scale, region.Width, region.Height, width, height);
+    size_t rowBytes = GetOutputRowBytes(m_convert.Format, width);
+    if (dstStride == 0)
+        dstStride = rowBytes;
+    size_t required = GetOutputFrameSize(m_convert.Format, width, height, dstStride);
+    if (dstStride < rowBytes || required > bufSize)
+    {
+        // Keep the frame mapped so a retry with a larger buffer gets it.
+        m_heldSlot = mapped;
+        m_hasHeldSlot = true;
+        return CopyResult::BufferTooSmall;
+    }
+
+    const uint8_t* pixels = mapped.Data + static_cast<size_t>(region.Y) * mapped.RowPitch + static_cast<size_t>(region.X) * 4;
+    size_t pitch = mapped.RowPitch;
+    auto placed = GetFitRect(m_scale.Fit, width, height, region.Width, region.Height);
+    if (placed.Width != region.Width || placed.Height != region.Height ||
+        placed.Width != width || placed.Height != height)
+    {
+        CaptureStats::ScopedTimer timer(m_stats, CaptureStage::Scale);
+        pitch = static_cast<size_t>(width) * 4;
+        PrepareScaled(width, height, placed);
+        uint8_t* dst = m_scaled.data() + static_cast<size_t>(placed.Y) * pitch + static_cast<size_t>(placed.X) * 4;
+        m_scaler.Scale(dst, pitch, placed.Width, placed.Height, pixels, mapped.RowPitch, region.Width, region.Height, m_scale.Filter);
+        pixels = m_scaled.data();
+    }
+
+    if (m_tileDiff)
+        m_tileDiff->Update(pixels, pitch, width, height);
+
+    // The cursor is drawn after the comparison, so dirty regions follow it
+    // through MarkDirty rather than through the tiles. BGRA and RGBA outputs
+    // get it straight in the caller's buffer; the other formats need it in a
+    // BGRA copy of the frame ahead of conversion.
+    auto cursor = UpdateCursor(region, placed);
+    bool directCursor = m_convert.Format == OutputFormat::Bgra || m_convert.Format == OutputFormat::Rgba;
+    if (cursor != nullptr && !directCursor)
+    {
+        if (pixels != m_scaled.data())
+        {
+            pitch = static_cast<size_t>(width) * 4;
+            PrepareScaled(width, height, placed);
+            m_scaler.Scale(m_scaled.data(), pitch, width, height, pixels, mapped.RowPitch, width, height, m_scale.Filter);
+            pixels = m_scaled.data();
+        }
+        DrawCursor(m_scaled.data(), pitch, placed, *cursor, false);
+    }
+
+    //Copy the bits, converting to the output format on the way
+    {
+        CaptureStats::ScopedTimer timer(m_stats, CaptureStage::RowCopy);
+        if (m_strips != nullptr)
+            m_strips->Convert(buf, dstStride, pixels, pitch, width, height, m_convert);
+        else
+            ConvertFrame(buf, dstStride, pixels, pitch, width, height, m_convert);
+    }
+    auto copyEndNs = ToTimestampNs(FramePacer::Clock::now());
+    if (cursor != nullptr && directCursor)
+        DrawCursor(buf, dstStride, placed, *cursor, m_convert.Format == OutputFormat::Rgba);
+    else if (cursor == nullptr && m_cursorDrawn.Width != 0)
+    {
+        if (m_tileDiff)
+            m_tileDiff->MarkDirty(m_cursorDrawn);
+        m_cursorDrawn = DirtyRect();
+    }
+    m_timing = Deliver(mapped, copyStartNs, copyEndNs, width, height);
+    m_source.ReleaseFrame(mapped);
+    m_stats.AddFrame();
+    m_stats.AddBytesCopied(GetOutputFrameSize(m_convert.Format, width, height, rowBytes));
+    return CopyResult::Ok;
+}
+
+bool CapturePipeline::LeaseFrame(FrameLease& lease)
+{
+    if (!m_leases.CanLease())
+        return false;
+
+    MappedSlot mapped;
+    if (!AcquireFrame(mapped))
+        return false;
+    // Nothing is copied; the frame is the caller's once it is mapped.
+    auto mappedNs = ToTimestampNs(FramePacer::Clock::now());
+    lease = m_leases.Lease(mapped, Deliver(mapped, mappedNs, mappedNs, mapped.Desc.Width, mapped.Desc.Height).DeliveryTimeNs);
+    m_stats.AddFrame();
+    return true;
+}
+
+bool CapturePipeline::ReturnFrame(uint64_t frameIndex)
+{
+    MappedSlot mapped;
+    if (!m_leases.Return(frameIndex, mapped))
+        return false;
+    m_source.ReleaseFrame(mapped);
+    return true;
+}
+
+void CapturePipeline::SetScale(ScaleParams const& params)
+{
+    m_scale = params;
+    m_sourceCrops = m_source.SetCrop(params.Crop);
+    m_source.SetScaleHint(params.Width, params.Height);
+}
+
+void CapturePipeline::SetTargetFrameRate(double fps)
+{
+    m_targetFrameRate = fps > 0 ? fps : 0;
+    bool sourcePaces = m_source.SetTargetFrameRate(m_targetFrameRate);
+    m_pacer.SetTargetFrameRate(sourcePaces ? 0 : m_targetFrameRate);
+}
+
+void CapturePipeline::EnableDirtyRegions(bool enable)
+{
+    if (!enable)
+        m_tileDiff = nullptr;
+    else if (!m_tileDiff)
+        m_tileDiff = std::make_unique<TileDiffer>();
+}
+
+void CapturePipeline::Reset()
+{
+    m_leases.ReturnAll([this](MappedSlot const& slot) { m_source.ReleaseFrame(slot); });
+    if (m_hasHeldSlot)
+    {
+        m_source.ReleaseFrame(m_heldSlot);
+        m_hasHeldSlot = false;
+    }
+}
+
+const CursorShape* CapturePipeline::UpdateCursor(CropRect const& region, CropRect const& placed)
+{
+    m_cursor = CursorState();
+    CursorSample sample;
+    if (!m_source.GetCursor(sample) || !sample.Visible || !sample.Shape)
+        return nullptr;
+
+    // The part of the source the frame shows: region itself, unless the
+    // source cropped (and maybe reduced) it before handing the frame over.
+    CropRect shown = region;
+    if (m_sourceCrops)
+    {
+        auto size = m_source.GetSourceSize();
+        shown = ClampCrop(m_scale.Crop, size.Width, size.Height);
+    }
+    if (shown.Empty())
+        return nullptr;
+
+    double scaleX = static_cast<double>(placed.Width) / shown.Width;
+    double scaleY = static_cast<double>(placed.Height) / shown.Height;
+    m_cursor.X = static_cast<int32_t>(placed.X + std::floor((static_cast<double>(sample.X) - shown.X) * scaleX));
+    m_cursor.Y = static_cast<int32_t>(placed.Y + std::floor((static_cast<double>(sample.Y) - shown.Y) * scaleY));
+    m_cursor.Shape = sample.Shape;
+    m_cursor.Visible =
+        m_cursor.X >= static_cast<int32_t>(placed.X) && m_cursor.X < static_cast<int32_t>(placed.X + placed.Width) &&
+        m_cursor.Y >= static_cast<int32_t>(placed.Y) && m_cursor.Y < static_cast<int32_t>(placed.Y + placed.Height);
+    if (!m_drawCursor)
+        return nullptr;
+    if (placed.Width == shown.Width && placed.Height == shown.Height)
+        return sample.Shape.get();
+
+    auto const& shape = *sample.Shape;
+    auto width = static_cast<uint32_t>(std::lround(shape.Width * scaleX));
+    auto height = static_cast<uint32_t>(std::lround(shape.Height * scaleY));
+    if (width == 0)
+        width = 1;
+    if (height == 0)
+        height = 1;
+    if (m_cursorScaledFrom != shape.Hash || m_cursorScaled.Width != width || m_cursorScaled.Height != height)
+    {
+        m_cursorScaled = ScaleCursorShape(shape, width, height);
+        m_cursorScaledFrom = shape.Hash;
+    }
+    return &m_cursorScaled;
+}
+
+void CapturePipeline::DrawCursor(uint8_t* frame, size_t stride, CropRect const& placed, CursorShape const& shape, bool swapRedBlue)
+{
+    // Clip to the frame's placement so nothing lands on letterbox bars.
+    uint8_t* area = frame + static_cast<size_t>(placed.Y) * stride + static_cast<size_t>(placed.X) * 4;
+    int32_t x = m_cursor.X - static_cast<int32_t>(placed.X);
+    int32_t y = m_cursor.Y - static_cast<int32_t>(placed.Y);
+    BlendCursor(area, stride, placed.Width, placed.Height, shape, x, y, swapRedBlue);
+
+    int64_t left = std::max<int64_t>(static_cast<int64_t>(x) - shape.HotspotX, 0);
+    int64_t top = std::max<int64_t>(static_cast<int64_t>(y) - shape.HotspotY, 0);
+    int64_t right = std::min<int64_t>(static_cast<int64_t>(x) - shape.HotspotX + shape.Width, placed.Width);
+    int64_t bottom = std::min<int64_t>(static_cast<int64_t>(y) - shape.HotspotY + shape.Height, placed.Height);
+    DirtyRect drawn;
+    if (left < right && top < bottom)
+    {
+        drawn.X = static_cast<uint32_t>(left) + placed.X;
+        drawn.Y = static_cast<uint32_t>(top) + placed.Y;
+        drawn.Width = static_cast<uint32_t>(right - left);
+        drawn.Height = static_cast<uint32_t>(bottom - top);
+    }
+    if (m_tileDiff && (drawn.X != m_cursorDrawn.X || drawn.Y != m_cursorDrawn.Y ||
+        drawn.Width != m_cursorDrawn.Width || drawn.Height != m_cursorDrawn.Height || shape.Hash != m_cursorDrawnHash))
+    {
+        m_tileDiff->MarkDirty(m_cursorDrawn);
+        m_tileDiff->MarkDirty(drawn);
+    }
+    m_cursorDrawn = drawn;
+    m_cursorDrawnHash = shape.Hash;
+}
+
+void CapturePipeline::PrepareScaled(uint32_t width, uint32_t height, CropRect const& placed)
+{
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    if (m_scaled.size() == pixelCount * 4 && m_scaledWidth == width &&
+        m_placed.X == placed.X && m_placed.Y == placed.Y &&
+        m_placed.Width == placed.Width && m_placed.Height == placed.Height)
+    {
+        // Same layout as last frame: the bars are still black.
+        return;
+    }
+    m_scaled.resize(pixelCount * 4);
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        m_scaled[i * 4 + 0] = 0;
+        m_scaled[i * 4 + 1] = 0;
+        m_scaled[i * 4 + 2] = 0;
+        m_scaled[i * 4 + 3] = 255;
+    }
+    m_scaledWidth = width;
+    m_placed = placed;
+}
+
+bool CapturePipeline::AcquireFrame(MappedSlot& mapped)
+{
+    if (m_hasHeldSlot)
+    {
+        mapped = m_heldSlot;
+        m_hasHeldSlot = false;
+        return true;
+    }
+    if (!m_source.AcquireFrame(mapped))
+        return false;
+    if (!m_pacer.Limited())
+        return true;
+
+    // The source can't drop frames before readback; drop them here instead.
+    auto captured = mapped.CaptureTimeNs != 0 ?
+        FramePacer::Clock::time_point(std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::nanoseconds(mapped.CaptureTimeNs))) :
+        FramePacer::Clock::now();
+    if (m_pacer.Admit(captured))
+        return true;
+    m_source.ReleaseFrame(mapped);
+    m_stats.AddDecimated();
+    return false;
+}
+
+FrameTiming CapturePipeline::Deliver(MappedSlot const& mapped, uint64_t copyStartNs, uint64_t copyEndNs, uint32_t width, uint32_t height)
+{
+    FrameTiming timing;
+    timing.FrameIndex = mapped.FrameIndex;
+    timing.CaptureTimeNs = mapped.CaptureTimeNs;
+    timing.DeliveryTimeNs = ToTimestampNs(FramePacer::Clock::now());
+    timing.FrameId = ++m_frameId;
+    timing.AcquireTimeNs = mapped.AcquireTimeNs;
+    timing.CopyStartNs = copyStartNs;
+    timing.CopyEndNs = copyEndNs;
+    if (timing.CaptureTimeNs != 0 && timing.DeliveryTimeNs >= timing.CaptureTimeNs)
+        m_stats.Record(CaptureStage::Delivery, static_cast<int64_t>(timing.DeliveryTimeNs - timing.CaptureTimeNs));
+    if (m_trace != nullptr)
+    {
+        FrameTraceRecord record;
+        record.Track = m_traceTrack;
+        record.Width = width;
+        record.Height = height;
+        record.Timing = timing;
+        m_trace->Record(record);
+    }
+    return timing;
+}
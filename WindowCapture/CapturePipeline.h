@@ -0,0 +1,105 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "CaptureStats.h"
+#include "FrameLease.h"
+#include "FrameScaler.h"
+#include "FrameTrace.h"
+#include "ICaptureSource.h"
+#include "PixelConvert.h"
+#include "StripCopier.h"
+#include "TileDiff.h"
+
+enum class CopyResult
+{
+    Ok,
+    NoFrame,
+    BufferTooSmall,
+};
+
+// The CPU side of a capture: pulls frames from an ICaptureSource and hands
+// them to the caller either copied (and converted) into a buffer or leased in
+// place. Holds no platform types, so the same code runs behind the DLL exports
+// and against a synthetic source.
+//
+// Not thread safe; all calls come from the consumer thread.
+class CapturePipeline
+{
+public:
+    CapturePipeline(ICaptureSource& source, CaptureStats& stats, uint32_t maxLeases);
+
+    CopyResult CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height);
+    // Leased frames are always in the source format; the output format applies to copies only.
+    // Leases skip the CPU scaler: they see the frame as the source produced it,
+    // cropped and possibly reduced, but not resampled to the output size.
+    bool LeaseFrame(FrameLease& lease);
+    bool ReturnFrame(uint64_t frameIndex);
+
+    void SetOutputFormat(ConvertParams const& params) { m_convert = params; }
+    ConvertParams const& GetOutputFormat() const { return m_convert; }
+    // Copy large frames out in strips on copier's threads, nullptr for the
+    // calling thread alone. The copier must outlive its use here.
+    void SetStripCopier(StripCopier* copier) { m_strips = copier; }
+    // Crop and output size for copies. The source is asked to do as much of it
+    // as it can before readback; the rest happens here.
+    void SetScale(ScaleParams const& params);
+    ScaleParams const& GetScale() const { return m_scale; }
+    // Frames per second to deliver, 0 for as many as the source produces.
+    void SetTargetFrameRate(double fps);
+    double GetTargetFrameRate() const { return m_targetFrameRate; }
+    // Timestamps of the last successful copy, from capture to delivery.
+    FrameTiming const& GetFrameTiming() const { return m_timing; }
+    // Record every frame copied or leased to trace under track, nullptr to
+    // stop. The trace must stay open while set.
+    void SetTrace(FrameTraceWriter* trace, uint32_t track) { m_trace = trace; m_traceTrack = track; }
+    void EnableDirtyRegions(bool enable);
+    TileDiffer const* GetTileDiff() const { return m_tileDiff.get(); }
+    // Blend the cursor into copies. Its position is reported either way.
+    void SetDrawCursor(bool draw) { m_drawCursor = draw; }
+    bool GetDrawCursor() const { return m_drawCursor; }
+    // Cursor as of the last successful copy.
+    CursorState const& GetCursorState() const { return m_cursor; }
+
+    // Give every held and leased frame back to the source.
+    void Reset();
+
+private:
+    bool AcquireFrame(MappedSlot& mapped);
+    // Stamp a frame on its way out, record how long it took to get here and
+    // trace it.
+    FrameTiming Deliver(MappedSlot const& mapped, uint64_t copyStartNs, uint64_t copyEndNs, uint32_t width, uint32_t height);
+    // Size m_scaled for a width x height output and blacken it whenever the
+    // frame's placement inside it changes.
+    void PrepareScaled(uint32_t width, uint32_t height, CropRect const& placed);
+    // Sample the cursor and map it into output pixels. Returns the shape to
+    // draw, already scaled like the frame, or nullptr when there is none.
+    const CursorShape* UpdateCursor(CropRect const& region, CropRect const& placed);
+    void DrawCursor(uint8_t* frame, size_t stride, CropRect const& placed, CursorShape const& shape, bool swapRedBlue);
+
+    ICaptureSource& m_source;
+    CaptureStats& m_stats;
+    FrameLeasePool m_leases;
+    ConvertParams m_convert;
+    StripCopier* m_strips = nullptr;
+    ScaleParams m_scale;
+    bool m_sourceCrops = false;
+    FrameScaler m_scaler;
+    std::vector<uint8_t> m_scaled;
+    uint32_t m_scaledWidth = 0;
+    CropRect m_placed;
+    std::unique_ptr<TileDiffer> m_tileDiff{ nullptr };
+    bool m_drawCursor = false;
+    CursorState m_cursor;
+    CursorShape m_cursorScaled;
+    uint64_t m_cursorScaledFrom = 0;    // hash of the shape m_cursorScaled was made from
+    DirtyRect m_cursorDrawn;            // where the cursor went in the previous copy
+    uint64_t m_cursorDrawnHash = 0;
+    double m_targetFrameRate = 0;
+    FramePacer m_pacer;                 // only when the source can't pace itself
+    FrameTiming m_timing;
+    uint64_t m_frameId = 0;
+    FrameTraceWriter* m_trace = nullptr;
+    uint32_t m_traceTrack = 0;
+    MappedSlot m_heldSlot;
+    bool m_hasHeldSlot = false;
+};
@@ -0,0 +1,251 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Latency histogram over nanosecond samples. Values below LinearLimit get a
+// bucket each; above that every power of two is split into SubBuckets linear
+// buckets, so a percentile read back is within 1/SubBuckets of the true value.
+// Recording is a couple of relaxed atomic adds and safe from any thread.
+class LatencyHistogram
+{
+public:
+    static constexpr uint32_t SubBucketBits = 3;
+    static constexpr uint32_t SubBuckets = 1u << SubBucketBits;
+    static constexpr uint32_t LinearLimit = SubBuckets * 4;
+    // Covers up to 2^40 ns, about 18 minutes; longer samples land in the last bucket.
+    static constexpr uint32_t MaxExponent = 40;
+    static constexpr uint32_t BucketCount = LinearLimit + (MaxExponent - 5 + 1) * SubBuckets;
+
+    void Record(uint64_t ns)
+    {
+        m_buckets[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Not atomic with respect to concurrent Record calls; a sample landing
+    // during a reset may be half counted.
+    void Reset()
+    {
+        for (auto& bucket : m_buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t Count() const { return m_count.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return m_max.load(std::memory_order_relaxed); }
+    uint64_t Mean() const
+    {
+        uint64_t count = Count();
+        return count == 0 ? 0 : m_sum.load(std::memory_order_relaxed) / count;
+    }
+
+    // Upper bound of the bucket holding the p-th percentile, p in [0, 100],
+    // capped at the largest sample seen. 0 when nothing was recorded.
+    uint64_t Percentile(double p) const
+    {
+        uint64_t counts[BucketCount];
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < BucketCount; i++)
+        {
+            counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0)
+            return 0;
+
+        if (p < 0)
+            p = 0;
+        if (p > 100)
+            p = 100;
+        uint64_t rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+        if (rank == 0)
+            rank = 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BucketCount; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                uint64_t bound = BucketUpperBound(i);
+                uint64_t max = Max();
+                return bound < max ? bound : max;
+            }
+        }
+        return Max();
+    }
+
+    static uint32_t BucketOf(uint64_t ns)
+    {
+        if (ns < LinearLimit)
+            return static_cast<uint32_t>(ns);
+        uint32_t exponent = HighestBit(ns);
+        if (exponent > MaxExponent)
+            return BucketCount - 1;
+        uint32_t sub = static_cast<uint32_t>(ns >> (exponent - SubBucketBits)) & (SubBuckets - 1);
+        return LinearLimit + (exponent - 5) * SubBuckets + sub;
+    }
+
+    // Largest value that maps to bucket.
+    static uint64_t BucketUpperBound(uint32_t bucket)
+    {
+        if (bucket < LinearLimit)
+            return bucket;
+        uint32_t exponent = (bucket - LinearLimit) / SubBuckets + 5;
+        uint64_t sub = (bucket - LinearLimit) % SubBuckets;
+        uint64_t width = uint64_t(1) << (exponent - SubBucketBits);
+        return (uint64_t(1) << exponent) + (sub + 1) * width - 1;
+    }
+
+private:
+    static uint32_t HighestBit(uint64_t value)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+            return index + 32;
+        _BitScanReverse(&index, static_cast<unsigned long>(value));
+        return index;
+#else
+        return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+    }
+
+    std::atomic<uint64_t> m_buckets[BucketCount] = {};
+    std::atomic<uint64_t> m_count{ 0 };
+    std::atomic<uint64_t> m_sum{ 0 };
+    std::atomic<uint64_t> m_max{ 0 };
+};
+
+// Where the time inside a capture goes.
+enum class CaptureStage
+{
+    Acquire,    // TryGetNextFrame on the frame arrived handler
+    Copy,       // GPU copy into the readback ring
+    Map,        // waiting for the staging copy to become readable
+    RowCopy,    // copying/converting the mapped rows into the caller's buffer
+    Resize,     // frame pool recreation after the source changed size
+    Scale,      // CPU resampling to the requested output size
+    Delivery,   // from the frame being captured to it being copied or leased out
+    Count,
+};
+
+struct StageStats
+{
+    uint64_t Count = 0;
+    uint64_t MeanNs = 0;
+    uint64_t P50Ns = 0;
+    uint64_t P95Ns = 0;
+    uint64_t P99Ns = 0;
+    uint64_t MaxNs = 0;
+};
+
+struct CaptureStatsSnapshot
+{
+    StageStats Stages[static_cast<size_t>(CaptureStage::Count)];
+    uint64_t Frames = 0;        // frames handed out by copy or lease
+    uint64_t NullFrames = 0;    // polls that found no frame
+    uint64_t Resizes = 0;       // frame pool recreations
+    uint64_t ResizeEvents = 0;  // source size changes, most absorbed without a recreate
+    uint64_t Decimated = 0;     // frames dropped before readback to hold the target frame rate
+    uint64_t BytesCopied = 0;   // bytes written to caller buffers, excluding row padding
+};
+
+// Per-capture timers and counters. Every update is a relaxed atomic, so the
+// frame arrived handler and the consumer can both record without locking;
+// Snapshot may run on any thread.
+class CaptureStats
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Times the enclosing scope into one stage.
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(CaptureStats& stats, CaptureStage stage) :
+            m_stats(stats), m_stage(stage), m_start(Clock::now())
+        {
+        }
+        ~ScopedTimer()
+        {
+            m_stats.Record(m_stage, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count());
+        }
+
+        ScopedTimer(ScopedTimer const&) = delete;
+        ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+    private:
+        CaptureStats& m_stats;
+        CaptureStage m_stage;
+        Clock::time_point m_start;
+    };
+
+    void Record(CaptureStage stage, int64_t ns)
+    {
+        m_stages[static_cast<size_t>(stage)].Record(ns < 0 ? 0 : static_cast<uint64_t>(ns));
+    }
+
+    void AddFrame() { m_frames.fetch_add(1, std::memory_order_relaxed); }
+    void AddNullFrame() { m_nullFrames.fetch_add(1, std::memory_order_relaxed); }
+    void AddResize() { m_resizes.fetch_add(1, std::memory_order_relaxed); }
+    void AddResizeEvent() { m_resizeEvents.fetch_add(1, std::memory_order_relaxed); }
+    void AddDecimated() { m_decimated.fetch_add(1, std::memory_order_relaxed); }
+    void AddBytesCopied(uint64_t bytes) { m_bytesCopied.fetch_add(bytes, std::memory_order_relaxed); }
+
+    // With reset, the next snapshot only covers what happens after this one,
+    // which turns the histograms into a window chosen by the caller.
+    CaptureStatsSnapshot Snapshot(bool reset = false)
+    {
+        CaptureStatsSnapshot snapshot;
+        for (size_t i = 0; i < static_cast<size_t>(CaptureStage::Count); i++)
+        {
+            auto& histogram = m_stages[i];
+            auto& stage = snapshot.Stages[i];
+            stage.Count = histogram.Count();
+            stage.MeanNs = histogram.Mean();
+            stage.P50Ns = histogram.Percentile(50);
+            stage.P95Ns = histogram.Percentile(95);
+            stage.P99Ns = histogram.Percentile(99);
+            stage.MaxNs = histogram.Max();
+            if (reset)
+                histogram.Reset();
+        }
+        snapshot.Frames = Take(m_frames, reset);
+        snapshot.NullFrames = Take(m_nullFrames, reset);
+        snapshot.Resizes = Take(m_resizes, reset);
+        snapshot.ResizeEvents = Take(m_resizeEvents, reset);
+        snapshot.Decimated = Take(m_decimated, reset);
+        snapshot.BytesCopied = Take(m_bytesCopied, reset);
+        return snapshot;
+    }
+
+private:
+    static uint64_t Take(std::atomic<uint64_t>& counter, bool reset)
+    {
+        return reset ? counter.exchange(0, std::memory_order_relaxed) : counter.load(std::memory_order_relaxed);
+    }
+
+    LatencyHistogram m_stages[static_cast<size_t>(CaptureStage::Count)];
+    std::atomic<uint64_t> m_frames{ 0 };
+    std::atomic<uint64_t> m_nullFrames{ 0 };
+    std::atomic<uint64_t> m_resizes{ 0 };
+    std::atomic<uint64_t> m_resizeEvents{ 0 };
+    std::atomic<uint64_t> m_decimated{ 0 };
+    std::atomic<uint64_t> m_bytesCopied{ 0 };
+};
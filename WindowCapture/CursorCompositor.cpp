@@ -0,0 +1,287 @@
+#include "CursorCompositor.h"
+#include <algorithm>
+#include "FrameScaler.h"
+#include "SimdTarget.h"
+
+namespace
+{
+    // FNV-1a; shapes are a few KB and hashed once per new cursor handle.
+    uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    void FinishShape(CursorShape& shape)
+    {
+        bool inverts = false;
+        for (auto value : shape.Invert)
+            inverts |= value != 0;
+        if (!inverts)
+            shape.Invert.clear();
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+        int32_t header[4] = {
+            static_cast<int32_t>(shape.Width), static_cast<int32_t>(shape.Height), shape.HotspotX, shape.HotspotY };
+        hash = HashBytes(hash, header, sizeof(header));
+        hash = HashBytes(hash, shape.Pixels.data(), shape.Pixels.size());
+        hash = HashBytes(hash, shape.Invert.data(), shape.Invert.size());
+        shape.Hash = hash;
+    }
+
+    CursorShape StartShape(uint32_t width, uint32_t height, int32_t hotspotX, int32_t hotspotY)
+    {
+        CursorShape shape;
+        shape.Width = width;
+        shape.Height = height;
+        shape.HotspotX = hotspotX;
+        shape.HotspotY = hotspotY;
+        shape.Pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+        shape.Invert.assign(static_cast<size_t>(width) * height, 0);
+        return shape;
+    }
+
+    void PutOpaque(uint8_t* px, uint32_t rgb)
+    {
+        px[0] = static_cast<uint8_t>(rgb);
+        px[1] = static_cast<uint8_t>(rgb >> 8);
+        px[2] = static_cast<uint8_t>(rgb >> 16);
+        px[3] = 255;
+    }
+
+    inline uint32_t Div255(uint32_t x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    void BlendRowScalar(uint8_t* dst, const uint8_t* src, uint32_t count, bool swapRedBlue)
+    {
+        for (uint32_t i = 0; i < count; i++, dst += 4, src += 4)
+        {
+            uint32_t inverse = 255 - src[3];
+            uint32_t b = src[swapRedBlue ? 2 : 0];
+            uint32_t r = src[swapRedBlue ? 0 : 2];
+            dst[0] = static_cast<uint8_t>(std::min<uint32_t>(255, b + Div255(dst[0] * inverse)));
+            dst[1] = static_cast<uint8_t>(std::min<uint32_t>(255, src[1] + Div255(dst[1] * inverse)));
+            dst[2] = static_cast<uint8_t>(std::min<uint32_t>(255, r + Div255(dst[2] * inverse)));
+            dst[3] = static_cast<uint8_t>(std::min<uint32_t>(255, src[3] + Div255(dst[3] * inverse)));
+        }
+    }
+
+    void BlendRow(uint8_t* dst, const uint8_t* src, uint32_t count, bool swapRedBlue)
+    {
+        uint32_t i = 0;
+#ifdef SIMD_X86
+        // SSE2 is baseline on every x86 target this builds for. Four pixels at
+        // a time in 16 bit lanes, with the same rounding as Div255.
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i c255 = _mm_set1_epi16(255);
+        const __m128i c128 = _mm_set1_epi16(128);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i * 4));
+            __m128i slo = _mm_unpacklo_epi8(s, zero);
+            __m128i shi = _mm_unpackhi_epi8(s, zero);
+            if (swapRedBlue)
+            {
+                slo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+                shi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, _MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2));
+                s = _mm_packus_epi16(slo, shi);
+            }
+            __m128i ilo = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+            __m128i ihi = _mm_sub_epi16(c255, _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)));
+            __m128i xlo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ilo), c128);
+            __m128i xhi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ihi), c128);
+            xlo = _mm_srli_epi16(_mm_add_epi16(xlo, _mm_srli_epi16(xlo, 8)), 8);
+            xhi = _mm_srli_epi16(_mm_add_epi16(xhi, _mm_srli_epi16(xhi, 8)), 8);
+            __m128i out = _mm_adds_epu8(_mm_packus_epi16(xlo, xhi), s);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), out);
+        }
+#endif
+        BlendRowScalar(dst + i * 4, src + i * 4, count - i, swapRedBlue);
+    }
+}
+
+CursorShape MakeAlphaCursor(uint32_t width, uint32_t height, int32_t hotspotX, int32_t hotspotY, const uint32_t* argb)
+{
+    auto shape = StartShape(width, height, hotspotX, hotspotY);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+    {
+        uint32_t pixel = argb[i];
+        uint32_t alpha = pixel >> 24;
+        uint8_t* px = &shape.Pixels[i * 4];
+        px[0] = static_cast<uint8_t>(Div255((pixel & 0xFF) * alpha));
+        px[1] = static_cast<uint8_t>(Div255(((pixel >> 8) & 0xFF) * alpha));
+        px[2] = static_cast<uint8_t>(Div255(((pixel >> 16) & 0xFF) * alpha));
+        px[3] = static_cast<uint8_t>(alpha);
+    }
+    FinishShape(shape);
+    return shape;
+}
+
+CursorShape MakeMaskedCursor(uint32_t width, uint32_t height, int32_t hotspotX, int32_t hotspotY, const uint32_t* rgb, const uint32_t* andMask)
+{
+    auto shape = StartShape(width, height, hotspotX, hotspotY);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+    {
+        uint32_t color = rgb[i] & 0xFFFFFF;
+        if ((andMask[i] & 0xFFFFFF) == 0)
+            PutOpaque(&shape.Pixels[i * 4], color);
+        else if (color != 0)
+            shape.Invert[i] = 1;    // XOR with the screen; inverting is what it looks like
+    }
+    FinishShape(shape);
+    return shape;
+}
+
+CursorShape MakeMonochromeCursor(uint32_t width, uint32_t height, int32_t hotspotX, int32_t hotspotY, const uint32_t* andMask, const uint32_t* xorMask)
+{
+    auto shape = StartShape(width, height, hotspotX, hotspotY);
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+    {
+        bool andBit = (andMask[i] & 0xFFFFFF) != 0;
+        bool xorBit = (xorMask[i] & 0xFFFFFF) != 0;
+        if (!andBit)
+            PutOpaque(&shape.Pixels[i * 4], xorBit ? 0xFFFFFF : 0);
+        else if (xorBit)
+            shape.Invert[i] = 1;
+    }
+    FinishShape(shape);
+    return shape;
+}
+
+CursorShape ScaleCursorShape(CursorShape const& shape, uint32_t width, uint32_t height)
+{
+    if (width == 0)
+        width = 1;
+    if (height == 0)
+        height = 1;
+    CursorShape scaled;
+    scaled.Width = width;
+    scaled.Height = height;
+    scaled.HotspotX = static_cast<int32_t>(static_cast<int64_t>(shape.HotspotX) * width / (shape.Width ? shape.Width : 1));
+    scaled.HotspotY = static_cast<int32_t>(static_cast<int64_t>(shape.HotspotY) * height / (shape.Height ? shape.Height : 1));
+    scaled.Pixels.resize(static_cast<size_t>(width) * height * 4);
+    if (shape.Width == 0 || shape.Height == 0)
+    {
+        std::fill(scaled.Pixels.begin(), scaled.Pixels.end(), static_cast<uint8_t>(0));
+        FinishShape(scaled);
+        return scaled;
+    }
+
+    // Premultiplied pixels filter correctly as they are. Box for shrinking,
+    // bilinear for enlarging.
+    FrameScaler scaler;
+    auto filter = width < shape.Width && height < shape.Height ? ScaleFilter::Box : ScaleFilter::Bilinear;
+    scaler.Scale(scaled.Pixels.data(), static_cast<size_t>(width) * 4, width, height,
+        shape.Pixels.data(), static_cast<size_t>(shape.Width) * 4, shape.Width, shape.Height, filter);
+
+    // The invert mask is all or nothing per pixel; take the nearest.
+    if (!shape.Invert.empty())
+    {
+        scaled.Invert.resize(static_cast<size_t>(width) * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            uint32_t sy = static_cast<uint32_t>(static_cast<uint64_t>(y) * shape.Height / height);
+            for (uint32_t x = 0; x < width; x++)
+            {
+                uint32_t sx = static_cast<uint32_t>(static_cast<uint64_t>(x) * shape.Width / width);
+                scaled.Invert[static_cast<size_t>(y) * width + x] = shape.Invert[static_cast<size_t>(sy) * shape.Width + sx];
+            }
+        }
+    }
+    FinishShape(scaled);
+    return scaled;
+}
+
+void BlendCursor(uint8_t* dst, size_t stride, uint32_t width, uint32_t height,
+    CursorShape const& shape, int32_t x, int32_t y, bool swapRedBlue)
+{
+    int64_t left = static_cast<int64_t>(x) - shape.HotspotX;
+    int64_t top = static_cast<int64_t>(y) - shape.HotspotY;
+    int64_t x0 = std::max<int64_t>(left, 0);
+    int64_t y0 = std::max<int64_t>(top, 0);
+    int64_t x1 = std::min<int64_t>(left + shape.Width, width);
+    int64_t y1 = std::min<int64_t>(top + shape.Height, height);
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    auto count = static_cast<uint32_t>(x1 - x0);
+    for (int64_t row = y0; row < y1; row++)
+    {
+        size_t sy = static_cast<size_t>(row - top);
+        size_t sx = static_cast<size_t>(x0 - left);
+        uint8_t* out = dst + static_cast<size_t>(row) * stride + static_cast<size_t>(x0) * 4;
+        BlendRow(out, &shape.Pixels[(sy * shape.Width + sx) * 4], count, swapRedBlue);
+        if (shape.Invert.empty())
+            continue;
+        const uint8_t* invert = &shape.Invert[sy * shape.Width + sx];
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (invert[i] == 0)
+                continue;
+            out[i * 4 + 0] = static_cast<uint8_t>(255 - out[i * 4 + 0]);
+            out[i * 4 + 1] = static_cast<uint8_t>(255 - out[i * 4 + 1]);
+            out[i * 4 + 2] = static_cast<uint8_t>(255 - out[i * 4 + 2]);
+        }
+    }
+}
+
+std::shared_ptr<const CursorShape> CursorShapeCache::Find(uint64_t handle)
+{
+    for (auto& entry : m_entries)
+    {
+        if (entry.Handle == handle)
+        {
+            entry.LastUse = ++m_tick;
+            m_hits++;
+            return entry.Shape;
+        }
+    }
+    m_misses++;
+    return nullptr;
+}
+
+std::shared_ptr<const CursorShape> CursorShapeCache::Insert(uint64_t handle, CursorShape&& shape)
+{
+    std::shared_ptr<const CursorShape> shared;
+    for (auto const& entry : m_entries)
+    {
+        if (entry.Shape->Hash == shape.Hash)
+        {
+            shared = entry.Shape;
+            break;
+        }
+    }
+    if (!shared)
+        shared = std::make_shared<const CursorShape>(std::move(shape));
+
+    for (auto& entry : m_entries)
+    {
+        if (entry.Handle == handle)
+        {
+            entry.Shape = shared;
+            entry.LastUse = ++m_tick;
+            return shared;
+        }
+    }
+    if (m_entries.size() >= m_capacity)
+    {
+        auto oldest = std::min_element(m_entries.begin(), m_entries.end(),
+            [](Entry const& a, Entry const& b) { return a.LastUse < b.LastUse; });
+        m_entries.erase(oldest);
+    }
+    Entry entry;
+    entry.Handle = handle;
+    entry.Shape = shared;
+    entry.LastUse = ++m_tick;
+    m_entries.push_back(entry);
+    return shared;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// A cursor image in the form the compositor draws: premultiplied BGRA plus an
+// optional mask of pixels that invert whatever is under them, which is how
+// monochrome and masked color cursors (the I-beam, for one) are drawn.
+struct CursorShape
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    int32_t HotspotX = 0;
+    int32_t HotspotY = 0;
+    std::vector<uint8_t> Pixels;    // Width * 4 bytes per row
+    std::vector<uint8_t> Invert;    // one byte per pixel, empty when nothing inverts
+    uint64_t Hash = 0;              // of everything above, for spotting identical shapes
+};
+
+// Shapes built from the rows Win32 hands out for the three kinds of cursor,
+// each as 0xAARRGGBB pixels, top row first. Mask pixels count as set when
+// their color bits are non-zero.
+// 32 bit cursor with straight alpha.
+CursorShape MakeAlphaCursor(uint32_t width, uint32_t height, int32_t hotspotX, int32_t hotspotY, const uint32_t* argb);
+// Color cursor without alpha: opaque where andMask is clear; where it is set,
+// transparent over a black color pixel and inverting otherwise.
+CursorShape MakeMaskedCursor(uint32_t width, uint32_t height, int32_t hotspotX, int32_t hotspotY, const uint32_t* rgb, const uint32_t* andMask);
+// Monochrome cursor: and/xor 0/0 black, 0/1 white, 1/0 transparent, 1/1 invert.
+CursorShape MakeMonochromeCursor(uint32_t width, uint32_t height, int32_t hotspotX, int32_t hotspotY, const uint32_t* andMask, const uint32_t* xorMask);
+
+// Resample a shape, hotspot included, for a scaled output.
+CursorShape ScaleCursorShape(CursorShape const& shape, uint32_t width, uint32_t height);
+
+// Draw shape into a BGRA (or, with swapRedBlue, RGBA) image with its hotspot
+// at (x, y), clipped to the image. Alpha blending is SSE2 where available and
+// gives the same bytes as the scalar path.
+void BlendCursor(uint8_t* dst, size_t stride, uint32_t width, uint32_t height,
+    CursorShape const& shape, int32_t x, int32_t y, bool swapRedBlue = false);
+
+// Position and shape of the cursor relative to a capture source's frames.
+struct CursorSample
+{
+    bool Visible = false;
+    int32_t X = 0;                  // hotspot, in source pixels
+    int32_t Y = 0;
+    std::shared_ptr<const CursorShape> Shape;
+};
+
+// Cursor as it appears in a copied frame.
+struct CursorState
+{
+    bool Visible = false;           // showing, with its hotspot inside the frame
+    int32_t X = 0;                  // hotspot, in output pixels
+    int32_t Y = 0;
+    std::shared_ptr<const CursorShape> Shape;  // as the source reported it, not scaled
+};
+
+// Shapes by cursor handle, so a cursor is fetched once rather than on every
+// frame. Handles that turn out to have the same image share one shape. Holds
+// at most capacity handles, dropping the least recently used.
+class CursorShapeCache
+{
+public:
+    explicit CursorShapeCache(size_t capacity = 32) : m_capacity(capacity == 0 ? 1 : capacity) {}
+
+    std::shared_ptr<const CursorShape> Find(uint64_t handle);
+    std::shared_ptr<const CursorShape> Insert(uint64_t handle, CursorShape&& shape);
+    void Clear() { m_entries.clear(); }
+
+    size_t Size() const noexcept { return m_entries.size(); }
+    uint64_t Hits() const noexcept { return m_hits; }
+    uint64_t Misses() const noexcept { return m_misses; }
+
+private:
+    struct Entry
+    {
+        uint64_t Handle = 0;
+        std::shared_ptr<const CursorShape> Shape;
+        uint64_t LastUse = 0;
+    };
+
+    size_t m_capacity;
+    std::vector<Entry> m_entries;
+    uint64_t m_tick = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
@@ -0,0 +1,105 @@
+#pragma once
+#include "D3D11ReadbackBackend.h"
+#include "FrameScaler.h"
+
+// Shrinks a region of a capture surface on the GPU before it is read back, so
+// the staging copy, the map and the row copy only move the reduced pixels.
+// The region is copied into mip 0 of a scratch texture and GenerateMips
+// builds the 2:1 box filtered chain below it; the caller reads back the level
+// it asked for and finishes the resampling on the CPU.
+//
+// The scratch texture keeps resize headroom like the staging ring. Its extents
+// are multiples of ResizeGranularity, so down to MaxLevels every level is an
+// exact 2:1 reduction of the one above and pixels outside the region never
+// bleed into the reduced copy.
+class D3D11Downscaler
+{
+public:
+    static constexpr uint32_t MaxLevels = 6;
+    static_assert((ResizeGranularity >> MaxLevels) << MaxLevels == ResizeGranularity, "levels must divide the allocation granularity");
+
+    D3D11Downscaler(
+        winrt::com_ptr<ID3D11Device> const& device,
+        winrt::com_ptr<ID3D11DeviceContext> const& context)
+    {
+        m_device = device;
+        m_context = context;
+    }
+
+    // Reduce region of src by 1..MaxLevels halvings. Returns the copy source
+    // for the reduced level and its size.
+    D3D11CopySource Reduce(
+        winrt::com_ptr<ID3D11Texture2D> const& src,
+        CropRect const& region,
+        uint32_t levels,
+        uint32_t& width,
+        uint32_t& height)
+    {
+        D3D11_TEXTURE2D_DESC srcDesc;
+        src->GetDesc(&srcDesc);
+        if (!m_texture || levels != m_levels || srcDesc.Format != m_format ||
+            !FitsAllocation(m_width, m_height, region.Width, region.Height))
+        {
+            Rebuild(WithResizeHeadroom(region.Width), WithResizeHeadroom(region.Height), levels, srcDesc.Format);
+        }
+
+        D3D11_BOX box = {};
+        box.left = region.X;
+        box.top = region.Y;
+        box.front = 0;
+        box.right = region.X + region.Width;
+        box.bottom = region.Y + region.Height;
+        box.back = 1;
+        m_context->CopySubresourceRegion(m_texture.get(), 0, 0, 0, 0, src.get(), 0, &box);
+        m_context->GenerateMips(m_view.get());
+
+        width = (std::max)(1u, region.Width >> levels);
+        height = (std::max)(1u, region.Height >> levels);
+        D3D11CopySource reduced;
+        reduced.Texture = m_texture.get();
+        reduced.Subresource = levels;
+        reduced.Box.right = width;
+        reduced.Box.bottom = height;
+        reduced.Box.back = 1;
+        return reduced;
+    }
+
+    void Reset()
+    {
+        m_view = nullptr;
+        m_texture = nullptr;
+    }
+
+private:
+    void Rebuild(uint32_t width, uint32_t height, uint32_t levels, DXGI_FORMAT format)
+    {
+        Reset();
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = width;
+        desc.Height = height;
+        desc.Format = format;
+        desc.MipLevels = levels + 1;
+        desc.ArraySize = 1;
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = 0;
+        desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+        m_texture = CreateTexture2D(m_device, &desc);
+        winrt::check_hresult(m_device->CreateShaderResourceView(m_texture.get(), nullptr, m_view.put()));
+        m_width = width;
+        m_height = height;
+        m_levels = levels;
+        m_format = format;
+    }
+
+    winrt::com_ptr<ID3D11Device> m_device;
+    winrt::com_ptr<ID3D11DeviceContext> m_context;
+    winrt::com_ptr<ID3D11Texture2D> m_texture;
+    winrt::com_ptr<ID3D11ShaderResourceView> m_view;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_levels = 0;
+    DXGI_FORMAT m_format = DXGI_FORMAT_UNKNOWN;
+};
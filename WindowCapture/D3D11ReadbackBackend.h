@@ -0,0 +1,72 @@
+#pragma once
+#include "ReadbackRing.h"
+
+// Part of one subresource to copy into a staging slot, placed at its origin.
+struct D3D11CopySource
+{
+    ID3D11Texture2D* Texture = nullptr;
+    UINT Subresource = 0;
+    D3D11_BOX Box = {};
+};
+
+// ReadbackRing backend on top of a D3D11 device and its immediate context.
+struct D3D11ReadbackBackend
+{
+public:
+    using Texture = winrt::com_ptr<ID3D11Texture2D>;
+
+    D3D11ReadbackBackend(
+        winrt::com_ptr<ID3D11Device> const& device,
+        winrt::com_ptr<ID3D11DeviceContext> const& context)
+    {
+        m_device = device;
+        m_context = context;
+    }
+
+    Texture CreateStaging(StagingDesc const& desc)
+    {
+        return CreateStageTexture2D(m_device, desc.Width, desc.Height, static_cast<DXGI_FORMAT>(desc.Format));
+    }
+
+    void Copy(Texture const& dst, winrt::com_ptr<ID3D11Texture2D> const& src)
+    {
+        m_context->CopySubresourceRegion(dst.get(), 0, 0, 0, 0, src.get(), 0, nullptr);
+    }
+
+    void Copy(Texture const& dst, D3D11CopySource const& src)
+    {
+        m_context->CopySubresourceRegion(dst.get(), 0, 0, 0, 0, src.Texture, src.Subresource, &src.Box);
+    }
+
+    bool Map(Texture const& tex, const uint8_t*& data, uint32_t& rowPitch)
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        if (FAILED(m_context->Map(tex.get(), 0, D3D11_MAP_READ, 0, &mapped)))
+            return false;
+        data = reinterpret_cast<const uint8_t*>(mapped.pData);
+        rowPitch = mapped.RowPitch;
+        return true;
+    }
+
+    MapStatus TryMap(Texture const& tex, const uint8_t*& data, uint32_t& rowPitch)
+    {
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        HRESULT hr = m_context->Map(tex.get(), 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+        if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+            return MapStatus::Pending;
+        if (FAILED(hr))
+            return MapStatus::Failed;
+        data = reinterpret_cast<const uint8_t*>(mapped.pData);
+        rowPitch = mapped.RowPitch;
+        return MapStatus::Mapped;
+    }
+
+    void Unmap(Texture const& tex)
+    {
+        m_context->Unmap(tex.get(), 0);
+    }
+
+private:
+    winrt::com_ptr<ID3D11Device> m_device;
+    winrt::com_ptr<ID3D11DeviceContext> m_context;
+};
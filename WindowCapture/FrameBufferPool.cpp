@@ -0,0 +1,250 @@
+#include "FrameBufferPool.h"
+#include <iterator>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cstdio>
+#include <sys/mman.h>
+#endif
+
+// Write a byte to every page, so the faults are taken now rather than by the
+// first frame copied in.
+static void Prefault(uint8_t* data, size_t size)
+{
+    for (size_t offset = 0; offset < size; offset += FrameBufferPool::PageSize)
+        data[offset] = 0;
+}
+
+#ifdef _WIN32
+
+// Large pages need SeLockMemoryPrivilege held and enabled; it is only ever
+// held if an administrator granted "Lock pages in memory" to the user.
+static bool EnableLockMemoryPrivilege()
+{
+    HANDLE token = nullptr;
+    if (!::OpenProcessToken(::GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return false;
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool enabled = ::LookupPrivilegeValueW(nullptr, L"SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+        ::AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+        ::GetLastError() == ERROR_SUCCESS;
+    ::CloseHandle(token);
+    return enabled;
+}
+
+size_t FrameBufferPool::LargePageSize()
+{
+    static size_t const size = EnableLockMemoryPrivilege() ? ::GetLargePageMinimum() : 0;
+    return size;
+}
+
+static void* AllocatePages(size_t size, bool large)
+{
+    // Large pages are locked in memory, so they come faulted in.
+    DWORD type = MEM_RESERVE | MEM_COMMIT | (large ? MEM_LARGE_PAGES : 0);
+    return ::VirtualAlloc(nullptr, size, type, PAGE_READWRITE);
+}
+
+void FrameBufferPool::Free(Block const& block)
+{
+    ::VirtualFree(block.Data, 0, MEM_RELEASE);
+}
+
+#else
+
+size_t FrameBufferPool::LargePageSize()
+{
+    static size_t const size = []() -> size_t
+    {
+        std::FILE* meminfo = std::fopen("/proc/meminfo", "r");
+        if (meminfo == nullptr)
+            return 0;
+        char line[128];
+        unsigned long long kb = 0;
+        while (std::fgets(line, sizeof(line), meminfo) != nullptr)
+        {
+            if (std::sscanf(line, "Hugepagesize: %llu kB", &kb) == 1)
+                break;
+        }
+        std::fclose(meminfo);
+        return static_cast<size_t>(kb) * 1024;
+    }();
+    return size;
+}
+
+static void* AllocatePages(size_t size, bool large)
+{
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (large)
+    {
+#if defined(MAP_HUGETLB) && defined(MAP_POPULATE)
+        flags |= MAP_HUGETLB | MAP_POPULATE;
+#else
+        return nullptr;
+#endif
+    }
+    void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    return data == MAP_FAILED ? nullptr : data;
+}
+
+void FrameBufferPool::Free(Block const& block)
+{
+    ::munmap(block.Data, block.Size);
+}
+
+#endif
+
+FrameBufferPool::FrameBufferPool(bool largePages, size_t maxCachedBytes) :
+    m_largePages(largePages),
+    m_maxCachedBytes(maxCachedBytes)
+{
+}
+
+FrameBufferPool::~FrameBufferPool()
+{
+    for (auto const& entry : m_inUse)
+        Free(entry.second);
+    for (auto const& block : m_cached)
+        Free(block);
+}
+
+size_t FrameBufferPool::ClassSize(size_t bytes)
+{
+    if (bytes <= MinClassSize)
+        return MinClassSize;
+    size_t power = MinClassSize;
+    while (power <= bytes / 2)
+        power *= 2;
+    size_t step = power / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+bool FrameBufferPool::Allocate(size_t classSize, Block& block)
+{
+    block.Class = classSize;
+    size_t large = m_largePages ? LargePageSize() : 0;
+    if (large != 0 && classSize >= large)
+    {
+        // Worth it only while rounding up to whole large pages wastes little.
+        size_t rounded = (classSize + large - 1) / large * large;
+        if (rounded - classSize <= classSize / 8)
+        {
+            block.Data = static_cast<uint8_t*>(AllocatePages(rounded, true));
+            if (block.Data != nullptr)
+            {
+                block.Size = rounded;
+                block.Large = true;
+                return true;
+            }
+        }
+    }
+
+    block.Data = static_cast<uint8_t*>(AllocatePages(classSize, false));
+    if (block.Data == nullptr)
+        return false;
+    block.Size = classSize;
+    block.Large = false;
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+    // Ahead of the faults, which is when transparent huge pages are picked.
+    if (m_largePages)
+        ::madvise(block.Data, block.Size, MADV_HUGEPAGE);
+#endif
+    Prefault(block.Data, block.Size);
+    return true;
+}
+
+uint8_t* FrameBufferPool::Acquire(size_t bytes, size_t* capacity)
+{
+    size_t classSize = ClassSize(bytes);
+    Block block;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Most recently released first: the likeliest to still be in cache.
+        for (auto it = m_cached.rbegin(); it != m_cached.rend(); ++it)
+        {
+            if (it->Class == classSize)
+            {
+                block = *it;
+                m_cached.erase(std::next(it).base());
+                m_stats.BytesCached -= block.Size;
+                m_stats.BytesInUse += block.Size;
+                m_stats.Reused++;
+                m_inUse.emplace(block.Data, block);
+                if (capacity != nullptr)
+                    *capacity = block.Size;
+                return block.Data;
+            }
+        }
+    }
+
+    // Faulting in a fresh buffer takes a while; not under the lock.
+    if (!Allocate(classSize, block))
+    {
+        // Cached buffers of other sizes may be all that stands in the way.
+        Trim();
+        if (!Allocate(classSize, block))
+            return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.Allocated++;
+    if (block.Large)
+        m_stats.LargePageBuffers++;
+    m_stats.BytesInUse += block.Size;
+    m_inUse.emplace(block.Data, block);
+    if (capacity != nullptr)
+        *capacity = block.Size;
+    return block.Data;
+}
+
+bool FrameBufferPool::Release(uint8_t* data)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_inUse.find(data);
+    if (it == m_inUse.end())
+        return false;
+    Block block = it->second;
+    m_inUse.erase(it);
+    m_stats.BytesInUse -= block.Size;
+    if (block.Size > m_maxCachedBytes)
+    {
+        Free(block);
+        m_stats.Freed++;
+        return true;
+    }
+    EvictLocked(block.Size);
+    m_cached.push_back(block);
+    m_stats.BytesCached += block.Size;
+    return true;
+}
+
+void FrameBufferPool::Trim()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EvictLocked(m_maxCachedBytes);
+}
+
+void FrameBufferPool::EvictLocked(size_t bytes)
+{
+    while (!m_cached.empty() && m_stats.BytesCached + bytes > m_maxCachedBytes)
+    {
+        Free(m_cached.front());
+        m_stats.BytesCached -= m_cached.front().Size;
+        m_stats.Freed++;
+        m_cached.pop_front();
+    }
+}
+
+FrameBufferPoolStats FrameBufferPool::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
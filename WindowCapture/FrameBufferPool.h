@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+struct FrameBufferPoolStats
+{
+    uint64_t Allocated = 0;         // buffers taken fresh from the system
+    uint64_t Reused = 0;            // acquires served from the cache
+    uint64_t Freed = 0;             // buffers given back to the system
+    uint64_t LargePageBuffers = 0;  // of Allocated, backed by large pages
+    uint64_t BytesInUse = 0;
+    uint64_t BytesCached = 0;
+};
+
+// Page aligned buffers for whole frames, faulted in before they are handed
+// out and kept for reuse once released, so neither a new buffer nor a resize
+// back to a size seen before costs the first write a page fault per 4 KB.
+//
+// Requests are rounded up to a size class, a quarter of a power of two apart,
+// so frames of a window being dragged around share buffers and no buffer is
+// more than a quarter larger than asked. Buffers of a large page multiple or
+// more come from large pages where the system allows: on Windows that takes
+// the "Lock pages in memory" right, on Linux pages reserved for hugetlbfs;
+// otherwise Linux is asked for transparent huge pages. Released buffers are
+// cached up to a byte limit, the longest unused going back to the system
+// first.
+//
+// Thread safe.
+class FrameBufferPool
+{
+public:
+    static constexpr size_t PageSize = 4096;
+    static constexpr size_t MinClassSize = 64u << 10;
+    static constexpr size_t DefaultMaxCachedBytes = 512u << 20;
+
+    explicit FrameBufferPool(bool largePages = true, size_t maxCachedBytes = DefaultMaxCachedBytes);
+    // Frees every buffer, including any still acquired.
+    ~FrameBufferPool();
+
+    FrameBufferPool(FrameBufferPool const&) = delete;
+    FrameBufferPool& operator=(FrameBufferPool const&) = delete;
+
+    // A buffer of at least bytes, capacity receiving its actual size. Returns
+    // nullptr when the system is out of memory.
+    uint8_t* Acquire(size_t bytes, size_t* capacity = nullptr);
+    // Returns false for pointers the pool didn't hand out.
+    bool Release(uint8_t* data);
+    // Give every cached buffer back to the system.
+    void Trim();
+
+    FrameBufferPoolStats Stats();
+
+    static size_t ClassSize(size_t bytes);
+    // Large page size, 0 when the system has none to give.
+    static size_t LargePageSize();
+
+private:
+    struct Block
+    {
+        uint8_t* Data = nullptr;
+        size_t Size = 0;        // mapped, at least Class
+        size_t Class = 0;
+        bool Large = false;
+    };
+
+    bool Allocate(size_t classSize, Block& block);
+    static void Free(Block const& block);
+    // Free cached blocks, longest unused first, until bytes more would fit.
+    void EvictLocked(size_t bytes);
+
+    bool m_largePages;
+    size_t m_maxCachedBytes;
+    std::mutex m_mutex;
+    std::unordered_map<uint8_t*, Block> m_inUse;
+    std::deque<Block> m_cached;         // in release order
+    FrameBufferPoolStats m_stats;
+};
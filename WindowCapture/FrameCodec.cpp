@@ -0,0 +1,325 @@
+#include "FrameCodec.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Frames whose payload wouldn't fit the header's 32 bit size; 8K BGRA is
+    // about 130 MB, so this only turns away nonsense.
+    constexpr uint64_t MaxFrameBytes = UINT32_MAX - 64;
+    // Most a payload exceeds the frame by: the last segment's varints.
+    constexpr size_t PayloadSlack = 16;
+
+    inline uint32_t Load32(const uint8_t* p)
+    {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t Load64(const uint8_t* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline void Store32(uint8_t* p, uint32_t value)
+    {
+        std::memcpy(p, &value, sizeof(value));
+    }
+
+    inline uint8_t* PutVarint(uint8_t* out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            *out++ = static_cast<uint8_t>(value) | 0x80;
+            value >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(value);
+        return out;
+    }
+
+    inline bool GetVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value)
+    {
+        value = 0;
+        for (uint32_t shift = 0; shift < 64 && in < end; shift += 7)
+        {
+            uint8_t byte = *in++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // First word from i on where cur and ref differ, or n. Unchanged areas
+    // are most of a typical delta frame, so this compares two words at once.
+    inline size_t SameUntil(const uint8_t* cur, const uint8_t* ref, size_t i, size_t n)
+    {
+        while (i + 2 <= n && Load64(cur + i * 4) == Load64(ref + i * 4))
+            i += 2;
+        while (i < n && Load32(cur + i * 4) == Load32(ref + i * 4))
+            i++;
+        return i;
+    }
+
+    uint8_t* PutLiterals(uint8_t* out, const uint8_t* cur, const uint8_t* ref, size_t first, size_t last)
+    {
+        out = PutVarint(out, last - first);
+        for (size_t i = first; i < last; i++, out += 4)
+            Store32(out, Load32(cur + i * 4) ^ Load32(ref + i * 4));
+        return out;
+    }
+
+    // Code the XOR of cur and ref, n words of it, as literal and run segments.
+    uint8_t* EncodeWords(uint8_t* out, const uint8_t* cur, const uint8_t* ref, size_t n)
+    {
+        size_t literal = 0;
+        size_t i = 0;
+        while (i < n)
+        {
+            uint32_t delta = Load32(cur + i * 4) ^ Load32(ref + i * 4);
+            size_t j = i + 1;
+            if (delta == 0)
+            {
+                j = SameUntil(cur, ref, j, n);
+            }
+            else
+            {
+                while (j < n && (Load32(cur + j * 4) ^ Load32(ref + j * 4)) == delta)
+                    j++;
+            }
+
+            // A run pays for its token once it saves more than it costs:
+            // two words of zeros, or three of anything else.
+            if (j - i >= (delta == 0 ? 2u : 3u))
+            {
+                out = PutLiterals(out, cur, ref, literal, i);
+                out = PutVarint(out, (static_cast<uint64_t>(j - i) << 1) | (delta != 0 ? 1 : 0));
+                if (delta != 0)
+                {
+                    Store32(out, delta);
+                    out += 4;
+                }
+                literal = j;
+            }
+            i = j;
+        }
+        out = PutLiterals(out, cur, ref, literal, n);
+        return PutVarint(out, 0);
+    }
+
+    inline void XorInto(uint8_t* dst, const uint8_t* src, size_t bytes)
+    {
+        size_t i = 0;
+        for (; i + 8 <= bytes; i += 8)
+        {
+            uint64_t value = Load64(dst + i) ^ Load64(src + i);
+            std::memcpy(dst + i, &value, sizeof(value));
+        }
+        for (; i < bytes; i++)
+            dst[i] ^= src[i];
+    }
+
+    inline void Fill32(uint8_t* dst, uint32_t value, size_t words)
+    {
+        if (value == 0)
+        {
+            std::memset(dst, 0, words * 4);
+            return;
+        }
+        for (size_t i = 0; i < words; i++)
+            Store32(dst + i * 4, value);
+    }
+
+    inline void Xor32(uint8_t* dst, uint32_t value, size_t words)
+    {
+        for (size_t i = 0; i < words; i++)
+            Store32(dst + i * 4, Load32(dst + i * 4) ^ value);
+    }
+}
+
+size_t GetCodedStride(OutputFormat format, uint32_t width)
+{
+    // Word aligned rows also leave room for the chroma row of an odd width
+    // NV12 frame, which is a byte longer than its luma row.
+    return (GetOutputRowBytes(format, width) + 3) & ~size_t(3);
+}
+
+size_t GetMaxEncodedSize(OutputFormat format, uint32_t width, uint32_t height)
+{
+    return sizeof(EncodedFrameHeader) + GetOutputFrameSize(format, width, height, GetCodedStride(format, width)) + PayloadSlack;
+}
+
+bool FrameEncoder::Encode(const uint8_t* src, size_t srcStride, OutputFormat format, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+{
+    if (src == nullptr || width == 0 || height == 0 || format < OutputFormat::Bgra || format > OutputFormat::I420)
+        return false;
+    size_t stride = GetCodedStride(format, width);
+    if (srcStride < GetOutputRowBytes(format, width) || uint64_t(stride) * height * 2 > MaxFrameBytes)
+        return false;
+    size_t bytes = GetOutputFrameSize(format, width, height, stride);
+
+    bool key = m_forceKey || format != m_format || width != m_width || height != m_height ||
+        (m_interval != 0 && m_sinceKey >= m_interval);
+    m_current.resize(stride + bytes);
+    std::memset(m_current.data(), 0, stride);
+    uint8_t* cur = m_current.data() + stride;
+    CopyOutputFrame(cur, stride, src, srcStride, format, width, height);
+    const uint8_t* ref = key ? m_current.data() : m_reference.data() + stride;
+
+    out.resize(GetMaxEncodedSize(format, width, height));
+    uint8_t* payload = out.data() + sizeof(EncodedFrameHeader);
+    size_t words = bytes / 4;
+    uint8_t* end = EncodeWords(payload, cur, ref, words);
+    for (size_t i = words * 4; i < bytes; i++)
+        *end++ = cur[i] ^ ref[i];
+
+    EncodedFrameHeader header = {};
+    header.Magic = EncodedFrameMagic;
+    header.Version = EncodedFrameVersion;
+    header.Flags = key ? EncodedKeyframe : 0;
+    header.Format = static_cast<uint8_t>(format);
+    header.Width = width;
+    header.Height = height;
+    header.Stride = static_cast<uint32_t>(stride);
+    header.PayloadBytes = static_cast<uint32_t>(end - payload);
+    header.Sequence = m_sequence;
+    std::memcpy(out.data(), &header, sizeof(header));
+    out.resize(sizeof(header) + header.PayloadBytes);
+
+    std::swap(m_current, m_reference);
+    m_format = format;
+    m_width = width;
+    m_height = height;
+    m_sinceKey = key ? 1 : m_sinceKey + 1;
+    m_forceKey = false;
+    m_sequence++;
+    if (key)
+        m_keyframes++;
+    return true;
+}
+
+bool FrameDecoder::ReadHeader(const uint8_t* data, size_t size, EncodedFrameHeader& header)
+{
+    if (data == nullptr || size < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.Magic != EncodedFrameMagic || header.Version != EncodedFrameVersion ||
+        header.Format > static_cast<uint8_t>(OutputFormat::I420) ||
+        header.Width == 0 || header.Height == 0)
+        return false;
+    auto format = static_cast<OutputFormat>(header.Format);
+    size_t stride = GetCodedStride(format, header.Width);
+    return header.Stride == stride &&
+        uint64_t(stride) * header.Height * 2 <= MaxFrameBytes &&
+        header.PayloadBytes <= size - sizeof(header);
+}
+
+DecodeResult FrameDecoder::Decode(const uint8_t* data, size_t size)
+{
+    EncodedFrameHeader header;
+    if (!ReadHeader(data, size, header))
+    {
+        m_valid = false;
+        return DecodeResult::Corrupt;
+    }
+    auto format = static_cast<OutputFormat>(header.Format);
+    bool key = (header.Flags & EncodedKeyframe) != 0;
+    if (!key && (!m_valid || header.Sequence != m_sequence + 1 || format != m_format ||
+        header.Width != m_width || header.Height != m_height))
+    {
+        m_valid = false;
+        return DecodeResult::NeedKeyframe;
+    }
+
+    // From here on a failure leaves the frame half updated.
+    m_valid = false;
+    size_t stride = header.Stride;
+    size_t bytes = GetOutputFrameSize(format, header.Width, header.Height, stride);
+    if (key)
+    {
+        m_frame.resize(stride + bytes);
+        std::memset(m_frame.data(), 0, stride);
+    }
+    uint8_t* frame = m_frame.data() + stride;
+
+    const uint8_t* in = data + sizeof(header);
+    const uint8_t* end = in + header.PayloadBytes;
+    size_t words = bytes / 4;
+    size_t i = 0;
+    for (;;)
+    {
+        uint64_t count;
+        if (!GetVarint(in, end, count) || count > words - i || count > static_cast<size_t>(end - in) / 4)
+            return DecodeResult::Corrupt;
+        if (key)
+            std::memcpy(frame + i * 4, in, static_cast<size_t>(count) * 4);
+        else
+            XorInto(frame + i * 4, in, static_cast<size_t>(count) * 4);
+        in += count * 4;
+        i += static_cast<size_t>(count);
+
+        uint64_t token;
+        if (!GetVarint(in, end, token))
+            return DecodeResult::Corrupt;
+        uint64_t run = token >> 1;
+        if (run == 0)
+        {
+            if (token != 0)
+                return DecodeResult::Corrupt;
+            break;
+        }
+        if (run > words - i)
+            return DecodeResult::Corrupt;
+        uint32_t value = 0;
+        if (token & 1)
+        {
+            if (end - in < 4)
+                return DecodeResult::Corrupt;
+            value = Load32(in);
+            in += 4;
+        }
+        if (key)
+            Fill32(frame + i * 4, value, static_cast<size_t>(run));
+        else if (value != 0)
+            Xor32(frame + i * 4, value, static_cast<size_t>(run));
+        i += static_cast<size_t>(run);
+    }
+    size_t tail = bytes - words * 4;
+    if (i != words || static_cast<size_t>(end - in) != tail)
+        return DecodeResult::Corrupt;
+    if (key)
+        std::memcpy(frame + words * 4, in, tail);
+    else
+        XorInto(frame + words * 4, in, tail);
+    if (key)
+    {
+        // Undo the prediction from the row above, top down.
+        for (size_t row = stride; row < bytes; row += stride)
+            XorInto(frame + row, frame + row - stride, std::min(stride, bytes - row));
+    }
+
+    m_format = format;
+    m_width = header.Width;
+    m_height = header.Height;
+    m_stride = stride;
+    m_sequence = header.Sequence;
+    m_keyframe = key;
+    m_valid = true;
+    return DecodeResult::Ok;
+}
+
+bool FrameDecoder::CopyFrame(uint8_t* dst, size_t dstSize, size_t dstStride) const
+{
+    if (!m_valid || dst == nullptr)
+        return false;
+    size_t rowBytes = GetOutputRowBytes(m_format, m_width);
+    if (dstStride == 0)
+        dstStride = rowBytes;
+    if (dstStride < rowBytes || GetOutputFrameSize(m_format, m_width, m_height, dstStride) > dstSize)
+        return false;
+    CopyOutputFrame(dst, dstStride, Frame(), m_stride, m_format, m_width, m_height);
+    return true;
+}
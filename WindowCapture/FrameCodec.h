@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "PixelConvert.h"
+
+// Lossless codec for captured frames, built for speed over ratio. A frame is
+// XORed with a reference, which turns everything that didn't change into
+// zero bytes, and the result run-length coded a 32 bit word at a time. Delta
+// frames use the previous frame as the reference; keyframes use the row
+// above, so flat areas and vertical edges still come out as runs, and a
+// decoder can start from them.
+//
+// Payload, after the header: segments of
+//   varint literal count, literal words,
+//   varint run << 1 | 1 if the run word is non-zero, that word if so,
+// ending with a segment whose run is 0, then the frame's last size % 4 bytes
+// as they are. Varints are LEB128; words are little endian.
+struct EncodedFrameHeader
+{
+    uint32_t Magic;             // "WCDF"
+    uint8_t Version;
+    uint8_t Flags;              // EncodedKeyframe
+    uint8_t Format;             // OutputFormat
+    uint8_t Reserved;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Stride;            // of the coded frame, as for GetOutputFrameSize
+    uint32_t PayloadBytes;      // after the header
+    uint64_t Sequence;          // a delta frame applies to the frame numbered one less
+};
+static_assert(sizeof(EncodedFrameHeader) == 32, "EncodedFrameHeader is a wire format");
+
+constexpr uint32_t EncodedFrameMagic = 0x46444357;  // "WCDF"
+constexpr uint8_t EncodedFrameVersion = 1;
+constexpr uint8_t EncodedKeyframe = 1u << 0;
+
+// Stride frames are coded at: the packed row size rounded up to a word.
+size_t GetCodedStride(OutputFormat format, uint32_t width);
+// Most bytes Encode can produce for a frame, header included.
+size_t GetMaxEncodedSize(OutputFormat format, uint32_t width, uint32_t height);
+
+// Not thread safe.
+class FrameEncoder
+{
+public:
+    static constexpr uint32_t DefaultKeyframeInterval = 120;
+
+    // A keyframe every interval frames; 0 for only the first frame, size or
+    // format changes and RequestKeyframe.
+    void SetKeyframeInterval(uint32_t interval) { m_interval = interval; }
+    uint32_t KeyframeInterval() const noexcept { return m_interval; }
+    void RequestKeyframe() { m_forceKey = true; }
+
+    // Encode a frame in the output layout at srcStride, as for
+    // GetOutputFrameSize, replacing the contents of out.
+    bool Encode(const uint8_t* src, size_t srcStride, OutputFormat format, uint32_t width, uint32_t height, std::vector<uint8_t>& out);
+
+    uint64_t Frames() const noexcept { return m_sequence; }
+    uint64_t Keyframes() const noexcept { return m_keyframes; }
+
+private:
+    // Previous frame and the one being coded, each behind a row of zeros so
+    // a keyframe's first row predicts from zero without a special case.
+    std::vector<uint8_t> m_reference;
+    std::vector<uint8_t> m_current;
+    OutputFormat m_format = OutputFormat::Bgra;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_interval = DefaultKeyframeInterval;
+    uint32_t m_sinceKey = 0;
+    bool m_forceKey = true;
+    uint64_t m_sequence = 0;
+    uint64_t m_keyframes = 0;
+};
+
+enum class DecodeResult
+{
+    Ok,
+    Corrupt,        // not a frame this decoder understands
+    NeedKeyframe,   // a delta that doesn't follow the last frame decoded
+};
+
+// Not thread safe.
+class FrameDecoder
+{
+public:
+    static bool ReadHeader(const uint8_t* data, size_t size, EncodedFrameHeader& header);
+
+    // Decode one frame produced by FrameEncoder. After a failure only a
+    // keyframe is accepted.
+    DecodeResult Decode(const uint8_t* data, size_t size);
+    void Reset() { m_valid = false; }
+
+    bool Valid() const noexcept { return m_valid; }
+    OutputFormat Format() const noexcept { return m_format; }
+    uint32_t Width() const noexcept { return m_width; }
+    uint32_t Height() const noexcept { return m_height; }
+    uint64_t Sequence() const noexcept { return m_sequence; }
+    bool Keyframe() const noexcept { return m_keyframe; }
+    // The decoded frame, at Stride.
+    const uint8_t* Frame() const noexcept { return m_frame.data() + m_stride; }
+    size_t Stride() const noexcept { return m_stride; }
+
+    // Copy the last decoded frame to dst at dstStride, 0 for the packed row
+    // size. Returns false if it doesn't fit dstSize.
+    bool CopyFrame(uint8_t* dst, size_t dstSize, size_t dstStride) const;
+
+private:
+    std::vector<uint8_t> m_frame;   // behind a row of zeros, as in FrameEncoder
+    OutputFormat m_format = OutputFormat::Bgra;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    size_t m_stride = 0;
+    uint64_t m_sequence = 0;
+    bool m_keyframe = false;
+    bool m_valid = false;
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Turns "a frame landed" notifications from the capture thread into either a
+// wakeup for a thread blocked in Wait, or a call to a registered callback on a
+// dedicated dispatch thread. Notifications that pile up while the consumer is
+// busy are coalesced: the consumer is told frames are ready, not how many.
+class FrameDispatcher
+{
+public:
+    using Callback = std::function<void()>;
+
+    FrameDispatcher() = default;
+    ~FrameDispatcher() { SetCallback(nullptr); }
+
+    FrameDispatcher(FrameDispatcher const&) = delete;
+    FrameDispatcher& operator=(FrameDispatcher const&) = delete;
+
+    // Producer side. Cheap enough to call from the frame arrived handler.
+    void Notify()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_posted++;
+            if (m_hook)
+                m_hook();
+        }
+        m_cv.notify_all();
+    }
+
+    // Run hook inline on the producer thread for every notification. Meant for
+    // cheap bookkeeping such as marking a session ready; it runs under the
+    // dispatcher lock and must not call back into this object.
+    void SetNotifyHook(Callback hook)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hook = std::move(hook);
+    }
+
+    // Block until a frame arrives that hasn't been waited for yet, or the
+    // timeout expires. Returns immediately if one is already pending.
+    bool Wait(uint32_t timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool ready = m_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+            [this] { return m_posted != m_waited; });
+        if (ready)
+            m_waited = m_posted;
+        return ready;
+    }
+
+    // Install or, with nullptr, remove the callback. The callback runs on the
+    // dispatch thread and must not call SetCallback itself.
+    void SetCallback(Callback callback)
+    {
+        StopThread();
+        if (!callback)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_callback = std::move(callback);
+        m_dispatched = m_posted;
+        m_stop = false;
+        m_thread = std::thread([this] { DispatchLoop(); });
+    }
+
+    uint64_t Posted()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_posted;
+    }
+
+private:
+    void DispatchLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_cv.wait(lock, [this] { return m_stop || m_posted != m_dispatched; });
+            if (m_stop)
+                return;
+            m_dispatched = m_posted;
+
+            auto callback = m_callback;
+            lock.unlock();
+            callback();
+            lock.lock();
+        }
+    }
+
+    void StopThread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable())
+            m_thread.join();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_callback = nullptr;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::thread m_thread;
+    Callback m_callback;
+    Callback m_hook;
+    uint64_t m_posted = 0;
+    uint64_t m_waited = 0;
+    uint64_t m_dispatched = 0;
+    bool m_stop = false;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include "ReadbackRing.h"
+
+// A frame handed out in place: the pointer addresses mapped staging memory and
+// stays valid until the lease is returned.
+struct FrameLease
+{
+    const uint8_t* Data = nullptr;
+    uint32_t RowPitch = 0;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t Format = 0;
+    uint64_t Size = 0;
+    uint64_t FrameIndex = 0;
+    uint64_t CaptureTimeNs = 0;     // see FrameTiming
+    uint64_t DeliveryTimeNs = 0;
+};
+
+// Bookkeeping for outstanding leases on ReadbackRing slots. Every lease pins a
+// mapped slot, so the ring needs one spare slot per allowed lease to keep its
+// copy pipeline moving while consumers read in place.
+class FrameLeasePool
+{
+public:
+    explicit FrameLeasePool(uint32_t maxLeases) : m_maxLeases(maxLeases) {}
+
+    bool CanLease() const noexcept { return m_leased.size() < m_maxLeases; }
+    size_t Outstanding() const noexcept { return m_leased.size(); }
+    uint32_t MaxLeases() const noexcept { return m_maxLeases; }
+
+    FrameLease Lease(MappedSlot const& slot, uint64_t deliveryTimeNs)
+    {
+        m_leased.push_back(slot);
+
+        FrameLease lease;
+        lease.Data = slot.Data;
+        lease.RowPitch = slot.RowPitch;
+        lease.Width = slot.Desc.Width;
+        lease.Height = slot.Desc.Height;
+        lease.Format = slot.Desc.Format;
+        // The last row only needs its visible bytes, the pitch padding after it
+        // is not guaranteed to be mapped.
+        lease.Size = slot.Desc.Height == 0 ? 0 :
+            static_cast<uint64_t>(slot.RowPitch) * (slot.Desc.Height - 1) + static_cast<uint64_t>(slot.Desc.Width) * 4;
+        lease.FrameIndex = slot.FrameIndex;
+        lease.CaptureTimeNs = slot.CaptureTimeNs;
+        lease.DeliveryTimeNs = deliveryTimeNs;
+        return lease;
+    }
+
+    // Look up the slot behind a lease. Fails for unknown or already returned
+    // frame indices so a double release can't unmap someone else's slot.
+    bool Return(uint64_t frameIndex, MappedSlot& slot)
+    {
+        for (auto it = m_leased.begin(); it != m_leased.end(); ++it)
+        {
+            if (it->FrameIndex == frameIndex)
+            {
+                slot = *it;
+                m_leased.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename TRelease>
+    void ReturnAll(TRelease&& release)
+    {
+        for (auto const& slot : m_leased)
+            release(slot);
+        m_leased.clear();
+    }
+
+private:
+    uint32_t m_maxLeases;
+    std::vector<MappedSlot> m_leased;
+};
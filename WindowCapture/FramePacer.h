@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// When a capture source and its consumer last touched a frame, in nanoseconds
+// on the steady clock (QueryPerformanceCounter on Windows, the same clock
+// Direct3D11CaptureFrame::SystemRelativeTime counts on). 0 when unknown.
+struct FrameTiming
+{
+    uint64_t FrameIndex = 0;
+    uint64_t CaptureTimeNs = 0;     // the compositor (or synthetic producer) finished the frame
+    uint64_t DeliveryTimeNs = 0;    // the frame was copied or leased to the caller
+    uint64_t FrameId = 0;           // counts delivered frames, never restarting unlike FrameIndex
+    uint64_t AcquireTimeNs = 0;     // the capture took the frame off its queue and started the readback
+    uint64_t CopyStartNs = 0;       // the readback landed and the CPU copy began
+    uint64_t CopyEndNs = 0;         // the frame was in the caller's buffer, or leased
+};
+
+// Decides which frames a capture keeps when it produces more than the target
+// rate. Ask before paying for the readback: frames it turns down should be
+// dropped while they are still GPU surfaces.
+//
+// Admitted frames are spaced on a grid of slots one interval apart. A frame is
+// taken when it arrives no more than a quarter interval before the next slot,
+// and the slot then advances by one interval from where it was rather than
+// from the frame, so jitter in the source neither drifts the rate nor makes
+// 60 -> 30 decimation alternate unevenly. After a gap longer than a slot the
+// grid restarts at the frame that ended it instead of letting a burst catch up.
+//
+// Times are passed in, which keeps it deterministic under a synthetic clock.
+// Not thread safe.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Frames per second to let through; 0 or less lets everything through.
+    void SetTargetFrameRate(double fps)
+    {
+        m_fps = fps > 0 ? fps : 0;
+        m_interval = m_fps > 0 ?
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_fps)) :
+            Clock::duration::zero();
+        Reset();
+    }
+    double TargetFrameRate() const noexcept { return m_fps; }
+    bool Limited() const noexcept { return m_interval > Clock::duration::zero(); }
+
+    // Forget the grid; the next frame is admitted.
+    void Reset() { m_started = false; }
+
+    // Whether a frame produced at frameTime should be delivered.
+    bool Admit(Clock::time_point frameTime)
+    {
+        if (!Limited())
+        {
+            m_admitted++;
+            return true;
+        }
+        if (m_started && frameTime < m_next - m_interval / 4)
+        {
+            m_decimated++;
+            return false;
+        }
+        if (!m_started || frameTime >= m_next + m_interval)
+            m_next = frameTime;
+        m_next += m_interval;
+        m_started = true;
+        m_admitted++;
+        return true;
+    }
+
+    uint64_t Admitted() const noexcept { return m_admitted; }
+    uint64_t Decimated() const noexcept { return m_decimated; }
+
+private:
+    double m_fps = 0;
+    Clock::duration m_interval = Clock::duration::zero();
+    Clock::time_point m_next;
+    bool m_started = false;
+    uint64_t m_admitted = 0;
+    uint64_t m_decimated = 0;
+};
+
+inline uint64_t ToTimestampNs(FramePacer::Clock::time_point time)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    return ns < 0 ? 0 : static_cast<uint64_t>(ns);
+}
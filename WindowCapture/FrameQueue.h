@@ -0,0 +1,140 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "SpscRing.h"
+
+// What happens when frames arrive faster than the consumer takes them.
+enum class FramePolicy
+{
+    LatestWins,     // keep only the newest frame; older ones are coalesced into it
+    Fifo,           // deliver in order; frames arriving to a full queue are dropped
+    DropOldest,     // deliver in order; a full queue evicts its oldest frame
+};
+
+struct FrameQueueStats
+{
+    uint64_t Arrived = 0;
+    uint64_t Delivered = 0;
+    uint64_t Dropped = 0;       // lost to a full Fifo/DropOldest queue
+    uint64_t Coalesced = 0;     // superseded by a newer frame under LatestWins
+};
+
+// Bounded handoff between the frame arrived handler (the only producer) and
+// the thread calling Pop (the only consumer), applying a FramePolicy when the
+// two run at different rates. Lock-free. Under LatestWins/DropOldest the
+// producer takes back the frames its push superseded, so a consumer that falls
+// behind never holds on to more than depth frames; the consumer drops them
+// too when it pops, in case the depth shrank since.
+template <typename T>
+class BoundedFrameQueue
+{
+public:
+    static constexpr uint32_t MaxDepth = 16;
+
+    BoundedFrameQueue(uint32_t depth = 1, FramePolicy policy = FramePolicy::LatestWins) :
+        m_ring(MaxDepth * 2)
+    {
+        Configure(depth, policy);
+    }
+
+    // Consumer side. Depth is clamped to [1, MaxDepth]; frames beyond the new
+    // depth are dropped on the next Pop.
+    void Configure(uint32_t depth, FramePolicy policy)
+    {
+        m_depth.store(depth == 0 ? 1 : (depth > MaxDepth ? MaxDepth : depth), std::memory_order_relaxed);
+        m_policy.store(policy, std::memory_order_relaxed);
+    }
+
+    // Producer side. Returns false when the frame was rejected. A Fifo queue
+    // counts frames the consumer is popping at the same time as still queued,
+    // so it may reject a frame it would have had room for a moment later.
+    bool Push(T item)
+    {
+        return Push(std::move(item), [](T&&) {});
+    }
+
+    // Producer side. Frames the push superseded are passed to discard, on
+    // this thread, so owners of pooled items get them back without waiting
+    // for the consumer.
+    template <typename TDiscard>
+    bool Push(T item, TDiscard&& discard)
+    {
+        m_arrived.fetch_add(1, std::memory_order_relaxed);
+        auto policy = m_policy.load(std::memory_order_relaxed);
+        size_t depth = m_depth.load(std::memory_order_relaxed);
+        size_t limit = policy == FramePolicy::Fifo ? depth : m_ring.Capacity();
+        // Under LatestWins/DropOldest the ring only fills when the consumer
+        // stalls in the middle of a pop; the newest frame is lost in that case.
+        if (m_ring.ProducerSize() >= limit || !m_ring.TryPush(std::move(item)))
+        {
+            m_rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (policy == FramePolicy::LatestWins)
+            m_coalesced.fetch_add(m_ring.Evict(1, discard), std::memory_order_relaxed);
+        else if (policy == FramePolicy::DropOldest)
+            m_evicted.fetch_add(m_ring.Evict(depth, discard), std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer side.
+    bool Pop(T& item)
+    {
+        return Pop(item, [](T&&) {});
+    }
+
+    // Consumer side. Frames dropped by the policy are passed to discard, on
+    // this thread, so owners of pooled items can take them back.
+    template <typename TDiscard>
+    bool Pop(T& item, TDiscard&& discard)
+    {
+        auto policy = m_policy.load(std::memory_order_relaxed);
+        size_t keep = policy == FramePolicy::LatestWins ? 1 : m_depth.load(std::memory_order_relaxed);
+        size_t dropped = m_ring.Drop(keep, discard);
+        if (policy == FramePolicy::LatestWins)
+            m_coalesced.fetch_add(dropped, std::memory_order_relaxed);
+        else
+            m_evicted.fetch_add(dropped, std::memory_order_relaxed);
+
+        if (!m_ring.TryPop(item))
+            return false;
+        m_delivered.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer side.
+    void Clear()
+    {
+        Clear([](T&&) {});
+    }
+
+    template <typename TDiscard>
+    void Clear(TDiscard&& discard)
+    {
+        m_ring.Drop(0, discard);
+    }
+
+    FrameQueueStats Stats() const
+    {
+        FrameQueueStats stats;
+        stats.Arrived = m_arrived.load(std::memory_order_relaxed);
+        stats.Delivered = m_delivered.load(std::memory_order_relaxed);
+        stats.Dropped = m_rejected.load(std::memory_order_relaxed) + m_evicted.load(std::memory_order_relaxed);
+        stats.Coalesced = m_coalesced.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    SpscRing<T> m_ring;
+    std::atomic<uint32_t> m_depth{ 1 };
+    std::atomic<FramePolicy> m_policy{ FramePolicy::LatestWins };
+
+    // Written by the producer only.
+    std::atomic<uint64_t> m_arrived{ 0 };
+    std::atomic<uint64_t> m_rejected{ 0 };
+    // Written by the consumer only.
+    std::atomic<uint64_t> m_delivered{ 0 };
+    // Written by both sides.
+    std::atomic<uint64_t> m_evicted{ 0 };
+    std::atomic<uint64_t> m_coalesced{ 0 };
+};
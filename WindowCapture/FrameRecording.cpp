@@ -0,0 +1,300 @@
+#include "FrameRecording.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+static const char RecordingMagic[8] = { 'W', 'C', 'A', 'P', 'R', 'E', 'C', '\0' };
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool FrameRecorder::Open(std::string const& path, RecordingConfig const& config)
+{
+    Close();
+    if (config.MaxWidth == 0 || config.MaxHeight == 0 ||
+        config.Format < OutputFormat::Bgra || config.Format > OutputFormat::I420)
+        return false;
+
+    // Rows on cache line boundaries; for NV12 this also leaves room for the
+    // chroma row of an odd width, which is a byte longer than the luma row.
+    uint64_t stride = AlignUp(GetOutputRowBytes(config.Format, config.MaxWidth), 64);
+    uint64_t frameBytes = GetOutputFrameSize(config.Format, config.MaxWidth, config.MaxHeight, static_cast<size_t>(stride));
+    uint64_t slotBytes = AlignUp(frameBytes, 4096);
+    uint32_t capacity = config.MaxFrames != 0 ? config.MaxFrames : DefaultMaxFrames;
+    uint64_t indexOffset = sizeof(RecordingHeader);
+    uint64_t dataOffset = AlignUp(indexOffset + uint64_t(capacity) * sizeof(RecordingIndexEntry), 64 * 1024);
+    if (slotBytes > SIZE_MAX / 2 || dataOffset > SIZE_MAX / 2)
+        return false;
+
+    if (!m_file.Open(path, true) || !m_file.Resize(dataOffset) ||
+        !m_file.Map(0, static_cast<size_t>(dataOffset), m_indexView))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    m_header = reinterpret_cast<RecordingHeader*>(m_indexView.Data);
+    m_index = reinterpret_cast<RecordingIndexEntry*>(m_indexView.Data + indexOffset);
+    std::memset(m_header, 0, sizeof(RecordingHeader));
+    std::memcpy(m_header->Magic, RecordingMagic, sizeof(RecordingMagic));
+    m_header->Version = RecordingVersion;
+    m_header->Format = static_cast<uint32_t>(config.Format);
+    m_header->MaxWidth = config.MaxWidth;
+    m_header->MaxHeight = config.MaxHeight;
+    m_header->Stride = stride;
+    m_header->SlotBytes = slotBytes;
+    m_header->IndexOffset = indexOffset;
+    m_header->DataOffset = dataOffset;
+    m_header->IndexCapacity = capacity;
+
+    m_slotsPerChunk = std::max<uint64_t>(1, ChunkBytes / slotBytes);
+    m_chunk = UINT64_MAX;
+    m_recorded = 0;
+    m_dropped = 0;
+    m_stopFlush = false;
+    m_flushThread = std::thread([this] { FlushLoop(); });
+    return true;
+}
+
+bool FrameRecorder::MapChunk(uint64_t chunk)
+{
+    auto& header = *m_header;
+    uint64_t first = chunk * m_slotsPerChunk;
+    uint64_t slots = std::min<uint64_t>(m_slotsPerChunk, header.IndexCapacity - first);
+    uint64_t offset = header.DataOffset + first * header.SlotBytes;
+    uint64_t length = slots * header.SlotBytes;
+    if (m_file.Size() < offset + length && !m_file.Resize(offset + length))
+        return false;
+    if (!m_file.Map(offset, static_cast<size_t>(length), m_chunkView))
+        return false;
+    m_chunk = chunk;
+    return true;
+}
+
+bool FrameRecorder::Append(const uint8_t* src, size_t srcStride, OutputFormat format, uint32_t width, uint32_t height,
+    FrameTiming const& timing, uint32_t flags)
+{
+    if (!IsOpen())
+        return false;
+    auto& header = *m_header;
+    if (src == nullptr || format != static_cast<OutputFormat>(header.Format) ||
+        width == 0 || height == 0 || width > header.MaxWidth || height > header.MaxHeight ||
+        m_recorded >= header.IndexCapacity)
+    {
+        m_dropped++;
+        return false;
+    }
+
+    uint64_t chunk = m_recorded / m_slotsPerChunk;
+    if (chunk != m_chunk)
+    {
+        if (m_chunkView.Base != nullptr)
+            Retire(m_chunkView);
+        if (!MapChunk(chunk))
+        {
+            m_dropped++;
+            return false;
+        }
+    }
+
+    auto stride = static_cast<size_t>(header.Stride);
+    uint8_t* slot = m_chunkView.Data + (m_recorded - chunk * m_slotsPerChunk) * header.SlotBytes;
+    CopyOutputFrame(slot, stride, src, srcStride, format, width, height);
+
+    auto& entry = m_index[m_recorded];
+    entry.FrameIndex = timing.FrameIndex;
+    entry.CaptureTimeNs = timing.CaptureTimeNs;
+    entry.DeliveryTimeNs = timing.DeliveryTimeNs;
+    entry.Width = width;
+    entry.Height = height;
+    entry.Bytes = static_cast<uint32_t>(GetOutputFrameSize(format, width, height, stride));
+    entry.Flags = flags;
+    entry.Reserved = 0;
+
+    // A reader mapping the same file sees the count only after the frame and
+    // its entry.
+    std::atomic_thread_fence(std::memory_order_release);
+    header.FrameCount = ++m_recorded;
+    return true;
+}
+
+void FrameRecorder::Retire(MappedView& view)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_flushMutex);
+        m_retired.push_back(view);
+    }
+    view = MappedView();
+    m_flushCv.notify_one();
+}
+
+void FrameRecorder::FlushLoop()
+{
+    std::unique_lock<std::mutex> lock(m_flushMutex);
+    for (;;)
+    {
+        m_flushCv.wait(lock, [this] { return m_stopFlush || !m_retired.empty(); });
+        if (m_retired.empty())
+            return;
+        auto view = m_retired.front();
+        m_retired.pop_front();
+        lock.unlock();
+
+        MappedFile::Flush(view);
+        MappedFile::Unmap(view);
+        // The index is still being appended to; this writes out the entries
+        // for the chunk just flushed, and whatever else is there by now.
+        MappedFile::Flush(m_indexView);
+
+        lock.lock();
+    }
+}
+
+bool FrameRecorder::Close()
+{
+    if (!IsOpen())
+        return false;
+
+    if (m_chunkView.Base != nullptr)
+        Retire(m_chunkView);
+    {
+        std::lock_guard<std::mutex> lock(m_flushMutex);
+        m_stopFlush = true;
+    }
+    m_flushCv.notify_one();
+    m_flushThread.join();
+
+    uint64_t used = m_header->DataOffset + m_recorded * m_header->SlotBytes;
+    m_header->Flags |= RecordingComplete;
+    bool flushed = MappedFile::Flush(m_indexView);
+    MappedFile::Unmap(m_indexView);
+    m_header = nullptr;
+    m_index = nullptr;
+    m_chunk = UINT64_MAX;
+
+    // Views are gone, so Windows lets the file shrink now.
+    bool trimmed = m_file.Resize(used);
+    m_file.Close();
+    return flushed && trimmed;
+}
+
+bool FrameRecordingReader::Open(std::string const& path)
+{
+    Close();
+    if (!m_file.Open(path, false) || m_file.Size() < sizeof(RecordingHeader))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    RecordingHeader header;
+    MappedView view;
+    if (!m_file.Map(0, sizeof(RecordingHeader), view))
+    {
+        m_file.Close();
+        return false;
+    }
+    std::memcpy(&header, view.Data, sizeof(header));
+    MappedFile::Unmap(view);
+
+    bool valid = std::memcmp(header.Magic, RecordingMagic, sizeof(RecordingMagic)) == 0 &&
+        header.Version == RecordingVersion &&
+        header.Format <= static_cast<uint32_t>(OutputFormat::I420) &&
+        header.MaxWidth != 0 && header.MaxHeight != 0 &&
+        header.IndexOffset >= sizeof(RecordingHeader) &&
+        header.IndexOffset + uint64_t(header.IndexCapacity) * sizeof(RecordingIndexEntry) <= header.DataOffset &&
+        header.DataOffset <= SIZE_MAX / 2 &&
+        header.Stride >= GetOutputRowBytes(static_cast<OutputFormat>(header.Format), header.MaxWidth) &&
+        header.SlotBytes >= GetOutputFrameSize(static_cast<OutputFormat>(header.Format), header.MaxWidth, header.MaxHeight, static_cast<size_t>(header.Stride));
+    if (!valid || !m_file.Map(0, static_cast<size_t>(header.DataOffset), m_indexView))
+    {
+        m_file.Close();
+        return false;
+    }
+    m_header = reinterpret_cast<const RecordingHeader*>(m_indexView.Data);
+    m_index = reinterpret_cast<const RecordingIndexEntry*>(m_indexView.Data + header.IndexOffset);
+    return true;
+}
+
+void FrameRecordingReader::Close()
+{
+    MappedFile::Unmap(m_frameView);
+    MappedFile::Unmap(m_indexView);
+    m_header = nullptr;
+    m_index = nullptr;
+    m_file.Close();
+}
+
+RecordingHeader FrameRecordingReader::Header() const
+{
+    RecordingHeader header = {};
+    if (m_header != nullptr)
+        std::memcpy(&header, m_header, sizeof(header));
+    return header;
+}
+
+uint64_t FrameRecordingReader::FrameCount() const
+{
+    if (m_header == nullptr)
+        return 0;
+    uint64_t count = m_header->FrameCount;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return std::min<uint64_t>(count, m_header->IndexCapacity);
+}
+
+bool FrameRecordingReader::Complete() const
+{
+    return m_header != nullptr && (m_header->Flags & RecordingComplete) != 0;
+}
+
+bool FrameRecordingReader::GetEntry(uint64_t index, RecordingIndexEntry& entry) const
+{
+    if (index >= FrameCount())
+        return false;
+    entry = m_index[index];
+    return true;
+}
+
+bool FrameRecordingReader::ReadFrame(uint64_t index, RecordedFrameView& view)
+{
+    view = RecordedFrameView();
+    RecordingIndexEntry entry;
+    if (!GetEntry(index, entry))
+        return false;
+
+    auto format = static_cast<OutputFormat>(m_header->Format);
+    auto stride = static_cast<size_t>(m_header->Stride);
+    if (entry.Width == 0 || entry.Height == 0 || entry.Width > m_header->MaxWidth || entry.Height > m_header->MaxHeight ||
+        entry.Bytes != GetOutputFrameSize(format, entry.Width, entry.Height, stride))
+        return false;
+
+    MappedFile::Unmap(m_frameView);
+    if (!m_file.Map(m_header->DataOffset + index * m_header->SlotBytes, entry.Bytes, m_frameView))
+        return false;
+    view.Data = m_frameView.Data;
+    view.Stride = stride;
+    view.Format = format;
+    view.Entry = entry;
+    return true;
+}
+
+bool FrameRecordingReader::CopyFrame(uint64_t index, uint8_t* dst, size_t dstSize, size_t dstStride, RecordingIndexEntry& entry)
+{
+    RecordedFrameView view;
+    if (!ReadFrame(index, view))
+    {
+        if (!GetEntry(index, entry))
+            entry = RecordingIndexEntry();
+        return false;
+    }
+    entry = view.Entry;
+    if (dstStride == 0)
+        dstStride = GetOutputRowBytes(view.Format, entry.Width);
+    if (dst == nullptr || dstStride < GetOutputRowBytes(view.Format, entry.Width) ||
+        GetOutputFrameSize(view.Format, entry.Width, entry.Height, dstStride) > dstSize)
+        return false;
+    CopyOutputFrame(dst, dstStride, view.Data, view.Stride, view.Format, entry.Width, entry.Height);
+    return true;
+}
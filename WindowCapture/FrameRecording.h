@@ -0,0 +1,161 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "FramePacer.h"
+#include "MappedFile.h"
+#include "PixelConvert.h"
+
+// Recording container: a header, an index with one entry per frame, then the
+// frames in fixed size slots, so frame n is found without reading the ones
+// before it. Frames are stored raw in the output format with a fixed row
+// stride; one smaller than the slot's maximum size uses the top left of it.
+// Little endian, as written.
+struct RecordingHeader
+{
+    char Magic[8];              // "WCAPREC"
+    uint32_t Version;
+    uint32_t Format;            // OutputFormat
+    uint32_t MaxWidth;
+    uint32_t MaxHeight;
+    uint64_t Stride;            // of every frame, as for GetOutputFrameSize
+    uint64_t SlotBytes;         // distance between frames
+    uint64_t IndexOffset;
+    uint64_t DataOffset;        // first frame
+    uint32_t IndexCapacity;     // frames the container can hold
+    uint32_t Flags;             // RecordingComplete once closed
+    uint64_t FrameCount;        // index entries written; grows as frames are appended
+    uint64_t Reserved[7];
+};
+static_assert(sizeof(RecordingHeader) == 128, "RecordingHeader is a file format");
+
+constexpr uint32_t RecordingVersion = 1;
+constexpr uint32_t RecordingComplete = 1u << 0;
+
+enum RecordedFrameFlags : uint32_t
+{
+    RecordedFrameDirty = 1u << 0,       // changed since the previous frame, or not known not to have
+    RecordedFrameTracked = 1u << 1,     // dirty comes from tile change detection
+};
+
+struct RecordingIndexEntry
+{
+    uint64_t FrameIndex;        // as the capture numbered it
+    uint64_t CaptureTimeNs;     // as in FrameTiming
+    uint64_t DeliveryTimeNs;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t Bytes;             // GetOutputFrameSize at the container stride
+    uint32_t Flags;             // RecordedFrameFlags
+    uint64_t Reserved;
+};
+static_assert(sizeof(RecordingIndexEntry) == 48, "RecordingIndexEntry is a file format");
+
+struct RecordingConfig
+{
+    OutputFormat Format = OutputFormat::Bgra;
+    uint32_t MaxWidth = 0;
+    uint32_t MaxHeight = 0;
+    uint32_t MaxFrames = 0;     // 0 for FrameRecorder::DefaultMaxFrames
+};
+
+// Appends frames to a recording container. Frames are copied into the mapped
+// file with no write calls; the file grows a chunk of slots at a time, and
+// each chunk, once filled, is flushed to disk and unmapped on a background
+// thread so the copying thread never waits on the disk. The header and index
+// stay mapped until Close, which flushes what is left and trims the file.
+// Append and Close are for one thread at a time.
+class FrameRecorder
+{
+public:
+    static constexpr uint32_t DefaultMaxFrames = 1u << 16;
+    // Mapped at a time for writing, and so also what a flush covers.
+    static constexpr size_t ChunkBytes = 64u << 20;
+
+    FrameRecorder() = default;
+    ~FrameRecorder() { Close(); }
+
+    FrameRecorder(FrameRecorder const&) = delete;
+    FrameRecorder& operator=(FrameRecorder const&) = delete;
+
+    bool Open(std::string const& path, RecordingConfig const& config);
+    // Returns false once the index is full, or for a frame that doesn't fit a
+    // slot or isn't in the container's format; such frames count as dropped.
+    // srcStride is as for GetOutputFrameSize.
+    bool Append(const uint8_t* src, size_t srcStride, OutputFormat format, uint32_t width, uint32_t height,
+        FrameTiming const& timing, uint32_t flags);
+    // Flush everything, mark the container complete and trim unused slots.
+    bool Close();
+
+    bool IsOpen() const noexcept { return m_header != nullptr; }
+    uint64_t Recorded() const noexcept { return m_recorded; }
+    uint64_t Dropped() const noexcept { return m_dropped; }
+
+private:
+    bool MapChunk(uint64_t chunk);
+    void Retire(MappedView& view);
+    void FlushLoop();
+
+    MappedFile m_file;
+    MappedView m_indexView;
+    RecordingHeader* m_header = nullptr;
+    RecordingIndexEntry* m_index = nullptr;
+    MappedView m_chunkView;
+    uint64_t m_chunk = UINT64_MAX;  // mapped in m_chunkView
+    uint64_t m_slotsPerChunk = 0;
+    uint64_t m_recorded = 0;
+    uint64_t m_dropped = 0;
+
+    std::mutex m_flushMutex;
+    std::condition_variable m_flushCv;
+    std::deque<MappedView> m_retired;
+    bool m_stopFlush = false;
+    std::thread m_flushThread;
+};
+
+// A frame in a container, mapped in place.
+struct RecordedFrameView
+{
+    const uint8_t* Data = nullptr;
+    size_t Stride = 0;
+    OutputFormat Format = OutputFormat::Bgra;
+    RecordingIndexEntry Entry = {};
+};
+
+// Random access to the frames of a container, including one that is still
+// being recorded: FrameCount follows the writer. Not thread safe.
+class FrameRecordingReader
+{
+public:
+    FrameRecordingReader() = default;
+    ~FrameRecordingReader() { Close(); }
+
+    FrameRecordingReader(FrameRecordingReader const&) = delete;
+    FrameRecordingReader& operator=(FrameRecordingReader const&) = delete;
+
+    bool Open(std::string const& path);
+    void Close();
+
+    bool IsOpen() const noexcept { return m_header != nullptr; }
+    RecordingHeader Header() const;
+    uint64_t FrameCount() const;
+    bool Complete() const;
+
+    bool GetEntry(uint64_t index, RecordingIndexEntry& entry) const;
+    // Map frame index. The view is valid until the next ReadFrame or Close.
+    bool ReadFrame(uint64_t index, RecordedFrameView& view);
+    // Copy frame index to dst at dstStride, 0 for the packed row size.
+    // Returns false if it doesn't fit dstSize, with entry filled in regardless.
+    bool CopyFrame(uint64_t index, uint8_t* dst, size_t dstSize, size_t dstStride, RecordingIndexEntry& entry);
+
+private:
+    MappedFile m_file;
+    MappedView m_indexView;
+    const RecordingHeader* m_header = nullptr;
+    const RecordingIndexEntry* m_index = nullptr;
+    MappedView m_frameView;
+};
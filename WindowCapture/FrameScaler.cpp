@@ -0,0 +1,376 @@
+#include "FrameScaler.h"
+#include <cstring>
+#include "SimdTarget.h"
+
+namespace
+{
+    // Column totals over rows source rows. While rows <= 257 they fit in 16
+    // bits, which halves the traffic compared to 32 bit totals.
+    void SumRows16(uint16_t* sums, const uint8_t* src, size_t srcStride, uint32_t rows, size_t bytes)
+    {
+        size_t i = 0;
+#ifdef SIMD_X86
+        // SSE2 is baseline on every x86 target this builds for. The totals for
+        // 16 bytes stay in registers while walking down the rows.
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= bytes; i += 16)
+        {
+            __m128i lo = zero;
+            __m128i hi = zero;
+            const uint8_t* p = src + i;
+            for (uint32_t row = 0; row < rows; row++, p += srcStride)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+                hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + 8), hi);
+        }
+#endif
+        for (; i < bytes; i++)
+        {
+            uint32_t sum = 0;
+            for (uint32_t row = 0; row < rows; row++)
+                sum += src[row * srcStride + i];
+            sums[i] = static_cast<uint16_t>(sum);
+        }
+    }
+
+    void SumRows32(uint32_t* sums, const uint8_t* src, size_t srcStride, uint32_t rows, size_t bytes)
+    {
+        memset(sums, 0, bytes * sizeof(uint32_t));
+        for (uint32_t row = 0; row < rows; row++, src += srcStride)
+        {
+            for (size_t i = 0; i < bytes; i++)
+                sums[i] += src[i];
+        }
+    }
+
+    // Exact 2:1 in both directions, the common 4K to 1080p case.
+    void HalveRows(uint8_t* dst, const uint8_t* row0, const uint8_t* row1, uint32_t dstWidth)
+    {
+        uint32_t x = 0;
+#ifdef SIMD_X86
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; x + 4 <= dstWidth; x += 4)
+        {
+            __m128i out[2];
+            for (int half = 0; half < 2; half++)
+            {
+                size_t offset = (static_cast<size_t>(x) * 2 + half * 4) * 4;
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + offset));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + offset));
+                // Vertical pairs, then the two horizontal neighbours of each
+                // output pixel sit in the low and high half of a register.
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                out[half] = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + static_cast<size_t>(x) * 4), _mm_packus_epi16(out[0], out[1]));
+        }
+#endif
+        for (; x < dstWidth; x++)
+        {
+            const uint8_t* a = row0 + static_cast<size_t>(x) * 8;
+            const uint8_t* b = row1 + static_cast<size_t>(x) * 8;
+            for (int c = 0; c < 4; c++)
+                dst[x * 4 + c] = static_cast<uint8_t>((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+        }
+    }
+
+    inline int Lerp7(int a, int b, int weight)
+    {
+        return a + (((b - a) * weight) >> 7);
+    }
+}
+
+CropRect ClampCrop(CropRect const& crop, uint32_t width, uint32_t height)
+{
+    CropRect clamped;
+    if (crop.Empty() || crop.X >= width || crop.Y >= height)
+    {
+        clamped.Width = width;
+        clamped.Height = height;
+        return clamped;
+    }
+    clamped.X = crop.X;
+    clamped.Y = crop.Y;
+    clamped.Width = crop.Width < width - crop.X ? crop.Width : width - crop.X;
+    clamped.Height = crop.Height < height - crop.Y ? crop.Height : height - crop.Y;
+    return clamped;
+}
+
+void GetScaledSize(ScaleParams const& params, uint32_t width, uint32_t height, uint32_t& outWidth, uint32_t& outHeight)
+{
+    outWidth = params.Width;
+    outHeight = params.Height;
+    if (outWidth == 0 && outHeight == 0)
+    {
+        outWidth = width;
+        outHeight = height;
+    }
+    else if (outHeight == 0)
+    {
+        outHeight = static_cast<uint32_t>((static_cast<uint64_t>(height) * outWidth + width / 2) / (width ? width : 1));
+    }
+    else if (outWidth == 0)
+    {
+        outWidth = static_cast<uint32_t>((static_cast<uint64_t>(width) * outHeight + height / 2) / (height ? height : 1));
+    }
+    if (outWidth == 0)
+        outWidth = 1;
+    if (outHeight == 0)
+        outHeight = 1;
+}
+
+CropRect GetFitRect(ScaleFit fit, uint32_t outWidth, uint32_t outHeight, uint32_t width, uint32_t height)
+{
+    CropRect rect;
+    rect.Width = outWidth;
+    rect.Height = outHeight;
+    if (fit != ScaleFit::Letterbox || width == 0 || height == 0)
+        return rect;
+
+    // Compare aspect ratios without dividing: width / height against outWidth / outHeight.
+    uint64_t scaledWidth = static_cast<uint64_t>(width) * outHeight;
+    uint64_t scaledHeight = static_cast<uint64_t>(height) * outWidth;
+    if (scaledWidth > scaledHeight)
+        rect.Height = static_cast<uint32_t>((scaledHeight + width / 2) / width);
+    else
+        rect.Width = static_cast<uint32_t>((scaledWidth + height / 2) / height);
+    if (rect.Width == 0)
+        rect.Width = 1;
+    if (rect.Height == 0)
+        rect.Height = 1;
+    rect.X = (outWidth - rect.Width) / 2;
+    rect.Y = (outHeight - rect.Height) / 2;
+    return rect;
+}
+
+uint32_t GetReductionLevels(uint32_t width, uint32_t height, uint32_t targetWidth, uint32_t targetHeight, uint32_t maxLevels)
+{
+    if (targetWidth == 0 && targetHeight == 0)
+        return 0;
+    uint32_t levels = 0;
+    while (levels < maxLevels &&
+        (targetWidth == 0 || (width >> (levels + 1)) >= targetWidth) &&
+        (targetHeight == 0 || (height >> (levels + 1)) >= targetHeight) &&
+        (width >> (levels + 1)) > 0 && (height >> (levels + 1)) > 0)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+void FrameScaler::Scale(
+    uint8_t* dst,
+    size_t dstStride,
+    uint32_t dstWidth,
+    uint32_t dstHeight,
+    const uint8_t* src,
+    size_t srcStride,
+    uint32_t srcWidth,
+    uint32_t srcHeight,
+    ScaleFilter filter)
+{
+    if (dstWidth == 0 || dstHeight == 0 || srcWidth == 0 || srcHeight == 0)
+        return;
+
+    if (dstWidth == srcWidth && dstHeight == srcHeight)
+    {
+        for (uint32_t y = 0; y < dstHeight; y++)
+            memcpy(dst + y * dstStride, src + y * srcStride, static_cast<size_t>(dstWidth) * 4);
+        return;
+    }
+
+    if (filter == ScaleFilter::Box && srcWidth == dstWidth * 2 && srcHeight == dstHeight * 2)
+    {
+        for (uint32_t y = 0; y < dstHeight; y++)
+            HalveRows(dst + y * dstStride, src + (y * 2) * srcStride, src + (y * 2 + 1) * srcStride, dstWidth);
+        return;
+    }
+
+    BuildTables(dstWidth, dstHeight, srcWidth, srcHeight, filter);
+    if (filter == ScaleFilter::Box)
+        ScaleBox(dst, dstStride, dstWidth, dstHeight, src, srcStride, srcWidth, srcHeight);
+    else
+        ScaleBilinear(dst, dstStride, dstWidth, dstHeight, src, srcStride, srcWidth, srcHeight);
+}
+
+void FrameScaler::BuildTables(uint32_t dstWidth, uint32_t dstHeight, uint32_t srcWidth, uint32_t srcHeight, ScaleFilter filter)
+{
+    if (dstWidth == m_dstWidth && dstHeight == m_dstHeight &&
+        srcWidth == m_srcWidth && srcHeight == m_srcHeight && filter == m_filter)
+        return;
+    m_dstWidth = dstWidth;
+    m_dstHeight = dstHeight;
+    m_srcWidth = srcWidth;
+    m_srcHeight = srcHeight;
+    m_filter = filter;
+
+    // Each output pixel covers [i * src / dst, (i + 1) * src / dst); when
+    // upscaling that is less than a pixel, so take the nearest one.
+    auto buildSpans = [](std::vector<Span>& spans, uint32_t dst, uint32_t src)
+    {
+        spans.resize(dst);
+        for (uint32_t i = 0; i < dst; i++)
+        {
+            uint32_t start = static_cast<uint32_t>(static_cast<uint64_t>(i) * src / dst);
+            uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(i + 1) * src / dst);
+            if (end <= start)
+                end = start + 1;
+            spans[i] = { start, end - start };
+        }
+    };
+
+    // Pixel centres line up: output i samples source (i + 0.5) * src / dst - 0.5.
+    auto buildTaps = [](std::vector<Tap>& taps, uint32_t dst, uint32_t src)
+    {
+        taps.resize(dst);
+        for (uint32_t i = 0; i < dst; i++)
+        {
+            int64_t pos = (static_cast<int64_t>(2 * i + 1) * src << 16) / (2 * static_cast<int64_t>(dst)) - 32768;
+            if (pos < 0)
+                pos = 0;
+            uint32_t index = static_cast<uint32_t>(pos >> 16);
+            Tap tap;
+            if (index >= src - 1)
+                tap = { src - 1, src - 1, 0 };
+            else
+                tap = { index, index + 1, static_cast<uint32_t>((pos & 0xFFFF) >> 9) };
+            taps[i] = tap;
+        }
+    };
+
+    if (filter == ScaleFilter::Box)
+    {
+        buildSpans(m_xSpans, dstWidth, srcWidth);
+        buildSpans(m_ySpans, dstHeight, srcHeight);
+        // Row spans differ by at most one, so the first tells which totals are needed.
+        m_columnSums16.resize(static_cast<size_t>(srcWidth) * 4);
+        if (m_ySpans[0].Count + 1 > 257)
+            m_columnSums32.resize(static_cast<size_t>(srcWidth) * 4);
+
+        // (n * (2^32 / c + 1)) >> 32 equals n / c for every n < 2^32 / c,
+        // which covers the rounded channel sums as long as c stays below 4096.
+        uint64_t maxCount = static_cast<uint64_t>(m_xSpans[0].Count + 1) * (m_ySpans[0].Count + 1);
+        m_reciprocals.clear();
+        if (maxCount < 4096)
+        {
+            m_reciprocals.resize(static_cast<size_t>(maxCount) + 1);
+            for (uint32_t c = 1; c <= maxCount; c++)
+                m_reciprocals[c] = (uint64_t(1) << 32) / c + 1;
+        }
+    }
+    else
+    {
+        buildTaps(m_xTaps, dstWidth, srcWidth);
+        buildTaps(m_yTaps, dstHeight, srcHeight);
+    }
+}
+
+void FrameScaler::ScaleBox(uint8_t* dst, size_t dstStride, uint32_t dstWidth, uint32_t dstHeight,
+    const uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t)
+{
+    // Sum the source rows under each output row into per-column totals, then
+    // add up the columns under each output pixel. Every source byte is read once.
+    size_t rowBytes = static_cast<size_t>(srcWidth) * 4;
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        Span ySpan = m_ySpans[y];
+        const uint8_t* rows = src + ySpan.Start * srcStride;
+        uint8_t* out = dst + y * dstStride;
+        if (ySpan.Count <= 257)
+        {
+            SumRows16(m_columnSums16.data(), rows, srcStride, ySpan.Count, rowBytes);
+            DivideColumns(out, m_columnSums16.data(), dstWidth, ySpan.Count);
+        }
+        else
+        {
+            SumRows32(m_columnSums32.data(), rows, srcStride, ySpan.Count, rowBytes);
+            DivideColumns(out, m_columnSums32.data(), dstWidth, ySpan.Count);
+        }
+    }
+}
+
+template <typename TSum>
+void FrameScaler::DivideColumns(uint8_t* out, const TSum* columnSums, uint32_t dstWidth, uint32_t rows)
+{
+    for (uint32_t x = 0; x < dstWidth; x++, out += 4)
+    {
+        Span xSpan = m_xSpans[x];
+        uint64_t sum[4] = {};
+        const TSum* column = columnSums + static_cast<size_t>(xSpan.Start) * 4;
+        for (uint32_t i = 0; i < xSpan.Count; i++, column += 4)
+        {
+            sum[0] += column[0];
+            sum[1] += column[1];
+            sum[2] += column[2];
+            sum[3] += column[3];
+        }
+        uint32_t count = xSpan.Count * rows;
+        if (count < m_reciprocals.size())
+        {
+            uint64_t reciprocal = m_reciprocals[count];
+            for (int c = 0; c < 4; c++)
+                out[c] = static_cast<uint8_t>(((sum[c] + count / 2) * reciprocal) >> 32);
+        }
+        else
+        {
+            for (int c = 0; c < 4; c++)
+                out[c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+        }
+    }
+}
+
+void FrameScaler::ScaleBilinear(uint8_t* dst, size_t dstStride, uint32_t dstWidth, uint32_t dstHeight,
+    const uint8_t* src, size_t srcStride, uint32_t, uint32_t)
+{
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        Tap yTap = m_yTaps[y];
+        const uint8_t* row0 = src + yTap.Index0 * srcStride;
+        const uint8_t* row1 = src + yTap.Index1 * srcStride;
+        uint8_t* out = dst + y * dstStride;
+        uint32_t x = 0;
+#ifdef SIMD_X86
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i fy = _mm_set1_epi16(static_cast<short>(yTap.Weight));
+        for (; x < dstWidth; x++)
+        {
+            Tap xTap = m_xTaps[x];
+            int32_t p00, p01, p10, p11;
+            memcpy(&p00, row0 + xTap.Index0 * 4, 4);
+            memcpy(&p01, row0 + xTap.Index1 * 4, 4);
+            memcpy(&p10, row1 + xTap.Index0 * 4, 4);
+            memcpy(&p11, row1 + xTap.Index1 * 4, 4);
+            // Left pixel in the low four lanes, right pixel in the high four.
+            __m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(p00), _mm_cvtsi32_si128(p01)), zero);
+            __m128i bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128(p10), _mm_cvtsi32_si128(p11)), zero);
+            __m128i v = _mm_add_epi16(top, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(bottom, top), fy), 7));
+            __m128i fx = _mm_set1_epi16(static_cast<short>(xTap.Weight));
+            __m128i h = _mm_add_epi16(v, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_srli_si128(v, 8), v), fx), 7));
+            int32_t pixel = _mm_cvtsi128_si32(_mm_packus_epi16(h, zero));
+            memcpy(out + x * 4, &pixel, 4);
+        }
+#endif
+        for (; x < dstWidth; x++)
+        {
+            Tap xTap = m_xTaps[x];
+            const uint8_t* a = row0 + xTap.Index0 * 4;
+            const uint8_t* b = row0 + xTap.Index1 * 4;
+            const uint8_t* c = row1 + xTap.Index0 * 4;
+            const uint8_t* d = row1 + xTap.Index1 * 4;
+            for (int ch = 0; ch < 4; ch++)
+            {
+                int left = Lerp7(a[ch], c[ch], static_cast<int>(yTap.Weight));
+                int right = Lerp7(b[ch], d[ch], static_cast<int>(yTap.Weight));
+                out[x * 4 + ch] = static_cast<uint8_t>(Lerp7(left, right, static_cast<int>(xTap.Weight)));
+            }
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Sub-rectangle of a frame in pixels. An empty rect means the whole frame.
+struct CropRect
+{
+    uint32_t X = 0;
+    uint32_t Y = 0;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+
+    bool Empty() const noexcept { return Width == 0 || Height == 0; }
+};
+
+enum class ScaleFilter
+{
+    Box,        // area average; the better choice for downscaling
+    Bilinear,
+};
+
+// How a frame is placed in an output size of a different aspect ratio.
+enum class ScaleFit
+{
+    Stretch,    // fill the output, distorting the frame
+    Letterbox,  // keep the aspect ratio, centered between black bars
+};
+
+// Crop and output size applied to captured frames. A zero output size keeps
+// the size of the cropped region. With both Width and Height set the output
+// stays that size however the source is resized, which is what Fit is for.
+struct ScaleParams
+{
+    CropRect Crop;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    ScaleFilter Filter = ScaleFilter::Box;
+    ScaleFit Fit = ScaleFit::Stretch;
+};
+
+// Clip crop to a width x height frame; an empty or fully outside crop yields
+// the whole frame.
+CropRect ClampCrop(CropRect const& crop, uint32_t width, uint32_t height);
+// Output size for a width x height region. With only one of params.Width and
+// params.Height set the other follows the region's aspect ratio.
+void GetScaledSize(ScaleParams const& params, uint32_t width, uint32_t height, uint32_t& outWidth, uint32_t& outHeight);
+// Where a width x height frame lands inside an outWidth x outHeight output
+// under fit.
+CropRect GetFitRect(ScaleFit fit, uint32_t outWidth, uint32_t outHeight, uint32_t width, uint32_t height);
+// Number of 2:1 halvings that can be applied to width x height while staying
+// at or above the target size, at most maxLevels. A zero target axis places no
+// limit on that axis; a zero target size means no halving at all.
+uint32_t GetReductionLevels(uint32_t width, uint32_t height, uint32_t targetWidth, uint32_t targetHeight, uint32_t maxLevels);
+
+// CPU resampler for BGRA frames, used for whatever part of the scaling the
+// capture source couldn't do on the GPU. Keeps its filter tables between calls
+// so scaling a stream of same-sized frames allocates nothing.
+class FrameScaler
+{
+public:
+    void Scale(
+        uint8_t* dst,
+        size_t dstStride,
+        uint32_t dstWidth,
+        uint32_t dstHeight,
+        const uint8_t* src,
+        size_t srcStride,
+        uint32_t srcWidth,
+        uint32_t srcHeight,
+        ScaleFilter filter);
+
+private:
+    void ScaleBox(uint8_t* dst, size_t dstStride, uint32_t dstWidth, uint32_t dstHeight,
+        const uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight);
+    void ScaleBilinear(uint8_t* dst, size_t dstStride, uint32_t dstWidth, uint32_t dstHeight,
+        const uint8_t* src, size_t srcStride, uint32_t srcWidth, uint32_t srcHeight);
+    template <typename TSum>
+    void DivideColumns(uint8_t* out, const TSum* columnSums, uint32_t dstWidth, uint32_t rows);
+    void BuildTables(uint32_t dstWidth, uint32_t dstHeight, uint32_t srcWidth, uint32_t srcHeight, ScaleFilter filter);
+
+    struct Span
+    {
+        uint32_t Start;
+        uint32_t Count;
+    };
+    struct Tap
+    {
+        uint32_t Index0;
+        uint32_t Index1;
+        uint32_t Weight;    // 7 bit weight of Index1
+    };
+
+    uint32_t m_dstWidth = 0;
+    uint32_t m_dstHeight = 0;
+    uint32_t m_srcWidth = 0;
+    uint32_t m_srcHeight = 0;
+    ScaleFilter m_filter = ScaleFilter::Box;
+    std::vector<Span> m_xSpans;
+    std::vector<Span> m_ySpans;
+    std::vector<Tap> m_xTaps;
+    std::vector<Tap> m_yTaps;
+    std::vector<uint16_t> m_columnSums16;
+    std::vector<uint32_t> m_columnSums32;
+    std::vector<uint64_t> m_reciprocals;
+};
@@ -0,0 +1,270 @@
+#include "FrameTrace.h"
+#include <cstdarg>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+FrameTraceBuffer::FrameTraceBuffer(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    m_slots.reset(new Slot[size]);
+    m_mask = size - 1;
+    // Slot i is free for the push at position i.
+    for (size_t i = 0; i < size; i++)
+        m_slots[i].Sequence.store(i, std::memory_order_relaxed);
+}
+
+bool FrameTraceBuffer::TryPush(FrameTraceRecord const& record)
+{
+    uint64_t head = m_head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        auto& slot = m_slots[head & m_mask];
+        uint64_t sequence = slot.Sequence.load(std::memory_order_acquire);
+        if (sequence == head)
+        {
+            if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed))
+            {
+                slot.Record = record;
+                slot.Sequence.store(head + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (sequence < head)
+        {
+            // Still holding the record from a lap ago.
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            head = m_head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool FrameTraceBuffer::TryPop(FrameTraceRecord& record)
+{
+    auto& slot = m_slots[m_tail & m_mask];
+    if (slot.Sequence.load(std::memory_order_acquire) != m_tail + 1)
+        return false;
+    record = slot.Record;
+    slot.Sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+    m_tail++;
+    return true;
+}
+
+namespace
+{
+    void AppendFormat(std::string& out, const char* format, ...)
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (written > 0)
+            out.append(buffer, written < static_cast<int>(sizeof(buffer)) ? written : sizeof(buffer) - 1);
+    }
+
+    void AppendEscaped(std::string& out, std::string const& text)
+    {
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                AppendFormat(out, "\\u%04x", static_cast<unsigned>(c));
+            }
+            else
+            {
+                out += c;
+            }
+        }
+    }
+
+    void AppendSeparator(std::string& out, bool& first)
+    {
+        if (!first)
+            out += ",\n";
+        first = false;
+    }
+
+    // One end of an async slice. Slices of a frame share its id, which keeps
+    // frames whose stages overlap on separate rows.
+    void AppendAsync(std::string& out, char phase, const char* name, std::string const* trackName,
+        FrameTraceRecord const& record, uint64_t timeNs, bool& first)
+    {
+        AppendSeparator(out, first);
+        out += "{\"name\":\"";
+        if (trackName != nullptr)
+            AppendEscaped(out, *trackName);
+        else
+            out += name;
+        AppendFormat(out, "\",\"cat\":\"frame\",\"ph\":\"%c\",\"id\":\"%u:%llu\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u",
+            phase,
+            record.Track,
+            static_cast<unsigned long long>(record.Timing.FrameId),
+            record.Track,
+            static_cast<unsigned long long>(timeNs / 1000),
+            static_cast<unsigned>(timeNs % 1000));
+        if (phase == 'b' && trackName != nullptr)
+        {
+            AppendFormat(out, ",\"args\":{\"frame_id\":%llu,\"frame_index\":%llu,\"width\":%u,\"height\":%u}",
+                static_cast<unsigned long long>(record.Timing.FrameId),
+                static_cast<unsigned long long>(record.Timing.FrameIndex),
+                record.Width,
+                record.Height);
+        }
+        out += '}';
+    }
+
+    void AppendStage(std::string& out, const char* name, FrameTraceRecord const& record, uint64_t startNs, uint64_t endNs, bool& first)
+    {
+        if (startNs == 0 || endNs < startNs)
+            return;
+        AppendAsync(out, 'b', name, nullptr, record, startNs, first);
+        AppendAsync(out, 'e', name, nullptr, record, endNs, first);
+    }
+}
+
+void AppendTraceEvents(std::string& out, FrameTraceRecord const& record, std::string const& trackName, bool& first)
+{
+    auto const& timing = record.Timing;
+    // Frames whose capture time isn't known start where they were taken.
+    uint64_t start = timing.CaptureTimeNs != 0 ? timing.CaptureTimeNs : timing.AcquireTimeNs;
+    if (start == 0)
+        start = timing.CopyStartNs;
+    if (start == 0 || timing.DeliveryTimeNs < start)
+        return;
+
+    AppendAsync(out, 'b', nullptr, &trackName, record, start, first);
+    if (timing.CaptureTimeNs != 0)
+        AppendStage(out, "queue", record, timing.CaptureTimeNs, timing.AcquireTimeNs, first);
+    AppendStage(out, "readback", record, timing.AcquireTimeNs, timing.CopyStartNs, first);
+    AppendStage(out, "copy", record, timing.CopyStartNs, timing.CopyEndNs, first);
+    if (timing.CopyEndNs != 0)
+        AppendStage(out, "deliver", record, timing.CopyEndNs, timing.DeliveryTimeNs, first);
+    AppendAsync(out, 'e', nullptr, &trackName, record, timing.DeliveryTimeNs, first);
+}
+
+void AppendTrackName(std::string& out, uint32_t track, std::string const& name, bool& first)
+{
+    AppendSeparator(out, first);
+    AppendFormat(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", track);
+    AppendEscaped(out, name);
+    out += "\"}}";
+}
+
+#ifdef _WIN32
+static std::FILE* OpenForWriting(std::string const& path)
+{
+    int length = ::MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    if (length <= 1)
+        return nullptr;
+    std::wstring wide(static_cast<size_t>(length), L'\0');
+    ::MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+    return ::_wfopen(wide.c_str(), L"wb");
+}
+#else
+static std::FILE* OpenForWriting(std::string const& path)
+{
+    return path.empty() ? nullptr : std::fopen(path.c_str(), "wb");
+}
+#endif
+
+bool FrameTraceWriter::Open(std::string const& path, size_t capacity)
+{
+    Close();
+    m_file = OpenForWriting(path);
+    if (m_file == nullptr)
+        return false;
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", m_file);
+    m_buffer = std::make_unique<FrameTraceBuffer>(capacity != 0 ? capacity : DefaultCapacity);
+    m_stop = false;
+    m_first = true;
+    m_tracks.clear();
+    m_written.store(0, std::memory_order_relaxed);
+    m_dropped = 0;
+    m_thread = std::thread(&FrameTraceWriter::WriteLoop, this);
+    return true;
+}
+
+bool FrameTraceWriter::Close()
+{
+    if (m_buffer == nullptr)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    DrainLocked();
+    std::fputs("\n]}\n", m_file);
+    bool ok = std::fclose(m_file) == 0;
+    m_file = nullptr;
+    m_dropped = m_buffer->Dropped();
+    m_buffer = nullptr;
+    return ok;
+}
+
+uint32_t FrameTraceWriter::AddTrack(std::string const& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto track = static_cast<uint32_t>(m_tracks.size());
+    m_tracks.push_back(name);
+    if (m_file != nullptr)
+        AppendTrackName(m_text, track, name, m_first);
+    return track;
+}
+
+bool FrameTraceWriter::Record(FrameTraceRecord const& record)
+{
+    return m_buffer != nullptr && m_buffer->TryPush(record);
+}
+
+void FrameTraceWriter::WriteLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop)
+    {
+        m_cv.wait_for(lock, FlushInterval, [this]() { return m_stop; });
+        DrainLocked();
+    }
+}
+
+void FrameTraceWriter::DrainLocked()
+{
+    static std::string const unnamed = "capture";
+    FrameTraceRecord record;
+    uint64_t written = 0;
+    while (m_buffer->TryPop(record))
+    {
+        auto const& name = record.Track < m_tracks.size() ? m_tracks[record.Track] : unnamed;
+        AppendTraceEvents(m_text, record, name, m_first);
+        written++;
+    }
+    if (!m_text.empty())
+    {
+        std::fwrite(m_text.data(), 1, m_text.size(), m_file);
+        std::fflush(m_file);
+        m_text.clear();
+    }
+    m_written.fetch_add(written, std::memory_order_relaxed);
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FramePacer.h"
+
+// One delivered frame, as a trace records it.
+struct FrameTraceRecord
+{
+    uint32_t Track = 0;         // the capture it came from, from FrameTraceWriter::AddTrack
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    FrameTiming Timing;
+};
+
+// Bounded lock-free queue of records from any number of capture threads to a
+// single reader. Every slot carries the position it is next ready for, so a
+// producer claims one with a single compare-exchange and the reader never
+// waits on a producer halfway through a write. When the reader falls behind
+// records are dropped rather than holding up a capture.
+class FrameTraceBuffer
+{
+public:
+    // capacity is rounded up to a power of two.
+    explicit FrameTraceBuffer(size_t capacity);
+
+    FrameTraceBuffer(FrameTraceBuffer const&) = delete;
+    FrameTraceBuffer& operator=(FrameTraceBuffer const&) = delete;
+
+    // Any thread. Fails, counting the record as dropped, when the buffer is full.
+    bool TryPush(FrameTraceRecord const& record);
+    // The reader only.
+    bool TryPop(FrameTraceRecord& record);
+
+    uint64_t Dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+    size_t Capacity() const noexcept { return m_mask + 1; }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> Sequence{ 0 };
+        FrameTraceRecord Record;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<uint64_t> m_head{ 0 };
+    alignas(64) std::atomic<uint64_t> m_dropped{ 0 };
+    alignas(64) uint64_t m_tail = 0;
+};
+
+// Append the Chrome trace events for record to out, each preceded by a comma
+// unless first is set, which is cleared then. Every frame is an async slice
+// named after its track, from capture to delivery, with one nested slice per
+// stage: queue (captured to taken off the queue), readback, copy and deliver.
+// Stages whose ends aren't known are left out. Times are in microseconds on
+// the FrameTiming clock.
+void AppendTraceEvents(std::string& out, FrameTraceRecord const& record, std::string const& trackName, bool& first);
+// The same for the metadata event naming a track.
+void AppendTrackName(std::string& out, uint32_t track, std::string const& name, bool& first);
+
+// Writes the frames of any number of captures to a Chrome trace (JSON Object
+// Format), which chrome://tracing and the Perfetto UI both open. Captures push
+// records into a FrameTraceBuffer; a thread of the writer's own drains it to
+// the file every flush interval, so recording costs a capture no I/O.
+class FrameTraceWriter
+{
+public:
+    static constexpr size_t DefaultCapacity = 4096;
+    static constexpr std::chrono::milliseconds FlushInterval{ 100 };
+
+    FrameTraceWriter() = default;
+    ~FrameTraceWriter() { Close(); }
+
+    FrameTraceWriter(FrameTraceWriter const&) = delete;
+    FrameTraceWriter& operator=(FrameTraceWriter const&) = delete;
+
+    // path is UTF-8 and is replaced. capacity is the records that can wait
+    // for the writer thread, 0 for the default.
+    bool Open(std::string const& path, size_t capacity = DefaultCapacity);
+    // Write what is left and finish the file. Stop every capture recording
+    // into the writer first.
+    bool Close();
+    bool IsOpen() const noexcept { return m_buffer != nullptr; }
+
+    // Name a capture's row in the trace.
+    uint32_t AddTrack(std::string const& name);
+    // Any thread, while open. Returns false if the record was dropped.
+    bool Record(FrameTraceRecord const& record);
+
+    uint64_t Written() const noexcept { return m_written.load(std::memory_order_relaxed); }
+    uint64_t Dropped() const noexcept { return m_buffer != nullptr ? m_buffer->Dropped() : m_dropped; }
+
+private:
+    void WriteLoop();
+    // Format everything buffered and write it out. Called with m_mutex held.
+    void DrainLocked();
+
+    std::unique_ptr<FrameTraceBuffer> m_buffer;
+    std::FILE* m_file = nullptr;
+    std::mutex m_mutex;                 // the file, the tracks and the stop flag
+    std::condition_variable m_cv;
+    bool m_stop = false;
+    bool m_first = true;
+    std::vector<std::string> m_tracks;
+    std::string m_text;
+    std::atomic<uint64_t> m_written{ 0 };
+    uint64_t m_dropped = 0;             // of the last trace once closed
+    std::thread m_thread;
+};
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include "CursorCompositor.h"
+#include "FramePacer.h"
+#include "FrameScaler.h"
+#include "ReadbackRing.h"
+
+// DXGI_FORMAT_B8G8R8A8_UNORM, the only layout capture sources produce today.
+constexpr uint32_t SourceFormatBgra8 = 87;
+
+struct SourceSize
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+};
+
+// Where CPU-readable frames come from. SimpleCapture is the Windows Graphics
+// Capture implementation; everything downstream of AcquireFrame (conversion,
+// dirty tracking, leases, stats) only sees this interface, so it can be driven
+// by a synthetic source on machines without a GPU.
+//
+// AcquireFrame and ReleaseFrame are called from one consumer thread.
+class ICaptureSource
+{
+public:
+    virtual ~ICaptureSource() = default;
+
+    virtual void StartCapture() = 0;
+    virtual void Close() = 0;
+
+    // Map the next frame for reading. Returns false when nothing new arrived.
+    // The view stays valid until it is passed to ReleaseFrame.
+    virtual bool AcquireFrame(MappedSlot& frame) = 0;
+    virtual void ReleaseFrame(MappedSlot const& frame) = 0;
+
+    // Content size of the newest frame the source has seen. Frames already
+    // acquired keep the size in their own description.
+    virtual SourceSize GetSourceSize() = 0;
+    // DXGI_FORMAT of acquired frames.
+    virtual uint32_t GetFormat() const { return SourceFormatBgra8; }
+
+    // Restrict acquired frames to crop before they are read back. Returns false
+    // when the source can't, in which case the pipeline crops on the CPU.
+    virtual bool SetCrop(CropRect const& crop) { (void)crop; return false; }
+    // Size the consumer will scale frames to, 0 for an axis it doesn't care
+    // about. A source may hand out frames already reduced towards it, but never
+    // smaller than it.
+    virtual void SetScaleHint(uint32_t width, uint32_t height) { (void)width; (void)height; }
+    // Deliver at most fps frames per second, 0 for every frame, dropping the
+    // surplus before it is read back. Returns false when the source can't, in
+    // which case the pipeline drops them after readback instead. Acquired
+    // frames carry their capture time either way.
+    virtual bool SetTargetFrameRate(double fps) { (void)fps; return false; }
+
+    // Where the cursor is now, relative to the source's frames. Returns false
+    // when the source has no cursor to report. Frames never include it.
+    virtual bool GetCursor(CursorSample& cursor) { (void)cursor; return false; }
+};
@@ -0,0 +1,205 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+static std::wstring ToWide(std::string const& path)
+{
+    int length = ::MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+    if (length <= 0)
+        return std::wstring();
+    std::wstring wide(static_cast<size_t>(length), L'\0');
+    ::MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], length);
+    wide.resize(static_cast<size_t>(length) - 1);
+    return wide;
+}
+
+bool MappedFile::Open(std::string const& path, bool writable)
+{
+    Close();
+    auto wide = ToWide(path);
+    if (wide.empty())
+        return false;
+    // A reader has to tolerate the writer holding the file open for writing.
+    HANDLE file = ::CreateFileW(wide.c_str(),
+        writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+        writable ? FILE_SHARE_READ : FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr,
+        writable ? CREATE_ALWAYS : OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    m_file = file;
+    m_writable = writable;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_file != nullptr)
+        ::CloseHandle(m_file);
+    m_file = nullptr;
+    m_writable = false;
+}
+
+bool MappedFile::IsOpen() const noexcept
+{
+    return m_file != nullptr;
+}
+
+uint64_t MappedFile::Size() const
+{
+    LARGE_INTEGER size;
+    if (m_file == nullptr || !::GetFileSizeEx(m_file, &size))
+        return 0;
+    return static_cast<uint64_t>(size.QuadPart);
+}
+
+bool MappedFile::Resize(uint64_t size)
+{
+    if (m_file == nullptr || !m_writable)
+        return false;
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(size);
+    return ::SetFilePointerEx(m_file, position, nullptr, FILE_BEGIN) && ::SetEndOfFile(m_file);
+}
+
+bool MappedFile::Map(uint64_t offset, size_t length, MappedView& view)
+{
+    view = MappedView();
+    if (m_file == nullptr || length == 0 || offset + length > Size())
+        return false;
+
+    // The mapping object only has to live as long as it takes to map the
+    // view, and making one per view keeps up with the file growing.
+    HANDLE mapping = ::CreateFileMappingW(m_file, nullptr, m_writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+        return false;
+    uint64_t base = offset - offset % Granularity();
+    size_t baseSize = static_cast<size_t>(offset - base) + length;
+    void* data = ::MapViewOfFile(mapping, m_writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+        static_cast<DWORD>(base >> 32), static_cast<DWORD>(base), baseSize);
+    ::CloseHandle(mapping);
+    if (data == nullptr)
+        return false;
+
+    view.Base = data;
+    view.BaseSize = baseSize;
+    view.Data = static_cast<uint8_t*>(data) + (offset - base);
+    view.Size = length;
+    return true;
+}
+
+bool MappedFile::Flush(MappedView const& view)
+{
+    return view.Base != nullptr && ::FlushViewOfFile(view.Base, view.BaseSize);
+}
+
+void MappedFile::Unmap(MappedView& view)
+{
+    if (view.Base != nullptr)
+        ::UnmapViewOfFile(view.Base);
+    view = MappedView();
+}
+
+size_t MappedFile::Granularity()
+{
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+}
+
+#else
+
+bool MappedFile::Open(std::string const& path, bool writable)
+{
+    Close();
+    int fd = writable ?
+        ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) :
+        ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    m_fd = fd;
+    m_writable = writable;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd = -1;
+    m_writable = false;
+}
+
+bool MappedFile::IsOpen() const noexcept
+{
+    return m_fd >= 0;
+}
+
+uint64_t MappedFile::Size() const
+{
+    struct stat info;
+    if (m_fd < 0 || ::fstat(m_fd, &info) != 0)
+        return 0;
+    return static_cast<uint64_t>(info.st_size);
+}
+
+bool MappedFile::Resize(uint64_t size)
+{
+    return m_fd >= 0 && m_writable && ::ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+}
+
+bool MappedFile::Map(uint64_t offset, size_t length, MappedView& view)
+{
+    view = MappedView();
+    if (m_fd < 0 || length == 0 || offset + length > Size())
+        return false;
+
+    uint64_t base = offset - offset % Granularity();
+    size_t baseSize = static_cast<size_t>(offset - base) + length;
+    void* data = ::mmap(nullptr, baseSize, m_writable ? PROT_READ | PROT_WRITE : PROT_READ,
+        MAP_SHARED, m_fd, static_cast<off_t>(base));
+    if (data == MAP_FAILED)
+        return false;
+
+    view.Base = data;
+    view.BaseSize = baseSize;
+    view.Data = static_cast<uint8_t*>(data) + (offset - base);
+    view.Size = length;
+    return true;
+}
+
+bool MappedFile::Flush(MappedView const& view)
+{
+    return view.Base != nullptr && ::msync(view.Base, view.BaseSize, MS_SYNC) == 0;
+}
+
+void MappedFile::Unmap(MappedView& view)
+{
+    if (view.Base != nullptr)
+        ::munmap(view.Base, view.BaseSize);
+    view = MappedView();
+}
+
+size_t MappedFile::Granularity()
+{
+    return static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A mapped range of a file. Data is where the requested offset landed; Base
+// and BaseSize cover the whole mapping, which starts at the allocation
+// granularity boundary at or below that offset.
+struct MappedView
+{
+    uint8_t* Data = nullptr;
+    size_t Size = 0;
+    void* Base = nullptr;
+    size_t BaseSize = 0;
+};
+
+// A file mapped a range at a time: CreateFileMapping and MapViewOfFile on
+// Windows, mmap elsewhere. Views stay valid after the file is closed and must
+// each be handed to Unmap. Map and Resize are for one thread at a time; Flush
+// and Unmap may run on another.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    // path is UTF-8. Writable creates the file, truncating an existing one,
+    // and lets other processes open it for reading meanwhile; read only opens
+    // an existing file, which may still be being written.
+    bool Open(std::string const& path, bool writable);
+    void Close();
+    bool IsOpen() const noexcept;
+    bool Writable() const noexcept { return m_writable; }
+
+    uint64_t Size() const;
+    // Grow or shrink the file. Shrinking fails on Windows while a view covers
+    // the part cut off.
+    bool Resize(uint64_t size);
+    // Map length bytes at offset, which must lie inside the file.
+    bool Map(uint64_t offset, size_t length, MappedView& view);
+
+    // Write the view's dirty pages to disk, waiting for them.
+    static bool Flush(MappedView const& view);
+    static void Unmap(MappedView& view);
+
+    // What Map rounds offsets down to.
+    static size_t Granularity();
+
+private:
+#ifdef _WIN32
+    void* m_file = nullptr;     // HANDLE
+#else
+    int m_fd = -1;
+#endif
+    bool m_writable = false;
+};
@@ -0,0 +1,357 @@
+#include "PixelConvert.h"
+#include "RowCopy.h"
+#include <cstring>
+#include "SimdTarget.h"
+
+namespace
+{
+    // 8.8 fixed point RGB to YUV weights. Chroma rows sum to zero and the Y row
+    // sums to 256 (full range) or 219/255 of it (limited range).
+    struct YuvCoeffs
+    {
+        int Ry, Gy, By;
+        int Ru, Gu, Bu;
+        int Rv, Gv, Bv;
+        int YOffset;
+    };
+
+    const YuvCoeffs& GetCoeffs(YuvMatrix matrix, YuvRange range)
+    {
+        static const YuvCoeffs bt601Limited = { 66, 129, 25, -38, -74, 112, 112, -94, -18, 16 };
+        static const YuvCoeffs bt601Full = { 77, 150, 29, -43, -85, 128, 128, -107, -21, 0 };
+        static const YuvCoeffs bt709Limited = { 47, 157, 16, -26, -86, 112, 112, -102, -10, 16 };
+        static const YuvCoeffs bt709Full = { 54, 183, 19, -29, -99, 128, 128, -116, -12, 0 };
+
+        if (matrix == YuvMatrix::Bt709)
+            return range == YuvRange::Full ? bt709Full : bt709Limited;
+        return range == YuvRange::Full ? bt601Full : bt601Limited;
+    }
+
+    inline uint8_t Clamp255(int v)
+    {
+        return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+    }
+
+    inline uint8_t ToY(YuvCoeffs const& c, int r, int g, int b)
+    {
+        return Clamp255(((c.Ry * r + c.Gy * g + c.By * b + 128) >> 8) + c.YOffset);
+    }
+
+    // The bias keeps the sum non-negative so the shift rounds the same way on
+    // every compiler.
+    inline uint8_t ToU(YuvCoeffs const& c, int r, int g, int b)
+    {
+        return Clamp255((c.Ru * r + c.Gu * g + c.Bu * b + 32896) >> 8);
+    }
+
+    inline uint8_t ToV(YuvCoeffs const& c, int r, int g, int b)
+    {
+        return Clamp255((c.Rv * r + c.Gv * g + c.Bv * b + 32896) >> 8);
+    }
+
+    bool UseSse41()
+    {
+        return GetRowCopyKernel() != RowCopyKernel::Scalar;
+    }
+
+    void SwizzleRowRgbaScalar(uint8_t* dst, const uint8_t* src, uint32_t width)
+    {
+        for (uint32_t x = 0; x < width; x++, src += 4, dst += 4)
+        {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = src[3];
+        }
+    }
+
+    void PackRowRgb24Scalar(uint8_t* dst, const uint8_t* src, uint32_t width)
+    {
+        for (uint32_t x = 0; x < width; x++, src += 4, dst += 3)
+        {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+        }
+    }
+
+    void LumaRowScalar(uint8_t* dst, const uint8_t* src, uint32_t width, YuvCoeffs const& c)
+    {
+        for (uint32_t x = 0; x < width; x++, src += 4)
+            dst[x] = ToY(c, src[2], src[1], src[0]);
+    }
+
+#ifdef SIMD_X86
+    SIMD_TARGET("sse4.1")
+    void SwizzleRowRgbaSse41(uint8_t* dst, const uint8_t* src, uint32_t width)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        uint32_t x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), _mm_shuffle_epi8(px, mask));
+        }
+        SwizzleRowRgbaScalar(dst + x * 4, src + x * 4, width - x);
+    }
+
+    // Each 16 byte store writes 4 bytes past the 12 that belong to this group,
+    // so the vector loop stops while at least 2 more pixels remain to cover them.
+    SIMD_TARGET("sse4.1")
+    void PackRowRgb24Sse41(uint8_t* dst, const uint8_t* src, uint32_t width)
+    {
+        const __m128i mask = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        uint32_t x = 0;
+        for (; x + 6 <= width; x += 4)
+        {
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 3), _mm_shuffle_epi8(px, mask));
+        }
+        PackRowRgb24Scalar(dst + x * 3, src + x * 4, width - x);
+    }
+
+    SIMD_TARGET("sse4.1")
+    void LumaRowSse41(uint8_t* dst, const uint8_t* src, uint32_t width, YuvCoeffs const& c)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i weights = _mm_setr_epi16(
+            static_cast<short>(c.By), static_cast<short>(c.Gy), static_cast<short>(c.Ry), 0,
+            static_cast<short>(c.By), static_cast<short>(c.Gy), static_cast<short>(c.Ry), 0);
+        const __m128i round = _mm_set1_epi32(128);
+        const __m128i offset = _mm_set1_epi16(static_cast<short>(c.YOffset));
+
+        uint32_t x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4 + 16));
+
+            // madd gives (B*By + G*Gy, R*Ry) per pixel, hadd folds the pair.
+            __m128i s0 = _mm_hadd_epi32(
+                _mm_madd_epi16(_mm_unpacklo_epi8(p0, zero), weights),
+                _mm_madd_epi16(_mm_unpackhi_epi8(p0, zero), weights));
+            __m128i s1 = _mm_hadd_epi32(
+                _mm_madd_epi16(_mm_unpacklo_epi8(p1, zero), weights),
+                _mm_madd_epi16(_mm_unpackhi_epi8(p1, zero), weights));
+            s0 = _mm_srai_epi32(_mm_add_epi32(s0, round), 8);
+            s1 = _mm_srai_epi32(_mm_add_epi32(s1, round), 8);
+
+            __m128i y = _mm_add_epi16(_mm_packs_epi32(s0, s1), offset);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(y, y));
+        }
+        LumaRowScalar(dst + x, src + x * 4, width - x, c);
+    }
+#endif
+
+    void SwizzleRowRgba(uint8_t* dst, const uint8_t* src, uint32_t width, bool simd)
+    {
+#ifdef SIMD_X86
+        if (simd)
+            return SwizzleRowRgbaSse41(dst, src, width);
+#endif
+        (void)simd;
+        SwizzleRowRgbaScalar(dst, src, width);
+    }
+
+    void PackRowRgb24(uint8_t* dst, const uint8_t* src, uint32_t width, bool simd)
+    {
+#ifdef SIMD_X86
+        if (simd)
+            return PackRowRgb24Sse41(dst, src, width);
+#endif
+        (void)simd;
+        PackRowRgb24Scalar(dst, src, width);
+    }
+
+    void LumaRow(uint8_t* dst, const uint8_t* src, uint32_t width, YuvCoeffs const& c, bool simd)
+    {
+#ifdef SIMD_X86
+        if (simd)
+            return LumaRowSse41(dst, src, width, c);
+#endif
+        (void)simd;
+        LumaRowScalar(dst, src, width, c);
+    }
+
+    // One row of chroma from a pair of BGRA rows, averaging 2x2 blocks. Odd
+    // trailing columns and rows reuse the last pixel. step lets NV12
+    // interleave into a single plane and I420 write two.
+    void ChromaRow(
+        uint8_t* u,
+        uint8_t* v,
+        size_t step,
+        const uint8_t* row0,
+        const uint8_t* row1,
+        uint32_t width,
+        YuvCoeffs const& c)
+    {
+        for (uint32_t x = 0; x < width; x += 2)
+        {
+            uint32_t x1 = (x + 1 < width) ? x + 1 : x;
+            const uint8_t* a = row0 + x * 4;
+            const uint8_t* b = row0 + x1 * 4;
+            const uint8_t* d = row1 + x * 4;
+            const uint8_t* e = row1 + x1 * 4;
+            int bl = (a[0] + b[0] + d[0] + e[0] + 2) >> 2;
+            int gr = (a[1] + b[1] + d[1] + e[1] + 2) >> 2;
+            int rd = (a[2] + b[2] + d[2] + e[2] + 2) >> 2;
+            *u = ToU(c, rd, gr, bl);
+            *v = ToV(c, rd, gr, bl);
+            u += step;
+            v += step;
+        }
+    }
+}
+
+size_t GetOutputRowBytes(OutputFormat format, uint32_t width)
+{
+    switch (format)
+    {
+    case OutputFormat::Rgb24:
+        return static_cast<size_t>(width) * 3;
+    case OutputFormat::Nv12:
+        // Each UV row holds a pair of bytes per two pixels, so an odd width
+        // needs one byte more than the Y row to keep UV rows apart.
+        return (static_cast<size_t>(width) + 1) & ~size_t(1);
+    case OutputFormat::I420:
+        return width;
+    default:
+        return static_cast<size_t>(width) * 4;
+    }
+}
+
+size_t GetOutputFrameSize(OutputFormat format, uint32_t width, uint32_t height, size_t dstStride)
+{
+    if (width == 0 || height == 0)
+        return 0;
+    size_t rowBytes = GetOutputRowBytes(format, width);
+    size_t stride = dstStride == 0 ? rowBytes : dstStride;
+    size_t chromaRows = (height + 1) / 2;
+
+    switch (format)
+    {
+    case OutputFormat::Nv12:
+        // UV rows hold width rounded up to even bytes.
+        return stride * height + stride * (chromaRows - 1) + ((width + 1) & ~1u);
+    case OutputFormat::I420:
+    {
+        size_t chromaStride = (stride + 1) / 2;
+        size_t chromaPlane = chromaStride * chromaRows;
+        return stride * height + chromaPlane + chromaStride * (chromaRows - 1) + (width + 1) / 2;
+    }
+    default:
+        return stride * (height - 1) + rowBytes;
+    }
+}
+
+void ConvertFrame(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    uint32_t width,
+    uint32_t height,
+    ConvertParams const& params)
+{
+    ConvertFrameRows(dst, dstStride, src, srcStride, width, height, 0, height, params);
+}
+
+void ConvertFrameRows(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    uint32_t width,
+    uint32_t height,
+    uint32_t firstRow,
+    uint32_t rows,
+    ConvertParams const& params)
+{
+    if (width == 0 || height == 0 || firstRow >= height)
+        return;
+    size_t rowBytes = GetOutputRowBytes(params.Format, width);
+    size_t stride = dstStride == 0 ? rowBytes : dstStride;
+    bool simd = UseSse41();
+    uint32_t endRow = rows < height - firstRow ? firstRow + rows : height;
+
+    switch (params.Format)
+    {
+    case OutputFormat::Bgra:
+        CopyRows(dst + firstRow * stride, stride, src + firstRow * srcStride, srcStride, rowBytes, endRow - firstRow);
+        break;
+    case OutputFormat::Rgba:
+        for (uint32_t y = firstRow; y < endRow; y++)
+            SwizzleRowRgba(dst + y * stride, src + y * srcStride, width, simd);
+        break;
+    case OutputFormat::Rgb24:
+        for (uint32_t y = firstRow; y < endRow; y++)
+            PackRowRgb24(dst + y * stride, src + y * srcStride, width, simd);
+        break;
+    case OutputFormat::Nv12:
+    case OutputFormat::I420:
+    {
+        auto const& c = GetCoeffs(params.Matrix, params.Range);
+        uint32_t chromaRows = (height + 1) / 2;
+        uint8_t* yPlane = dst;
+        uint8_t* uPlane = yPlane + stride * height;
+        uint8_t* vPlane = uPlane + 1;
+        size_t chromaStride = stride;
+        size_t step = 2;
+        if (params.Format == OutputFormat::I420)
+        {
+            chromaStride = (stride + 1) / 2;
+            vPlane = uPlane + chromaStride * chromaRows;
+            step = 1;
+        }
+
+        // Both luma rows of a chroma row are produced while its source rows are
+        // still in cache.
+        for (uint32_t cy = firstRow / 2; cy < (endRow + 1) / 2; cy++)
+        {
+            uint32_t y0 = cy * 2;
+            uint32_t y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+            const uint8_t* row0 = src + y0 * srcStride;
+            const uint8_t* row1 = src + y1 * srcStride;
+            LumaRow(yPlane + y0 * stride, row0, width, c, simd);
+            if (y1 != y0)
+                LumaRow(yPlane + y1 * stride, row1, width, c, simd);
+            ChromaRow(uPlane + cy * chromaStride, vPlane + cy * chromaStride, step, row0, row1, width, c);
+        }
+        break;
+    }
+    }
+}
+
+void CopyOutputFrame(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    OutputFormat format,
+    uint32_t width,
+    uint32_t height)
+{
+    if (width == 0 || height == 0)
+        return;
+    size_t rowBytes = GetOutputRowBytes(format, width);
+    if (dstStride == 0)
+        dstStride = rowBytes;
+    if (srcStride == 0)
+        srcStride = rowBytes;
+    CopyRows(dst, dstStride, src, srcStride, rowBytes, height);
+
+    size_t chromaRows = (height + 1) / 2;
+    if (format == OutputFormat::Nv12)
+    {
+        CopyRows(dst + dstStride * height, dstStride, src + srcStride * height, srcStride, (width + 1) & ~1u, chromaRows);
+    }
+    else if (format == OutputFormat::I420)
+    {
+        size_t dstChroma = (dstStride + 1) / 2;
+        size_t srcChroma = (srcStride + 1) / 2;
+        uint8_t* dstU = dst + dstStride * height;
+        const uint8_t* srcU = src + srcStride * height;
+        CopyRows(dstU, dstChroma, srcU, srcChroma, (width + 1) / 2, chromaRows);
+        CopyRows(dstU + dstChroma * chromaRows, dstChroma, srcU + srcChroma * chromaRows, srcChroma, (width + 1) / 2, chromaRows);
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Layout of frames handed to the caller. BGRA is what the capture surface
+// holds; everything else is converted while copying out of staging memory.
+enum class OutputFormat
+{
+    Bgra,
+    Rgba,
+    Rgb24,
+    Nv12,   // Y plane, then interleaved UV at half resolution
+    I420,   // Y plane, then U and V planes at half resolution
+};
+
+enum class YuvMatrix
+{
+    Bt601,
+    Bt709,
+};
+
+enum class YuvRange
+{
+    Limited,    // Y 16-235, UV 16-240
+    Full,       // 0-255
+};
+
+struct ConvertParams
+{
+    OutputFormat Format = OutputFormat::Bgra;
+    YuvMatrix Matrix = YuvMatrix::Bt601;
+    YuvRange Range = YuvRange::Limited;
+};
+
+// Bytes per row of a packed format, or of the Y plane of a planar one. For
+// NV12 that is the width rounded up to even, as its UV rows need.
+size_t GetOutputRowBytes(OutputFormat format, uint32_t width);
+
+// Total bytes for a width x height frame. dstStride is the packed row stride or
+// the Y plane stride, 0 for GetOutputRowBytes. Planar chroma rows use the Y
+// stride for NV12 and half of it, rounded up, for I420.
+size_t GetOutputFrameSize(OutputFormat format, uint32_t width, uint32_t height, size_t dstStride);
+
+// Convert BGRA rows straight into the output layout. This replaces the plain
+// row copy, so each source byte is read once regardless of the output format.
+void ConvertFrame(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    uint32_t width,
+    uint32_t height,
+    ConvertParams const& params);
+
+// ConvertFrame for rows firstRow to firstRow + rows of the frame only, so
+// strips of a frame can be converted on different threads. For NV12 and I420
+// firstRow must be even, as must rows unless the strip ends the frame.
+void ConvertFrameRows(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    uint32_t width,
+    uint32_t height,
+    uint32_t firstRow,
+    uint32_t rows,
+    ConvertParams const& params);
+
+// Copy a frame that is already in the output layout to one with another
+// stride, plane by plane. Strides are as for GetOutputFrameSize.
+void CopyOutputFrame(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    OutputFormat format,
+    uint32_t width,
+    uint32_t height);
@@ -0,0 +1,168 @@
+#include "ReadbackEngine.h"
+#include <algorithm>
+
+ReadbackEngine::ReadbackEngine(uint32_t workers, std::chrono::microseconds pollInterval) :
+    m_pollInterval(pollInterval)
+{
+    if (workers == 0)
+        workers = std::min(4u, std::max(1u, std::thread::hardware_concurrency() / 2));
+    for (uint32_t i = 0; i < workers; i++)
+        m_threads.emplace_back([this] { WorkerLoop(); });
+}
+
+ReadbackEngine::~ReadbackEngine()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void ReadbackEngine::Add(uint32_t id, IReadbackJob& job, Callback onComplete)
+{
+    Remove(id);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Entry entry;
+    entry.Job = &job;
+    entry.OnComplete = std::move(onComplete);
+    m_jobs[id] = std::move(entry);
+}
+
+void ReadbackEngine::Remove(uint32_t id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&]
+    {
+        auto it = m_jobs.find(id);
+        return it == m_jobs.end() || it->second.State != JobState::Running;
+    });
+    // Its id may still sit in m_queue; workers skip ids that aren't Queued.
+    m_jobs.erase(id);
+}
+
+void ReadbackEngine::Kick(uint32_t id)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end())
+            return;
+        auto& entry = it->second;
+        switch (entry.State)
+        {
+        case JobState::Running:
+            entry.Kicked = true;
+            return;
+        case JobState::Queued:
+            return;
+        default:
+            // A waiting job is stepped right away too: the step that issues the
+            // new copy also polls the old one.
+            entry.State = JobState::Queued;
+            m_queue.push_back(id);
+            break;
+        }
+    }
+    m_cv.notify_one();
+}
+
+ReadbackEngineStats ReadbackEngine::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+ReadbackEngine::Clock::time_point ReadbackEngine::PromoteDue(Clock::time_point now)
+{
+    auto next = Clock::time_point::max();
+    for (auto& job : m_jobs)
+    {
+        auto& entry = job.second;
+        if (entry.State != JobState::Waiting)
+            continue;
+        if (entry.PollAt <= now)
+        {
+            entry.State = JobState::Queued;
+            m_queue.push_back(job.first);
+        }
+        else if (entry.PollAt < next)
+        {
+            next = entry.PollAt;
+        }
+    }
+    return next;
+}
+
+void ReadbackEngine::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        if (m_stop)
+            return;
+
+        auto nextPoll = PromoteDue(Clock::now());
+        if (m_queue.empty())
+        {
+            if (nextPoll == Clock::time_point::max())
+                m_cv.wait(lock);
+            else
+                m_cv.wait_until(lock, nextPoll);
+            continue;
+        }
+
+        uint32_t id = m_queue.front();
+        m_queue.pop_front();
+        auto it = m_jobs.find(id);
+        if (it == m_jobs.end() || it->second.State != JobState::Queued)
+            continue;
+
+        auto& entry = it->second;
+        entry.State = JobState::Running;
+        entry.Kicked = false;
+        auto job = entry.Job;
+        auto onComplete = entry.OnComplete;
+        m_running++;
+        m_stats.MaxConcurrent = std::max(m_stats.MaxConcurrent, m_running);
+        lock.unlock();
+
+        auto step = job->Step();
+        if (step == ReadbackStep::Completed && onComplete)
+            onComplete(id);
+
+        lock.lock();
+        m_running--;
+        m_stats.Steps++;
+        // Remove waits for Running to clear, so the entry is still there.
+        auto& done = m_jobs[id];
+        if (step == ReadbackStep::Completed)
+        {
+            // Step again straight away: more copies may already be queued up
+            // behind the one that finished.
+            m_stats.Completed++;
+            done.State = JobState::Queued;
+            m_queue.push_back(id);
+        }
+        else if (done.Kicked)
+        {
+            done.State = JobState::Queued;
+            m_queue.push_back(id);
+        }
+        else if (step == ReadbackStep::Pending)
+        {
+            m_stats.Polls++;
+            done.State = JobState::Waiting;
+            done.PollAt = Clock::now() + m_pollInterval;
+        }
+        else
+        {
+            done.State = JobState::Idle;
+        }
+        if (done.State == JobState::Queued)
+            m_cv.notify_one();
+        m_idle.notify_all();
+    }
+}
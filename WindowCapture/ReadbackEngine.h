@@ -0,0 +1,100 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum class ReadbackStep
+{
+    Idle,       // nothing to read back
+    Pending,    // a copy is in flight and the GPU isn't done with it
+    Completed,  // a frame was read back
+};
+
+// One capture session as the engine drives it.
+class IReadbackJob
+{
+public:
+    virtual ~IReadbackJob() = default;
+
+    // Issue copies for the frames that arrived since the last step and read
+    // back the oldest copy if the GPU has finished it. Must not wait on the
+    // GPU: a copy still in flight is reported as Pending and polled again.
+    // Never called for the same job from two threads at once.
+    virtual ReadbackStep Step() = 0;
+};
+
+struct ReadbackEngineStats
+{
+    uint64_t Steps = 0;
+    uint64_t Completed = 0;
+    uint64_t Polls = 0;         // steps that found the copy still in flight
+    uint32_t MaxConcurrent = 0; // most jobs stepping at the same time
+};
+
+// Reads back many capture sessions on a few worker threads. A session is
+// kicked when a frame lands for it; a worker steps it, and while its copy is
+// in flight the worker moves on to other sessions and polls this one again
+// after the poll interval. No thread ever sits in Map, so one slow copy
+// doesn't hold up the others, and copies for different sessions overlap on
+// the GPU. Each session is stepped by one worker at a time, with kicks that
+// arrive meanwhile folded into another step.
+class ReadbackEngine
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void(uint32_t id)>;
+
+    static constexpr std::chrono::microseconds DefaultPollInterval{ 250 };
+
+    // workers 0 picks half the hardware threads, between 1 and 4.
+    explicit ReadbackEngine(uint32_t workers = 0, std::chrono::microseconds pollInterval = DefaultPollInterval);
+    ~ReadbackEngine();
+
+    ReadbackEngine(ReadbackEngine const&) = delete;
+    ReadbackEngine& operator=(ReadbackEngine const&) = delete;
+
+    // Register job under id, replacing whatever was registered there. When a
+    // step completes a frame, onComplete runs on the worker right after it.
+    void Add(uint32_t id, IReadbackJob& job, Callback onComplete = nullptr);
+    // Unregister id, waiting for a step (and its callback) in progress to
+    // finish. Don't call it from a callback or from Step.
+    void Remove(uint32_t id);
+    // A frame landed for id. Cheap enough for the frame arrived handler.
+    void Kick(uint32_t id);
+
+    uint32_t Workers() const noexcept { return static_cast<uint32_t>(m_threads.size()); }
+    ReadbackEngineStats Stats();
+
+private:
+    enum class JobState { Idle, Queued, Running, Waiting };
+
+    struct Entry
+    {
+        IReadbackJob* Job = nullptr;
+        Callback OnComplete;
+        JobState State = JobState::Idle;
+        bool Kicked = false;            // kicked while running
+        Clock::time_point PollAt;       // while Waiting
+    };
+
+    void WorkerLoop();
+    // Queue the waiting jobs that are due; returns when the next one will be.
+    Clock::time_point PromoteDue(Clock::time_point now);
+
+    std::chrono::microseconds m_pollInterval;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;       // work for the workers
+    std::condition_variable m_idle;     // a step finished, for Remove
+    std::unordered_map<uint32_t, Entry> m_jobs;
+    std::deque<uint32_t> m_queue;
+    uint32_t m_running = 0;
+    ReadbackEngineStats m_stats;
+    bool m_stop = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,296 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Surfaces that follow the size of a window are allocated with room to grow,
+// so dragging a window edge doesn't recreate them on every step: an eighth is
+// added to each extent, then it is rounded up to a multiple of 64.
+constexpr uint32_t ResizeGranularity = 64;
+
+inline uint32_t WithResizeHeadroom(uint32_t extent)
+{
+    uint64_t padded = extent + extent / 8;
+    return static_cast<uint32_t>((padded + ResizeGranularity - 1) / ResizeGranularity * ResizeGranularity);
+}
+
+// Whether a width x height image can live in a surface allocated as
+// allocWidth x allocHeight. Shrinking far enough that a fresh allocation
+// would be less than half the size gives the memory back instead.
+inline bool FitsAllocation(uint32_t allocWidth, uint32_t allocHeight, uint32_t width, uint32_t height)
+{
+    if (width > allocWidth || height > allocHeight)
+        return false;
+    uint64_t needed = static_cast<uint64_t>(WithResizeHeadroom(width)) * WithResizeHeadroom(height);
+    return needed * 2 >= static_cast<uint64_t>(allocWidth) * allocHeight;
+}
+
+// Size and pixel format of a CPU-readable staging surface.
+struct StagingDesc
+{
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t Format = 0;
+
+    bool operator==(StagingDesc const& other) const noexcept
+    {
+        return Width == other.Width && Height == other.Height && Format == other.Format;
+    }
+    bool operator!=(StagingDesc const& other) const noexcept { return !(*this == other); }
+};
+
+// CPU view of a mapped ring slot. Valid until the slot is released. Desc is
+// the size of the frame, which may be smaller than the surface behind it.
+struct MappedSlot
+{
+    const uint8_t* Data = nullptr;
+    uint32_t RowPitch = 0;
+    StagingDesc Desc;
+    uint64_t FrameIndex = 0;
+    uint64_t CaptureTimeNs = 0;     // as passed to Submit
+    uint64_t AcquireTimeNs = 0;
+};
+
+// Outcome of a non-blocking map.
+enum class MapStatus
+{
+    Mapped,
+    Pending,    // the GPU hasn't finished the copy yet
+    Failed,
+    None,       // TryAcquire only: no copy due for mapping
+};
+
+struct ReadbackRingStats
+{
+    uint64_t Allocations = 0;   // staging surfaces created
+    uint64_t Submitted = 0;     // copies issued
+    uint64_t Mapped = 0;        // slots handed to the CPU
+    uint64_t Discarded = 0;     // copies overwritten or dropped before being mapped
+    uint64_t MapWaitNs = 0;     // total time spent blocked in Map
+};
+
+// N-deep ring of staging surfaces with pipelined readback: the copy for frame k
+// goes into one slot while the CPU maps the slot holding frame k-N+1, so the
+// GPU has N-1 frames of slack before Map has to wait on it. Spare slots on top
+// of the pipeline depth let consumers keep slots mapped without stalling it.
+// Slots are allocated with resize headroom and only rebuilt when a frame no
+// longer fits them, so frames already in flight survive small size changes.
+//
+// TBackend supplies the device specific parts:
+//   using Texture = ...;
+//   Texture CreateStaging(StagingDesc const& desc);
+//   void Copy(Texture const& dst, TSource const& src);  // src at dst's origin
+//   bool Map(Texture const& tex, const uint8_t*& data, uint32_t& rowPitch);
+//   void Unmap(Texture const& tex);
+// and, for TryAcquire only:
+//   MapStatus TryMap(Texture const& tex, const uint8_t*& data, uint32_t& rowPitch);
+template <typename TBackend>
+class ReadbackRing
+{
+public:
+    using Texture = typename TBackend::Texture;
+
+    ReadbackRing(TBackend& backend, uint32_t depth, uint32_t spareSlots = 0) :
+        m_backend(backend),
+        m_depth(depth == 0 ? 1 : depth),
+        m_slotCount(m_depth + spareSlots)
+    {
+    }
+    ~ReadbackRing() { Reset(); }
+
+    ReadbackRing(ReadbackRing const&) = delete;
+    ReadbackRing& operator=(ReadbackRing const&) = delete;
+
+    // Issue a copy of src, a desc sized frame, into the next slot that isn't
+    // mapped. Fails if every slot is mapped by the consumer, or if the frame
+    // outgrew the slots while any slot is mapped (the ring can't be rebuilt
+    // under a live mapping). captureTimeNs and acquireTimeNs travel with the
+    // slot to Acquire.
+    template <typename TSource>
+    bool Submit(StagingDesc const& desc, TSource const& src, uint64_t captureTimeNs = 0, uint64_t acquireTimeNs = 0)
+    {
+        if (m_slots.empty() || desc.Format != m_allocated.Format ||
+            !FitsAllocation(m_allocated.Width, m_allocated.Height, desc.Width, desc.Height))
+        {
+            if (!Rebuild(desc))
+                return false;
+        }
+
+        uint32_t skipped = 0;
+        while (m_slots[m_next].State == SlotState::Mapped)
+        {
+            if (++skipped == m_slotCount)
+                return false;
+            m_next = (m_next + 1) % m_slotCount;
+        }
+
+        auto& slot = m_slots[m_next];
+        if (slot.State == SlotState::Copied)
+            m_stats.Discarded++;
+
+        m_backend.Copy(slot.Surface, src);
+        slot.State = SlotState::Copied;
+        slot.Desc = desc;
+        slot.FrameIndex = ++m_submitted;
+        slot.CaptureTimeNs = captureTimeNs;
+        slot.AcquireTimeNs = acquireTimeNs;
+        m_next = (m_next + 1) % m_slotCount;
+        m_stats.Submitted++;
+        return true;
+    }
+
+    // Map the oldest copied slot once it is depth-1 frames behind the newest
+    // submission. With drain set the lag requirement is waived, which is how
+    // the last copies are flushed out when no new frames are arriving.
+    bool Acquire(MappedSlot& out, bool drain = false)
+    {
+        Slot* oldest = Oldest(drain);
+        if (oldest == nullptr)
+            return false;
+
+        const uint8_t* data = nullptr;
+        uint32_t rowPitch = 0;
+        auto start = std::chrono::steady_clock::now();
+        bool mapped = m_backend.Map(oldest->Surface, data, rowPitch);
+        m_stats.MapWaitNs += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        return Mapped(*oldest, mapped ? MapStatus::Mapped : MapStatus::Failed, data, rowPitch, out) == MapStatus::Mapped;
+    }
+
+    // Acquire without waiting on the GPU: Pending when the oldest copy is
+    // still in flight, in which case it stays queued for the next try.
+    MapStatus TryAcquire(MappedSlot& out, bool drain = false)
+    {
+        Slot* oldest = Oldest(drain);
+        if (oldest == nullptr)
+            return MapStatus::None;
+
+        const uint8_t* data = nullptr;
+        uint32_t rowPitch = 0;
+        // Not in Mapped's argument list: data and rowPitch could be read
+        // before TryMap writes them.
+        MapStatus status = m_backend.TryMap(oldest->Surface, data, rowPitch);
+        return Mapped(*oldest, status, data, rowPitch, out);
+    }
+
+    void Release(MappedSlot const& mapped)
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.State == SlotState::Mapped && slot.FrameIndex == mapped.FrameIndex)
+            {
+                m_backend.Unmap(slot.Surface);
+                slot.State = SlotState::Idle;
+                return;
+            }
+        }
+    }
+
+    // Drop every slot. Outstanding mappings are unmapped first.
+    void Reset()
+    {
+        for (auto& slot : m_slots)
+        {
+            if (slot.State == SlotState::Mapped)
+                m_backend.Unmap(slot.Surface);
+            else if (slot.State == SlotState::Copied)
+                m_stats.Discarded++;
+        }
+        m_slots.clear();
+        m_allocated = {};
+        m_next = 0;
+    }
+
+    bool HasMappedSlot() const noexcept
+    {
+        for (auto const& slot : m_slots)
+        {
+            if (slot.State == SlotState::Mapped)
+                return true;
+        }
+        return false;
+    }
+
+    uint32_t Depth() const noexcept { return m_depth; }
+    // Size the slots were allocated with.
+    StagingDesc const& AllocatedDesc() const noexcept { return m_allocated; }
+    ReadbackRingStats const& Stats() const noexcept { return m_stats; }
+
+private:
+    enum class SlotState { Idle, Copied, Mapped };
+
+    struct Slot
+    {
+        Texture Surface{};
+        SlotState State = SlotState::Idle;
+        StagingDesc Desc;
+        uint64_t FrameIndex = 0;
+        uint64_t CaptureTimeNs = 0;
+        uint64_t AcquireTimeNs = 0;
+    };
+
+    // The oldest copy, provided it is depth-1 frames behind the newest.
+    Slot* Oldest(bool drain)
+    {
+        Slot* oldest = nullptr;
+        for (auto& slot : m_slots)
+        {
+            if (slot.State == SlotState::Copied &&
+                (oldest == nullptr || slot.FrameIndex < oldest->FrameIndex))
+            {
+                oldest = &slot;
+            }
+        }
+        if (oldest != nullptr && !drain && oldest->FrameIndex + (m_depth - 1) > m_submitted)
+            return nullptr;
+        return oldest;
+    }
+
+    MapStatus Mapped(Slot& slot, MapStatus status, const uint8_t* data, uint32_t rowPitch, MappedSlot& out)
+    {
+        if (status == MapStatus::Failed)
+        {
+            slot.State = SlotState::Idle;
+            m_stats.Discarded++;
+        }
+        if (status != MapStatus::Mapped)
+            return status;
+
+        slot.State = SlotState::Mapped;
+        m_stats.Mapped++;
+        out.Data = data;
+        out.RowPitch = rowPitch;
+        out.Desc = slot.Desc;
+        out.FrameIndex = slot.FrameIndex;
+        out.CaptureTimeNs = slot.CaptureTimeNs;
+        out.AcquireTimeNs = slot.AcquireTimeNs;
+        return status;
+    }
+
+    bool Rebuild(StagingDesc const& desc)
+    {
+        if (HasMappedSlot())
+            return false;
+        Reset();
+        StagingDesc allocated = desc;
+        allocated.Width = WithResizeHeadroom(desc.Width);
+        allocated.Height = WithResizeHeadroom(desc.Height);
+        m_slots.resize(m_slotCount);
+        for (auto& slot : m_slots)
+        {
+            slot.Surface = m_backend.CreateStaging(allocated);
+            m_stats.Allocations++;
+        }
+        m_allocated = allocated;
+        return true;
+    }
+
+    TBackend& m_backend;
+    uint32_t m_depth;
+    uint32_t m_slotCount;
+    StagingDesc m_allocated;
+    std::vector<Slot> m_slots;
+    uint32_t m_next = 0;
+    uint64_t m_submitted = 0;
+    ReadbackRingStats m_stats;
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "ICaptureSource.h"
+
+// Decides when a frame pool that follows a window's size gets recreated.
+//
+// The pool is allocated with resize headroom, and frames whose content still
+// fits it are used as they are, so most size changes cost nothing. When the
+// content outgrows the pool (or shrinks far enough to waste most of it) the
+// recreate is held back until the size has stopped changing for the settle
+// window, so dragging a window edge ends in one recreate instead of one per
+// step. Frames keep flowing meanwhile, clipped to the old pool. MaxDelay
+// bounds how long a continuous drag can postpone it.
+//
+// Times are passed in, which keeps the state machine deterministic under a
+// synthetic clock. Not thread safe.
+class ResizeCoalescer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr Clock::duration DefaultSettle = std::chrono::milliseconds(100);
+    static constexpr Clock::duration DefaultMaxDelay = std::chrono::milliseconds(500);
+
+    explicit ResizeCoalescer(Clock::duration settle = DefaultSettle, Clock::duration maxDelay = DefaultMaxDelay) :
+        m_settle(settle),
+        m_maxDelay(maxDelay)
+    {
+    }
+
+    // Start over with a pool sized for content of the given size; returns the
+    // pool size to allocate.
+    SourceSize Reset(SourceSize content)
+    {
+        m_pool = WithHeadroom(content);
+        m_settling = false;
+        return m_pool;
+    }
+
+    // Content size of a frame that arrived at now.
+    void Observe(SourceSize content, Clock::time_point now)
+    {
+        // Minimized windows report an empty size; keep the pool for their return.
+        if (content.Width == 0 || content.Height == 0)
+            return;
+        if (FitsAllocation(m_pool.Width, m_pool.Height, content.Width, content.Height))
+        {
+            // Back inside the pool before the window settled; nothing to do.
+            m_settling = false;
+            return;
+        }
+        if (!m_settling)
+        {
+            m_settling = true;
+            m_firstChange = now;
+            m_lastChange = now;
+            m_pending = content;
+        }
+        else if (content.Width != m_pending.Width || content.Height != m_pending.Height)
+        {
+            m_lastChange = now;
+            m_pending = content;
+        }
+    }
+
+    // Whether the pool should be recreated at now, and at which size. Call it
+    // on every poll, not only when a frame arrives: the last step of a drag
+    // may be the last frame for a while.
+    bool Poll(Clock::time_point now, SourceSize& pool)
+    {
+        if (!m_settling)
+            return false;
+        if (now - m_lastChange < m_settle && now - m_firstChange < m_maxDelay)
+            return false;
+        m_pool = WithHeadroom(m_pending);
+        m_settling = false;
+        pool = m_pool;
+        return true;
+    }
+
+    bool Settling() const noexcept { return m_settling; }
+    SourceSize PoolSize() const noexcept { return m_pool; }
+
+private:
+    static SourceSize WithHeadroom(SourceSize content)
+    {
+        SourceSize pool;
+        pool.Width = WithResizeHeadroom(content.Width > 0 ? content.Width : 1);
+        pool.Height = WithResizeHeadroom(content.Height > 0 ? content.Height : 1);
+        return pool;
+    }
+
+    Clock::duration m_settle;
+    Clock::duration m_maxDelay;
+    SourceSize m_pool;
+    SourceSize m_pending;
+    bool m_settling = false;
+    Clock::time_point m_firstChange;
+    Clock::time_point m_lastChange;
+};
@@ -0,0 +1,212 @@
+#include "RowCopy.h"
+#include <atomic>
+#include <cstring>
+#include <initializer_list>
+#include "SimdTarget.h"
+
+namespace
+{
+    using RowKernelFn = void (*)(uint8_t* dst, const uint8_t* src, size_t bytes);
+
+    void CopyRowScalar(uint8_t* dst, const uint8_t* src, size_t bytes)
+    {
+        memcpy(dst, src, bytes);
+    }
+
+#ifdef SIMD_X86
+    // Staging memory may be write-combined, where MOVNTDQA is the only fast way
+    // to read it. Fall back to plain loads when the source isn't 16 aligned.
+    SIMD_TARGET("sse4.1")
+    void CopyRowSse41(uint8_t* dst, const uint8_t* src, size_t bytes)
+    {
+        size_t i = 0;
+        if ((reinterpret_cast<uintptr_t>(src) & 15) == 0)
+        {
+            for (; i + 64 <= bytes; i += 64)
+            {
+                __m128i a = _mm_stream_load_si128(reinterpret_cast<__m128i*>(const_cast<uint8_t*>(src + i)));
+                __m128i b = _mm_stream_load_si128(reinterpret_cast<__m128i*>(const_cast<uint8_t*>(src + i + 16)));
+                __m128i c = _mm_stream_load_si128(reinterpret_cast<__m128i*>(const_cast<uint8_t*>(src + i + 32)));
+                __m128i d = _mm_stream_load_si128(reinterpret_cast<__m128i*>(const_cast<uint8_t*>(src + i + 48)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), a);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 16), b);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 32), c);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 48), d);
+            }
+        }
+        for (; i + 16 <= bytes; i += 16)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        }
+        if (i < bytes)
+            memcpy(dst + i, src + i, bytes - i);
+    }
+
+    SIMD_TARGET("avx2")
+    void CopyRowAvx2(uint8_t* dst, const uint8_t* src, size_t bytes)
+    {
+        size_t i = 0;
+        if ((reinterpret_cast<uintptr_t>(src) & 31) == 0)
+        {
+            for (; i + 128 <= bytes; i += 128)
+            {
+                __m256i a = _mm256_stream_load_si256(reinterpret_cast<const __m256i*>(src + i));
+                __m256i b = _mm256_stream_load_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+                __m256i c = _mm256_stream_load_si256(reinterpret_cast<const __m256i*>(src + i + 64));
+                __m256i d = _mm256_stream_load_si256(reinterpret_cast<const __m256i*>(src + i + 96));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), a);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), b);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 64), c);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 96), d);
+            }
+        }
+        for (; i + 32 <= bytes; i += 32)
+        {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+        }
+        if (i < bytes)
+            memcpy(dst + i, src + i, bytes - i);
+        _mm256_zeroupper();
+    }
+
+    void CpuId(int leaf, int subleaf, int regs[4])
+    {
+#if defined(_MSC_VER)
+        __cpuidex(regs, leaf, subleaf);
+#else
+        unsigned int a = 0, b = 0, c = 0, d = 0;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        regs[0] = static_cast<int>(a);
+        regs[1] = static_cast<int>(b);
+        regs[2] = static_cast<int>(c);
+        regs[3] = static_cast<int>(d);
+#endif
+    }
+
+    SIMD_TARGET("xsave")
+    bool OsSavesAvxState()
+    {
+        return (_xgetbv(0) & 0x6) == 0x6;
+    }
+#endif
+
+    bool IsSupported(RowCopyKernel kernel)
+    {
+#ifdef SIMD_X86
+        int regs[4] = {};
+        CpuId(0, 0, regs);
+        int maxLeaf = regs[0];
+        CpuId(1, 0, regs);
+        bool sse41 = (regs[2] & (1 << 19)) != 0;
+        bool osxsave = (regs[2] & (1 << 27)) != 0;
+        bool avx = (regs[2] & (1 << 28)) != 0;
+
+        switch (kernel)
+        {
+        case RowCopyKernel::Avx2:
+            if (maxLeaf < 7 || !osxsave || !avx || !OsSavesAvxState())
+                return false;
+            CpuId(7, 0, regs);
+            return (regs[1] & (1 << 5)) != 0;
+        case RowCopyKernel::Sse41:
+            return sse41;
+        default:
+            return true;
+        }
+#else
+        return kernel == RowCopyKernel::Scalar;
+#endif
+    }
+
+    RowKernelFn KernelFunction(RowCopyKernel kernel)
+    {
+        switch (kernel)
+        {
+#ifdef SIMD_X86
+        case RowCopyKernel::Avx2:
+            return CopyRowAvx2;
+        case RowCopyKernel::Sse41:
+            return CopyRowSse41;
+#endif
+        default:
+            return CopyRowScalar;
+        }
+    }
+
+    RowCopyKernel BestSupported(RowCopyKernel ceiling)
+    {
+        for (auto kernel : { RowCopyKernel::Avx2, RowCopyKernel::Sse41 })
+        {
+            if (kernel <= ceiling && IsSupported(kernel))
+                return kernel;
+        }
+        return RowCopyKernel::Scalar;
+    }
+
+    std::atomic<int> g_kernel{ -1 };
+
+    RowCopyKernel ActiveKernel()
+    {
+        int kernel = g_kernel.load(std::memory_order_relaxed);
+        if (kernel < 0)
+        {
+            kernel = static_cast<int>(BestSupported(RowCopyKernel::Avx2));
+            g_kernel.store(kernel, std::memory_order_relaxed);
+        }
+        return static_cast<RowCopyKernel>(kernel);
+    }
+}
+
+RowCopyKernel GetRowCopyKernel()
+{
+    return ActiveKernel();
+}
+
+const char* GetRowCopyKernelName(RowCopyKernel kernel)
+{
+    switch (kernel)
+    {
+    case RowCopyKernel::Avx2:
+        return "avx2";
+    case RowCopyKernel::Sse41:
+        return "sse4.1";
+    default:
+        return "scalar";
+    }
+}
+
+RowCopyKernel SetRowCopyKernel(RowCopyKernel kernel)
+{
+    auto selected = BestSupported(kernel);
+    g_kernel.store(static_cast<int>(selected), std::memory_order_relaxed);
+    return selected;
+}
+
+void CopyRows(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    size_t rowBytes,
+    size_t rows)
+{
+    if (rows == 0 || rowBytes == 0)
+        return;
+
+    // Both sides tightly packed: one contiguous block.
+    if (dstStride == rowBytes && srcStride == rowBytes)
+    {
+        rowBytes *= rows;
+        rows = 1;
+    }
+
+    auto copyRow = KernelFunction(ActiveKernel());
+    for (size_t y = 0; y < rows; y++)
+    {
+        copyRow(dst, src, rowBytes);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
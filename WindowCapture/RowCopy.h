@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Row copy kernels for moving mapped frames into caller memory. The widest
+// kernel the CPU supports is picked once, on first use.
+enum class RowCopyKernel
+{
+    Scalar,
+    Sse41,
+    Avx2,
+};
+
+RowCopyKernel GetRowCopyKernel();
+const char* GetRowCopyKernelName(RowCopyKernel kernel);
+
+// Force a kernel, e.g. to compare variants. Requests for a kernel the CPU
+// doesn't support fall back to the best supported one. Returns the kernel in use.
+RowCopyKernel SetRowCopyKernel(RowCopyKernel kernel);
+
+// Copy rows rows of rowBytes bytes between surfaces with independent strides.
+void CopyRows(
+    uint8_t* dst,
+    size_t dstStride,
+    const uint8_t* src,
+    size_t srcStride,
+    size_t rowBytes,
+    size_t rows);
@@ -0,0 +1,125 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// Decides which capture session to read back next when many share one device.
+// Sessions become ready when their source signals a frame; among the ready
+// ones the session that has waited longest goes first, subject to an optional
+// per-session minimum interval between readbacks.
+class SessionScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void Add(uint32_t id, std::chrono::nanoseconds minInterval)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Session session;
+        session.MinInterval = minInterval;
+        m_sessions[id] = session;
+    }
+
+    void Remove(uint32_t id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_sessions.erase(id);
+    }
+
+    // A frame landed for id. Repeated calls before the session is served keep
+    // the original ready time so it doesn't lose its place.
+    void MarkReady(uint32_t id, Clock::time_point now)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_sessions.find(id);
+            if (it == m_sessions.end() || it->second.Ready)
+                return;
+            it->second.Ready = true;
+            it->second.ReadySince = now;
+        }
+        m_cv.notify_all();
+    }
+
+    // Pick the next session to serve at time now without blocking.
+    bool Next(Clock::time_point now, uint32_t& id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Clock::time_point unused;
+        return PickLocked(now, id, unused);
+    }
+
+    // Block until a session is due or the timeout passes.
+    bool WaitNext(uint32_t& id, std::chrono::milliseconds timeout)
+    {
+        auto deadline = Clock::now() + timeout;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            auto now = Clock::now();
+            Clock::time_point eligibleAt = Clock::time_point::max();
+            if (PickLocked(now, id, eligibleAt))
+                return true;
+            if (now >= deadline)
+                return false;
+            m_cv.wait_until(lock, eligibleAt < deadline ? eligibleAt : deadline);
+        }
+    }
+
+    size_t Count()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_sessions.size();
+    }
+
+private:
+    struct Session
+    {
+        std::chrono::nanoseconds MinInterval{ 0 };
+        Clock::time_point LastServed{};
+        Clock::time_point ReadySince{};
+        bool Ready = false;
+        bool Served = false;
+    };
+
+    // eligibleAt receives the earliest time a ready but rate limited session
+    // becomes due, so a waiter knows when to look again.
+    bool PickLocked(Clock::time_point now, uint32_t& id, Clock::time_point& eligibleAt)
+    {
+        Session* best = nullptr;
+        uint32_t bestId = 0;
+        for (auto& entry : m_sessions)
+        {
+            auto& session = entry.second;
+            if (!session.Ready)
+                continue;
+            if (session.Served && session.LastServed + session.MinInterval > now)
+            {
+                auto due = session.LastServed + session.MinInterval;
+                if (due < eligibleAt)
+                    eligibleAt = due;
+                continue;
+            }
+            if (best == nullptr || session.ReadySince < best->ReadySince ||
+                (session.ReadySince == best->ReadySince && entry.first < bestId))
+            {
+                best = &session;
+                bestId = entry.first;
+            }
+        }
+        if (best == nullptr)
+            return false;
+
+        best->Ready = false;
+        best->Served = true;
+        best->LastServed = now;
+        id = bestId;
+        return true;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::unordered_map<uint32_t, Session> m_sessions;
+};
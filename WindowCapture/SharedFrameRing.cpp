@@ -0,0 +1,459 @@
+#include "SharedFrameRing.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+
+namespace
+{
+    const char RingMagic[8] = { 'W', 'C', 'A', 'P', 'R', 'I', 'N', 'G' };
+    constexpr uint32_t NoSlot = UINT32_MAX;
+    constexpr uint64_t FrameShift = 8;
+    constexpr uint32_t MaxSlots = 255;
+
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    struct RingLayout
+    {
+        size_t Stride = 0;
+        size_t SlotBytes = 0;
+        size_t SlotsOffset = 0;
+        size_t ReadersOffset = 0;
+        size_t DataOffset = 0;
+        size_t TotalBytes = 0;
+    };
+
+    bool GetLayout(SharedRingConfig const& config, RingLayout& layout)
+    {
+        if (config.MaxWidth == 0 || config.MaxHeight == 0 || config.Slots < 2 || config.Slots > MaxSlots ||
+            config.MaxReaders == 0 || config.Format < OutputFormat::Bgra || config.Format > OutputFormat::I420)
+            return false;
+        // Rows on cache line boundaries.
+        layout.Stride = AlignUp(GetOutputRowBytes(config.Format, config.MaxWidth), 64);
+        if (uint64_t(layout.Stride) * config.MaxHeight * 2 * config.Slots > SIZE_MAX / 2)
+            return false;
+        layout.SlotBytes = AlignUp(GetOutputFrameSize(config.Format, config.MaxWidth, config.MaxHeight, layout.Stride), 4096);
+        layout.SlotsOffset = sizeof(SharedRingHeader);
+        layout.ReadersOffset = layout.SlotsOffset + sizeof(SharedSlotHeader) * config.Slots;
+        layout.DataOffset = AlignUp(layout.ReadersOffset + sizeof(SharedReaderEntry) * config.MaxReaders, 4096);
+        layout.TotalBytes = layout.DataOffset + layout.SlotBytes * config.Slots;
+        return true;
+    }
+
+    bool Quiet(uint64_t heartbeat, uint64_t now)
+    {
+        return now > heartbeat && now - heartbeat > ReaderTimeoutNs;
+    }
+}
+
+size_t GetSharedRingSize(SharedRingConfig const& config)
+{
+    RingLayout layout;
+    return GetLayout(config, layout) ? layout.TotalBytes : 0;
+}
+
+uint64_t SharedRingNowNs()
+{
+    return ToTimestampNs(std::chrono::steady_clock::now());
+}
+
+bool SharedFrameWriter::Create(std::string const& name, SharedRingConfig const& config)
+{
+    Close();
+    size_t size = GetSharedRingSize(config);
+    bool existed = false;
+    if (size == 0 || !m_memory.Create(name, size, existed))
+        return false;
+
+    if (existed)
+    {
+        // Another writer's ring. Take it over only once that writer is gone.
+        auto header = reinterpret_cast<SharedRingHeader*>(m_memory.Data());
+        bool abandoned = m_memory.Size() >= sizeof(SharedRingHeader) &&
+            std::memcmp(header->Magic, RingMagic, sizeof(RingMagic)) == 0 &&
+            (header->State.load() == static_cast<uint32_t>(SharedRingState::Closed) ||
+                Quiet(header->WriterHeartbeatNs.load(), SharedRingNowNs()));
+        if (!abandoned || m_memory.Size() < size)
+        {
+            m_memory.Close();
+            return false;
+        }
+        m_memory.Adopt();
+    }
+
+    if (!Initialize(m_memory.Data(), m_memory.Size(), config))
+    {
+        m_memory.Close();
+        return false;
+    }
+    return true;
+}
+
+bool SharedFrameWriter::Initialize(uint8_t* memory, size_t size, SharedRingConfig const& config)
+{
+    RingLayout layout;
+    if (memory == nullptr || !GetLayout(config, layout) || layout.TotalBytes > size)
+        return false;
+
+    auto header = reinterpret_cast<SharedRingHeader*>(memory);
+    uint32_t generation = 0;
+    if (std::memcmp(header->Magic, RingMagic, sizeof(RingMagic)) == 0)
+    {
+        // Readers still mapping the old ring see the state and generation
+        // change and let go of it.
+        header->State.store(static_cast<uint32_t>(SharedRingState::Initializing));
+        generation = header->Generation.load() + 1;
+    }
+    else
+    {
+        std::memset(memory, 0, layout.DataOffset);
+    }
+
+    std::memcpy(header->Magic, RingMagic, sizeof(RingMagic));
+    header->Version = SharedRingVersion;
+    header->SlotCount = config.Slots;
+    header->MaxReaders = config.MaxReaders;
+    header->Format = static_cast<uint32_t>(config.Format);
+    header->MaxWidth = config.MaxWidth;
+    header->MaxHeight = config.MaxHeight;
+    header->Stride = layout.Stride;
+    header->SlotBytes = layout.SlotBytes;
+    header->SlotsOffset = layout.SlotsOffset;
+    header->ReadersOffset = layout.ReadersOffset;
+    header->DataOffset = layout.DataOffset;
+    header->TotalBytes = layout.TotalBytes;
+    header->Generation.store(generation);
+    header->Latest.store(0);
+    header->Published.store(0);
+    header->WriterHeartbeatNs.store(SharedRingNowNs());
+
+    m_header = header;
+    m_slots = reinterpret_cast<SharedSlotHeader*>(memory + layout.SlotsOffset);
+    m_readers = reinterpret_cast<SharedReaderEntry*>(memory + layout.ReadersOffset);
+    m_data = memory + layout.DataOffset;
+    for (uint32_t i = 0; i < config.Slots; i++)
+    {
+        m_slots[i].Sequence.store(0);
+        m_slots[i].FrameNumber = 0;
+    }
+    for (uint32_t i = 0; i < config.MaxReaders; i++)
+    {
+        m_readers[i].Owner.store(0);
+        m_readers[i].HeartbeatNs.store(0);
+        m_readers[i].Pinned.store(0);
+    }
+    m_format = config.Format;
+    m_slotFrames.assign(config.Slots, 0);
+    m_published = 0;
+    m_dropped = 0;
+    m_overwrites = 0;
+
+    header->State.store(static_cast<uint32_t>(SharedRingState::Serving), std::memory_order_release);
+    return true;
+}
+
+void SharedFrameWriter::Close()
+{
+    if (m_header != nullptr)
+        m_header->State.store(static_cast<uint32_t>(SharedRingState::Closed), std::memory_order_release);
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_readers = nullptr;
+    m_data = nullptr;
+    m_memory.Close();
+}
+
+bool SharedFrameWriter::Pinned(uint64_t frameNumber, uint64_t now) const
+{
+    for (uint32_t i = 0; i < m_header->MaxReaders; i++)
+    {
+        auto const& reader = m_readers[i];
+        if (reader.Owner.load() != 0 && reader.Pinned.load() == frameNumber && !Quiet(reader.HeartbeatNs.load(), now))
+            return true;
+    }
+    return false;
+}
+
+bool SharedFrameWriter::BeginWrite(SharedWriteSlot& slot)
+{
+    if (!IsOpen())
+        return false;
+
+    // Oldest slot that holds neither the newest frame, which is what readers
+    // go for, nor a frame a reader is holding. Empty slots count as oldest.
+    uint32_t count = m_header->SlotCount;
+    uint64_t latest = m_header->Latest.load(std::memory_order_relaxed);
+    uint32_t latestSlot = latest != 0 ? static_cast<uint32_t>(latest & ((1u << FrameShift) - 1)) : NoSlot;
+    uint64_t now = SharedRingNowNs();
+    uint32_t chosen = NoSlot;
+    uint32_t oldest = NoSlot;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (i == latestSlot)
+            continue;
+        if (oldest == NoSlot || m_slotFrames[i] < m_slotFrames[oldest])
+            oldest = i;
+        if (m_slotFrames[i] != 0 && Pinned(m_slotFrames[i], now))
+            continue;
+        if (chosen == NoSlot || m_slotFrames[i] < m_slotFrames[chosen])
+            chosen = i;
+    }
+    if (chosen == NoSlot)
+    {
+        // Every reader is holding on; the oldest loses out.
+        chosen = oldest;
+        m_overwrites++;
+    }
+
+    auto& header = m_slots[chosen];
+    header.Sequence.store(header.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_slotFrames[chosen] = 0;
+
+    slot.Data = m_data + static_cast<size_t>(chosen) * m_header->SlotBytes;
+    slot.Capacity = static_cast<size_t>(m_header->SlotBytes);
+    slot.Stride = static_cast<size_t>(m_header->Stride);
+    slot.Slot = chosen;
+    return true;
+}
+
+bool SharedFrameWriter::CommitWrite(SharedWriteSlot const& slot, uint32_t width, uint32_t height, FrameTiming const& timing)
+{
+    if (width == 0 || height == 0 || width > m_header->MaxWidth || height > m_header->MaxHeight)
+    {
+        AbortWrite(slot);
+        m_dropped++;
+        return false;
+    }
+    auto& header = m_slots[slot.Slot];
+    uint64_t number = ++m_published;
+    header.FrameNumber = number;
+    header.FrameIndex = timing.FrameIndex;
+    header.CaptureTimeNs = timing.CaptureTimeNs;
+    header.DeliveryTimeNs = timing.DeliveryTimeNs;
+    header.Width = width;
+    header.Height = height;
+    header.Bytes = GetOutputFrameSize(m_format, width, height, slot.Stride);
+    header.Sequence.store(header.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    m_slotFrames[slot.Slot] = number;
+
+    m_header->Latest.store(number << FrameShift | slot.Slot, std::memory_order_release);
+    m_header->Published.store(number, std::memory_order_relaxed);
+    Heartbeat();
+    return true;
+}
+
+void SharedFrameWriter::AbortWrite(SharedWriteSlot const& slot)
+{
+    auto& header = m_slots[slot.Slot];
+    header.FrameNumber = 0;
+    header.Sequence.store(header.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool SharedFrameWriter::Publish(const uint8_t* src, size_t srcStride, OutputFormat format, uint32_t width, uint32_t height, FrameTiming const& timing)
+{
+    if (!IsOpen())
+        return false;
+    if (src == nullptr || format != m_format || width == 0 || height == 0 ||
+        width > m_header->MaxWidth || height > m_header->MaxHeight)
+    {
+        m_dropped++;
+        return false;
+    }
+    SharedWriteSlot slot;
+    if (!BeginWrite(slot))
+        return false;
+    CopyOutputFrame(slot.Data, slot.Stride, src, srcStride, format, width, height);
+    return CommitWrite(slot, width, height, timing);
+}
+
+void SharedFrameWriter::Heartbeat()
+{
+    if (IsOpen())
+        m_header->WriterHeartbeatNs.store(SharedRingNowNs(), std::memory_order_relaxed);
+}
+
+bool SharedFrameReader::Open(std::string const& name)
+{
+    Close();
+    if (!m_memory.Open(name))
+        return false;
+    if (!Attach(m_memory.Data(), m_memory.Size()))
+    {
+        m_memory.Close();
+        return false;
+    }
+    return true;
+}
+
+bool SharedFrameReader::Attach(uint8_t* memory, size_t size)
+{
+    if (memory == nullptr || size < sizeof(SharedRingHeader))
+        return false;
+    auto header = reinterpret_cast<SharedRingHeader*>(memory);
+    if (std::memcmp(header->Magic, RingMagic, sizeof(RingMagic)) != 0 ||
+        header->State.load(std::memory_order_acquire) != static_cast<uint32_t>(SharedRingState::Serving))
+        return false;
+    uint32_t generation = header->Generation.load();
+
+    SharedRingConfig config;
+    config.Format = static_cast<OutputFormat>(header->Format);
+    config.MaxWidth = header->MaxWidth;
+    config.MaxHeight = header->MaxHeight;
+    config.Slots = header->SlotCount;
+    config.MaxReaders = header->MaxReaders;
+    RingLayout layout;
+    if (header->Version != SharedRingVersion || header->Format > static_cast<uint32_t>(OutputFormat::I420) ||
+        !GetLayout(config, layout) || layout.TotalBytes > size ||
+        header->Stride != layout.Stride || header->SlotBytes != layout.SlotBytes ||
+        header->SlotsOffset != layout.SlotsOffset || header->ReadersOffset != layout.ReadersOffset ||
+        header->DataOffset != layout.DataOffset || header->TotalBytes != layout.TotalBytes ||
+        header->Generation.load() != generation)
+        return false;
+
+    m_header = header;
+    m_slots = reinterpret_cast<SharedSlotHeader*>(memory + layout.SlotsOffset);
+    m_readers = reinterpret_cast<SharedReaderEntry*>(memory + layout.ReadersOffset);
+    m_data = memory + layout.DataOffset;
+    m_generation = generation;
+    m_lastFrame = 0;
+
+    std::random_device random;
+    m_token = (static_cast<uint64_t>(random()) << 32 | random()) ^ SharedRingNowNs();
+    if (m_token == 0)
+        m_token = 1;
+    ClaimEntry(SharedRingNowNs());
+    return true;
+}
+
+void SharedFrameReader::Close()
+{
+    if (m_entry != nullptr)
+    {
+        uint64_t token = m_token;
+        m_entry->Pinned.store(0);
+        m_entry->Owner.compare_exchange_strong(token, 0);
+    }
+    m_entry = nullptr;
+    m_header = nullptr;
+    m_slots = nullptr;
+    m_readers = nullptr;
+    m_data = nullptr;
+    m_memory.Close();
+}
+
+bool SharedFrameReader::ClaimEntry(uint64_t now)
+{
+    m_entry = nullptr;
+    for (uint32_t i = 0; i < m_header->MaxReaders; i++)
+    {
+        auto& entry = m_readers[i];
+        uint64_t owner = entry.Owner.load();
+        bool free = owner == 0 || Quiet(entry.HeartbeatNs.load(), now);
+        if (!free)
+            continue;
+        if (entry.Owner.compare_exchange_strong(owner, m_token))
+        {
+            entry.HeartbeatNs.store(now);
+            entry.Pinned.store(0);
+            m_entry = &entry;
+            return true;
+        }
+    }
+    // No entry to be had: read anyway, just without pinning.
+    return false;
+}
+
+SharedReadResult SharedFrameReader::TryAcquire(SharedFrameView& view)
+{
+    if (m_header->State.load(std::memory_order_acquire) != static_cast<uint32_t>(SharedRingState::Serving) ||
+        m_header->Generation.load() != m_generation)
+        return SharedReadResult::Closed;
+
+    uint64_t now = SharedRingNowNs();
+    if (m_entry == nullptr || m_entry->Owner.load() != m_token)
+        ClaimEntry(now);
+    if (m_entry != nullptr)
+        m_entry->HeartbeatNs.store(now);
+
+    for (int attempt = 0; attempt < 4; attempt++)
+    {
+        uint64_t latest = m_header->Latest.load(std::memory_order_acquire);
+        uint64_t number = latest >> FrameShift;
+        uint32_t index = static_cast<uint32_t>(latest & ((1u << FrameShift) - 1));
+        if (latest == 0 || number == m_lastFrame || index >= m_header->SlotCount)
+            break;
+
+        if (m_entry != nullptr)
+            m_entry->Pinned.store(number);
+        auto& slot = m_slots[index];
+        uint64_t sequence = slot.Sequence.load();
+        if (sequence & 1)
+            continue;
+        uint64_t frameNumber = slot.FrameNumber;
+        FrameTiming timing;
+        timing.FrameIndex = slot.FrameIndex;
+        timing.CaptureTimeNs = slot.CaptureTimeNs;
+        timing.DeliveryTimeNs = slot.DeliveryTimeNs;
+        uint32_t width = slot.Width;
+        uint32_t height = slot.Height;
+        uint64_t bytes = slot.Bytes;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.Sequence.load(std::memory_order_relaxed) != sequence || frameNumber != number)
+            continue;
+
+        auto format = static_cast<OutputFormat>(m_header->Format);
+        if (width == 0 || height == 0 || width > m_header->MaxWidth || height > m_header->MaxHeight ||
+            bytes != GetOutputFrameSize(format, width, height, static_cast<size_t>(m_header->Stride)))
+            break;
+
+        view.Data = m_data + static_cast<size_t>(index) * m_header->SlotBytes;
+        view.Stride = static_cast<size_t>(m_header->Stride);
+        view.Bytes = static_cast<size_t>(bytes);
+        view.Format = format;
+        view.Width = width;
+        view.Height = height;
+        view.FrameNumber = number;
+        view.Timing = timing;
+        view.Slot = index;
+        view.Sequence = sequence;
+        m_lastFrame = number;
+        return SharedReadResult::Ok;
+    }
+
+    if (m_entry != nullptr)
+        m_entry->Pinned.store(0);
+    return SharedReadResult::NoFrame;
+}
+
+SharedReadResult SharedFrameReader::Acquire(SharedFrameView& view, uint32_t timeoutMs)
+{
+    view = SharedFrameView();
+    if (!IsOpen())
+        return SharedReadResult::Closed;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;)
+    {
+        auto result = TryAcquire(view);
+        if (result != SharedReadResult::NoFrame || std::chrono::steady_clock::now() >= deadline)
+            return result;
+        // There is no cross-process wakeup; a millisecond is well inside a
+        // frame at any rate a window produces.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool SharedFrameReader::Release(SharedFrameView const& view)
+{
+    if (!IsOpen() || view.Data == nullptr || view.Slot >= m_header->SlotCount)
+        return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    bool intact = m_slots[view.Slot].Sequence.load(std::memory_order_relaxed) == view.Sequence;
+    if (m_entry != nullptr)
+        m_entry->Pinned.store(0, std::memory_order_release);
+    return intact;
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FramePacer.h"
+#include "PixelConvert.h"
+#include "SharedMemory.h"
+
+// Frames published by one process for others to read in place, laid out in
+// a block of shared memory:
+//
+//   SharedRingHeader
+//   SharedSlotHeader  x SlotCount
+//   SharedReaderEntry x MaxReaders
+//   frame data        x SlotCount, SlotBytes each, page aligned
+//
+// Every slot is a seqlock. The writer makes the slot's sequence odd, writes
+// the frame and its description, then makes it even again and points Latest
+// at it. A reader takes the sequence, uses the frame in place and takes the
+// sequence again: if it moved, the frame was overwritten meanwhile and what
+// was read is thrown away. The writer never waits for a reader, so a reader
+// that stalls or dies can't hold up the capture.
+//
+// To make overwrites rare, each reader pins the frame it is holding, and the
+// writer reuses slots oldest first, skipping the newest frame and frames
+// pinned by readers that have been heard from within ReaderTimeoutNs. Only
+// when every slot is spoken for does it overwrite a pinned one. Readers
+// claim and keep alive a table entry; entries gone quiet for longer than the
+// timeout are reclaimed by the next reader that attaches.
+//
+// Atomics in the block must be lock free, which makes them address free and
+// so usable between processes. Times are steady clock nanoseconds, which on
+// Windows and Linux count on one clock for every process.
+struct alignas(64) SharedRingHeader
+{
+    char Magic[8];                          // "WCAPRING"
+    uint32_t Version;
+    uint32_t SlotCount;
+    uint32_t MaxReaders;
+    uint32_t Format;                        // OutputFormat of every frame
+    uint32_t MaxWidth;
+    uint32_t MaxHeight;
+    uint64_t Stride;                        // of every frame, as for GetOutputFrameSize
+    uint64_t SlotBytes;
+    uint64_t SlotsOffset;
+    uint64_t ReadersOffset;
+    uint64_t DataOffset;
+    uint64_t TotalBytes;
+    std::atomic<uint32_t> State;            // SharedRingState
+    std::atomic<uint32_t> Generation;       // bumped when a writer takes the block over
+    std::atomic<uint64_t> Latest;           // frame number << 8 | slot, 0 before the first frame
+    std::atomic<uint64_t> WriterHeartbeatNs;
+    std::atomic<uint64_t> Published;
+};
+
+struct alignas(64) SharedSlotHeader
+{
+    std::atomic<uint64_t> Sequence;         // odd while the writer is in the slot
+    // Written under the sequence like the frame itself.
+    uint64_t FrameNumber;                   // counts from 1 in publishing order, 0 for none
+    uint64_t FrameIndex;                    // as in FrameTiming
+    uint64_t CaptureTimeNs;
+    uint64_t DeliveryTimeNs;
+    uint32_t Width;
+    uint32_t Height;
+    uint64_t Bytes;
+};
+
+struct alignas(64) SharedReaderEntry
+{
+    std::atomic<uint64_t> Owner;            // token of the reader holding the entry, 0 when free
+    std::atomic<uint64_t> HeartbeatNs;
+    std::atomic<uint64_t> Pinned;           // frame number being read, 0 for none
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+    "shared ring atomics must work between processes");
+
+enum class SharedRingState : uint32_t
+{
+    Initializing,
+    Serving,
+    Closed,
+};
+
+constexpr uint32_t SharedRingVersion = 1;
+
+struct SharedRingConfig
+{
+    OutputFormat Format = OutputFormat::Bgra;
+    uint32_t MaxWidth = 0;
+    uint32_t MaxHeight = 0;
+    uint32_t Slots = 4;             // 2 to 255
+    uint32_t MaxReaders = 16;
+};
+
+// Bytes a block for config needs, 0 if config can't be served.
+size_t GetSharedRingSize(SharedRingConfig const& config);
+
+// Pins and entries from readers quiet for longer than this don't count.
+constexpr uint64_t ReaderTimeoutNs = 2000000000;
+
+uint64_t SharedRingNowNs();
+
+// Where the writer puts the next frame: Capacity bytes at Stride.
+struct SharedWriteSlot
+{
+    uint8_t* Data = nullptr;
+    size_t Capacity = 0;
+    size_t Stride = 0;
+    uint32_t Slot = 0;
+};
+
+// The publishing side. Not thread safe.
+class SharedFrameWriter
+{
+public:
+    SharedFrameWriter() = default;
+    ~SharedFrameWriter() { Close(); }
+
+    SharedFrameWriter(SharedFrameWriter const&) = delete;
+    SharedFrameWriter& operator=(SharedFrameWriter const&) = delete;
+
+    // Create the named block, or take over one left Closed, or whose writer
+    // has been silent for ReaderTimeoutNs, if it is big enough.
+    bool Create(std::string const& name, SharedRingConfig const& config);
+    // Lay the ring out in memory the caller owns and shares.
+    bool Initialize(uint8_t* memory, size_t size, SharedRingConfig const& config);
+    // Mark the ring closed for readers and let go of the memory.
+    void Close();
+
+    bool IsOpen() const noexcept { return m_header != nullptr; }
+    OutputFormat Format() const noexcept { return m_format; }
+
+    // Open the slot the next frame goes to, so it can be written in place.
+    // Exactly one of CommitWrite or AbortWrite must follow.
+    bool BeginWrite(SharedWriteSlot& slot);
+    // A frame over the maximum size is dropped, leaving the slot empty.
+    bool CommitWrite(SharedWriteSlot const& slot, uint32_t width, uint32_t height, FrameTiming const& timing);
+    // The slot is left empty; whatever frame it held is gone.
+    void AbortWrite(SharedWriteSlot const& slot);
+    // BeginWrite, copy, CommitWrite. Frames over the maximum size, or in
+    // another format, are dropped.
+    bool Publish(const uint8_t* src, size_t srcStride, OutputFormat format, uint32_t width, uint32_t height, FrameTiming const& timing);
+
+    // Tell readers the writer is alive while no frames are coming.
+    void Heartbeat();
+    void CountDropped() { m_dropped++; }
+
+    uint64_t Published() const noexcept { return m_published; }
+    uint64_t Dropped() const noexcept { return m_dropped; }
+    // Slots reclaimed while a reader had them pinned.
+    uint64_t Overwrites() const noexcept { return m_overwrites; }
+
+private:
+    bool Pinned(uint64_t frameNumber, uint64_t now) const;
+
+    SharedMemory m_memory;
+    SharedRingHeader* m_header = nullptr;
+    SharedSlotHeader* m_slots = nullptr;
+    SharedReaderEntry* m_readers = nullptr;
+    uint8_t* m_data = nullptr;
+    OutputFormat m_format = OutputFormat::Bgra;
+    std::vector<uint64_t> m_slotFrames;     // frame number in each slot
+    uint64_t m_published = 0;
+    uint64_t m_dropped = 0;
+    uint64_t m_overwrites = 0;
+};
+
+// A frame read in place. Valid until Release, which says whether it stayed
+// intact for the whole time.
+struct SharedFrameView
+{
+    const uint8_t* Data = nullptr;
+    size_t Stride = 0;
+    size_t Bytes = 0;
+    OutputFormat Format = OutputFormat::Bgra;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint64_t FrameNumber = 0;
+    FrameTiming Timing;
+    uint32_t Slot = 0;
+    uint64_t Sequence = 0;
+};
+
+enum class SharedReadResult
+{
+    Ok,
+    NoFrame,    // nothing newer than the last frame acquired
+    Closed,     // the writer closed or replaced the ring; open it again
+};
+
+// The reading side. Holds one frame at a time. Not thread safe.
+class SharedFrameReader
+{
+public:
+    SharedFrameReader() = default;
+    ~SharedFrameReader() { Close(); }
+
+    SharedFrameReader(SharedFrameReader const&) = delete;
+    SharedFrameReader& operator=(SharedFrameReader const&) = delete;
+
+    bool Open(std::string const& name);
+    // Read a ring in memory the caller maps.
+    bool Attach(uint8_t* memory, size_t size);
+    void Close();
+
+    bool IsOpen() const noexcept { return m_header != nullptr; }
+
+    // The newest frame, if it is newer than the last one acquired, pinned
+    // until Release. Polls for up to timeoutMs when there is none yet.
+    SharedReadResult Acquire(SharedFrameView& view, uint32_t timeoutMs = 0);
+    // Unpin. Returns false if the frame was overwritten while held, in which
+    // case anything read from it must be discarded.
+    bool Release(SharedFrameView const& view);
+
+private:
+    SharedReadResult TryAcquire(SharedFrameView& view);
+    bool ClaimEntry(uint64_t now);
+
+    SharedMemory m_memory;
+    SharedRingHeader* m_header = nullptr;
+    SharedSlotHeader* m_slots = nullptr;
+    SharedReaderEntry* m_readers = nullptr;
+    uint8_t* m_data = nullptr;
+    uint32_t m_generation = 0;
+    SharedReaderEntry* m_entry = nullptr;
+    uint64_t m_token = 0;
+    uint64_t m_lastFrame = 0;
+};
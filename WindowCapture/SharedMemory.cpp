@@ -0,0 +1,198 @@
+#include "SharedMemory.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+static std::wstring ToWide(std::string const& name)
+{
+    int length = ::MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, nullptr, 0);
+    if (length <= 0)
+        return std::wstring();
+    std::wstring wide(static_cast<size_t>(length), L'\0');
+    ::MultiByteToWideChar(CP_UTF8, 0, name.c_str(), -1, &wide[0], length);
+    wide.resize(static_cast<size_t>(length) - 1);
+    return wide;
+}
+
+// Views are mapped whole, so the region size is the size of the section
+// rounded up to a page.
+static size_t ViewSize(void* data)
+{
+    MEMORY_BASIC_INFORMATION info;
+    if (::VirtualQuery(data, &info, sizeof(info)) == 0)
+        return 0;
+    return info.RegionSize;
+}
+
+bool SharedMemory::Create(std::string const& name, size_t size, bool& existed)
+{
+    Close();
+    existed = false;
+    auto wide = ToWide(name);
+    if (wide.empty() || size == 0)
+        return false;
+
+    uint64_t size64 = size;
+    HANDLE mapping = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64), wide.c_str());
+    if (mapping == nullptr)
+        return false;
+    existed = ::GetLastError() == ERROR_ALREADY_EXISTS;
+    void* data = ::MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+    if (data == nullptr)
+    {
+        ::CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data = static_cast<uint8_t*>(data);
+    m_size = ViewSize(data);
+    return true;
+}
+
+bool SharedMemory::Open(std::string const& name)
+{
+    Close();
+    auto wide = ToWide(name);
+    if (wide.empty())
+        return false;
+    HANDLE mapping = ::OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, wide.c_str());
+    if (mapping == nullptr)
+        return false;
+    void* data = ::MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+    if (data == nullptr)
+    {
+        ::CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data = static_cast<uint8_t*>(data);
+    m_size = ViewSize(data);
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    if (m_data != nullptr)
+        ::UnmapViewOfFile(m_data);
+    if (m_mapping != nullptr)
+        ::CloseHandle(m_mapping);
+    m_data = nullptr;
+    m_size = 0;
+    m_mapping = nullptr;
+}
+
+void SharedMemory::Adopt()
+{
+    // Named sections go away with their last handle; there is nothing to remove.
+}
+
+#else
+
+static std::string PosixName(std::string const& name)
+{
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+static bool MapShared(int fd, uint8_t*& data, size_t& size)
+{
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+        return false;
+    void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+        return false;
+    data = static_cast<uint8_t*>(mapped);
+    size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+bool SharedMemory::Create(std::string const& name, size_t size, bool& existed)
+{
+    Close();
+    existed = false;
+    if (name.empty() || size == 0)
+        return false;
+    auto path = PosixName(name);
+
+    int fd = ::shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0)
+    {
+        if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            ::close(fd);
+            ::shm_unlink(path.c_str());
+            return false;
+        }
+    }
+    else if (errno == EEXIST)
+    {
+        existed = true;
+        fd = ::shm_open(path.c_str(), O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+    }
+    else
+    {
+        return false;
+    }
+
+    bool mapped = MapShared(fd, m_data, m_size);
+    ::close(fd);
+    if (!mapped)
+    {
+        if (!existed)
+            ::shm_unlink(path.c_str());
+        return false;
+    }
+    m_name = path;
+    m_owned = !existed;
+    return true;
+}
+
+bool SharedMemory::Open(std::string const& name)
+{
+    Close();
+    if (name.empty())
+        return false;
+    int fd = ::shm_open(PosixName(name).c_str(), O_RDWR, 0600);
+    if (fd < 0)
+        return false;
+    bool mapped = MapShared(fd, m_data, m_size);
+    ::close(fd);
+    return mapped;
+}
+
+void SharedMemory::Close()
+{
+    if (m_data != nullptr)
+        ::munmap(m_data, m_size);
+    if (m_owned)
+        ::shm_unlink(m_name.c_str());
+    m_data = nullptr;
+    m_size = 0;
+    m_name.clear();
+    m_owned = false;
+}
+
+void SharedMemory::Adopt()
+{
+    m_owned = !m_name.empty();
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A named block of memory shared between processes: a pagefile backed
+// CreateFileMapping on Windows, shm_open elsewhere. Not thread safe.
+class SharedMemory
+{
+public:
+    SharedMemory() = default;
+    ~SharedMemory() { Close(); }
+
+    SharedMemory(SharedMemory const&) = delete;
+    SharedMemory& operator=(SharedMemory const&) = delete;
+
+    // Create name with at least size bytes, or open it if it already exists,
+    // in which case existed is set and Size reports what it really has. On
+    // POSIX a leading '/' is added when missing, and Close removes a name
+    // this object created, or one it has taken over with Adopt. New memory
+    // reads as zeros.
+    bool Create(std::string const& name, size_t size, bool& existed);
+    // Remove the name on Close even though Create found it already there.
+    void Adopt();
+    // Open an existing name for reading and writing.
+    bool Open(std::string const& name);
+    void Close();
+
+    uint8_t* Data() const noexcept { return m_data; }
+    size_t Size() const noexcept { return m_size; }
+
+private:
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_mapping = nullptr;  // HANDLE
+#else
+    std::string m_name;
+    bool m_owned = false;       // remove m_name on Close
+#endif
+};
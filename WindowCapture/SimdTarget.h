@@ -0,0 +1,15 @@
+#pragma once
+
+// Per-function instruction set targeting. MSVC lets any function use any
+// intrinsic; GCC and Clang need the target spelled out on the function.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET(isa)
+#else
+#include <cpuid.h>
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
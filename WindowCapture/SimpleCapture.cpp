@@ -14,6 +14,8 @@
 
 #include "pch.h"
 #include "SimpleCapture.h"
+#include <optional>
+#include <thread>
 
 using namespace winrt;
 using namespace Windows;
@@ -29,20 +31,30 @@ using namespace Windows::UI::Composition;
 
 SimpleCapture::SimpleCapture(
     IDirect3DDevice const& device,
-    GraphicsCaptureItem const& item)
+    GraphicsCaptureItem const& item,
+    FrameDispatcher* dispatcher,
+    HWND window) :
+    m_cursor(window)
 {
     m_item = item;
     m_device = device;
+    m_dispatcher = dispatcher;
 	// Set up 
     auto d3dDevice = GetDXGIInterfaceFromObject<ID3D11Device>(m_device);
     d3dDevice->GetImmediateContext(m_d3dContext.put());
 
 	auto size = m_item.Size();
+    m_lastSize = size;
+    SourceSize content;
+    content.Width = static_cast<uint32_t>(size.Width);
+    content.Height = static_cast<uint32_t>(size.Height);
+    m_resize.Reset(content);
+    auto poolSize = GetPoolSize();
     
     m_swapChain = CreateDXGISwapChain(
         d3dDevice, 
-		static_cast<uint32_t>(size.Width),
-		static_cast<uint32_t>(size.Height),
+		static_cast<uint32_t>(poolSize.Width),
+		static_cast<uint32_t>(poolSize.Height),
         static_cast<DXGI_FORMAT>(DirectXPixelFormat::B8G8R8A8UIntNormalized),
         2);
 
@@ -51,20 +63,29 @@ SimpleCapture::SimpleCapture(
     m_framePool = Direct3D11CaptureFramePool::Create(
         m_device,
         DirectXPixelFormat::B8G8R8A8UIntNormalized,
-        1,
-        size);
+        m_poolBuffers,
+        poolSize);
 #else
     m_framePool = Direct3D11CaptureFramePool::CreateFreeThreaded(
         m_device,
         DirectXPixelFormat::B8G8R8A8UIntNormalized,
-        1,
-        size);
+        m_poolBuffers,
+        poolSize);
 #endif
     m_session = m_framePool.CreateCaptureSession(m_item);
-    //m_session.IsCursorCaptureEnabled(false);
-    m_lastSize = size;
+    m_readbackBackend = std::make_unique<D3D11ReadbackBackend>(d3dDevice, m_d3dContext);
+    m_readback = std::make_unique<ReadbackRing<D3D11ReadbackBackend>>(*m_readbackBackend, ReadbackDepth, MaxFrameLeases);
+    m_downscaler = std::make_unique<D3D11Downscaler>(d3dDevice, m_d3dContext);
+    // The cursor is a separate channel (see Win32CursorTracker), so keep it
+    // out of the frames where the OS lets us.
+    if (auto session2 = m_session.try_as<IGraphicsCaptureSession2>())
+        session2.IsCursorCaptureEnabled(false);
 #ifdef _DEBUG
 	m_frameArrived = m_framePool.FrameArrived(auto_revoke, { this, &SimpleCapture::OnFrameArrived });
+#else
+    // Move frames out of the pool as they land so the compositor keeps a free
+    // buffer; the queue policy decides which of them the consumer gets.
+    m_frameArrived = m_framePool.FrameArrived(auto_revoke, { this, &SimpleCapture::OnFrameQueued });
 #endif
 }
 
@@ -89,8 +110,18 @@ void SimpleCapture::Close()
     if (m_closed.compare_exchange_strong(expected, true))
     {
 		m_frameArrived.revoke();
+
+        // Callers still in the pipeline finish first, and find the capture
+        // closed once they get the lock; IssueCopy may be recreating the pool.
+        // A ReadbackEngine must have had the job removed already, as for
+        // SetAsyncReadback.
+        std::lock_guard<std::mutex> lock(m_pipelineMutex);
 		m_framePool.Close();
         m_session.Close();
+        m_pipeline.Reset();
+        m_frameQueue.Clear([](Direct3D11CaptureFrame&& dropped) { dropped.Close(); });
+        m_readback->Reset();
+        m_downscaler->Reset();
 
         m_swapChain = nullptr;
         m_framePool = nullptr;
@@ -101,111 +132,512 @@ void SimpleCapture::Close()
 
 bool SimpleCapture::CopyImage(unsigned char* buf)
 {
-    auto newSize = false;
-    auto d3dDevice = GetDXGIInterfaceFromObject<ID3D11Device>(m_device);
-    auto frame = m_framePool.TryGetNextFrame();
-    if (frame == nullptr) {
-        OutputDebugStringA("Null frame!\r\n");
-        return false;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    OutputFormat format = OutputFormat::Bgra;
+    return CopyImage(buf, SIZE_MAX, 0, width, height, format) == CopyResult::Ok;
+}
+
+CopyResult SimpleCapture::CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format)
+{
+    if (AsyncReadback())
+        return CopyCompleted(buf, bufSize, dstStride, width, height, format);
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    format = m_pipeline.GetOutputFormat().Format;
+    return m_pipeline.CopyImage(buf, bufSize, dstStride, width, height);
+}
+
+bool SimpleCapture::AsyncReadback()
+{
+    return m_kick.load() != nullptr;
+}
+
+void SimpleCapture::SwapKick(std::function<void()>* kick)
+{
+    auto old = m_kick.exchange(kick);
+    // A handler that counted itself before the exchange may still be calling
+    // the old kick; one that counts itself after it sees the new one.
+    while (m_kicking.load() != 0)
+        std::this_thread::yield();
+    delete old;
+}
+
+CopyResult SimpleCapture::CopyCompleted(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format)
+{
+    // Take the newest completed frame under the lock the frame arrived
+    // handler kicks under, and copy it out after letting go.
+    std::lock_guard<std::mutex> readLock(m_readMutex);
+    {
+        std::lock_guard<std::mutex> lock(m_asyncMutex);
+        if (m_readSerial != m_frontSerial)
+        {
+            std::swap(m_asyncRead, m_asyncFront);
+            m_readStride = m_frontStride;
+            m_readWidth = m_frontWidth;
+            m_readHeight = m_frontHeight;
+            m_readFormat = m_frontFormat;
+            m_readTiming = m_frontTiming;
+            m_readSerial = m_frontSerial;
+        }
     }
-    auto frameContentSize = frame.ContentSize();
-    m_captureFrame = GetDXGIInterfaceFromObject<ID3D11Texture2D>(frame.Surface());
-    
-    D3D11_TEXTURE2D_DESC desc;
-    m_captureFrame->GetDesc(&desc);
-    UINT uiWidth = desc.Width;
-    UINT uiHeight = desc.Height;
-    ULONG ulFrameBufferSize = uiWidth * uiHeight * 4;
-
-    auto CopyBuffer = CreateStageTexture2D(d3dDevice,
-        static_cast<uint32_t>(desc.Width),
-        static_cast<uint32_t>(desc.Height),
-        static_cast<DXGI_FORMAT>(DirectXPixelFormat::B8G8R8A8UIntNormalized));
-    m_d3dContext->CopyResource(CopyBuffer.get(), m_captureFrame.get());
-
-    //Copy the bits
-    D3D11_MAPPED_SUBRESOURCE mapped = {};
-    winrt::check_hresult(m_d3dContext->Map(CopyBuffer.get(), 0, D3D11_MAP_READ, 0, &mapped));
-    auto source = reinterpret_cast<byte*>(mapped.pData);
-    for (auto i = 0; i < (int)desc.Height; i++)
+    if (m_readCopied == m_readSerial)
+        return CopyResult::NoFrame;
+    width = m_readWidth;
+    height = m_readHeight;
+    format = m_readFormat;
+    size_t rowBytes = GetOutputRowBytes(m_readFormat, width);
+    if (dstStride == 0)
+        dstStride = rowBytes;
+    if (dstStride < rowBytes || GetOutputFrameSize(m_readFormat, width, height, dstStride) > bufSize)
+        return CopyResult::BufferTooSmall;
+
+    CopyOutputFrame(buf, dstStride, m_asyncRead.data(), m_readStride, m_readFormat, width, height);
+    m_readCopied = m_readSerial;
+    m_copiedTiming = m_readTiming;
+    m_copiedTiming.DeliveryTimeNs = ToTimestampNs(FramePacer::Clock::now());
+    if (m_trace != nullptr)
     {
-        memcpy(buf, source, desc.Width * 4);
-        source += mapped.RowPitch;
-        buf += desc.Width * 4;
+        FrameTraceRecord record;
+        record.Track = m_traceTrack;
+        record.Width = width;
+        record.Height = height;
+        record.Timing = m_copiedTiming;
+        m_trace->Record(record);
     }
-    m_d3dContext->Unmap(CopyBuffer.get(), 0);
+    return CopyResult::Ok;
+}
+
+bool SimpleCapture::LeaseFrame(FrameLease& lease)
+{
+    if (AsyncReadback())
+        return false;
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    return m_pipeline.LeaseFrame(lease);
+}
+
+bool SimpleCapture::ReturnFrame(uint64_t frameIndex)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    return m_pipeline.ReturnFrame(frameIndex);
+}
+
+void SimpleCapture::SetOutputFormat(ConvertParams const& params)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_pipeline.SetOutputFormat(params);
+}
+
+void SimpleCapture::SetStripCopier(StripCopier* copier)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_pipeline.SetStripCopier(copier);
+}
+
+void SimpleCapture::SetScale(ScaleParams const& params)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_pipeline.SetScale(params);
+}
 
-    if (frameContentSize.Width != m_lastSize.Width ||
-        frameContentSize.Height != m_lastSize.Height)
+void SimpleCapture::SetFrameRate(double fps)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_pipeline.SetTargetFrameRate(fps);
+}
+
+FrameTiming SimpleCapture::GetFrameTiming()
+{
+    if (AsyncReadback())
     {
-        // The thing we have been capturing has changed size.
-        // We need to resize our swap chain first, then blit the pixels.
-        // After we do that, retire the frame and then recreate our frame pool.
-        newSize = true;
-        m_lastSize = frameContentSize;
-        m_framePool.Recreate(
-            m_device,
-            DirectXPixelFormat::B8G8R8A8UIntNormalized,
-            1,
-            m_lastSize);
+        std::lock_guard<std::mutex> lock(m_readMutex);
+        return m_copiedTiming;
     }
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    return m_pipeline.GetFrameTiming();
+}
+
+void SimpleCapture::SetFrameTrace(FrameTraceWriter* trace, uint32_t track)
+{
+    std::lock_guard<std::mutex> pipelineLock(m_pipelineMutex);
+    std::lock_guard<std::mutex> readLock(m_readMutex);
+    std::lock_guard<std::mutex> lock(m_asyncMutex);
+    m_trace = trace;
+    m_traceTrack = track;
+    // The engine's readback is only half way; CopyCompleted traces the rest.
+    m_pipeline.SetTrace(AsyncReadback() ? nullptr : trace, track);
+}
+
+void SimpleCapture::EnableDirtyRegions(bool enable)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_pipeline.EnableDirtyRegions(enable);
+}
+
+bool SimpleCapture::GetDirtyRegions(std::vector<DirtyRect>& rects, bool& identical)
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    auto diff = m_pipeline.GetTileDiff();
+    if (diff == nullptr)
+        return false;
+    rects = diff->DirtyRects();
+    identical = diff->Identical();
     return true;
 }
 
-void SimpleCapture::OnFrameArrived(
-    Direct3D11CaptureFramePool const& sender,
-    winrt::Windows::Foundation::IInspectable const&)
+void SimpleCapture::SetDrawCursor(bool draw)
 {
-    auto newSize = false;
-    HRESULT hr = S_OK;
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_pipeline.SetDrawCursor(draw);
+}
+
+CursorState SimpleCapture::GetCursorState()
+{
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    return m_pipeline.GetCursorState();
+}
+
+void SimpleCapture::SetAsyncReadback(std::function<void()> kick)
+{
+    std::lock_guard<std::mutex> pipelineLock(m_pipelineMutex);
+    if (kick)
+        EnableMultithread();
+    // A frame held back for a larger buffer belongs to whichever mode read it.
+    m_pipeline.Reset();
+
+    std::lock_guard<std::mutex> readLock(m_readMutex);
+    std::lock_guard<std::mutex> lock(m_asyncMutex);
+    SwapKick(kick ? new std::function<void()>(std::move(kick)) : nullptr);
+    // Whatever was read back before doesn't carry over.
+    m_readSerial = m_frontSerial;
+    m_readCopied = m_readSerial;
+    m_pipeline.SetTrace(AsyncReadback() ? nullptr : m_trace, m_traceTrack);
+}
+
+void SimpleCapture::EnableMultithread()
+{
+    if (m_multithread != nullptr)
+        return;
+    // Engine and batch workers share the immediate context with each other
+    // and with every other session on the device.
+    m_multithread = m_d3dContext.as<ID3D11Multithread>();
+    m_multithread->SetMultithreadProtected(TRUE);
+}
+
+void SimpleCapture::SubmitBatch()
+{
+    if (m_closed.load())
+        return;
+    // The engine reads back already; collecting copies out its last frame.
+    if (AsyncReadback())
+        return;
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    if (m_closed.load())
+        return;
+    EnableMultithread();
+    D3D11DeviceLock deviceLock(m_multithread.get());
+    bool decimated = false;
+    IssueCopy(decimated);
+}
+
+bool SimpleCapture::CollectBatch(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format, CopyResult& result)
+{
+    if (AsyncReadback())
     {
-        auto frame = sender.TryGetNextFrame();
-		auto frameContentSize = frame.ContentSize();
+        result = CopyCompleted(buf, bufSize, dstStride, width, height, format);
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    format = m_pipeline.GetOutputFormat().Format;
+    m_nonBlocking = true;
+    m_collecting = true;
+    m_mapPending = false;
+    result = m_pipeline.CopyImage(buf, bufSize, dstStride, width, height);
+    bool pending = m_mapPending;
+    m_nonBlocking = false;
+    m_collecting = false;
+    m_mapPending = false;
+    return result != CopyResult::NoFrame || !pending;
+}
 
-        if (frameContentSize.Width != m_lastSize.Width ||
-			frameContentSize.Height != m_lastSize.Height)
+ReadbackStep SimpleCapture::Step()
+{
+    if (m_closed.load())
+        return ReadbackStep::Idle;
+
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    m_nonBlocking = true;
+    m_mapPending = false;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    auto format = m_pipeline.GetOutputFormat().Format;
+    auto result = m_pipeline.CopyImage(m_asyncBack.data(), m_asyncBack.size(), m_asyncStride, width, height);
+    if (result == CopyResult::BufferTooSmall)
+    {
+        // The pipeline holds on to the frame; take it again with room for it.
+        // Rows are padded to 16 bytes, which also keeps NV12 chroma rows of odd
+        // widths from overlapping as they would at the packed stride.
+        m_asyncStride = (GetOutputRowBytes(format, width) + 15) & ~static_cast<size_t>(15);
+        m_asyncBack.resize(GetOutputFrameSize(format, width, height, m_asyncStride));
+        result = m_pipeline.CopyImage(m_asyncBack.data(), m_asyncBack.size(), m_asyncStride, width, height);
+    }
+    bool pending = m_mapPending;
+    m_nonBlocking = false;
+    m_mapPending = false;
+    if (result != CopyResult::Ok)
+        return pending ? ReadbackStep::Pending : ReadbackStep::Idle;
+
+    {
+        std::lock_guard<std::mutex> asyncLock(m_asyncMutex);
+        std::swap(m_asyncBack, m_asyncFront);
+        m_frontWidth = width;
+        m_frontHeight = height;
+        m_frontFormat = format;
+        m_frontStride = m_asyncStride;
+        m_frontTiming = m_pipeline.GetFrameTiming();
+        m_frontSerial++;
+    }
+    if (m_dispatcher != nullptr)
+        m_dispatcher->Notify();
+    return ReadbackStep::Completed;
+}
+
+winrt::Windows::Graphics::SizeInt32 SimpleCapture::GetPoolSize() const
+{
+    auto pool = m_resize.PoolSize();
+    return { static_cast<int32_t>(pool.Width), static_cast<int32_t>(pool.Height) };
+}
+
+SourceSize SimpleCapture::GetSourceSize()
+{
+    SourceSize size;
+    size.Width = static_cast<uint32_t>(m_lastSize.Width);
+    size.Height = static_cast<uint32_t>(m_lastSize.Height);
+    return size;
+}
+
+bool SimpleCapture::AcquireFrame(MappedSlot& mapped)
+{
+    if (m_closed.load())
+        return false;
+
+    // Copies and maps for one frame go to the context as a unit when engine
+    // workers share it; Map itself doesn't wait then, so the lock is brief.
+    std::optional<D3D11DeviceLock> deviceLock;
+    if (m_nonBlocking && m_multithread != nullptr)
+        deviceLock.emplace(m_multithread.get());
+
+    // A batch issued the copy already; only map it here.
+    bool decimated = false;
+    bool arrived = !m_collecting && IssueCopy(decimated);
+
+    // Map the copy issued depth-1 frames ago. When no new frame arrived there is
+    // nothing left to overlap with, so drain whatever is still in flight.
+    bool acquired;
+    {
+        CaptureStats::ScopedTimer timer(m_stats, CaptureStage::Map);
+        if (m_nonBlocking)
         {
-            // The thing we have been capturing has changed size.
-            // We need to resize our swap chain first, then blit the pixels.
-            // After we do that, retire the frame and then recreate our frame pool.
-            newSize = true;
-            m_lastSize = frameContentSize;
-#ifdef _DEBUG
-            m_swapChain->ResizeBuffers(
-                2, 
-				static_cast<uint32_t>(m_lastSize.Width),
-				static_cast<uint32_t>(m_lastSize.Height),
-                static_cast<DXGI_FORMAT>(DirectXPixelFormat::B8G8R8A8UIntNormalized), 
-                0);
-#endif
+            // Nothing overlaps with the copy here anyway: the engine polls it
+            // and gets on with other sessions meanwhile.
+            auto status = m_readback->TryAcquire(mapped, true);
+            m_mapPending = status == MapStatus::Pending;
+            acquired = status == MapStatus::Mapped;
         }
-        
+        else
         {
-            m_captureFrame = GetDXGIInterfaceFromObject<ID3D11Texture2D>(frame.Surface());
-            auto d3dDevice = GetDXGIInterfaceFromObject<ID3D11Device>(m_device);
-            /* need GetDesc because ContentSize is not reliable */
-            D3D11_TEXTURE2D_DESC desc;
-            m_captureFrame->GetDesc(&desc);
-            UINT uiWidth = desc.Width;
-            UINT uiHeight = desc.Height;
-            ULONG ulFrameBufferSize = uiWidth * uiHeight * 4;
-#ifdef _DEBUG
-            com_ptr<ID3D11Texture2D> backBuffer;
-            check_hresult(m_swapChain->GetBuffer(0, guid_of<ID3D11Texture2D>(), backBuffer.put_void()));
-            m_d3dContext->CopyResource(backBuffer.get(), m_captureFrame.get());
-#endif            
+            acquired = m_readback->Acquire(mapped, !arrived);
         }
     }
+    if (!acquired)
+    {
+        // Polls that don't wait find nothing whenever the last frame was
+        // already taken; that is the engine or a batch idling, not a miss.
+        if (!arrived && !decimated && !m_nonBlocking)
+        {
+            m_stats.AddNullFrame();
 #ifdef _DEBUG
-    DXGI_PRESENT_PARAMETERS presentParameters = { 0 };
-    m_swapChain->Present1(1, 0, &presentParameters);
+            OutputDebugStringA("Null frame!\r\n");
 #endif
-    if (newSize)
+        }
+        return false;
+    }
+    return true;
+}
+
+bool SimpleCapture::IssueCopy(bool& decimated)
+{
+    auto now = ResizeCoalescer::Clock::now();
+    Direct3D11CaptureFrame frame{ nullptr };
+    auto close = [](Direct3D11CaptureFrame&& dropped) { dropped.Close(); };
+    while (m_frameQueue.Pop(frame, close))
+    {
+        auto frameContentSize = frame.ContentSize();
+        if (frameContentSize.Width != m_lastSize.Width ||
+            frameContentSize.Height != m_lastSize.Height)
+        {
+            m_lastSize = frameContentSize;
+            m_stats.AddResizeEvent();
+        }
+        m_resize.Observe(GetSourceSize(), now);
+
+        // Frames over the target rate go back to the pool before any copy is
+        // spent on them. SystemRelativeTime counts on the steady clock.
+        auto captured = FramePacer::Clock::time_point(
+            std::chrono::duration_cast<FramePacer::Clock::duration>(frame.SystemRelativeTime()));
+        if (m_pacer.Admit(captured))
+            break;
+        frame.Close();
+        frame = nullptr;
+        decimated = true;
+        m_stats.AddDecimated();
+    }
+    if (frame != nullptr)
     {
+        SourceSize content = GetSourceSize();
+        m_captureFrame = GetDXGIInterfaceFromObject<ID3D11Texture2D>(frame.Surface());
+
+        // The surface is the size of the pool, not of the window: larger while
+        // there is headroom, smaller while a grow is settling. Copy the part
+        // that holds content.
+        D3D11_TEXTURE2D_DESC desc;
+        m_captureFrame->GetDesc(&desc);
+        auto visibleWidth = (std::min)(content.Width, desc.Width);
+        auto visibleHeight = (std::min)(content.Height, desc.Height);
+        if (visibleWidth > 0 && visibleHeight > 0)
+        {
+            auto region = ClampCrop(m_crop, visibleWidth, visibleHeight);
+            StagingDesc stagingDesc;
+            stagingDesc.Width = region.Width;
+            stagingDesc.Height = region.Height;
+            stagingDesc.Format = static_cast<uint32_t>(DirectXPixelFormat::B8G8R8A8UIntNormalized);
+            CaptureStats::ScopedTimer timer(m_stats, CaptureStage::Copy);
+            // Only read back what the consumer will use: the crop, halved on
+            // the GPU for as long as that stays above the output size.
+            auto levels = GetReductionLevels(region.Width, region.Height, m_scaleWidth, m_scaleHeight, D3D11Downscaler::MaxLevels);
+            D3D11CopySource source;
+            if (levels > 0)
+            {
+                source = m_downscaler->Reduce(m_captureFrame, region, levels, stagingDesc.Width, stagingDesc.Height);
+            }
+            else
+            {
+                source.Texture = m_captureFrame.get();
+                source.Box.left = region.X;
+                source.Box.top = region.Y;
+                source.Box.right = region.X + region.Width;
+                source.Box.bottom = region.Y + region.Height;
+                source.Box.back = 1;
+            }
+            auto captureTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(frame.SystemRelativeTime()).count();
+            m_readback->Submit(stagingDesc, source, captureTimeNs > 0 ? static_cast<uint64_t>(captureTimeNs) : 0, ToTimestampNs(now));
+        }
+    }
+
+    // Recreate the pool once the window has settled at a size it doesn't fit.
+    // Checked on every poll, since the last step of a drag may be the last
+    // frame for a while.
+    SourceSize poolSize;
+    if (m_resize.Poll(now, poolSize))
+    {
+        CaptureStats::ScopedTimer timer(m_stats, CaptureStage::Resize);
         m_framePool.Recreate(
             m_device,
             DirectXPixelFormat::B8G8R8A8UIntNormalized,
-            1,
-            m_lastSize);
+            m_poolBuffers,
+            GetPoolSize());
+        m_stats.AddResize();
     }
-}
\ No newline at end of file
+    return frame != nullptr;
+}
+
+void SimpleCapture::SetFramePolicy(uint32_t depth, FramePolicy policy)
+{
+    // Configure is consumer side and IssueCopy recreates the pool too: both
+    // run under the pipeline lock, as does Close.
+    std::lock_guard<std::mutex> lock(m_pipelineMutex);
+    CheckClosed();
+    m_frameQueue.Configure(depth, policy);
+    // One buffer more than the queue can hold, so the compositor always has
+    // somewhere to render the next frame.
+    if (depth == 0)
+        depth = 1;
+    else if (depth > BoundedFrameQueue<Direct3D11CaptureFrame>::MaxDepth)
+        depth = BoundedFrameQueue<Direct3D11CaptureFrame>::MaxDepth;
+    m_poolBuffers = static_cast<int32_t>(policy == FramePolicy::LatestWins ? 1 : depth) + 1;
+    m_framePool.Recreate(
+        m_device,
+        DirectXPixelFormat::B8G8R8A8UIntNormalized,
+        m_poolBuffers,
+        GetPoolSize());
+}
+
+void SimpleCapture::QueueFrame(Direct3D11CaptureFrame const& frame)
+{
+    // Frames the new one supersedes go back to the pool here, not when the
+    // consumer next pops: with depth + 1 buffers the compositor would
+    // otherwise run out while the consumer is busy.
+    auto close = [](Direct3D11CaptureFrame&& superseded) { superseded.Close(); };
+    if (!m_frameQueue.Push(frame, close))
+        frame.Close();
+    // No lock here: the compositor's thread must not wait on a copy out.
+    m_kicking.fetch_add(1);
+    if (auto kick = m_kick.load())
+        (*kick)();
+    else if (m_dispatcher != nullptr)
+        m_dispatcher->Notify();
+    m_kicking.fetch_sub(1);
+}
+
+void SimpleCapture::OnFrameQueued(
+    Direct3D11CaptureFramePool const& sender,
+    winrt::Windows::Foundation::IInspectable const&)
+{
+    Direct3D11CaptureFrame frame{ nullptr };
+    {
+        CaptureStats::ScopedTimer timer(m_stats, CaptureStage::Acquire);
+        frame = sender.TryGetNextFrame();
+    }
+    if (frame != nullptr && m_closed.load() == false)
+        QueueFrame(frame);
+}
+
+void SimpleCapture::OnFrameArrived(
+    Direct3D11CaptureFramePool const& sender,
+    winrt::Windows::Foundation::IInspectable const&)
+{
+    Direct3D11CaptureFrame frame{ nullptr };
+    {
+        CaptureStats::ScopedTimer timer(m_stats, CaptureStage::Acquire);
+        frame = sender.TryGetNextFrame();
+    }
+    if (frame == nullptr || m_closed.load())
+        return;
+
+    // Pool recreation is left to AcquireFrame, which coalesces resizes; the
+    // preview only follows the size of the surfaces the pool hands out.
+    auto surface = GetDXGIInterfaceFromObject<ID3D11Texture2D>(frame.Surface());
+    /* need GetDesc because ContentSize is not reliable */
+    D3D11_TEXTURE2D_DESC desc;
+    surface->GetDesc(&desc);
+#ifdef _DEBUG
+    DXGI_SWAP_CHAIN_DESC1 swapChainDesc;
+    m_swapChain->GetDesc1(&swapChainDesc);
+    if (swapChainDesc.Width != desc.Width || swapChainDesc.Height != desc.Height)
+    {
+        m_swapChain->ResizeBuffers(
+            2, 
+            desc.Width,
+            desc.Height,
+            static_cast<DXGI_FORMAT>(DirectXPixelFormat::B8G8R8A8UIntNormalized), 
+            0);
+    }
+    com_ptr<ID3D11Texture2D> backBuffer;
+    check_hresult(m_swapChain->GetBuffer(0, guid_of<ID3D11Texture2D>(), backBuffer.put_void()));
+    m_d3dContext->CopyResource(backBuffer.get(), surface.get());
+#endif
+    QueueFrame(frame);
+#ifdef _DEBUG
+    DXGI_PRESENT_PARAMETERS presentParameters = { 0 };
+    m_swapChain->Present1(1, 0, &presentParameters);
+#endif
+}
@@ -1,25 +1,129 @@
 #pragma once
+#include <functional>
+#include <mutex>
+#include "CapturePipeline.h"
+#include "D3D11Downscaler.h"
+#include "D3D11ReadbackBackend.h"
+#include "FrameDispatcher.h"
+#include "FrameQueue.h"
+#include "ReadbackEngine.h"
+#include "ResizeCoalescer.h"
+#include "Win32Cursor.h"
 
-class SimpleCapture
+// Calls that reach the pipeline are serialized on m_pipelineMutex, since with
+// asynchronous readback the pipeline runs on a ReadbackEngine worker while the
+// caller changes settings from its own thread.
+class SimpleCapture : public ICaptureSource, public IReadbackJob
 {
 public:
+    // Staging slots in the readback ring; frames are returned depth-1 calls
+    // after their copy was issued.
+    static constexpr uint32_t ReadbackDepth = 2;
+    // Frames a consumer may hold through LeaseFrame at the same time.
+    static constexpr uint32_t MaxFrameLeases = 2;
+
     SimpleCapture(
         winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice const& device,
-        winrt::Windows::Graphics::Capture::GraphicsCaptureItem const& item);
-    ~SimpleCapture() { Close(); }
+        winrt::Windows::Graphics::Capture::GraphicsCaptureItem const& item,
+        FrameDispatcher* dispatcher = nullptr,
+        HWND window = nullptr);
+    ~SimpleCapture()
+    {
+        Close();
+        SwapKick(nullptr);
+    }
 
-    void StartCapture();
+    void StartCapture() override;
     winrt::Windows::UI::Composition::ICompositionSurface CreateSurface(
         winrt::Windows::UI::Composition::Compositor const& compositor);
 
     bool CopyImage(unsigned char* buf);
+    // Bounds checked copy. A dstStride of 0 packs rows tightly. The frame size
+    // is reported even when the buffer turns out to be too small, as is the
+    // format it comes in: under asynchronous readback, that of the output
+    // format when the frame was read back, which may since have changed.
+    CopyResult CopyImage(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format);
+    // Leased frames are always BGRA; the output format applies to copies only.
+    // Not available while readback is asynchronous.
+    bool LeaseFrame(FrameLease& lease);
+    bool ReturnFrame(uint64_t frameIndex);
 
-    void Close();
+    void SetOutputFormat(ConvertParams const& params);
+    // See CapturePipeline::SetStripCopier.
+    void SetStripCopier(StripCopier* copier);
+    // Crop and output size of copies. Cropping and whole 2:1 reductions are
+    // done on the GPU ahead of the staging copy; the CPU scaler only covers
+    // what is left.
+    void SetScale(ScaleParams const& params);
+    // Deliver at most fps frames per second, 0 for all of them. Surplus frames
+    // are handed back to the frame pool without being copied or mapped.
+    void SetFrameRate(double fps);
+    FrameTiming GetFrameTiming();
+    // Record delivered frames to trace under track, nullptr to stop. Under
+    // asynchronous readback a frame is delivered when CopyImage copies it.
+    void SetFrameTrace(FrameTraceWriter* trace, uint32_t track);
+    // Hand readback to a ReadbackEngine. Frames landing call kick instead of
+    // notifying the dispatcher; the engine's Step reads them back into a CPU
+    // buffer without waiting on the GPU and notifies the dispatcher then, and
+    // CopyImage copies out of that buffer. nullptr goes back to reading back
+    // on the caller's thread. Remove the job from the engine first. Returns
+    // once no frame arrived handler is calling the old kick any more.
+    void SetAsyncReadback(std::function<void()> kick);
+    // Batched capture, as one IBatchJob: SubmitBatch issues the staging copy
+    // of the newest frame without mapping it; CollectBatch then maps it
+    // without waiting and copies it out, returning false while the copy is
+    // still in flight. Under asynchronous readback the engine's last frame is
+    // copied instead.
+    void SubmitBatch();
+    bool CollectBatch(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format, CopyResult& result);
+    // Queue depth and overflow policy between the frame pool and CopyImage.
+    // The pool is recreated with one buffer more than the queue can hold.
+    void SetFramePolicy(uint32_t depth, FramePolicy policy);
+    FrameQueueStats GetFrameQueueStats() { return m_frameQueue.Stats(); }
+    CaptureStatsSnapshot GetCaptureStats(bool reset) { return m_stats.Snapshot(reset); }
+    // Track which tiles changed between frames returned by CopyImage.
+    void EnableDirtyRegions(bool enable);
+    bool GetDirtyRegions(std::vector<DirtyRect>& rects, bool& identical);
+    // The capture itself never contains the cursor; it is tracked on the side
+    // and blended into copies on request.
+    void SetDrawCursor(bool draw);
+    CursorState GetCursorState();
+
+    // Stop capturing and release the pool and staging surfaces. Under
+    // asynchronous readback, remove the job from the engine first.
+    void Close() override;
     winrt::Windows::Graphics::SizeInt32 GetLastSize() { return m_lastSize; }
+
+    // ICaptureSource
+    bool AcquireFrame(MappedSlot& mapped) override;
+    void ReleaseFrame(MappedSlot const& mapped) override { m_readback->Release(mapped); }
+    SourceSize GetSourceSize() override;
+    bool SetCrop(CropRect const& crop) override { m_crop = crop; return true; }
+    void SetScaleHint(uint32_t width, uint32_t height) override { m_scaleWidth = width; m_scaleHeight = height; }
+    bool SetTargetFrameRate(double fps) override { m_pacer.SetTargetFrameRate(fps); return true; }
+    bool GetCursor(CursorSample& cursor) override { return m_cursor.Sample(cursor); }
+
+    // IReadbackJob
+    ReadbackStep Step() override;
 private:
     void OnFrameArrived(
         winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool const& sender,
         winrt::Windows::Foundation::IInspectable const& args);
+    void OnFrameQueued(
+        winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool const& sender,
+        winrt::Windows::Foundation::IInspectable const& args);
+    void QueueFrame(winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame const& frame);
+
+    winrt::Windows::Graphics::SizeInt32 GetPoolSize() const;
+    // Pop and pace queued frames and copy the one admitted to staging.
+    // Returns whether a frame arrived.
+    bool IssueCopy(bool& decimated);
+    void EnableMultithread();
+    bool AsyncReadback();
+    // Install kick and delete the old one once no kick is in flight.
+    void SwapKick(std::function<void()>* kick);
+    // The frame Step read back last, copied into the caller's buffer.
+    CopyResult CopyCompleted(unsigned char* buf, size_t bufSize, size_t dstStride, uint32_t& width, uint32_t& height, OutputFormat& format);
 
     void CheckClosed()
     {
@@ -34,11 +138,62 @@ private:
     winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool m_framePool{ nullptr };
     winrt::Windows::Graphics::Capture::GraphicsCaptureSession m_session{ nullptr };
     winrt::Windows::Graphics::SizeInt32 m_lastSize;
+    // Frame pool size, with headroom over m_lastSize; lags it while a resize settles.
+    ResizeCoalescer m_resize;
 
     winrt::Windows::Graphics::DirectX::Direct3D11::IDirect3DDevice m_device{ nullptr };
     winrt::com_ptr<IDXGISwapChain1> m_swapChain{ nullptr };
     winrt::com_ptr<ID3D11Texture2D> m_captureFrame{ nullptr };
     winrt::com_ptr<ID3D11DeviceContext> m_d3dContext{ nullptr };
+    std::unique_ptr<D3D11ReadbackBackend> m_readbackBackend{ nullptr };
+    std::unique_ptr<ReadbackRing<D3D11ReadbackBackend>> m_readback{ nullptr };
+    std::unique_ptr<D3D11Downscaler> m_downscaler{ nullptr };
+    CropRect m_crop;
+    uint32_t m_scaleWidth = 0;
+    uint32_t m_scaleHeight = 0;
+    FramePacer m_pacer;
+    FrameDispatcher* m_dispatcher = nullptr;
+    Win32CursorTracker m_cursor;
+    BoundedFrameQueue<winrt::Windows::Graphics::Capture::Direct3D11CaptureFrame> m_frameQueue;
+    int32_t m_poolBuffers = 2;
+    CaptureStats m_stats;
+    std::mutex m_pipelineMutex;
+    CapturePipeline m_pipeline{ *this, m_stats, MaxFrameLeases };
+
+    // Asynchronous readback. m_asyncMutex guards the completed frame; the
+    // rest belongs to whoever holds m_pipelineMutex. Copies out run under
+    // m_readMutex only, from the frame swapped into m_asyncRead.
+    // Lock order is pipeline, read, async.
+    std::mutex m_readMutex;
+    std::mutex m_asyncMutex;
+    // The frame arrived handler calls the kick without taking a lock; it
+    // counts itself in m_kicking meanwhile, which SwapKick waits out.
+    std::atomic<std::function<void()>*> m_kick{ nullptr };
+    std::atomic<uint32_t> m_kicking{ 0 };
+    winrt::com_ptr<ID3D11Multithread> m_multithread{ nullptr };
+    bool m_nonBlocking = false;         // AcquireFrame must not wait on Map
+    bool m_mapPending = false;          // ...and found the copy still in flight
+    bool m_collecting = false;          // SubmitBatch issued the copy already
+    std::vector<uint8_t> m_asyncBack;
+    size_t m_asyncStride = 0;
+    std::vector<uint8_t> m_asyncFront;
+    size_t m_frontStride = 0;
+    uint32_t m_frontWidth = 0;
+    uint32_t m_frontHeight = 0;
+    OutputFormat m_frontFormat = OutputFormat::Bgra;
+    FrameTiming m_frontTiming;
+    FrameTraceWriter* m_trace = nullptr;    // under every mutex
+    uint32_t m_traceTrack = 0;
+    uint64_t m_frontSerial = 0;
+    std::vector<uint8_t> m_asyncRead;
+    size_t m_readStride = 0;
+    uint32_t m_readWidth = 0;
+    uint32_t m_readHeight = 0;
+    OutputFormat m_readFormat = OutputFormat::Bgra;
+    FrameTiming m_readTiming;
+    uint64_t m_readSerial = 0;
+    uint64_t m_readCopied = 0;
+    FrameTiming m_copiedTiming;
     
     std::atomic<bool> m_closed = false;
 	winrt::Windows::Graphics::Capture::Direct3D11CaptureFramePool::FrameArrived_revoker m_frameArrived;
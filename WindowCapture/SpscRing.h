@@ -0,0 +1,191 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// Lock-free single-producer/single-consumer ring. Each pushed value is stamped
+// with a sequence number, so the consumer can tell how many values it never
+// saw. Exactly one thread may push and exactly one (other) thread may pop.
+// The producer may also take back values the consumer hasn't popped yet;
+// each value goes to whichever side claims it first.
+template <typename T>
+class SpscRing
+{
+public:
+    // capacity is rounded up to a power of two.
+    explicit SpscRing(size_t capacity)
+    {
+        size_t size = 1;
+        while (size < capacity)
+            size <<= 1;
+        m_slots = std::make_unique<Slot[]>(size);
+        m_mask = size - 1;
+    }
+
+    SpscRing(SpscRing const&) = delete;
+    SpscRing& operator=(SpscRing const&) = delete;
+
+    // Producer side. Fails when the ring is full.
+    bool TryPush(T value)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail > m_mask)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cachedTail > m_mask)
+                return false;
+        }
+
+        auto& slot = m_slots[head & m_mask];
+        slot.Value.emplace(std::move(value));
+        slot.State.store(Stamp(head, Queued), std::memory_order_relaxed);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side. Takes back every value but the newest keep that the
+    // consumer hasn't popped yet, passing each to evicted, and frees their
+    // slots. Returns how many were taken back.
+    template <typename TEvicted>
+    size_t Evict(size_t keep, TEvicted&& evicted)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head <= keep)
+            return 0;
+        uint64_t end = head - keep;
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        size_t count = 0;
+        for (uint64_t next = m_evictNext > tail ? m_evictNext : tail; next < end; next++)
+        {
+            auto& slot = m_slots[next & m_mask];
+            uint64_t expected = Stamp(next, Queued);
+            if (!slot.State.compare_exchange_strong(expected, Stamp(next, Evicted), std::memory_order_acq_rel))
+                continue;
+            evicted(std::move(*slot.Value));
+            slot.Value.reset();
+            count++;
+        }
+        if (end > m_evictNext)
+            m_evictNext = end;
+
+        // Step the tail over what was taken back, up to a value the consumer
+        // is popping, so a consumer that stops popping doesn't leave the ring
+        // full of slots nobody holds.
+        while (tail < end && m_slots[tail & m_mask].State.load(std::memory_order_acquire) == Stamp(tail, Evicted))
+        {
+            if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+                tail++;
+        }
+        return count;
+    }
+
+    // Consumer side. sequence, if given, receives the value's push index.
+    bool TryPop(T& value, uint64_t* sequence = nullptr)
+    {
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if (tail >= m_cachedHead)
+            {
+                m_cachedHead = m_head.load(std::memory_order_acquire);
+                if (tail >= m_cachedHead)
+                    return false;
+            }
+            uint64_t popped = tail;
+            if (Claim(tail, [&](T&& claimed) { value = std::move(claimed); }))
+            {
+                if (sequence != nullptr)
+                    *sequence = popped;
+                return true;
+            }
+        }
+    }
+
+    // Consumer side. Pops values, passing each to dropped, until no more than
+    // keep are left. Returns how many were dropped.
+    template <typename TDropped>
+    size_t Drop(size_t keep, TDropped&& dropped)
+    {
+        size_t count = 0;
+        uint64_t tail = m_tail.load(std::memory_order_acquire);
+        for (;;)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (m_cachedHead - tail <= keep)
+                return count;
+            if (Claim(tail, dropped))
+                count++;
+        }
+    }
+
+    // Consumer side. Number of values waiting, counting any the producer took
+    // back and hasn't stepped over yet; a lower bound while the producer keeps
+    // pushing.
+    size_t Size() const
+    {
+        return static_cast<size_t>(m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed));
+    }
+
+    // Producer side. Number of values waiting; exact for the producer, an
+    // upper bound while the consumer keeps popping.
+    size_t ProducerSize() const
+    {
+        return static_cast<size_t>(m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire));
+    }
+
+    size_t Capacity() const noexcept { return m_mask + 1; }
+
+private:
+    // A slot's state is the sequence number of the value in it and who holds
+    // that value, so a side that fell behind can't claim a later one.
+    static constexpr uint64_t Queued = 0;
+    static constexpr uint64_t Popped = 1;
+    static constexpr uint64_t Evicted = 2;
+
+    static constexpr uint64_t Stamp(uint64_t sequence, uint64_t owner) noexcept
+    {
+        return sequence << 2 | owner;
+    }
+
+    struct Slot
+    {
+        std::optional<T> Value;
+        std::atomic<uint64_t> State{ 0 };
+    };
+
+    // Consumer side. Passes the value at tail to take unless the producer took
+    // it back, and steps tail past it either way.
+    template <typename TTake>
+    bool Claim(uint64_t& tail, TTake&& take)
+    {
+        auto& slot = m_slots[tail & m_mask];
+        uint64_t expected = Stamp(tail, Queued);
+        if (slot.State.compare_exchange_strong(expected, Stamp(tail, Popped), std::memory_order_acq_rel))
+        {
+            take(std::move(*slot.Value));
+            slot.Value.reset();
+            // The producer only steps over values it took back, so the tail
+            // is still ours to move.
+            m_tail.store(++tail, std::memory_order_release);
+            return true;
+        }
+        // Taken back; step over it unless the producer already has, in which
+        // case the exchange reloads tail.
+        if (m_tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            tail++;
+        return false;
+    }
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask = 0;
+
+    // Producer and consumer indices on separate cache lines, each next to the
+    // other side's index as last seen, so the fast path touches no shared line.
+    alignas(64) std::atomic<uint64_t> m_head{ 0 };
+    uint64_t m_cachedTail = 0;
+    uint64_t m_evictNext = 0;       // values before it were taken back or popped
+    alignas(64) std::atomic<uint64_t> m_tail{ 0 };
+    uint64_t m_cachedHead = 0;
+};
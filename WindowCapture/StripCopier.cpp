@@ -0,0 +1,285 @@
+#include "StripCopier.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <cstdio>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _WIN32
+
+// The index-th processor set in mask, wrapping around.
+static KAFFINITY NthProcessor(KAFFINITY mask, uint32_t index)
+{
+    uint32_t count = 0;
+    for (KAFFINITY bit = 1; bit != 0; bit <<= 1)
+        count += (mask & bit) != 0 ? 1 : 0;
+    index %= count;
+    for (KAFFINITY bit = 1; bit != 0; bit <<= 1)
+    {
+        if ((mask & bit) != 0 && index-- == 0)
+            return bit;
+    }
+    return mask;
+}
+
+static bool SetWorkerAffinity(int32_t node, bool pin, uint32_t index)
+{
+    GROUP_AFFINITY affinity = {};
+    if (node >= 0)
+    {
+        if (!::GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) || affinity.Mask == 0)
+            return false;
+        if (pin)
+            affinity.Mask = NthProcessor(affinity.Mask, index);
+    }
+    else if (pin)
+    {
+        // Every processor of every group, in turn.
+        DWORD total = ::GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+        if (total == 0)
+            return false;
+        DWORD processor = index % total;
+        WORD groups = ::GetActiveProcessorGroupCount();
+        WORD group = 0;
+        while (group < groups && processor >= ::GetActiveProcessorCount(group))
+            processor -= ::GetActiveProcessorCount(group++);
+        if (group == groups)
+            return false;
+        affinity.Group = group;
+        affinity.Mask = static_cast<KAFFINITY>(1) << processor;
+    }
+    else
+    {
+        return false;
+    }
+    return ::SetThreadGroupAffinity(::GetCurrentThread(), &affinity, nullptr) != FALSE;
+}
+
+#elif defined(__linux__)
+
+// Processors of a node, from its cpulist ("0-7,16-23").
+static std::vector<int> NodeProcessors(int32_t node)
+{
+    std::vector<int> cpus;
+    char path[64];
+    std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    std::FILE* file = std::fopen(path, "r");
+    if (file == nullptr)
+        return cpus;
+    int first = 0;
+    while (std::fscanf(file, "%d", &first) == 1)
+    {
+        int last = first;
+        int separator = std::fgetc(file);
+        if (separator == '-')
+        {
+            if (std::fscanf(file, "%d", &last) != 1)
+                break;
+            separator = std::fgetc(file);
+        }
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            cpus.push_back(cpu);
+        if (separator != ',')
+            break;
+    }
+    std::fclose(file);
+    return cpus;
+}
+
+static bool SetWorkerAffinity(int32_t node, bool pin, uint32_t index)
+{
+    std::vector<int> cpus;
+    if (node >= 0)
+    {
+        cpus = NodeProcessors(node);
+    }
+    else if (pin)
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return false;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        }
+    }
+    if (cpus.empty())
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pin)
+        CPU_SET(cpus[index % cpus.size()], &set);
+    else
+        for (int cpu : cpus)
+            CPU_SET(cpu, &set);
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+#else
+
+static bool SetWorkerAffinity(int32_t node, bool pin, uint32_t index)
+{
+    (void)node;
+    (void)pin;
+    (void)index;
+    return false;
+}
+
+#endif
+
+StripCopier::StripCopier(StripCopierConfig const& config) :
+    m_config(config)
+{
+    uint32_t threads = config.Threads;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, 16u);
+    if (m_config.MinStripRows == 0)
+        m_config.MinStripRows = 1;
+    for (uint32_t i = 1; i < threads; i++)
+        m_threads.emplace_back([this, i] { WorkerLoop(i - 1); });
+}
+
+StripCopier::~StripCopier()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void StripCopier::Convert(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride,
+    uint32_t width, uint32_t height, ConvertParams const& params)
+{
+    // A chroma row is made from two luma rows; strips can't split them.
+    bool planar = params.Format == OutputFormat::Nv12 || params.Format == OutputFormat::I420;
+    size_t bytes = GetOutputFrameSize(params.Format, width, height, dstStride);
+    Run(height, planar ? 2 : 1, bytes, [&](uint32_t first, uint32_t count)
+    {
+        ConvertFrameRows(dst, dstStride, src, srcStride, width, height, first, count, params);
+    });
+}
+
+void StripCopier::Run(uint32_t rows, uint32_t alignment, size_t bytes, StripFunction const& work)
+{
+    if (rows == 0)
+        return;
+    if (alignment == 0)
+        alignment = 1;
+    uint32_t strips = 1;
+    if (!m_threads.empty() && bytes >= m_config.MinParallelBytes)
+    {
+        // Twice the threads, so one that starts late or runs slow leaves its
+        // second strip to the others.
+        strips = std::min(Threads() * 2, rows / m_config.MinStripRows);
+    }
+    if (strips <= 1)
+    {
+        work(0, rows);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.Frames++;
+        m_stats.Strips++;
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(m_runMutex);
+    uint32_t stripRows = (rows + strips - 1) / strips;
+    stripRows = (stripRows + alignment - 1) / alignment * alignment;
+    strips = (rows + stripRows - 1) / stripRows;
+
+    uint64_t run;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        run = ++m_run;
+        m_work = &work;
+        m_rows = rows;
+        m_stripRows = stripRows;
+        m_strips = strips;
+        m_pending.store(strips, std::memory_order_relaxed);
+        m_claim.store(run << 32, std::memory_order_release);
+        m_stats.Frames++;
+        m_stats.ParallelFrames++;
+        m_stats.Strips += strips;
+    }
+    m_cv.notify_all();
+
+    RunStrips(run, work, rows, stripRows, strips);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCv.wait(lock, [this] { return m_pending.load(std::memory_order_acquire) == 0; });
+    m_work = nullptr;
+}
+
+void StripCopier::RunStrips(uint64_t run, StripFunction const& work, uint32_t rows, uint32_t stripRows,
+    uint32_t strips)
+{
+    // work outlives the run, which can't end before a strip claimed here is done.
+    for (;;)
+    {
+        uint64_t claim = m_claim.load(std::memory_order_acquire);
+        if ((claim >> 32) != (run & 0xffffffffu) || (claim & 0xffffffffu) >= strips)
+            return;
+        if (!m_claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel))
+            continue;
+
+        uint32_t first = static_cast<uint32_t>(claim & 0xffffffffu) * stripRows;
+        work(first, std::min(stripRows, rows - first));
+        if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_doneCv.notify_all();
+        }
+    }
+}
+
+void StripCopier::WorkerLoop(uint32_t index)
+{
+    if ((m_config.NumaNode >= 0 || m_config.PinWorkers) &&
+        SetWorkerAffinity(m_config.NumaNode, m_config.PinWorkers, index))
+    {
+        m_pinned.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    uint64_t seen = m_run;
+    for (;;)
+    {
+        m_cv.wait(lock, [this, seen] { return m_stop || m_run != seen; });
+        if (m_stop)
+            return;
+        seen = m_run;
+        if (m_work != nullptr)
+        {
+            StripFunction const& work = *m_work;
+            uint32_t rows = m_rows;
+            uint32_t stripRows = m_stripRows;
+            uint32_t strips = m_strips;
+            lock.unlock();
+            RunStrips(seen, work, rows, stripRows, strips);
+            lock.lock();
+        }
+    }
+}
+
+StripCopierStats StripCopier::Stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto stats = m_stats;
+    stats.Affinity = !m_threads.empty() && m_pinned.load(std::memory_order_relaxed) == m_threads.size();
+    return stats;
+}
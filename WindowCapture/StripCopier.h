@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "PixelConvert.h"
+
+struct StripCopierConfig
+{
+    static constexpr size_t DefaultMinParallelBytes = 4u << 20;
+
+    // Threads copying, the caller included; 0 for the hardware threads, at
+    // most 16.
+    uint32_t Threads = 0;
+    // Frames writing fewer bytes are copied on the calling thread alone: below
+    // about 1080p BGRA, waking the workers costs more than they save.
+    size_t MinParallelBytes = DefaultMinParallelBytes;
+    // Rows a strip is never cut below.
+    uint32_t MinStripRows = 32;
+    // Keep the workers on the processors of this NUMA node, -1 for any. The
+    // staging memory a frame is mapped from is best read from the node that
+    // owns the GPU.
+    int32_t NumaNode = -1;
+    // Pin each worker to one processor, taken in turn from the node's or from
+    // every processor, rather than letting them move within the set.
+    bool PinWorkers = false;
+};
+
+struct StripCopierStats
+{
+    uint64_t Frames = 0;
+    uint64_t ParallelFrames = 0;    // split into strips rather than copied on the caller alone
+    uint64_t Strips = 0;
+    bool Affinity = false;          // the requested node or pinning took effect
+};
+
+// Splits row work on a frame into strips run on a persistent pool of threads,
+// so copying a large frame out of staging memory isn't held to the bandwidth
+// one core can pull. The calling thread takes strips too. Strips are claimed
+// one at a time, so a thread held up elsewhere doesn't hold up the frame.
+// Runs from several threads are taken one after another.
+class StripCopier
+{
+public:
+    // Work on rows first to first + count of the frame.
+    using StripFunction = std::function<void(uint32_t first, uint32_t count)>;
+
+    explicit StripCopier(StripCopierConfig const& config = StripCopierConfig());
+    ~StripCopier();
+
+    StripCopier(StripCopier const&) = delete;
+    StripCopier& operator=(StripCopier const&) = delete;
+
+    // ConvertFrame, in strips when the output is large enough.
+    void Convert(uint8_t* dst, size_t dstStride, const uint8_t* src, size_t srcStride,
+        uint32_t width, uint32_t height, ConvertParams const& params);
+    // Run work over rows 0 to rows, in strips starting on multiples of
+    // alignment. bytes is what the whole run writes, for the threshold.
+    void Run(uint32_t rows, uint32_t alignment, size_t bytes, StripFunction const& work);
+
+    uint32_t Threads() const noexcept { return static_cast<uint32_t>(m_threads.size()) + 1; }
+    StripCopierStats Stats();
+
+private:
+    void WorkerLoop(uint32_t index);
+    // Run strips of the given run until none is left to claim. The parameters
+    // are the run's, read under m_mutex.
+    void RunStrips(uint64_t run, StripFunction const& work, uint32_t rows, uint32_t stripRows, uint32_t strips);
+
+    StripCopierConfig m_config;
+    std::mutex m_runMutex;              // one run at a time
+    std::mutex m_mutex;
+    std::condition_variable m_cv;       // a run started, or stop
+    std::condition_variable m_doneCv;   // the last strip of a run finished
+    bool m_stop = false;
+    uint64_t m_run = 0;
+    // The latest run's strips; written under m_mutex as m_run changes.
+    StripFunction const* m_work = nullptr;
+    uint32_t m_rows = 0;
+    uint32_t m_stripRows = 0;
+    uint32_t m_strips = 0;
+    // Run number in the high half and next strip in the low, so a thread
+    // late for one run can't claim a strip of the next.
+    std::atomic<uint64_t> m_claim{ 0 };
+    std::atomic<uint32_t> m_pending{ 0 };
+    StripCopierStats m_stats;
+    std::atomic<uint32_t> m_pinned{ 0 };
+    std::vector<std::thread> m_threads;
+};
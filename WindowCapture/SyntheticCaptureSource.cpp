@@ -0,0 +1,389 @@
+#include "SyntheticCaptureSource.h"
+#include <algorithm>
+
+namespace
+{
+    // Staging surfaces come back with their rows padded; mimic the usual pitch
+    // so stride handling downstream gets exercised.
+    constexpr uint32_t RowPitchAlignment = 256;
+
+    uint32_t RowPitchFor(uint32_t width)
+    {
+        return (width * 4 + RowPitchAlignment - 1) / RowPitchAlignment * RowPitchAlignment;
+    }
+
+    inline void PutBackground(uint8_t* px, uint32_t x, uint32_t y)
+    {
+        px[0] = static_cast<uint8_t>(x);
+        px[1] = static_cast<uint8_t>(y);
+        px[2] = static_cast<uint8_t>((x + y) >> 1);
+        px[3] = 255;
+    }
+
+    void FillBackground(uint8_t* dst, size_t stride, uint32_t x0, uint32_t y0, uint32_t w, uint32_t h)
+    {
+        for (uint32_t y = y0; y < y0 + h; y++)
+        {
+            uint8_t* row = dst + y * stride;
+            for (uint32_t x = x0; x < x0 + w; x++)
+                PutBackground(row + x * 4, x, y);
+        }
+    }
+
+    struct Box
+    {
+        uint32_t X = 0;
+        uint32_t Y = 0;
+        uint32_t Width = 0;
+        uint32_t Height = 0;
+    };
+
+    Box BoxFor(uint32_t width, uint32_t height, uint32_t boxSize, uint64_t frameIndex)
+    {
+        Box box;
+        box.Width = std::min(boxSize, width);
+        box.Height = std::min(boxSize, height);
+        box.X = static_cast<uint32_t>((frameIndex * 7) % (width - box.Width + 1));
+        box.Y = static_cast<uint32_t>((frameIndex * 3) % (height - box.Height + 1));
+        return box;
+    }
+
+    Box ClipBox(Box box, uint32_t width, uint32_t height)
+    {
+        box.Width = box.X < width ? std::min(box.Width, width - box.X) : 0;
+        box.Height = box.Y < height ? std::min(box.Height, height - box.Y) : 0;
+        return box;
+    }
+
+    void FillBox(uint8_t* dst, size_t stride, Box const& box, uint64_t frameIndex)
+    {
+        uint8_t b = static_cast<uint8_t>(frameIndex * 5);
+        uint8_t g = static_cast<uint8_t>(255 - frameIndex * 3);
+        uint8_t r = static_cast<uint8_t>(frameIndex * 11);
+        for (uint32_t y = box.Y; y < box.Y + box.Height; y++)
+        {
+            uint8_t* px = dst + y * stride + static_cast<size_t>(box.X) * 4;
+            for (uint32_t x = 0; x < box.Width; x++, px += 4)
+            {
+                px[0] = b;
+                px[1] = g;
+                px[2] = r;
+                px[3] = 255;
+            }
+        }
+    }
+}
+
+SyntheticCaptureSource::SyntheticCaptureSource(
+    SyntheticSourceConfig const& config,
+    CaptureStats* stats,
+    FrameDispatcher* dispatcher) :
+    m_config(config),
+    m_stats(stats),
+    m_dispatcher(dispatcher),
+    m_free(BoundedFrameQueue<Buffer*>::MaxDepth * 2 + 8),
+    m_queue(config.QueueDepth, config.Policy)
+{
+    std::sort(m_config.Resizes.begin(), m_config.Resizes.end(),
+        [](SyntheticResize const& a, SyntheticResize const& b) { return a.AtFrame < b.AtFrame; });
+
+    uint32_t poolBuffers = m_config.PoolBuffers;
+    if (poolBuffers == 0)
+        poolBuffers = std::min(m_config.QueueDepth, BoundedFrameQueue<Buffer*>::MaxDepth) + 4;
+    poolBuffers = std::min<uint32_t>(poolBuffers, static_cast<uint32_t>(m_free.Capacity()));
+    for (uint32_t i = 0; i < poolBuffers; i++)
+    {
+        m_buffers.push_back(std::make_unique<Buffer>());
+        m_free.TryPush(m_buffers.back().get());
+    }
+    m_spare.reserve(poolBuffers);
+
+    m_width = m_config.Width;
+    m_height = m_config.Height;
+    m_resize = ResizeCoalescer(m_config.ResizeSettle, m_config.ResizeMaxDelay);
+    m_pool = m_resize.Reset({ m_width, m_height });
+    m_sourceSize.store(static_cast<uint64_t>(m_width) << 32 | m_height, std::memory_order_relaxed);
+}
+
+void SyntheticCaptureSource::StartCapture()
+{
+    if (m_closed.load() || m_config.FrameRate <= 0 || m_thread.joinable())
+        return;
+    m_stop = false;
+    m_thread = std::thread([this] { ProducerLoop(); });
+}
+
+void SyntheticCaptureSource::Close()
+{
+    auto expected = false;
+    if (!m_closed.compare_exchange_strong(expected, true))
+        return;
+    m_stop = true;
+    if (m_thread.joinable())
+        m_thread.join();
+    m_queue.Clear();
+}
+
+SyntheticCaptureSource::Buffer* SyntheticCaptureSource::TakeFrame()
+{
+    if (m_config.FrameRate <= 0)
+        ProduceFrame();
+
+    Buffer* buffer = nullptr;
+    auto recycle = [this](Buffer*&& dropped) { m_free.TryPush(dropped); };
+    bool decimated = false;
+    for (;;)
+    {
+        if (!m_queue.Pop(buffer, recycle))
+        {
+            if (m_stats != nullptr && !decimated)
+                m_stats->AddNullFrame();
+            return nullptr;
+        }
+        if (m_pacer.Admit(buffer->FrameTime))
+        {
+            buffer->AcquireTimeNs = ToTimestampNs(FramePacer::Clock::now());
+            return buffer;
+        }
+        // Over the target rate: recycle the frame before anyone reads it.
+        m_free.TryPush(buffer);
+        decimated = true;
+        if (m_stats != nullptr)
+            m_stats->AddDecimated();
+    }
+}
+
+void SyntheticCaptureSource::IssueCopy()
+{
+    if (m_closed.load() || m_config.ReadbackLatency.count() <= 0 || m_copying != nullptr)
+        return;
+    m_copying = TakeFrame();
+    m_copyDone = std::chrono::steady_clock::now() + m_config.ReadbackLatency;
+}
+
+bool SyntheticCaptureSource::AcquireFrame(MappedSlot& frame)
+{
+    m_mapPending = false;
+    if (m_closed.load())
+        return false;
+
+    Buffer* buffer = nullptr;
+    if (m_config.ReadbackLatency.count() <= 0)
+    {
+        buffer = TakeFrame();
+    }
+    else
+    {
+        IssueCopy();
+        if (m_copying == nullptr)
+            return false;
+        if (std::chrono::steady_clock::now() < m_copyDone)
+        {
+            if (m_nonBlocking)
+            {
+                m_mapPending = true;
+                return false;
+            }
+            std::this_thread::sleep_until(m_copyDone);
+        }
+        buffer = m_copying;
+        m_copying = nullptr;
+    }
+    if (buffer == nullptr)
+        return false;
+
+    frame.Data = buffer->Pixels.data();
+    frame.RowPitch = RowPitchFor(buffer->Pool.Width);
+    frame.Desc.Width = buffer->Width;
+    frame.Desc.Height = buffer->Height;
+    frame.Desc.Format = SourceFormatBgra8;
+    frame.FrameIndex = buffer->FrameIndex;
+    frame.CaptureTimeNs = buffer->CaptureTimeNs;
+    frame.AcquireTimeNs = buffer->AcquireTimeNs;
+    m_acquired.push_back(buffer);
+    m_lastAcquired = buffer->FrameIndex;
+    m_lastAcquiredSize = { buffer->SourceWidth, buffer->SourceHeight };
+    return true;
+}
+
+void SyntheticCaptureSource::ReleaseFrame(MappedSlot const& frame)
+{
+    for (auto it = m_acquired.begin(); it != m_acquired.end(); ++it)
+    {
+        if ((*it)->FrameIndex == frame.FrameIndex)
+        {
+            m_free.TryPush(*it);
+            m_acquired.erase(it);
+            return;
+        }
+    }
+}
+
+SourceSize SyntheticCaptureSource::GetSourceSize()
+{
+    uint64_t packed = m_sourceSize.load(std::memory_order_relaxed);
+    SourceSize size;
+    size.Width = static_cast<uint32_t>(packed >> 32);
+    size.Height = static_cast<uint32_t>(packed);
+    return size;
+}
+
+bool SyntheticCaptureSource::SetTargetFrameRate(double fps)
+{
+    m_pacer.SetTargetFrameRate(fps);
+    return true;
+}
+
+bool SyntheticCaptureSource::GetCursor(CursorSample& cursor)
+{
+    if (!m_config.Cursor)
+        return false;
+    cursor = CursorFor(m_lastAcquiredSize.Width, m_lastAcquiredSize.Height, m_lastAcquired);
+    return true;
+}
+
+CursorSample SyntheticCaptureSource::CursorFor(uint32_t width, uint32_t height, uint64_t frameIndex)
+{
+    // A 12x19 arrow: black outline, white inside, and one inverting pixel at
+    // the tip so the invert path is exercised too.
+    static const std::shared_ptr<const CursorShape> arrow = []
+    {
+        constexpr uint32_t w = 12;
+        constexpr uint32_t h = 19;
+        std::vector<uint32_t> andMask(w * h, 0xFFFFFF);
+        std::vector<uint32_t> xorMask(w * h, 0);
+        for (uint32_t y = 0; y < h; y++)
+        {
+            uint32_t span = y < 12 ? y + 1 : 12 - (y - 11);
+            for (uint32_t x = 0; x < span && x < w; x++)
+            {
+                bool edge = x == 0 || x + 1 == span || y == h - 1;
+                andMask[y * w + x] = 0;
+                xorMask[y * w + x] = edge ? 0 : 0xFFFFFF;
+            }
+        }
+        xorMask[0] = 0xFFFFFF;
+        andMask[0] = 0xFFFFFF;
+        return std::make_shared<const CursorShape>(MakeMonochromeCursor(w, h, 0, 0, andMask.data(), xorMask.data()));
+    }();
+
+    CursorSample cursor;
+    cursor.Visible = width > 0 && height > 0;
+    cursor.X = width > 0 ? static_cast<int32_t>((frameIndex * 13) % width) : 0;
+    cursor.Y = height > 0 ? static_cast<int32_t>((frameIndex * 5) % height) : 0;
+    cursor.Shape = arrow;
+    return cursor;
+}
+
+void SyntheticCaptureSource::RenderFrame(uint8_t* dst, size_t stride, uint32_t width, uint32_t height, uint32_t boxSize, uint64_t frameIndex)
+{
+    FillBackground(dst, stride, 0, 0, width, height);
+    FillBox(dst, stride, BoxFor(width, height, boxSize, frameIndex), frameIndex);
+}
+
+void SyntheticCaptureSource::ProduceFrame()
+{
+    while (m_nextResize < m_config.Resizes.size() && m_config.Resizes[m_nextResize].AtFrame <= m_produced)
+    {
+        auto const& resize = m_config.Resizes[m_nextResize++];
+        if (resize.Width == m_width && resize.Height == m_height)
+            continue;
+        m_width = resize.Width;
+        m_height = resize.Height;
+        m_sourceSize.store(static_cast<uint64_t>(m_width) << 32 | m_height, std::memory_order_relaxed);
+        if (m_stats != nullptr)
+            m_stats->AddResizeEvent();
+    }
+
+    uint64_t frameIndex = m_produced++;
+    double rate = m_config.FrameRate > 0 ? m_config.FrameRate : 60;
+    auto now = ResizeCoalescer::Clock::time_point(std::chrono::duration_cast<ResizeCoalescer::Clock::duration>(
+        std::chrono::duration<double>(frameIndex / rate)));
+    m_resize.Observe({ m_width, m_height }, now);
+    SourceSize pool;
+    if (m_resize.Poll(now, pool))
+    {
+        m_pool = pool;
+        m_poolResizes.fetch_add(1, std::memory_order_relaxed);
+        if (m_stats != nullptr)
+            m_stats->AddResize();
+    }
+
+    Buffer* buffer = nullptr;
+    if (!m_spare.empty())
+    {
+        buffer = m_spare.back();
+        m_spare.pop_back();
+    }
+    else if (!m_free.TryPop(buffer))
+    {
+        m_starved.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Render(*buffer, frameIndex);
+    buffer->FrameTime = now;
+    buffer->CaptureTimeNs = ToTimestampNs(FramePacer::Clock::now());
+    auto reuse = [this](Buffer*&& superseded) { m_spare.push_back(superseded); };
+    if (!m_queue.Push(buffer, reuse))
+    {
+        // Rejected by a full Fifo queue; the buffer never left this thread.
+        m_spare.push_back(buffer);
+        return;
+    }
+    if (m_dispatcher != nullptr)
+        m_dispatcher->Notify();
+}
+
+void SyntheticCaptureSource::ProducerLoop()
+{
+    using Clock = std::chrono::steady_clock;
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_config.FrameRate));
+    auto next = Clock::now();
+    while (!m_stop.load())
+    {
+        ProduceFrame();
+        next += period;
+        auto now = Clock::now();
+        if (next < now)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void SyntheticCaptureSource::Render(Buffer& buffer, uint64_t frameIndex)
+{
+    // Pool buffers are sized for the pool, so they survive every source size
+    // change that doesn't recreate it.
+    size_t stride = RowPitchFor(m_pool.Width);
+    if (buffer.Pool.Width != m_pool.Width || buffer.Pool.Height != m_pool.Height)
+    {
+        if (buffer.Pixels.capacity() < stride * m_pool.Height)
+            m_allocations.fetch_add(1, std::memory_order_relaxed);
+        buffer.Pixels.resize(stride * m_pool.Height);
+        buffer.Pool = m_pool;
+        buffer.Drawn = false;
+    }
+
+    uint32_t width = std::min(m_width, m_pool.Width);
+    uint32_t height = std::min(m_height, m_pool.Height);
+    Box box = ClipBox(BoxFor(m_width, m_height, m_config.BoxSize, frameIndex), width, height);
+    if (!buffer.Drawn || buffer.SourceWidth != m_width || buffer.SourceHeight != m_height)
+    {
+        buffer.Width = width;
+        buffer.Height = height;
+        buffer.SourceWidth = m_width;
+        buffer.SourceHeight = m_height;
+        FillBackground(buffer.Pixels.data(), stride, 0, 0, width, height);
+        buffer.Drawn = true;
+    }
+    else
+    {
+        // Only the square moves: put back the background where it was drawn
+        // the last time this buffer was used.
+        Box old = ClipBox(BoxFor(m_width, m_height, m_config.BoxSize, buffer.FrameIndex), width, height);
+        FillBackground(buffer.Pixels.data(), stride, old.X, old.Y, old.Width, old.Height);
+    }
+    FillBox(buffer.Pixels.data(), stride, box, frameIndex);
+    buffer.FrameIndex = frameIndex;
+}
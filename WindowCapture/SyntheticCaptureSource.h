@@ -0,0 +1,160 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "CaptureStats.h"
+#include "FrameDispatcher.h"
+#include "FrameQueue.h"
+#include "ICaptureSource.h"
+#include "ResizeCoalescer.h"
+#include "SpscRing.h"
+
+struct SyntheticResize
+{
+    uint64_t AtFrame = 0;       // index of the first frame produced at the new size
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+};
+
+struct SyntheticSourceConfig
+{
+    uint32_t Width = 1920;
+    uint32_t Height = 1080;
+    // Frames per second produced on a background thread, like a window being
+    // composed. 0 renders a new frame on demand in every AcquireFrame.
+    double FrameRate = 0;
+    std::vector<SyntheticResize> Resizes;
+    // Frames are rendered into a pool that follows the size like the capture
+    // frame pool does, through a ResizeCoalescer. Its clock is frame time:
+    // frame index over FrameRate, or over 60 when rendering on demand, so a
+    // schedule plays out the same however fast the consumer is. Pacing to a
+    // target frame rate runs on frame time too.
+    ResizeCoalescer::Clock::duration ResizeSettle = ResizeCoalescer::DefaultSettle;
+    ResizeCoalescer::Clock::duration ResizeMaxDelay = ResizeCoalescer::DefaultMaxDelay;
+    uint32_t QueueDepth = 1;
+    FramePolicy Policy = FramePolicy::LatestWins;
+    // Frame buffers in rotation, like the frame pool; 0 picks the queue depth
+    // plus room for the frames a consumer can hold. When all are in use the
+    // producer skips the frame.
+    uint32_t PoolBuffers = 0;
+    // Side of the square that moves each frame; the rest of the frame is static.
+    uint32_t BoxSize = 128;
+    // Report a monochrome arrow cursor that moves with the frame index.
+    bool Cursor = false;
+    // Stand in for the staging copy: a frame taken from the queue can only
+    // be mapped this long after, and AcquireFrame waits for it like Map does.
+    // 0 hands frames out at once.
+    std::chrono::microseconds ReadbackLatency{ 0 };
+};
+
+// Deterministic BGRA frames for driving CapturePipeline without a GPU or a
+// window. Each frame is a fixed gradient with a square whose position and color
+// depend only on the frame index, so any frame can be reproduced with
+// RenderFrame. Frames pass through the same BoundedFrameQueue as real ones.
+// While a resize settles, frames are clipped to the pool like captured ones:
+// they hold the top left of what RenderFrame draws at the source size.
+class SyntheticCaptureSource : public ICaptureSource
+{
+public:
+    explicit SyntheticCaptureSource(
+        SyntheticSourceConfig const& config,
+        CaptureStats* stats = nullptr,
+        FrameDispatcher* dispatcher = nullptr);
+    ~SyntheticCaptureSource() { Close(); }
+
+    SyntheticCaptureSource(SyntheticCaptureSource const&) = delete;
+    SyntheticCaptureSource& operator=(SyntheticCaptureSource const&) = delete;
+
+    void StartCapture() override;
+    void Close() override;
+    bool AcquireFrame(MappedSlot& frame) override;
+    void ReleaseFrame(MappedSlot const& frame) override;
+    SourceSize GetSourceSize() override;
+    bool SetTargetFrameRate(double fps) override;
+    bool GetCursor(CursorSample& cursor) override;
+
+    // With ReadbackLatency, start the copy of the next frame without waiting
+    // for it, as a batch does for all its sources before mapping any.
+    void IssueCopy();
+    // Have AcquireFrame return false rather than wait while the copy is in
+    // flight, MapPending telling the two apart, as the readback engine has
+    // SimpleCapture do.
+    void SetNonBlocking(bool nonBlocking) { m_nonBlocking = nonBlocking; }
+    bool MapPending() const { return m_mapPending; }
+
+    FrameQueueStats GetFrameQueueStats() { return m_queue.Stats(); }
+    // Frames the producer skipped because every buffer was in use.
+    uint64_t GetStarvedFrames() const { return m_starved.load(std::memory_order_relaxed); }
+    // Frame buffer (re)allocations so far, including the initial ones.
+    uint64_t GetAllocations() const { return m_allocations.load(std::memory_order_relaxed); }
+    // Pool recreations so far.
+    uint64_t GetPoolResizes() const { return m_poolResizes.load(std::memory_order_relaxed); }
+
+    // Render frame frameIndex of a width x height source from scratch.
+    static void RenderFrame(uint8_t* dst, size_t stride, uint32_t width, uint32_t height, uint32_t boxSize, uint64_t frameIndex);
+    // Where the cursor is while frame frameIndex of a width x height source is the newest.
+    static CursorSample CursorFor(uint32_t width, uint32_t height, uint64_t frameIndex);
+
+private:
+    struct Buffer
+    {
+        std::vector<uint8_t> Pixels;
+        uint32_t Width = 0;             // visible part of the source
+        uint32_t Height = 0;
+        uint32_t SourceWidth = 0;       // size the frame was rendered at
+        uint32_t SourceHeight = 0;
+        SourceSize Pool;
+        uint64_t FrameIndex = 0;
+        FramePacer::Clock::time_point FrameTime;
+        uint64_t CaptureTimeNs = 0;     // wall clock, for delivery latency
+        uint64_t AcquireTimeNs = 0;     // taken off the queue
+        bool Drawn = false;
+        uint32_t BoxX = 0;
+        uint32_t BoxY = 0;
+    };
+
+    void ProduceFrame();
+    // The next frame from the queue, after pacing; nullptr if there is none.
+    Buffer* TakeFrame();
+    void ProducerLoop();
+    void Render(Buffer& buffer, uint64_t frameIndex);
+
+    SyntheticSourceConfig m_config;
+    CaptureStats* m_stats = nullptr;
+    FrameDispatcher* m_dispatcher = nullptr;
+
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+    // Buffers the consumer has finished with, handed back to the producer.
+    SpscRing<Buffer*> m_free;
+    BoundedFrameQueue<Buffer*> m_queue;
+
+    // Consumer state: frames handed out and not yet released.
+    std::vector<Buffer*> m_acquired;
+    FramePacer m_pacer;
+    uint64_t m_lastAcquired = 0;
+    SourceSize m_lastAcquiredSize;
+    Buffer* m_copying = nullptr;        // in the simulated staging copy
+    std::chrono::steady_clock::time_point m_copyDone;
+    bool m_nonBlocking = false;
+    bool m_mapPending = false;
+
+    // Producer state. Buffers that never reached the consumer: rejected by a
+    // full Fifo queue, or superseded by a newer frame before it popped them.
+    std::vector<Buffer*> m_spare;
+    uint64_t m_produced = 0;
+    size_t m_nextResize = 0;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    ResizeCoalescer m_resize;
+    SourceSize m_pool;
+
+    std::atomic<uint64_t> m_sourceSize{ 0 };   // width << 32 | height
+    std::atomic<uint64_t> m_starved{ 0 };
+    std::atomic<uint64_t> m_allocations{ 0 };
+    std::atomic<uint64_t> m_poolResizes{ 0 };
+    std::atomic<bool> m_stop{ false };
+    std::atomic<bool> m_closed{ false };
+    std::thread m_thread;
+};
@@ -0,0 +1,146 @@
+#include "TileDiff.h"
+#include <algorithm>
+#include <cstring>
+#include "SimdTarget.h"
+
+namespace
+{
+    bool BytesEqual(const uint8_t* a, const uint8_t* b, size_t bytes)
+    {
+        size_t i = 0;
+#ifdef SIMD_X86
+        // SSE2 is baseline on every x86 target this builds for.
+        for (; i + 64 <= bytes; i += 64)
+        {
+            __m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+            __m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+            __m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 32)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 32)));
+            __m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 48)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 48)));
+            __m128i all = _mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3));
+            if (_mm_movemask_epi8(all) != 0xFFFF)
+                return false;
+        }
+#endif
+        return memcmp(a + i, b + i, bytes - i) == 0;
+    }
+}
+
+bool TileDiffer::Update(const uint8_t* frame, size_t stride, uint32_t width, uint32_t height)
+{
+    m_rects.clear();
+    m_openRects.clear();
+    m_dirtyTiles = 0;
+
+    bool sizeChanged = width != m_width || height != m_height || m_reference.empty();
+    if (sizeChanged)
+    {
+        m_width = width;
+        m_height = height;
+        m_reference.resize(static_cast<size_t>(width) * 4 * height);
+    }
+
+    for (uint32_t ty = 0; ty < height; ty += TileSize)
+    {
+        uint32_t th = (height - ty < TileSize) ? height - ty : TileSize;
+        m_nextOpenRects.clear();
+
+        uint32_t runStart = 0;
+        bool inRun = false;
+        for (uint32_t tx = 0; tx < width; tx += TileSize)
+        {
+            uint32_t tw = (width - tx < TileSize) ? width - tx : TileSize;
+            bool dirty = sizeChanged || !CompareTile(frame, stride, tx, ty, tw, th);
+            if (dirty)
+            {
+                StoreTile(frame, stride, tx, ty, tw, th);
+                m_dirtyTiles++;
+                if (!inRun)
+                {
+                    runStart = tx;
+                    inRun = true;
+                }
+            }
+            else if (inRun)
+            {
+                AddRun(runStart, ty, tx - runStart, th);
+                inRun = false;
+            }
+        }
+        if (inRun)
+            AddRun(runStart, ty, width - runStart, th);
+
+        m_openRects.swap(m_nextOpenRects);
+    }
+
+    m_identical = m_dirtyTiles == 0;
+    return m_identical;
+}
+
+void TileDiffer::MarkDirty(DirtyRect const& rect)
+{
+    if (rect.X >= m_width || rect.Y >= m_height || rect.Width == 0 || rect.Height == 0)
+        return;
+    DirtyRect clipped = rect;
+    clipped.Width = std::min(rect.Width, m_width - rect.X);
+    clipped.Height = std::min(rect.Height, m_height - rect.Y);
+    m_rects.push_back(clipped);
+    m_identical = false;
+}
+
+void TileDiffer::Reset()
+{
+    m_reference.clear();
+    m_width = 0;
+    m_height = 0;
+    m_identical = false;
+    m_dirtyTiles = 0;
+    m_rects.clear();
+}
+
+bool TileDiffer::CompareTile(const uint8_t* frame, size_t stride, uint32_t x, uint32_t y, uint32_t w, uint32_t h) const
+{
+    size_t refStride = static_cast<size_t>(m_width) * 4;
+    const uint8_t* src = frame + y * stride + static_cast<size_t>(x) * 4;
+    const uint8_t* ref = m_reference.data() + y * refStride + static_cast<size_t>(x) * 4;
+    for (uint32_t row = 0; row < h; row++, src += stride, ref += refStride)
+    {
+        if (!BytesEqual(src, ref, static_cast<size_t>(w) * 4))
+            return false;
+    }
+    return true;
+}
+
+void TileDiffer::StoreTile(const uint8_t* frame, size_t stride, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    size_t refStride = static_cast<size_t>(m_width) * 4;
+    const uint8_t* src = frame + y * stride + static_cast<size_t>(x) * 4;
+    uint8_t* ref = m_reference.data() + y * refStride + static_cast<size_t>(x) * 4;
+    for (uint32_t row = 0; row < h; row++, src += stride, ref += refStride)
+        memcpy(ref, src, static_cast<size_t>(w) * 4);
+}
+
+void TileDiffer::AddRun(uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    for (auto index : m_openRects)
+    {
+        auto& rect = m_rects[index];
+        if (rect.X == x && rect.Width == w && rect.Y + rect.Height == y)
+        {
+            rect.Height += h;
+            m_nextOpenRects.push_back(index);
+            return;
+        }
+    }
+
+    DirtyRect rect;
+    rect.X = x;
+    rect.Y = y;
+    rect.Width = w;
+    rect.Height = h;
+    m_nextOpenRects.push_back(m_rects.size());
+    m_rects.push_back(rect);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct DirtyRect
+{
+    uint32_t X = 0;
+    uint32_t Y = 0;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+};
+
+// Tile based change detection over BGRA frames. Each frame is compared against
+// a private copy of the previous one in TileSize x TileSize blocks; only tiles
+// that changed are copied into the reference, so a static frame costs one read
+// of each buffer and no writes.
+class TileDiffer
+{
+public:
+    static constexpr uint32_t TileSize = 64;
+
+    // Compare frame against the previous one. Returns true when every tile is
+    // unchanged. A size change, or the first frame, marks the whole frame dirty.
+    bool Update(const uint8_t* frame, size_t stride, uint32_t width, uint32_t height);
+
+    // Report rect as changed on top of what the last Update found, for
+    // drawing done after the comparison. It may overlap other rects.
+    void MarkDirty(DirtyRect const& rect);
+
+    // Forget the reference frame; the next Update reports a full frame.
+    void Reset();
+
+    bool Identical() const noexcept { return m_identical; }
+    uint32_t DirtyTileCount() const noexcept { return m_dirtyTiles; }
+
+    // Dirty tiles merged into rectangles: runs along a tile row first, then
+    // runs with the same span on consecutive tile rows. Clipped to the frame.
+    std::vector<DirtyRect> const& DirtyRects() const noexcept { return m_rects; }
+
+private:
+    bool CompareTile(const uint8_t* frame, size_t stride, uint32_t x, uint32_t y, uint32_t w, uint32_t h) const;
+    void StoreTile(const uint8_t* frame, size_t stride, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+    void AddRun(uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+    std::vector<uint8_t> m_reference;
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    bool m_identical = false;
+    uint32_t m_dirtyTiles = 0;
+    std::vector<DirtyRect> m_rects;
+    // Rects that end on the previous tile row and can still grow downwards.
+    std::vector<size_t> m_openRects;
+    std::vector<size_t> m_nextOpenRects;
+};
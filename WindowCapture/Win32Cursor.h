@@ -0,0 +1,115 @@
+#pragma once
+#include <dwmapi.h>
+#include "CursorCompositor.h"
+
+// Reads the cursor for a captured window: position from GetCursorInfo, which
+// is cheap enough to call per frame, and the shape through GetIconInfo and
+// GetDIBits only the first time a cursor handle is seen.
+class Win32CursorTracker
+{
+public:
+    explicit Win32CursorTracker(HWND window) : m_window(window) {}
+
+    // Cursor relative to the window's captured area, which for windows is the
+    // DWM frame bounds (the visible window without its drop shadow).
+    bool Sample(CursorSample& sample)
+    {
+        sample = CursorSample();
+        CURSORINFO info = { sizeof(info) };
+        if (!::GetCursorInfo(&info))
+            return false;
+        if ((info.flags & CURSOR_SHOWING) == 0 || info.hCursor == nullptr)
+            return true;
+
+        RECT bounds;
+        if (m_window == nullptr ||
+            FAILED(::DwmGetWindowAttribute(m_window, DWMWA_EXTENDED_FRAME_BOUNDS, &bounds, sizeof(bounds))))
+            return false;
+
+        auto handle = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(info.hCursor));
+        auto shape = m_shapes.Find(handle);
+        if (!shape)
+        {
+            CursorShape loaded;
+            if (!LoadShape(info.hCursor, loaded))
+                return false;
+            shape = m_shapes.Insert(handle, std::move(loaded));
+        }
+
+        sample.Visible = true;
+        sample.X = info.ptScreenPos.x - bounds.left;
+        sample.Y = info.ptScreenPos.y - bounds.top;
+        sample.Shape = shape;
+        return true;
+    }
+
+    CursorShapeCache const& Shapes() const { return m_shapes; }
+
+private:
+    static bool ReadBitmap(HBITMAP bitmap, uint32_t width, uint32_t height, std::vector<uint32_t>& pixels)
+    {
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+        bmi.bmiHeader.biWidth = static_cast<LONG>(width);
+        bmi.bmiHeader.biHeight = -static_cast<LONG>(height);    // top-down
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        pixels.assign(static_cast<size_t>(width) * height, 0);
+
+        HDC dc = ::GetDC(nullptr);
+        int lines = ::GetDIBits(dc, bitmap, 0, height, pixels.data(), &bmi, DIB_RGB_COLORS);
+        ::ReleaseDC(nullptr, dc);
+        return lines == static_cast<int>(height);
+    }
+
+    static bool LoadShape(HCURSOR cursor, CursorShape& shape)
+    {
+        ICONINFO icon = {};
+        if (!::GetIconInfo(cursor, &icon))
+            return false;
+
+        bool loaded = false;
+        BITMAP mask = {};
+        if (icon.hbmMask != nullptr && ::GetObject(icon.hbmMask, sizeof(mask), &mask) != 0)
+        {
+            auto width = static_cast<uint32_t>(mask.bmWidth);
+            auto height = static_cast<uint32_t>(mask.bmHeight);
+            auto hotspotX = static_cast<int32_t>(icon.xHotspot);
+            auto hotspotY = static_cast<int32_t>(icon.yHotspot);
+            std::vector<uint32_t> maskPixels;
+            std::vector<uint32_t> colorPixels;
+            if (icon.hbmColor == nullptr)
+            {
+                // Monochrome: the AND mask on top of the XOR mask in one bitmap.
+                if (ReadBitmap(icon.hbmMask, width, height, maskPixels))
+                {
+                    height /= 2;
+                    shape = MakeMonochromeCursor(width, height, hotspotX, hotspotY,
+                        maskPixels.data(), maskPixels.data() + static_cast<size_t>(width) * height);
+                    loaded = true;
+                }
+            }
+            else if (ReadBitmap(icon.hbmColor, width, height, colorPixels) &&
+                ReadBitmap(icon.hbmMask, width, height, maskPixels))
+            {
+                bool hasAlpha = false;
+                for (auto pixel : colorPixels)
+                    hasAlpha |= (pixel >> 24) != 0;
+                shape = hasAlpha ?
+                    MakeAlphaCursor(width, height, hotspotX, hotspotY, colorPixels.data()) :
+                    MakeMaskedCursor(width, height, hotspotX, hotspotY, colorPixels.data(), maskPixels.data());
+                loaded = true;
+            }
+        }
+
+        if (icon.hbmMask != nullptr)
+            ::DeleteObject(icon.hbmMask);
+        if (icon.hbmColor != nullptr)
+            ::DeleteObject(icon.hbmColor);
+        return loaded;
+    }
+
+    HWND m_window;
+    CursorShapeCache m_shapes;
+};
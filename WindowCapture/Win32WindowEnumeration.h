@@ -3,6 +3,9 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <future>
+#include <thread>
+#include "WindowRegistry.h"
 struct Window
 {
 public:
@@ -44,55 +47,186 @@ std::wstring GetWindowText(HWND hwnd)
     return title;
 }
 
-bool IsAltTabWindow(Window const& window)
+// Attributes of top level windows, straight from user32 and DWM.
+class Win32WindowSource : public IWindowSource
 {
-    HWND hwnd = window.Hwnd();
-    HWND shellWindow = GetShellWindow();
+public:
+    static HWND ToHwnd(uint64_t handle) { return reinterpret_cast<HWND>(static_cast<uintptr_t>(handle)); }
+    static uint64_t ToHandle(HWND hwnd) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(hwnd)); }
 
-    auto title = window.Title();
-    auto className = window.ClassName();
+    void Enumerate(std::vector<uint64_t>& handles) override
+    {
+        handles.clear();
+        ::EnumWindows([](HWND hwnd, LPARAM lParam) -> BOOL
+            {
+                reinterpret_cast<std::vector<uint64_t>*>(lParam)->push_back(ToHandle(hwnd));
+                return TRUE;
+            }, reinterpret_cast<LPARAM>(&handles));
+    }
 
-    if (hwnd == shellWindow)
+    bool Read(uint64_t handle, WindowInfo& info) override
     {
-        return false;
+        HWND hwnd = ToHwnd(handle);
+        if (!ReadState(handle, info))
+            return false;
+        DWORD processId = 0;
+        if (::GetWindowThreadProcessId(hwnd, &processId) == 0)
+            return false;
+        // Class names are at most 256 characters.
+        WCHAR className[257];
+        int length = ::GetClassNameW(hwnd, className, ARRAYSIZE(className));
+        info.Handle = handle;
+        info.ProcessId = processId;
+        info.ClassName.assign(className, length > 0 ? static_cast<size_t>(length) : 0);
+        return ReadTitle(handle, info.Title);
     }
 
-    if (title.length() == 0)
+    bool ReadTitle(uint64_t handle, std::wstring& title) override
     {
-        return false;
+        HWND hwnd = ToHwnd(handle);
+        // Sized to the title rather than a fixed buffer; the length may run
+        // long, never short.
+        int length = ::GetWindowTextLengthW(hwnd);
+        title.resize(length > 0 ? static_cast<size_t>(length) : 0);
+        if (length > 0)
+            length = ::GetWindowTextW(hwnd, &title[0], length + 1);
+        title.resize(length > 0 ? static_cast<size_t>(length) : 0);
+        return ::IsWindow(hwnd) != FALSE;
     }
 
-    if (!IsWindowVisible(hwnd))
+    bool ReadState(uint64_t handle, WindowInfo& info) override
     {
-        return false;
+        HWND hwnd = ToHwnd(handle);
+        if (!::IsWindow(hwnd) || ::GetAncestor(hwnd, GA_PARENT) != ::GetDesktopWindow())
+            return false;
+        info.Style = static_cast<uint32_t>(::GetWindowLongW(hwnd, GWL_STYLE));
+        info.ExStyle = static_cast<uint32_t>(::GetWindowLongW(hwnd, GWL_EXSTYLE));
+        info.Visible = ::IsWindowVisible(hwnd) != FALSE;
+        info.Root = ::GetAncestor(hwnd, GA_ROOT) == hwnd;
+        info.Shell = hwnd == ::GetShellWindow();
+        DWORD cloaked = FALSE;
+        info.Cloaked = SUCCEEDED(::DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked))) && cloaked;
+        return true;
     }
+};
+
+// Keeps a WindowRegistry current from WinEvents on a thread of its own, which
+// out of context hooks need for their message loop.
+class Win32WindowWatcher
+{
+public:
+    explicit Win32WindowWatcher(WindowRegistry& registry) : m_registry(registry) {}
+    ~Win32WindowWatcher() { Stop(); }
 
-    if (GetAncestor(hwnd, GA_ROOT) != hwnd)
+    Win32WindowWatcher(Win32WindowWatcher const&) = delete;
+    Win32WindowWatcher& operator=(Win32WindowWatcher const&) = delete;
+
+    // Hook window events, then fill the registry, so nothing that happens in
+    // between is missed.
+    bool Start()
     {
-        return false;
+        Stop();
+        std::promise<bool> started;
+        auto result = started.get_future();
+        m_thread = std::thread([this, &started] { Run(started); });
+        if (!result.get())
+        {
+            m_thread.join();
+            return false;
+        }
+        return true;
     }
 
-    LONG style = GetWindowLong(hwnd, GWL_STYLE);
-    if (!((style & WS_DISABLED) != WS_DISABLED))
+    void Stop()
     {
-        return false;
+        if (!m_thread.joinable())
+            return;
+        ::PostThreadMessageW(m_threadId, WM_QUIT, 0, 0);
+        m_thread.join();
     }
-    LONG styles = (DWORD)GetWindowLongPtr(hwnd, GWL_STYLE);
-    LONG ex_styles = (DWORD)GetWindowLongPtr(hwnd, GWL_EXSTYLE);
-    if (ex_styles & WS_EX_TOOLWINDOW)
-        return false;
-    if (styles & WS_CHILD)
-        return false;
 
-    DWORD cloaked = FALSE;
-    HRESULT hrTemp = DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked, sizeof(cloaked));
-    if (SUCCEEDED(hrTemp) && cloaked)
+private:
+    void Run(std::promise<bool>& started)
     {
-        return false;
+        // The callback has no context argument; it runs on this thread.
+        t_registry = &m_registry;
+        m_threadId = ::GetCurrentThreadId();
+        MSG msg;
+        ::PeekMessageW(&msg, nullptr, WM_USER, WM_USER, PM_NOREMOVE);
+
+        // Separate ranges, to stay clear of the location and focus events in
+        // between, which fire far too often to be worth the context switches.
+        const DWORD ranges[][2] = {
+            { EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE },
+            { EVENT_OBJECT_STATECHANGE, EVENT_OBJECT_STATECHANGE },
+            { EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE },
+            { EVENT_OBJECT_PARENTCHANGE, EVENT_OBJECT_PARENTCHANGE },
+            { EVENT_OBJECT_CLOAKED, EVENT_OBJECT_UNCLOAKED },
+        };
+        // The host's own windows are enumerated along with everyone else's,
+        // so their events are wanted too: no WINEVENT_SKIPOWNPROCESS.
+        std::vector<HWINEVENTHOOK> hooks;
+        for (auto const& range : ranges)
+        {
+            HWINEVENTHOOK hook = ::SetWinEventHook(range[0], range[1], nullptr, OnWinEvent, 0, 0,
+                WINEVENT_OUTOFCONTEXT);
+            if (hook != nullptr)
+                hooks.push_back(hook);
+        }
+        if (hooks.size() != ARRAYSIZE(ranges))
+        {
+            for (auto hook : hooks)
+                ::UnhookWinEvent(hook);
+            started.set_value(false);
+            return;
+        }
+        m_registry.Refresh();
+        started.set_value(true);
+
+        while (::GetMessageW(&msg, nullptr, 0, 0) > 0)
+        {
+            ::TranslateMessage(&msg);
+            ::DispatchMessageW(&msg);
+        }
+        for (auto hook : hooks)
+            ::UnhookWinEvent(hook);
+        t_registry = nullptr;
+    }
+
+    static void CALLBACK OnWinEvent(HWINEVENTHOOK, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD, DWORD)
+    {
+        if (t_registry == nullptr || hwnd == nullptr || idObject != OBJID_WINDOW || idChild != CHILDID_SELF)
+            return;
+        WindowEvent windowEvent;
+        switch (event)
+        {
+        case EVENT_OBJECT_CREATE: windowEvent = WindowEvent::Created; break;
+        case EVENT_OBJECT_DESTROY: windowEvent = WindowEvent::Destroyed; break;
+        case EVENT_OBJECT_SHOW: windowEvent = WindowEvent::Shown; break;
+        case EVENT_OBJECT_HIDE: windowEvent = WindowEvent::Hidden; break;
+        case EVENT_OBJECT_NAMECHANGE: windowEvent = WindowEvent::TitleChanged; break;
+        default: windowEvent = WindowEvent::StateChanged; break;
+        }
+        t_registry->OnEvent(windowEvent, Win32WindowSource::ToHandle(hwnd));
     }
 
-    return true;
+    static inline thread_local WindowRegistry* t_registry = nullptr;
+
+    WindowRegistry& m_registry;
+    std::thread m_thread;
+    DWORD m_threadId = 0;
+};
+
+bool IsAltTabWindow(Window const& window)
+{
+    Win32WindowSource source;
+    WindowInfo info;
+    if (!source.ReadState(Win32WindowSource::ToHandle(window.Hwnd()), info))
+        return false;
+    info.Title = window.Title();
+    return IsAltTabWindow(info);
 }
+
 BOOL CALLBACK EnumWindowsProc(HWND hwnd, LPARAM lParam)
 {
     auto class_name = GetClassName(hwnd);
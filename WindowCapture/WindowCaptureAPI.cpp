@@ -1,7 +1,13 @@
 #include "pch.h"
 #include "Win32WindowEnumeration.h"
 #include "App.h"
+#include "BatchCopier.h"
+#include "CaptureBenchmark.h"
+#include "CaptureManager.h"
+#include "FrameBufferPool.h"
 #include "WindowCaptureAPI.h"
+#include <algorithm>
+#include <unordered_set>
 
 using namespace winrt;
 using namespace Windows::UI;
@@ -13,27 +19,39 @@ typedef struct
     HWND	WindowHandle;
     UINT	Width;
     UINT	Height;
-    bool    capture_cursor;//TODO
-    bool    cursor_visible;//TODO
+    bool    capture_cursor;     // cursor blended into copies
+    bool    cursor_visible;     // as of the last copy
+    ConvertParams convert;
     std::shared_ptr<App> m_APP;
+    void*   manager;            // WNDCAP_MANAGER_STRUCT for sessions, else nullptr
+    uint32_t session_id;
+    void*   trace;              // WNDCAP_TRACE_STRUCT it records to, else nullptr
+    std::unique_ptr<FrameBufferPool> buffers;
 } WNDCAP_HANDLE_STRUCT;
 
-// Direct3D11CaptureFramePool requires a DispatcherQueue
-auto CreateDispatcherQueueController()
+typedef struct
 {
-    namespace abi = ABI::Windows::System;
+    std::unique_ptr<CaptureManager> manager;
+    std::mutex lock;
+    std::unordered_map<uint32_t, WNDCAP_HANDLE_STRUCT*> sessions;
+} WNDCAP_MANAGER_STRUCT;
 
-    DispatcherQueueOptions options
-    {
-        sizeof(DispatcherQueueOptions),
-        DQTYPE_THREAD_CURRENT,
-        DQTAT_COM_STA
-    };
+typedef struct
+{
+    FrameTraceWriter writer;
+    std::unordered_set<WNDCAP_HANDLE_STRUCT*> handles;
+} WNDCAP_TRACE_STRUCT;
 
-    Windows::System::DispatcherQueueController controller{ nullptr };
-    check_hresult(CreateDispatcherQueueController(options, reinterpret_cast<abi::IDispatcherQueueController**>(put_abi(controller))));
-    return controller;
-}
+// Guards every trace's handles and every handle's trace, which point at each
+// other: a handle switching traces and a trace being closed touch both.
+static std::mutex g_traceLock;
+
+typedef struct WNDCAP_WINDOWS_STRUCT
+{
+    Win32WindowSource source;
+    WindowRegistry registry{ source };
+    Win32WindowWatcher watcher{ registry };
+} WNDCAP_WINDOWS_STRUCT;
 
 DesktopWindowTarget CreateDesktopWindowTarget(Compositor const& compositor, HWND window)
 {
@@ -53,6 +71,12 @@ WNDCAP_HANDLE InitWndCap(HWND WindowHandle)
     wndcap->WindowHandle = WindowHandle;
     wndcap->Width = 0;
     wndcap->Height = 0;
+    wndcap->capture_cursor = true;
+    wndcap->cursor_visible = false;
+    wndcap->manager = nullptr;
+    wndcap->session_id = 0;
+    wndcap->trace = nullptr;
+    wndcap->buffers = std::make_unique<FrameBufferPool>();
 
     wndcap->m_APP = std::make_shared<App>();
     // Init COM
@@ -76,6 +100,14 @@ bool UninitWndCap(WNDCAP_HANDLE wndcap_handle)
     WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
     if (wndcap == nullptr)
         return false;
+    SetFrameTrace(wndcap_handle, nullptr, nullptr);
+    if (wndcap->manager != nullptr)
+    {
+        auto owner = reinterpret_cast<WNDCAP_MANAGER_STRUCT*>(wndcap->manager);
+        std::lock_guard<std::mutex> lock(owner->lock);
+        owner->sessions.erase(wndcap->session_id);
+        owner->manager->RemoveSession(wndcap->session_id);
+    }
     delete wndcap;
     return true;
 }
@@ -94,13 +126,1124 @@ bool WindowCapture(WNDCAP_HANDLE wndcap_handle, unsigned char* buf, unsigned int
     if (wndcap == nullptr)
         return false;
 
-    bool ret = wndcap->m_APP->CopyImage(buf);
-    winrt::Windows::Graphics::SizeInt32 frameSize = wndcap->m_APP->GetFrameSize();
-    uiWidth = frameSize.Width;
-    uiHeight = frameSize.Height;
+    if (wndcap->capture_cursor == bSkipMouse)
+    {
+        wndcap->capture_cursor = !bSkipMouse;
+        wndcap->m_APP->SetDrawCursor(wndcap->capture_cursor);
+    }
+
+    // Report the size actually copied, which differs from the window size
+    // once SetCaptureRegion is in effect.
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool ret = wndcap->m_APP->CopyImage(buf, SIZE_MAX, 0, width, height) == CopyResult::Ok;
+    CursorState cursor;
+    if (ret && wndcap->m_APP->GetCursorState(cursor))
+        wndcap->cursor_visible = cursor.Visible;
+    bMouseVisible = wndcap->cursor_visible;
+    if (!ret)
+    {
+        winrt::Windows::Graphics::SizeInt32 frameSize = wndcap->m_APP->GetFrameSize();
+        width = frameSize.Width;
+        height = frameSize.Height;
+    }
+    uiWidth = width;
+    uiHeight = height;
     return ret;
 }
 
+WNDCAP_RESULT WindowCaptureEx(WNDCAP_HANDLE wndcap_handle, unsigned char* buf, unsigned long long buf_size, unsigned int dst_stride, unsigned int& uiWidth, unsigned int& uiHeight)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || (buf == nullptr && buf_size != 0))
+        return WNDCAP_INVALID_ARG;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    auto result = wndcap->m_APP->CopyImage(buf, static_cast<size_t>(buf_size), dst_stride, width, height);
+    if (result == CopyResult::NoFrame)
+        return WNDCAP_NO_FRAME;
+    uiWidth = width;
+    uiHeight = height;
+    if (result == CopyResult::BufferTooSmall)
+        return WNDCAP_BUFFER_TOO_SMALL;
+    wndcap->Width = width;
+    wndcap->Height = height;
+    return WNDCAP_OK;
+}
+
+namespace
+{
+    class AppBatchJob : public IBatchJob
+    {
+    public:
+        AppBatchJob(WNDCAP_HANDLE_STRUCT* wndcap, WNDCAP_BATCH_OUTPUT* output) : m_wndcap(wndcap), m_output(output) {}
+
+        void Submit() override { m_wndcap->m_APP->SubmitBatch(); }
+
+        bool Collect() override
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            CopyResult result;
+            if (!m_wndcap->m_APP->CollectBatch(m_output->buf, static_cast<size_t>(m_output->buf_size), m_output->dst_stride, width, height, result))
+                return false;
+            if (result == CopyResult::NoFrame)
+            {
+                m_output->result = WNDCAP_NO_FRAME;
+                return true;
+            }
+            m_output->width = width;
+            m_output->height = height;
+            if (result == CopyResult::BufferTooSmall)
+            {
+                m_output->result = WNDCAP_BUFFER_TOO_SMALL;
+                return true;
+            }
+            m_wndcap->Width = width;
+            m_wndcap->Height = height;
+            m_output->result = WNDCAP_OK;
+            return true;
+        }
+
+    private:
+        WNDCAP_HANDLE_STRUCT* m_wndcap;
+        WNDCAP_BATCH_OUTPUT* m_output;
+    };
+}
+
+WNDCAP_BATCH CreateBatchCopier(unsigned int threads)
+{
+    try {
+        return new BatchCopier(threads);
+    }
+    catch (...) {
+        OutputDebugStringA("CreateBatchCopier failed!!!\r\n");
+        return nullptr;
+    }
+}
+
+bool DestroyBatchCopier(WNDCAP_BATCH batch)
+{
+    auto copier = reinterpret_cast<BatchCopier*>(batch);
+    if (copier == nullptr)
+        return false;
+    delete copier;
+    return true;
+}
+
+bool WindowCaptureBatch(WNDCAP_BATCH batch, WNDCAP_HANDLE* handles, WNDCAP_BATCH_OUTPUT* outputs, unsigned int count)
+{
+    auto copier = reinterpret_cast<BatchCopier*>(batch);
+    if (copier == nullptr || (count != 0 && (handles == nullptr || outputs == nullptr)))
+        return false;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (handles[i] == nullptr || outputs[i].buf == nullptr)
+            return false;
+    }
+    // Two jobs on one handle would collect the same staging texture from
+    // two threads at once.
+    std::vector<WNDCAP_HANDLE> sorted(handles, handles + count);
+    std::sort(sorted.begin(), sorted.end());
+    if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end())
+    {
+        OutputDebugStringA("WindowCaptureBatch: handle given twice!!!\r\n");
+        return false;
+    }
+
+    std::vector<AppBatchJob> jobs;
+    std::vector<IBatchJob*> pointers;
+    jobs.reserve(count);
+    pointers.reserve(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        outputs[i].result = WNDCAP_NO_FRAME;
+        jobs.emplace_back(reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(handles[i]), &outputs[i]);
+        pointers.push_back(&jobs.back());
+    }
+    copier->Run(pointers.data(), pointers.size());
+    return true;
+}
+
+static bool ToConvertParams(WNDCAP_OUTPUT_FORMAT format, WNDCAP_COLOR_SPACE color_space, ConvertParams& params)
+{
+    if (format < WNDCAP_FORMAT_BGRA || format > WNDCAP_FORMAT_I420 ||
+        color_space < WNDCAP_BT601_LIMITED || color_space > WNDCAP_BT709_FULL)
+        return false;
+    params.Format = static_cast<OutputFormat>(format);
+    params.Matrix = (color_space == WNDCAP_BT709_LIMITED || color_space == WNDCAP_BT709_FULL) ? YuvMatrix::Bt709 : YuvMatrix::Bt601;
+    params.Range = (color_space == WNDCAP_BT601_FULL || color_space == WNDCAP_BT709_FULL) ? YuvRange::Full : YuvRange::Limited;
+    return true;
+}
+
+bool SetOutputFormat(WNDCAP_HANDLE wndcap_handle, WNDCAP_OUTPUT_FORMAT format, WNDCAP_COLOR_SPACE color_space)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    ConvertParams params;
+    if (wndcap == nullptr || !ToConvertParams(format, color_space, params))
+        return false;
+    wndcap->convert = params;
+    wndcap->m_APP->SetOutputFormat(params);
+    return true;
+}
+
+unsigned long long GetOutputFrameSize(WNDCAP_HANDLE wndcap_handle, unsigned int width, unsigned int height, unsigned int dst_stride)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return 0;
+    return GetOutputFrameSize(wndcap->convert.Format, width, height, dst_stride);
+}
+
+unsigned char* AllocFrameBuffer(WNDCAP_HANDLE wndcap_handle, unsigned int width, unsigned int height, unsigned int dst_stride, unsigned long long& buf_size)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    buf_size = 0;
+    if (wndcap == nullptr || width == 0 || height == 0)
+        return nullptr;
+    if (dst_stride != 0 && dst_stride < GetOutputRowBytes(wndcap->convert.Format, width))
+        return nullptr;
+    size_t capacity = 0;
+    auto buf = wndcap->buffers->Acquire(GetOutputFrameSize(wndcap->convert.Format, width, height, dst_stride), &capacity);
+    if (buf != nullptr)
+        buf_size = capacity;
+    return buf;
+}
+
+bool FreeFrameBuffer(WNDCAP_HANDLE wndcap_handle, unsigned char* buf)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || buf == nullptr)
+        return false;
+    return wndcap->buffers->Release(buf);
+}
+
+bool SetParallelCopy(WNDCAP_HANDLE wndcap_handle, const WNDCAP_PARALLEL_COPY_CONFIG* config)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    if (config == nullptr)
+    {
+        wndcap->m_APP->SetParallelCopy(nullptr);
+        return true;
+    }
+    StripCopierConfig copier;
+    copier.Threads = config->threads;
+    if (config->min_parallel_bytes != 0)
+        copier.MinParallelBytes = static_cast<size_t>(config->min_parallel_bytes);
+    copier.NumaNode = config->numa_node;
+    copier.PinWorkers = config->pin_workers;
+    try {
+        wndcap->m_APP->SetParallelCopy(&copier);
+    }
+    catch (...) {
+        OutputDebugStringA("SetParallelCopy failed!!!\r\n");
+        return false;
+    }
+    return true;
+}
+
+bool GetFrameBufferStats(WNDCAP_HANDLE wndcap_handle, WNDCAP_BUFFER_POOL_STATS* stats)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || stats == nullptr)
+        return false;
+    auto pool = wndcap->buffers->Stats();
+    stats->allocated = pool.Allocated;
+    stats->reused = pool.Reused;
+    stats->freed = pool.Freed;
+    stats->large_page_buffers = pool.LargePageBuffers;
+    stats->bytes_in_use = pool.BytesInUse;
+    stats->bytes_cached = pool.BytesCached;
+    return true;
+}
+
+bool SetCaptureRegion(WNDCAP_HANDLE wndcap_handle, const WNDCAP_RECT* crop, unsigned int out_width, unsigned int out_height, WNDCAP_SCALE_FILTER filter, WNDCAP_FIT_MODE fit)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || filter < WNDCAP_SCALE_BOX || filter > WNDCAP_SCALE_BILINEAR ||
+        fit < WNDCAP_FIT_STRETCH || fit > WNDCAP_FIT_LETTERBOX)
+        return false;
+
+    ScaleParams params;
+    if (crop != nullptr)
+    {
+        params.Crop.X = crop->x;
+        params.Crop.Y = crop->y;
+        params.Crop.Width = crop->width;
+        params.Crop.Height = crop->height;
+    }
+    params.Width = out_width;
+    params.Height = out_height;
+    params.Filter = static_cast<ScaleFilter>(filter);
+    params.Fit = static_cast<ScaleFit>(fit);
+    wndcap->m_APP->SetScale(params);
+    return true;
+}
+
+bool SetCaptureFrameRate(WNDCAP_HANDLE wndcap_handle, double fps)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || !(fps >= 0))
+        return false;
+    wndcap->m_APP->SetFrameRate(fps);
+    return true;
+}
+
+bool GetFrameTiming(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_TIMING* timing)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    FrameTiming frame;
+    if (wndcap == nullptr || timing == nullptr || !wndcap->m_APP->GetFrameTiming(frame))
+        return false;
+    timing->frame_index = frame.FrameIndex;
+    timing->capture_time_ns = frame.CaptureTimeNs;
+    timing->delivery_time_ns = frame.DeliveryTimeNs;
+    return true;
+}
+
+bool GetFrameRecord(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_RECORD* record)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    FrameTiming frame;
+    if (wndcap == nullptr || record == nullptr || !wndcap->m_APP->GetFrameTiming(frame))
+        return false;
+    record->frame_id = frame.FrameId;
+    record->frame_index = frame.FrameIndex;
+    record->capture_time_ns = frame.CaptureTimeNs;
+    record->acquire_time_ns = frame.AcquireTimeNs;
+    record->copy_start_ns = frame.CopyStartNs;
+    record->copy_end_ns = frame.CopyEndNs;
+    record->delivery_time_ns = frame.DeliveryTimeNs;
+    return true;
+}
+
+WNDCAP_TRACE OpenFrameTrace(const char* path, unsigned int capacity)
+{
+    if (path == nullptr)
+        return nullptr;
+    auto trace = std::make_unique<WNDCAP_TRACE_STRUCT>();
+    if (!trace->writer.Open(path, capacity))
+        return nullptr;
+    return trace.release();
+}
+
+bool CloseFrameTrace(WNDCAP_TRACE trace)
+{
+    auto owner = reinterpret_cast<WNDCAP_TRACE_STRUCT*>(trace);
+    if (owner == nullptr)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(g_traceLock);
+        for (auto wndcap : owner->handles)
+        {
+            wndcap->m_APP->SetFrameTrace(nullptr, 0);
+            wndcap->trace = nullptr;
+        }
+        owner->handles.clear();
+    }
+    bool ok = owner->writer.Close();
+    delete owner;
+    return ok;
+}
+
+bool SetFrameTrace(WNDCAP_HANDLE wndcap_handle, WNDCAP_TRACE trace, const char* name)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    auto owner = reinterpret_cast<WNDCAP_TRACE_STRUCT*>(trace);
+    if (wndcap == nullptr)
+        return false;
+    std::lock_guard<std::mutex> lock(g_traceLock);
+    if (wndcap->trace != nullptr)
+    {
+        auto previous = reinterpret_cast<WNDCAP_TRACE_STRUCT*>(wndcap->trace);
+        wndcap->m_APP->SetFrameTrace(nullptr, 0);
+        previous->handles.erase(wndcap);
+        wndcap->trace = nullptr;
+    }
+    if (owner == nullptr)
+        return true;
+
+    auto track = owner->writer.AddTrack(name != nullptr ? name : "capture");
+    owner->handles.insert(wndcap);
+    wndcap->trace = owner;
+    wndcap->m_APP->SetFrameTrace(&owner->writer, track);
+    return true;
+}
+
+bool GetFrameTraceStats(WNDCAP_TRACE trace, unsigned long long& frames_written, unsigned long long& frames_dropped)
+{
+    auto owner = reinterpret_cast<WNDCAP_TRACE_STRUCT*>(trace);
+    if (owner == nullptr)
+        return false;
+    frames_written = owner->writer.Written();
+    frames_dropped = owner->writer.Dropped();
+    return true;
+}
+
+bool SetCursorCapture(WNDCAP_HANDLE wndcap_handle, bool draw)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    wndcap->capture_cursor = draw;
+    wndcap->m_APP->SetDrawCursor(draw);
+    return true;
+}
+
+bool GetCaptureCursor(WNDCAP_HANDLE wndcap_handle, WNDCAP_CURSOR_INFO* info, unsigned char* shape, unsigned long long shape_size)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    CursorState cursor;
+    if (wndcap == nullptr || info == nullptr || !wndcap->m_APP->GetCursorState(cursor))
+        return false;
+
+    *info = {};
+    info->visible = cursor.Visible;
+    info->x = cursor.X;
+    info->y = cursor.Y;
+    if (cursor.Shape)
+    {
+        info->shape_id = cursor.Shape->Hash;
+        info->width = cursor.Shape->Width;
+        info->height = cursor.Shape->Height;
+        info->hotspot_x = cursor.Shape->HotspotX;
+        info->hotspot_y = cursor.Shape->HotspotY;
+        info->inverts = !cursor.Shape->Invert.empty();
+        if (shape != nullptr)
+        {
+            if (shape_size < cursor.Shape->Pixels.size())
+                return false;
+            memcpy(shape, cursor.Shape->Pixels.data(), cursor.Shape->Pixels.size());
+        }
+    }
+    return true;
+}
+
+bool EnableDirtyRegions(WNDCAP_HANDLE wndcap_handle, bool enable)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    wndcap->m_APP->EnableDirtyRegions(enable);
+    return true;
+}
+
+bool GetDirtyRegions(WNDCAP_HANDLE wndcap_handle, WNDCAP_RECT* rects, unsigned int capacity, unsigned int& count, bool& identical)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    count = 0;
+    if (wndcap == nullptr)
+        return false;
+
+    std::vector<DirtyRect> dirty;
+    if (!wndcap->m_APP->GetDirtyRegions(dirty, identical))
+        return false;
+    count = static_cast<unsigned int>(dirty.size());
+    for (unsigned int i = 0; i < count && i < capacity && rects != nullptr; i++)
+    {
+        rects[i].x = dirty[i].X;
+        rects[i].y = dirty[i].Y;
+        rects[i].width = dirty[i].Width;
+        rects[i].height = dirty[i].Height;
+    }
+    return count <= capacity;
+}
+
+bool SetFrameCallback(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_CALLBACK callback, void* user_data)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+
+    if (callback == nullptr)
+        wndcap->m_APP->SetFrameCallback(nullptr);
+    else
+        wndcap->m_APP->SetFrameCallback([=]() { callback(wndcap_handle, user_data); });
+    return true;
+}
+
+bool WaitForFrame(WNDCAP_HANDLE wndcap_handle, unsigned int timeout_ms)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    return wndcap->m_APP->WaitForFrame(timeout_ms);
+}
+
+bool SetFramePolicy(WNDCAP_HANDLE wndcap_handle, unsigned int depth, WNDCAP_FRAME_POLICY policy)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || depth == 0 || policy < WNDCAP_POLICY_LATEST_WINS || policy > WNDCAP_POLICY_DROP_OLDEST)
+        return false;
+    try {
+        wndcap->m_APP->SetFramePolicy(depth, static_cast<FramePolicy>(policy));
+    }
+    catch (...) {
+        return false;
+    }
+    return true;
+}
+
+bool GetFrameQueueStats(WNDCAP_HANDLE wndcap_handle, WNDCAP_QUEUE_STATS* stats)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || stats == nullptr)
+        return false;
+
+    auto queueStats = wndcap->m_APP->GetFrameQueueStats();
+    stats->frames_arrived = queueStats.Arrived;
+    stats->frames_delivered = queueStats.Delivered;
+    stats->frames_dropped = queueStats.Dropped;
+    stats->frames_coalesced = queueStats.Coalesced;
+    return true;
+}
+
+static void CopyStageStats(WNDCAP_STAGE_STATS& dst, StageStats const& src)
+{
+    dst.count = src.Count;
+    dst.mean_ns = src.MeanNs;
+    dst.p50_ns = src.P50Ns;
+    dst.p95_ns = src.P95Ns;
+    dst.p99_ns = src.P99Ns;
+    dst.max_ns = src.MaxNs;
+}
+
+bool GetCaptureStats(WNDCAP_HANDLE wndcap_handle, WNDCAP_CAPTURE_STATS* stats, bool reset)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || stats == nullptr)
+        return false;
+
+    auto snapshot = wndcap->m_APP->GetCaptureStats(reset);
+    CopyStageStats(stats->acquire, snapshot.Stages[static_cast<size_t>(CaptureStage::Acquire)]);
+    CopyStageStats(stats->copy, snapshot.Stages[static_cast<size_t>(CaptureStage::Copy)]);
+    CopyStageStats(stats->map, snapshot.Stages[static_cast<size_t>(CaptureStage::Map)]);
+    CopyStageStats(stats->row_copy, snapshot.Stages[static_cast<size_t>(CaptureStage::RowCopy)]);
+    CopyStageStats(stats->resize, snapshot.Stages[static_cast<size_t>(CaptureStage::Resize)]);
+    CopyStageStats(stats->scale, snapshot.Stages[static_cast<size_t>(CaptureStage::Scale)]);
+    CopyStageStats(stats->delivery, snapshot.Stages[static_cast<size_t>(CaptureStage::Delivery)]);
+    stats->frames = snapshot.Frames;
+    stats->null_frames = snapshot.NullFrames;
+    stats->resizes = snapshot.Resizes;
+    stats->resize_events = snapshot.ResizeEvents;
+    stats->frames_decimated = snapshot.Decimated;
+    stats->bytes_copied = snapshot.BytesCopied;
+    return true;
+}
+
+WNDCAP_MANAGER CreateCaptureManager()
+{
+    auto owner = new WNDCAP_MANAGER_STRUCT;
+    try {
+        owner->manager = std::make_unique<CaptureManager>();
+    }
+    catch (...) {
+        OutputDebugStringA("CreateCaptureManager failed!!!\r\n");
+        delete owner;
+        return nullptr;
+    }
+    return owner;
+}
+
+bool DestroyCaptureManager(WNDCAP_MANAGER manager)
+{
+    auto owner = reinterpret_cast<WNDCAP_MANAGER_STRUCT*>(manager);
+    if (owner == nullptr)
+        return false;
+    {
+        // Sessions still open keep working on their own but are detached.
+        std::lock_guard<std::mutex> lock(owner->lock);
+        for (auto& entry : owner->sessions)
+            entry.second->manager = nullptr;
+    }
+    delete owner;
+    return true;
+}
+
+WNDCAP_HANDLE CreateCaptureSession(WNDCAP_MANAGER manager, unsigned int min_interval_ms)
+{
+    auto owner = reinterpret_cast<WNDCAP_MANAGER_STRUCT*>(manager);
+    if (owner == nullptr)
+        return nullptr;
+
+    WNDCAP_HANDLE_STRUCT* wndcap = new WNDCAP_HANDLE_STRUCT;
+    wndcap->WindowHandle = nullptr;
+    wndcap->Width = 0;
+    wndcap->Height = 0;
+    wndcap->capture_cursor = true;
+    wndcap->cursor_visible = false;
+    wndcap->manager = owner;
+    wndcap->trace = nullptr;
+    wndcap->buffers = std::make_unique<FrameBufferPool>();
+    wndcap->m_APP = owner->manager->CreateSession(wndcap->session_id, std::chrono::milliseconds(min_interval_ms));
+
+    std::lock_guard<std::mutex> lock(owner->lock);
+    owner->sessions[wndcap->session_id] = wndcap;
+    return wndcap;
+}
+
+WNDCAP_HANDLE NextReadySession(WNDCAP_MANAGER manager, unsigned int timeout_ms)
+{
+    auto owner = reinterpret_cast<WNDCAP_MANAGER_STRUCT*>(manager);
+    if (owner == nullptr)
+        return nullptr;
+
+    uint32_t sessionId = 0;
+    if (!owner->manager->WaitNextSession(sessionId, timeout_ms))
+        return nullptr;
+    std::lock_guard<std::mutex> lock(owner->lock);
+    auto it = owner->sessions.find(sessionId);
+    return it == owner->sessions.end() ? nullptr : it->second;
+}
+
+bool EnableAsyncReadback(WNDCAP_HANDLE wndcap_handle, bool enable)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || wndcap->manager == nullptr)
+        return false;
+    auto owner = reinterpret_cast<WNDCAP_MANAGER_STRUCT*>(wndcap->manager);
+    return owner->manager->SetAsyncReadback(wndcap->session_id, enable);
+}
+
+// The tail the benchmark exports share: run makes the JSON, which goes out
+// NUL terminated as the header describes. name labels a failure.
+template <typename TRun>
+static bool CopyJson(const char* name, char* json, unsigned long long capacity, unsigned long long& length, TRun&& run)
+{
+    std::string result;
+    try {
+        result = run();
+    }
+    catch (...) {
+        OutputDebugStringA((std::string(name) + " failed!!!\r\n").c_str());
+        return false;
+    }
+    length = result.size() + 1;
+    if (json == nullptr || length > capacity)
+        return false;
+    memcpy(json, result.c_str(), static_cast<size_t>(length));
+    return true;
+}
+
+bool RunCaptureBenchmark(const WNDCAP_BENCHMARK_CONFIG* config, char* json, unsigned long long capacity, unsigned long long& length)
+{
+    length = 0;
+    CaptureBenchmarkConfig benchmark;
+    if (config != nullptr)
+    {
+        if (!ToConvertParams(config->format, config->color_space, benchmark.Convert))
+            return false;
+        if (config->frames_per_case != 0)
+            benchmark.FramesPerCase = config->frames_per_case;
+        if (config->source_fps != 0)
+            benchmark.SourceRate = config->source_fps;
+        benchmark.DirtyRegions = config->dirty_regions;
+        benchmark.Compress = config->compress;
+        if (config->keyframe_interval != 0)
+            benchmark.KeyframeInterval = config->keyframe_interval;
+    }
+
+    return CopyJson("RunCaptureBenchmark", json, capacity, length,
+        [&] { return CaptureBenchmarkToJson(benchmark, RunCaptureBenchmark(benchmark)); });
+}
+
+bool RunBatchBenchmark(const WNDCAP_BATCH_BENCHMARK_CONFIG* config, char* json, unsigned long long capacity, unsigned long long& length)
+{
+    length = 0;
+    BatchBenchmarkConfig benchmark;
+    if (config != nullptr)
+    {
+        if (config->width != 0 && config->height != 0)
+            benchmark.Resolution = { "custom", config->width, config->height };
+        if (config->max_sources != 0)
+        {
+            for (uint32_t sources = 1; sources < config->max_sources; sources *= 2)
+                benchmark.SourceCounts.push_back(sources);
+            benchmark.SourceCounts.push_back(config->max_sources);
+        }
+        benchmark.Threads = config->threads;
+        if (config->readback_latency_us != 0)
+            benchmark.ReadbackLatency = std::chrono::microseconds(config->readback_latency_us);
+        if (config->rounds != 0)
+            benchmark.Rounds = config->rounds;
+    }
+
+    return CopyJson("RunBatchBenchmark", json, capacity, length,
+        [&] { return BatchBenchmarkToJson(benchmark, RunBatchBenchmark(benchmark)); });
+}
+
+bool RunBufferPoolBenchmark(unsigned int iterations, char* json, unsigned long long capacity, unsigned long long& length)
+{
+    length = 0;
+    BufferPoolBenchmarkConfig benchmark;
+    if (iterations != 0)
+        benchmark.Iterations = iterations;
+
+    return CopyJson("RunBufferPoolBenchmark", json, capacity, length,
+        [&] { return BufferPoolBenchmarkToJson(benchmark, RunBufferPoolBenchmark(benchmark)); });
+}
+
+bool RunParallelCopyBenchmark(const WNDCAP_PARALLEL_COPY_BENCHMARK_CONFIG* config, char* json, unsigned long long capacity, unsigned long long& length)
+{
+    length = 0;
+    StripBenchmarkConfig benchmark;
+    if (config != nullptr)
+    {
+        if (!ToConvertParams(config->format, config->color_space, benchmark.Convert))
+            return false;
+        if (config->width != 0 && config->height != 0)
+            benchmark.Resolutions.push_back({ "custom", config->width, config->height });
+        if (config->max_threads != 0)
+        {
+            for (uint32_t threads = 1; threads < config->max_threads; threads *= 2)
+                benchmark.ThreadCounts.push_back(threads);
+            benchmark.ThreadCounts.push_back(config->max_threads);
+        }
+        if (config->frames != 0)
+            benchmark.Frames = config->frames;
+    }
+
+    return CopyJson("RunParallelCopyBenchmark", json, capacity, length,
+        [&] { return StripBenchmarkToJson(benchmark, RunStripBenchmark(benchmark)); });
+}
+
+bool AcquireFrame(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_VIEW* view)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || view == nullptr)
+        return false;
+
+    FrameLease lease;
+    if (!wndcap->m_APP->AcquireFrame(lease))
+        return false;
+    view->data = lease.Data;
+    view->row_pitch = lease.RowPitch;
+    view->width = lease.Width;
+    view->height = lease.Height;
+    view->format = lease.Format;
+    view->size = lease.Size;
+    view->frame_index = lease.FrameIndex;
+    view->capture_time_ns = lease.CaptureTimeNs;
+    view->delivery_time_ns = lease.DeliveryTimeNs;
+    wndcap->Width = lease.Width;
+    wndcap->Height = lease.Height;
+    return true;
+}
+
+bool ReleaseFrame(WNDCAP_HANDLE wndcap_handle, const WNDCAP_FRAME_VIEW* view)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || view == nullptr)
+        return false;
+    return wndcap->m_APP->ReleaseFrame(view->frame_index);
+}
+
+static void ToEncodedFrame(EncodedFrameHeader const& header, WNDCAP_ENCODED_FRAME* frame)
+{
+    if (frame == nullptr)
+        return;
+    frame->width = header.Width;
+    frame->height = header.Height;
+    frame->format = static_cast<WNDCAP_OUTPUT_FORMAT>(header.Format);
+    frame->keyframe = (header.Flags & EncodedKeyframe) != 0;
+    frame->sequence = header.Sequence;
+    frame->size = sizeof(header) + header.PayloadBytes;
+}
+
+WNDCAP_RESULT WindowCaptureCompressed(WNDCAP_HANDLE wndcap_handle, unsigned char* buf, unsigned long long buf_size, unsigned long long& encoded_size, WNDCAP_ENCODED_FRAME* frame)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return WNDCAP_INVALID_ARG;
+
+    size_t size = 0;
+    EncodedFrameHeader header = {};
+    auto result = wndcap->m_APP->CopyCompressed(buf, static_cast<size_t>(buf_size), size, header);
+    if (result == CopyResult::NoFrame)
+        return WNDCAP_NO_FRAME;
+    encoded_size = size;
+    ToEncodedFrame(header, frame);
+    if (result == CopyResult::BufferTooSmall)
+        return WNDCAP_BUFFER_TOO_SMALL;
+    wndcap->Width = header.Width;
+    wndcap->Height = header.Height;
+    return WNDCAP_OK;
+}
+
+bool SetKeyframeInterval(WNDCAP_HANDLE wndcap_handle, unsigned int interval)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    wndcap->m_APP->SetKeyframeInterval(interval);
+    return true;
+}
+
+bool RequestKeyframe(WNDCAP_HANDLE wndcap_handle)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    wndcap->m_APP->RequestKeyframe();
+    return true;
+}
+
+WNDCAP_DECODER CreateFrameDecoder()
+{
+    return new FrameDecoder();
+}
+
+bool DestroyFrameDecoder(WNDCAP_DECODER decoder)
+{
+    auto frameDecoder = reinterpret_cast<FrameDecoder*>(decoder);
+    if (frameDecoder == nullptr)
+        return false;
+    delete frameDecoder;
+    return true;
+}
+
+WNDCAP_RESULT DecodeFrame(WNDCAP_DECODER decoder, const unsigned char* data, unsigned long long size, unsigned char* buf, unsigned long long buf_size, unsigned int dst_stride, WNDCAP_ENCODED_FRAME* frame)
+{
+    auto frameDecoder = reinterpret_cast<FrameDecoder*>(decoder);
+    if (frameDecoder == nullptr)
+        return WNDCAP_INVALID_ARG;
+
+    EncodedFrameHeader header = {};
+    if (data != nullptr)
+    {
+        if (!FrameDecoder::ReadHeader(data, static_cast<size_t>(size), header))
+            return WNDCAP_INVALID_ARG;
+        switch (frameDecoder->Decode(data, static_cast<size_t>(size)))
+        {
+        case DecodeResult::Corrupt:
+            return WNDCAP_INVALID_ARG;
+        case DecodeResult::NeedKeyframe:
+            return WNDCAP_NEED_KEYFRAME;
+        default:
+            break;
+        }
+    }
+    else
+    {
+        if (!frameDecoder->Valid())
+            return WNDCAP_NO_FRAME;
+        header.Width = frameDecoder->Width();
+        header.Height = frameDecoder->Height();
+        header.Format = static_cast<uint8_t>(frameDecoder->Format());
+        header.Flags = frameDecoder->Keyframe() ? EncodedKeyframe : 0;
+        header.Sequence = frameDecoder->Sequence();
+    }
+    ToEncodedFrame(header, frame);
+    if (data == nullptr && frame != nullptr)
+        frame->size = 0;
+
+    if (buf == nullptr)
+        return WNDCAP_OK;
+    auto format = frameDecoder->Format();
+    size_t stride = dst_stride != 0 ? dst_stride : GetOutputRowBytes(format, header.Width);
+    if (stride < GetOutputRowBytes(format, header.Width))
+        return WNDCAP_INVALID_ARG;
+    if (!frameDecoder->CopyFrame(buf, static_cast<size_t>(buf_size), stride))
+        return WNDCAP_BUFFER_TOO_SMALL;
+    return WNDCAP_OK;
+}
+
+bool StartRecording(WNDCAP_HANDLE wndcap_handle, const char* path, unsigned int max_width, unsigned int max_height, unsigned int max_frames)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || path == nullptr)
+        return false;
+    return wndcap->m_APP->StartRecording(path, max_width, max_height, max_frames);
+}
+
+bool StopRecording(WNDCAP_HANDLE wndcap_handle)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    return wndcap->m_APP->StopRecording();
+}
+
+bool GetRecordingStats(WNDCAP_HANDLE wndcap_handle, unsigned long long& frames_recorded, unsigned long long& frames_dropped)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    uint64_t recorded = 0;
+    uint64_t dropped = 0;
+    if (!wndcap->m_APP->GetRecordingStats(recorded, dropped))
+        return false;
+    frames_recorded = recorded;
+    frames_dropped = dropped;
+    return true;
+}
+
+WNDCAP_RECORDING OpenRecording(const char* path)
+{
+    if (path == nullptr)
+        return nullptr;
+    auto reader = std::make_unique<FrameRecordingReader>();
+    if (!reader->Open(path))
+        return nullptr;
+    return reader.release();
+}
+
+bool CloseRecording(WNDCAP_RECORDING recording)
+{
+    auto reader = reinterpret_cast<FrameRecordingReader*>(recording);
+    if (reader == nullptr)
+        return false;
+    delete reader;
+    return true;
+}
+
+bool GetRecordingInfo(WNDCAP_RECORDING recording, WNDCAP_RECORDING_INFO* info)
+{
+    auto reader = reinterpret_cast<FrameRecordingReader*>(recording);
+    if (reader == nullptr || info == nullptr)
+        return false;
+    auto header = reader->Header();
+    info->format = static_cast<WNDCAP_OUTPUT_FORMAT>(header.Format);
+    info->max_width = header.MaxWidth;
+    info->max_height = header.MaxHeight;
+    info->stride = static_cast<unsigned int>(header.Stride);
+    info->frame_count = reader->FrameCount();
+    info->capacity = header.IndexCapacity;
+    info->complete = reader->Complete();
+    return true;
+}
+
+WNDCAP_RESULT ReadRecordedFrame(WNDCAP_RECORDING recording, unsigned long long index, unsigned char* buf, unsigned long long buf_size, unsigned int dst_stride, WNDCAP_RECORDED_FRAME* frame)
+{
+    auto reader = reinterpret_cast<FrameRecordingReader*>(recording);
+    if (reader == nullptr)
+        return WNDCAP_INVALID_ARG;
+
+    RecordingIndexEntry entry;
+    if (!reader->GetEntry(index, entry))
+        return WNDCAP_NO_FRAME;
+    if (frame != nullptr)
+    {
+        frame->frame_index = entry.FrameIndex;
+        frame->capture_time_ns = entry.CaptureTimeNs;
+        frame->delivery_time_ns = entry.DeliveryTimeNs;
+        frame->width = entry.Width;
+        frame->height = entry.Height;
+        frame->dirty = (entry.Flags & RecordedFrameDirty) != 0;
+        frame->dirty_tracked = (entry.Flags & RecordedFrameTracked) != 0;
+    }
+    if (buf == nullptr)
+        return WNDCAP_OK;
+
+    auto format = static_cast<OutputFormat>(reader->Header().Format);
+    size_t stride = dst_stride != 0 ? dst_stride : GetOutputRowBytes(format, entry.Width);
+    if (stride < GetOutputRowBytes(format, entry.Width))
+        return WNDCAP_INVALID_ARG;
+    if (GetOutputFrameSize(format, entry.Width, entry.Height, stride) > buf_size)
+        return WNDCAP_BUFFER_TOO_SMALL;
+    if (!reader->CopyFrame(index, buf, static_cast<size_t>(buf_size), stride, entry))
+        return WNDCAP_INVALID_ARG;
+    return WNDCAP_OK;
+}
+
+bool StartFrameServer(WNDCAP_HANDLE wndcap_handle, const char* name, unsigned int max_width, unsigned int max_height, unsigned int slots)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr || name == nullptr)
+        return false;
+    return wndcap->m_APP->StartFrameServer(name, max_width, max_height, slots);
+}
+
+bool StopFrameServer(WNDCAP_HANDLE wndcap_handle)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    return wndcap->m_APP->StopFrameServer();
+}
+
+bool GetFrameServerStats(WNDCAP_HANDLE wndcap_handle, unsigned long long& frames_published, unsigned long long& frames_dropped, unsigned long long& overwrites)
+{
+    WNDCAP_HANDLE_STRUCT* wndcap = reinterpret_cast<WNDCAP_HANDLE_STRUCT*>(wndcap_handle);
+    if (wndcap == nullptr)
+        return false;
+    uint64_t published = 0;
+    uint64_t dropped = 0;
+    uint64_t overwritten = 0;
+    if (!wndcap->m_APP->GetFrameServerStats(published, dropped, overwritten))
+        return false;
+    frames_published = published;
+    frames_dropped = dropped;
+    overwrites = overwritten;
+    return true;
+}
+
+WNDCAP_FRAME_CLIENT OpenFrameServer(const char* name)
+{
+    if (name == nullptr)
+        return nullptr;
+    auto reader = std::make_unique<SharedFrameReader>();
+    if (!reader->Open(name))
+        return nullptr;
+    return reader.release();
+}
+
+bool CloseFrameServer(WNDCAP_FRAME_CLIENT client)
+{
+    auto reader = reinterpret_cast<SharedFrameReader*>(client);
+    if (reader == nullptr)
+        return false;
+    delete reader;
+    return true;
+}
+
+WNDCAP_RESULT AcquireServerFrame(WNDCAP_FRAME_CLIENT client, unsigned int timeout_ms, WNDCAP_SERVER_FRAME* frame)
+{
+    auto reader = reinterpret_cast<SharedFrameReader*>(client);
+    if (reader == nullptr || frame == nullptr)
+        return WNDCAP_INVALID_ARG;
+
+    SharedFrameView view;
+    switch (reader->Acquire(view, timeout_ms))
+    {
+    case SharedReadResult::Ok:
+        break;
+    case SharedReadResult::NoFrame:
+        return WNDCAP_NO_FRAME;
+    default:
+        return WNDCAP_CLOSED;
+    }
+    frame->data = view.Data;
+    frame->stride = static_cast<unsigned int>(view.Stride);
+    frame->size = view.Bytes;
+    frame->format = static_cast<WNDCAP_OUTPUT_FORMAT>(view.Format);
+    frame->width = view.Width;
+    frame->height = view.Height;
+    frame->frame_number = view.FrameNumber;
+    frame->frame_index = view.Timing.FrameIndex;
+    frame->capture_time_ns = view.Timing.CaptureTimeNs;
+    frame->delivery_time_ns = view.Timing.DeliveryTimeNs;
+    frame->slot = view.Slot;
+    frame->sequence = view.Sequence;
+    return WNDCAP_OK;
+}
+
+bool ReleaseServerFrame(WNDCAP_FRAME_CLIENT client, const WNDCAP_SERVER_FRAME* frame)
+{
+    auto reader = reinterpret_cast<SharedFrameReader*>(client);
+    if (reader == nullptr || frame == nullptr)
+        return false;
+    SharedFrameView view;
+    view.Data = frame->data;
+    view.Slot = frame->slot;
+    view.Sequence = frame->sequence;
+    return reader->Release(view);
+}
+
+static std::wstring FromUtf8(const char* text)
+{
+    int length = ::MultiByteToWideChar(CP_UTF8, 0, text, -1, nullptr, 0);
+    if (length <= 0)
+        return std::wstring();
+    std::wstring wide(static_cast<size_t>(length), L'\0');
+    ::MultiByteToWideChar(CP_UTF8, 0, text, -1, &wide[0], length);
+    wide.resize(static_cast<size_t>(length) - 1);
+    return wide;
+}
+
+// Into a fixed buffer, cut at a character boundary if it doesn't fit.
+template <size_t N>
+static void ToUtf8(std::wstring const& text, char (&out)[N])
+{
+    out[0] = '\0';
+    int length = ::WideCharToMultiByte(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), nullptr, 0, nullptr, nullptr);
+    if (length <= 0)
+        return;
+    std::string utf8(static_cast<size_t>(length), '\0');
+    ::WideCharToMultiByte(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), &utf8[0], length, nullptr, nullptr);
+    size_t size = utf8.size();
+    if (size >= N)
+    {
+        size = N - 1;
+        while (size > 0 && (static_cast<unsigned char>(utf8[size]) & 0xC0) == 0x80)
+            size--;
+    }
+    memcpy(out, utf8.data(), size);
+    out[size] = '\0';
+}
+
+WNDCAP_WINDOWS OpenWindowRegistry()
+{
+    auto windows = std::make_unique<WNDCAP_WINDOWS_STRUCT>();
+    if (!windows->watcher.Start())
+        return nullptr;
+    return windows.release();
+}
+
+bool CloseWindowRegistry(WNDCAP_WINDOWS windows)
+{
+    auto registry = reinterpret_cast<WNDCAP_WINDOWS_STRUCT*>(windows);
+    if (registry == nullptr)
+        return false;
+    delete registry;
+    return true;
+}
+
+unsigned long long GetWindowRegistryVersion(WNDCAP_WINDOWS windows)
+{
+    auto registry = reinterpret_cast<WNDCAP_WINDOWS_STRUCT*>(windows);
+    return registry == nullptr ? 0 : registry->registry.Version();
+}
+
+unsigned int ListWindows(WNDCAP_WINDOWS windows, const WNDCAP_WINDOW_QUERY* query, WNDCAP_WINDOW_INFO* list, unsigned int capacity)
+{
+    auto registry = reinterpret_cast<WNDCAP_WINDOWS_STRUCT*>(windows);
+    if (registry == nullptr)
+        return 0;
+
+    std::wstring title;
+    std::wstring className;
+    uint32_t processId = 0;
+    bool altTabOnly = false;
+    if (query != nullptr)
+    {
+        if (query->title != nullptr)
+            title = FromUtf8(query->title);
+        if (query->class_name != nullptr)
+            className = FromUtf8(query->class_name);
+        processId = query->process_id;
+        altTabOnly = query->alt_tab_only;
+    }
+    bool anyClass = query == nullptr || query->class_name == nullptr;
+    auto matches = registry->registry.Query([&](WindowInfo const& window)
+        {
+            return (processId == 0 || window.ProcessId == processId) &&
+                (anyClass || window.ClassName == className) &&
+                (!altTabOnly || IsAltTabWindow(window)) &&
+                ContainsIgnoreCase(window.Title, title);
+        });
+
+    if (list != nullptr)
+    {
+        for (size_t i = 0; i < matches.size() && i < capacity; i++)
+        {
+            auto const& window = matches[i];
+            auto& info = list[i];
+            info.hwnd = Win32WindowSource::ToHwnd(window.Handle);
+            info.process_id = window.ProcessId;
+            info.alt_tab = IsAltTabWindow(window);
+            info.visible = window.Visible;
+            info.cloaked = window.Cloaked;
+            ToUtf8(window.Title, info.title);
+            ToUtf8(window.ClassName, info.class_name);
+        }
+    }
+    return static_cast<unsigned int>(matches.size());
+}
+
 
 #ifdef _DEBUG
 int CALLBACK WinMain(
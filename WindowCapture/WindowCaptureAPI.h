@@ -11,11 +11,506 @@ extern "C" {
 #endif
 
 typedef void* WNDCAP_HANDLE;
-//TODO: mouse cursor
+typedef void* WNDCAP_MANAGER;
+typedef void* WNDCAP_RECORDING;
+typedef void* WNDCAP_DECODER;
+typedef void* WNDCAP_FRAME_CLIENT;
+typedef void* WNDCAP_WINDOWS;
+typedef void* WNDCAP_TRACE;
+typedef void* WNDCAP_BATCH;
+
+typedef enum
+{
+    WNDCAP_OK = 0,
+    WNDCAP_NO_FRAME = 1,            // nothing new since the last call
+    WNDCAP_BUFFER_TOO_SMALL = 2,    // frame kept, width/height report the size needed
+    WNDCAP_INVALID_ARG = 3,
+    WNDCAP_NEED_KEYFRAME = 4,       // a delta frame that doesn't follow the last one decoded
+    WNDCAP_CLOSED = 5,              // the frame server stopped or was replaced; open it again
+} WNDCAP_RESULT;
+
+typedef enum
+{
+    WNDCAP_FORMAT_BGRA = 0,
+    WNDCAP_FORMAT_RGBA = 1,
+    WNDCAP_FORMAT_RGB24 = 2,
+    WNDCAP_FORMAT_NV12 = 3,         // Y plane, interleaved UV plane with the same stride
+    WNDCAP_FORMAT_I420 = 4,         // Y plane, U and V planes with half the stride
+} WNDCAP_OUTPUT_FORMAT;
+
+typedef enum
+{
+    WNDCAP_BT601_LIMITED = 0,
+    WNDCAP_BT601_FULL = 1,
+    WNDCAP_BT709_LIMITED = 2,
+    WNDCAP_BT709_FULL = 3,
+} WNDCAP_COLOR_SPACE;
+
+typedef struct
+{
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+} WNDCAP_RECT;
+
+typedef enum
+{
+    WNDCAP_SCALE_BOX = 0,           // area average, best for downscaling
+    WNDCAP_SCALE_BILINEAR = 1,
+} WNDCAP_SCALE_FILTER;
+
+typedef enum
+{
+    WNDCAP_FIT_STRETCH = 0,         // fill the output size
+    WNDCAP_FIT_LETTERBOX = 1,       // keep the aspect ratio, pad with black bars
+} WNDCAP_FIT_MODE;
+
+typedef enum
+{
+    WNDCAP_POLICY_LATEST_WINS = 0,  // only the newest frame is kept
+    WNDCAP_POLICY_FIFO = 1,         // frames arriving to a full queue are dropped
+    WNDCAP_POLICY_DROP_OLDEST = 2,  // a full queue evicts its oldest frame
+} WNDCAP_FRAME_POLICY;
+
+typedef struct
+{
+    unsigned long long frames_arrived;
+    unsigned long long frames_delivered;
+    unsigned long long frames_dropped;
+    unsigned long long frames_coalesced;
+} WNDCAP_QUEUE_STATS;
+
+// Latency of one capture stage in nanoseconds. Percentiles are accurate to
+// within 1/8 of their value.
+typedef struct
+{
+    unsigned long long count;
+    unsigned long long mean_ns;
+    unsigned long long p50_ns;
+    unsigned long long p95_ns;
+    unsigned long long p99_ns;
+    unsigned long long max_ns;
+} WNDCAP_STAGE_STATS;
+
+typedef struct
+{
+    WNDCAP_STAGE_STATS acquire;     // TryGetNextFrame
+    WNDCAP_STAGE_STATS copy;        // GPU copy into staging
+    WNDCAP_STAGE_STATS map;         // waiting for the staging copy
+    WNDCAP_STAGE_STATS row_copy;    // copy/convert into the caller's buffer
+    WNDCAP_STAGE_STATS resize;      // frame pool recreation, after the window settles
+    unsigned long long frames;
+    unsigned long long null_frames;
+    unsigned long long resizes;
+    unsigned long long bytes_copied;
+    WNDCAP_STAGE_STATS scale;       // CPU resampling to the output size
+    unsigned long long resize_events;   // window size changes; resizes counts the recreates they caused
+    WNDCAP_STAGE_STATS delivery;    // from the compositor finishing a frame to the caller getting it
+    unsigned long long frames_decimated;    // dropped before readback to hold the target frame rate
+} WNDCAP_CAPTURE_STATS;
+
+typedef struct
+{
+    unsigned int frames_per_case;   // 0 for 120
+    unsigned int source_fps;        // producer rate for the rate-limited cases, 0 for 60
+    WNDCAP_OUTPUT_FORMAT format;
+    WNDCAP_COLOR_SPACE color_space;
+    bool dirty_regions;
+    bool compress;                  // also time WindowCaptureCompressed's encoder and a decoder
+    unsigned int keyframe_interval; // with compress, 0 for 120
+} WNDCAP_BENCHMARK_CONFIG;
+
+typedef struct
+{
+    unsigned int width;             // of the synthetic sources, 0 for 1280x720
+    unsigned int height;
+    unsigned int max_sources;       // batches of 1, 2, 4... up to this many, 0 for 32
+    unsigned int threads;           // copier threads including the caller, 0 for the hardware threads
+    unsigned int readback_latency_us;   // modelled GPU copy time, 0 for 1000
+    unsigned int rounds;            // captures of every source per case, 0 for 60
+} WNDCAP_BATCH_BENCHMARK_CONFIG;
+
+// One capture of a WindowCaptureBatch, with the arguments and the outcome of
+// WindowCaptureEx.
+typedef struct
+{
+    unsigned char* buf;
+    unsigned long long buf_size;
+    unsigned int dst_stride;
+    unsigned int width;             // set as uiWidth and uiHeight are by WindowCaptureEx
+    unsigned int height;
+    WNDCAP_RESULT result;
+} WNDCAP_BATCH_OUTPUT;
+
+// Cursor as of the last copy, tracked separately from the captured frames.
+typedef struct
+{
+    bool visible;                   // showing, with its hotspot inside the frame
+    int x;                          // hotspot, in pixels of the copied frame
+    int y;
+    unsigned long long shape_id;    // changes when the shape does; 0 without a cursor
+    unsigned int width;             // shape size, unscaled
+    unsigned int height;
+    int hotspot_x;
+    int hotspot_y;
+    bool inverts;                   // parts of the shape invert the screen and can't be shown as BGRA alone
+} WNDCAP_CURSOR_INFO;
+
+// When the last copied frame was captured and handed over, in nanoseconds on
+// the QueryPerformanceCounter clock; 0 when unknown.
+typedef struct
+{
+    unsigned long long frame_index;
+    unsigned long long capture_time_ns;
+    unsigned long long delivery_time_ns;
+} WNDCAP_FRAME_TIMING;
+
+// Every timestamp of the last copied frame, on the WNDCAP_FRAME_TIMING clock;
+// 0 when unknown.
+typedef struct
+{
+    unsigned long long frame_id;            // counts delivered frames, never restarting
+    unsigned long long frame_index;         // as in WNDCAP_FRAME_TIMING, restarts with the capture
+    unsigned long long capture_time_ns;     // the compositor finished the frame
+    unsigned long long acquire_time_ns;     // taken off the frame queue, readback started
+    unsigned long long copy_start_ns;       // readback done, CPU copy started
+    unsigned long long copy_end_ns;         // in the caller's buffer
+    unsigned long long delivery_time_ns;    // returned to the caller
+} WNDCAP_FRAME_RECORD;
+
+typedef struct
+{
+    unsigned long long allocated;           // buffers taken fresh from the system
+    unsigned long long reused;              // served from released ones
+    unsigned long long freed;               // given back to the system
+    unsigned long long large_page_buffers;  // of allocated, backed by large pages
+    unsigned long long bytes_in_use;
+    unsigned long long bytes_cached;
+} WNDCAP_BUFFER_POOL_STATS;
+
+typedef struct
+{
+    unsigned int threads;           // copying, the caller included; 0 for the hardware threads, at most 16
+    unsigned long long min_parallel_bytes;  // smaller frames are copied on the caller alone, 0 for 4 MB
+    int numa_node;                  // keep the threads on this node's processors, -1 for any
+    bool pin_workers;               // one processor per thread rather than the whole set
+} WNDCAP_PARALLEL_COPY_CONFIG;
+
+typedef struct
+{
+    unsigned int width;             // one resolution, 0 for 720p to 8K
+    unsigned int height;
+    unsigned int max_threads;       // 1, 2, 4... up to this many threads, 0 for 16
+    unsigned int frames;            // per case, 0 for 60
+    WNDCAP_OUTPUT_FORMAT format;
+    WNDCAP_COLOR_SPACE color_space;
+} WNDCAP_PARALLEL_COPY_BENCHMARK_CONFIG;
+
+typedef struct
+{
+    WNDCAP_OUTPUT_FORMAT format;
+    unsigned int max_width;         // frames are at most this size
+    unsigned int max_height;
+    unsigned int stride;            // of every frame, as dst_stride is for WindowCaptureEx
+    unsigned long long frame_count; // keeps growing while the recording is still being written
+    unsigned int capacity;          // frames the recording can hold
+    bool complete;                  // StopRecording finished it
+} WNDCAP_RECORDING_INFO;
+
+typedef struct
+{
+    unsigned long long frame_index;         // as in WNDCAP_FRAME_TIMING
+    unsigned long long capture_time_ns;
+    unsigned long long delivery_time_ns;
+    unsigned int width;
+    unsigned int height;
+    bool dirty;                     // changed since the previous recorded frame, or not known not to have
+    bool dirty_tracked;             // dirty comes from EnableDirtyRegions rather than being assumed
+} WNDCAP_RECORDED_FRAME;
+
+// A frame from WindowCaptureCompressed, as its header describes it.
+typedef struct
+{
+    unsigned int width;
+    unsigned int height;
+    WNDCAP_OUTPUT_FORMAT format;
+    bool keyframe;                  // decodes on its own; otherwise needs the frame before it
+    unsigned long long sequence;    // counts frames from the first one compressed
+    unsigned long long size;        // encoded bytes, header included; 0 when DecodeFrame copies out again
+} WNDCAP_ENCODED_FRAME;
+
+// A frame read in place from a frame server's shared memory. data is valid
+// until ReleaseServerFrame; the fields after delivery_time_ns are for it.
+typedef struct
+{
+    const unsigned char* data;
+    unsigned int stride;            // as dst_stride is for WindowCaptureEx
+    unsigned long long size;        // readable bytes from data
+    WNDCAP_OUTPUT_FORMAT format;
+    unsigned int width;
+    unsigned int height;
+    unsigned long long frame_number;        // counts the frames the server published, from 1
+    unsigned long long frame_index;         // as in WNDCAP_FRAME_TIMING
+    unsigned long long capture_time_ns;
+    unsigned long long delivery_time_ns;
+    unsigned int slot;
+    unsigned long long sequence;
+} WNDCAP_SERVER_FRAME;
+
+typedef struct
+{
+    HWND hwnd;
+    unsigned int process_id;
+    bool alt_tab;                   // listed by Alt+Tab, which is what a picker wants
+    bool visible;
+    bool cloaked;                   // e.g. on another virtual desktop
+    char title[512];                // UTF-8, cut short if longer
+    char class_name[256];
+} WNDCAP_WINDOW_INFO;
+
+// Windows ListWindows returns: those matching every field set.
+typedef struct
+{
+    const char* title;              // UTF-8, contained in the title ignoring case; nullptr for any
+    const char* class_name;         // UTF-8, the whole class name; nullptr for any
+    unsigned int process_id;        // 0 for any
+    bool alt_tab_only;
+} WNDCAP_WINDOW_QUERY;
+
+typedef void (*WNDCAP_FRAME_CALLBACK)(WNDCAP_HANDLE wndcap_handle, void* user_data);
+
+// In-place view of a captured frame. data points straight into mapped staging
+// memory and is valid until the frame is handed back with ReleaseFrame.
+typedef struct
+{
+    const unsigned char* data;
+    unsigned int row_pitch;           // bytes between rows, may exceed width * 4
+    unsigned int width;
+    unsigned int height;
+    unsigned int format;              // DXGI_FORMAT
+    unsigned long long size;          // readable bytes from data
+    unsigned long long frame_index;
+    unsigned long long capture_time_ns;     // as in WNDCAP_FRAME_TIMING
+    unsigned long long delivery_time_ns;
+} WNDCAP_FRAME_VIEW;
+
 DLLEXPORT WNDCAP_HANDLE InitWndCap(HWND WindowHandle);
 DLLEXPORT bool UninitWndCap(WNDCAP_HANDLE wndcap_handle);
 DLLEXPORT void StartCapture(WNDCAP_HANDLE wndcap_handle, HWND wndHandle);
+// bSkipMouse leaves the cursor out of buf, as SetCursorCapture(false) does;
+// bMouseVisible reports whether it is over the frame either way.
 DLLEXPORT bool WindowCapture(WNDCAP_HANDLE wndcap_handle, unsigned char* buf, unsigned int& uiWidth, unsigned int& uiHeight, bool bSkipMouse, bool& bMouseVisible);
+// Bounds checked WindowCapture. buf_size is the capacity of buf in bytes and
+// dst_stride the distance between rows in buf, 0 for width * 4. A null buf
+// with a buf_size of 0 asks for the size of the next frame alone: it returns
+// WNDCAP_BUFFER_TOO_SMALL with the frame kept for the call that copies it.
+DLLEXPORT WNDCAP_RESULT WindowCaptureEx(WNDCAP_HANDLE wndcap_handle, unsigned char* buf, unsigned long long buf_size, unsigned int dst_stride, unsigned int& uiWidth, unsigned int& uiHeight);
+// Pixel layout written by WindowCapture/WindowCaptureEx. The color space only
+// matters for the YUV formats. Defaults to BGRA.
+DLLEXPORT bool SetOutputFormat(WNDCAP_HANDLE wndcap_handle, WNDCAP_OUTPUT_FORMAT format, WNDCAP_COLOR_SPACE color_space);
+// Bytes WindowCaptureEx needs for a frame of the given size in the current output format.
+DLLEXPORT unsigned long long GetOutputFrameSize(WNDCAP_HANDLE wndcap_handle, unsigned int width, unsigned int height, unsigned int dst_stride);
+// A page aligned buffer for a frame of the given size in the current output
+// format, for WindowCaptureEx; buf_size receives its capacity, which may be
+// more than the frame needs. Buffers come already faulted in, from large pages
+// when the process holds the "Lock pages in memory" right, and are kept for
+// reuse once freed, so allocating after a resize back to a size seen before
+// costs next to nothing. Returns nullptr when out of memory.
+DLLEXPORT unsigned char* AllocFrameBuffer(WNDCAP_HANDLE wndcap_handle, unsigned int width, unsigned int height, unsigned int dst_stride, unsigned long long& buf_size);
+// Hand a buffer back to the handle it came from. Buffers not freed by
+// UninitWndCap are freed with the handle.
+DLLEXPORT bool FreeFrameBuffer(WNDCAP_HANDLE wndcap_handle, unsigned char* buf);
+DLLEXPORT bool GetFrameBufferStats(WNDCAP_HANDLE wndcap_handle, WNDCAP_BUFFER_POOL_STATS* stats);
+// Copy and convert large frames in row strips on a pool of threads kept for
+// the handle, rather than on the thread calling WindowCapture/WindowCaptureEx
+// alone; nullptr turns it off. Off by default.
+DLLEXPORT bool SetParallelCopy(WNDCAP_HANDLE wndcap_handle, const WNDCAP_PARALLEL_COPY_CONFIG* config);
+// Crop and output size for WindowCapture/WindowCaptureEx. crop is in window
+// pixels and is clipped to the window, nullptr for the whole window. A zero
+// out_width and out_height keep the crop size; with only one of them zero it
+// follows the crop's aspect ratio. With both set the output keeps that size
+// while the window is resized, stretched or letterboxed according to fit. The
+// crop and whole 2:1 reductions are done on the GPU before readback, the
+// remainder with filter on the CPU. Both exports report the output size.
+// AcquireFrame views are cropped and may be reduced, but are not resampled to
+// the output size.
+DLLEXPORT bool SetCaptureRegion(WNDCAP_HANDLE wndcap_handle, const WNDCAP_RECT* crop, unsigned int out_width, unsigned int out_height, WNDCAP_SCALE_FILTER filter, WNDCAP_FIT_MODE fit);
+// Deliver at most fps frames per second, 0 (the default) for every frame the
+// window produces. Surplus frames are dropped before they are copied off the
+// GPU, spread evenly rather than in bursts, and counted in frames_decimated.
+DLLEXPORT bool SetCaptureFrameRate(WNDCAP_HANDLE wndcap_handle, double fps);
+// Capture and delivery time of the frame returned by the last successful
+// WindowCapture/WindowCaptureEx.
+DLLEXPORT bool GetFrameTiming(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_TIMING* timing);
+// GetFrameTiming with the time of every stage in between.
+DLLEXPORT bool GetFrameRecord(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_RECORD* record);
+// Trace delivered frames of any number of handles to a Chrome trace JSON file
+// at path (UTF-8, replaced), which chrome://tracing and ui.perfetto.dev open.
+// Each frame shows as a slice from capture to delivery split into queue,
+// readback, copy and deliver. Frames are handed to a writer thread through a
+// lock-free buffer of capacity records, 0 for 4096; frames that find it full
+// are dropped from the trace.
+DLLEXPORT WNDCAP_TRACE OpenFrameTrace(const char* path, unsigned int capacity);
+// Stops every handle tracing to it and finishes the file. Safe to call while
+// other threads set or clear traces on handles, or uninitialize them.
+DLLEXPORT bool CloseFrameTrace(WNDCAP_TRACE trace);
+// Trace the handle's frames under name (UTF-8), or stop with a nullptr trace.
+DLLEXPORT bool SetFrameTrace(WNDCAP_HANDLE wndcap_handle, WNDCAP_TRACE trace, const char* name);
+DLLEXPORT bool GetFrameTraceStats(WNDCAP_TRACE trace, unsigned long long& frames_written, unsigned long long& frames_dropped);
+// Whether WindowCaptureEx blends the cursor into frames. On by default. The
+// cursor is read separately from the capture, so either way its position is
+// available from GetCaptureCursor.
+DLLEXPORT bool SetCursorCapture(WNDCAP_HANDLE wndcap_handle, bool draw);
+// Cursor position and shape as of the last copy. shape may be nullptr;
+// otherwise it receives width * height premultiplied BGRA pixels and must
+// hold at least that many bytes.
+DLLEXPORT bool GetCaptureCursor(WNDCAP_HANDLE wndcap_handle, WNDCAP_CURSOR_INFO* info, unsigned char* shape, unsigned long long shape_size);
+// Tile based change detection for frames returned by WindowCapture/WindowCaptureEx.
+DLLEXPORT bool EnableDirtyRegions(WNDCAP_HANDLE wndcap_handle, bool enable);
+// Changed regions of the last copied frame. count receives the total number of
+// rects; if it exceeds capacity only the first capacity are written and false
+// is returned, in which case the caller should treat the whole frame as dirty.
+DLLEXPORT bool GetDirtyRegions(WNDCAP_HANDLE wndcap_handle, WNDCAP_RECT* rects, unsigned int capacity, unsigned int& count, bool& identical);
+// Event driven delivery instead of polling WindowCapture. The callback runs on a
+// dispatch thread owned by the handle whenever new frames are ready; pass
+// nullptr to remove it. Bursts of frames are coalesced into one call.
+DLLEXPORT bool SetFrameCallback(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_CALLBACK callback, void* user_data);
+// Block until a frame is ready or timeout_ms passes. Returns false on timeout.
+DLLEXPORT bool WaitForFrame(WNDCAP_HANDLE wndcap_handle, unsigned int timeout_ms);
+// Frames queued between the capture pool and WindowCapture, and what to do
+// when the queue is full. Defaults to WNDCAP_POLICY_LATEST_WINS with depth 1;
+// depth is clamped to 1..16.
+DLLEXPORT bool SetFramePolicy(WNDCAP_HANDLE wndcap_handle, unsigned int depth, WNDCAP_FRAME_POLICY policy);
+// Counters for the current capture; reset by StartCapture.
+DLLEXPORT bool GetFrameQueueStats(WNDCAP_HANDLE wndcap_handle, WNDCAP_QUEUE_STATS* stats);
+// Per-stage timings and counters for the current capture; reset by StartCapture.
+// With reset set the next call only covers what happened after this one.
+DLLEXPORT bool GetCaptureStats(WNDCAP_HANDLE wndcap_handle, WNDCAP_CAPTURE_STATS* stats, bool reset);
+// Capture manager: one D3D device, dispatcher queue and compositor shared by
+// many sessions. Sessions are WNDCAP_HANDLEs that work with every export above
+// and are released with UninitWndCap, before the manager is destroyed. Like
+// InitWndCap, the manager must be created on a thread that pumps messages.
+DLLEXPORT WNDCAP_MANAGER CreateCaptureManager();
+DLLEXPORT bool DestroyCaptureManager(WNDCAP_MANAGER manager);
+// min_interval_ms limits how often NextReadySession returns this session, 0 for no limit.
+DLLEXPORT WNDCAP_HANDLE CreateCaptureSession(WNDCAP_MANAGER manager, unsigned int min_interval_ms);
+// The session to read back next: the one whose frame has waited longest among
+// those due. Returns nullptr if none becomes ready within timeout_ms.
+DLLEXPORT WNDCAP_HANDLE NextReadySession(WNDCAP_MANAGER manager, unsigned int timeout_ms);
+// Read a manager session back on the manager's worker threads. Copies for all
+// such sessions overlap on the GPU, and WindowCapture/WindowCaptureEx copy the
+// newest completed frame without waiting on Map. Frame callbacks, WaitForFrame
+// and NextReadySession then signal completed frames rather than captured ones.
+// AcquireFrame is unavailable meanwhile. Fails for handles from InitWndCap.
+DLLEXPORT bool EnableAsyncReadback(WNDCAP_HANDLE wndcap_handle, bool enable);
+// Run the copy path against a synthetic source at 720p to 8K, with the consumer
+// polling flat out, at 60 and at 30 frames/s, and write the results to json as
+// a NUL terminated JSON object. config may be nullptr for defaults. length
+// receives the bytes needed including the terminator; if that exceeds capacity
+// nothing is written and false is returned. 64 KB is plenty for the defaults.
+// Takes tens of seconds; needs no window or GPU.
+DLLEXPORT bool RunCaptureBenchmark(const WNDCAP_BENCHMARK_CONFIG* config, char* json, unsigned long long capacity, unsigned long long& length);
+// Threads for WindowCaptureBatch to copy out of staging on, threads counting
+// the caller, 0 for the hardware threads, at most 8. Destroy it before
+// unloading the DLL, on a thread other than DllMain's: it joins its threads.
+DLLEXPORT WNDCAP_BATCH CreateBatchCopier(unsigned int threads);
+DLLEXPORT bool DestroyBatchCopier(WNDCAP_BATCH batch);
+// WindowCaptureEx for count handles at once, outputs[i] going with handles[i].
+// The staging copies of all of them are issued before any is waited on, so
+// they overlap on the GPU, and the copies out of staging run in parallel on
+// batch's threads. Batches on the same batch from several threads are taken
+// one after another. Returns false if an argument is invalid, including a
+// handle given twice; otherwise every output has its result.
+DLLEXPORT bool WindowCaptureBatch(WNDCAP_BATCH batch, WNDCAP_HANDLE* handles, WNDCAP_BATCH_OUTPUT* outputs, unsigned int count);
+// Time capturing batches of synthetic sources one after another and through
+// WindowCaptureBatch's scheduler, as RunCaptureBenchmark does, for 1 up to
+// max_sources sources.
+DLLEXPORT bool RunBatchBenchmark(const WNDCAP_BATCH_BENCHMARK_CONFIG* config, char* json, unsigned long long capacity, unsigned long long& length);
+// Time getting frame buffers from the heap and from AllocFrameBuffer's pool,
+// fresh and reused, at 720p to 8K, as RunCaptureBenchmark does. iterations
+// is per case, 0 for 20.
+DLLEXPORT bool RunBufferPoolBenchmark(unsigned int iterations, char* json, unsigned long long capacity, unsigned long long& length);
+// Time SetParallelCopy's strip copier on every resolution and thread count,
+// as RunCaptureBenchmark does, with every frame split whatever its size.
+DLLEXPORT bool RunParallelCopyBenchmark(const WNDCAP_PARALLEL_COPY_BENCHMARK_CONFIG* config, char* json, unsigned long long capacity, unsigned long long& length);
+// Record every frame WindowCapture/WindowCaptureEx return to the file at path
+// (UTF-8), replacing it: raw frames in the output format at the time, in
+// fixed size slots of a memory-mapped file, with an index of timestamps,
+// sizes and dirty flags. Frames go straight into the mapping and are flushed
+// to disk in the background. max_width and max_height bound the frames kept,
+// 0 for the current output size; max_frames is the capacity, 0 for 65536.
+// Frames over either limit, or in another format, are counted as dropped.
+DLLEXPORT bool StartRecording(WNDCAP_HANDLE wndcap_handle, const char* path, unsigned int max_width, unsigned int max_height, unsigned int max_frames);
+// Flush and close the recording, trimming the file to the frames written.
+DLLEXPORT bool StopRecording(WNDCAP_HANDLE wndcap_handle);
+DLLEXPORT bool GetRecordingStats(WNDCAP_HANDLE wndcap_handle, unsigned long long& frames_recorded, unsigned long long& frames_dropped);
+// Read a file written by StartRecording, while it is being written or after.
+DLLEXPORT WNDCAP_RECORDING OpenRecording(const char* path);
+DLLEXPORT bool CloseRecording(WNDCAP_RECORDING recording);
+DLLEXPORT bool GetRecordingInfo(WNDCAP_RECORDING recording, WNDCAP_RECORDING_INFO* info);
+// Copy recorded frame number index, counting from 0, into buf at dst_stride,
+// 0 for the packed row size. buf may be nullptr to only read frame. Returns
+// WNDCAP_NO_FRAME past the last frame written, and WNDCAP_BUFFER_TOO_SMALL
+// with frame filled in when buf can't hold it.
+DLLEXPORT WNDCAP_RESULT ReadRecordedFrame(WNDCAP_RECORDING recording, unsigned long long index, unsigned char* buf, unsigned long long buf_size, unsigned int dst_stride, WNDCAP_RECORDED_FRAME* frame);
+// WindowCaptureEx output, losslessly compressed: each frame is XORed with
+// the previous one, or for keyframes with the row above, and run-length
+// coded, so unchanged parts of the window cost next to nothing. encoded_size
+// receives the packet size; WNDCAP_BUFFER_TOO_SMALL keeps the packet for the
+// next call. Frames are in the output format and cropped and scaled as set.
+// Packets go to DecodeFrame in order, starting from a keyframe.
+DLLEXPORT WNDCAP_RESULT WindowCaptureCompressed(WNDCAP_HANDLE wndcap_handle, unsigned char* buf, unsigned long long buf_size, unsigned long long& encoded_size, WNDCAP_ENCODED_FRAME* frame);
+// A keyframe every interval frames, 0 for only when the size or format
+// changes or one is requested. Defaults to 120.
+DLLEXPORT bool SetKeyframeInterval(WNDCAP_HANDLE wndcap_handle, unsigned int interval);
+// Make the next compressed frame a keyframe, for a decoder that joins late.
+DLLEXPORT bool RequestKeyframe(WNDCAP_HANDLE wndcap_handle);
+// Decoder for WindowCaptureCompressed packets; needs no window or GPU.
+DLLEXPORT WNDCAP_DECODER CreateFrameDecoder();
+DLLEXPORT bool DestroyFrameDecoder(WNDCAP_DECODER decoder);
+// Decode a packet and copy the frame into buf at dst_stride, 0 for the packed
+// row size. buf may be nullptr to only decode. data may be nullptr to copy
+// out the last frame decoded again, after WNDCAP_BUFFER_TOO_SMALL.
+DLLEXPORT WNDCAP_RESULT DecodeFrame(WNDCAP_DECODER decoder, const unsigned char* data, unsigned long long size, unsigned char* buf, unsigned long long buf_size, unsigned int dst_stride, WNDCAP_ENCODED_FRAME* frame);
+// Publish frames to other processes through shared memory named name (UTF-8):
+// a ring of slots frames are read back straight into, which readers opened
+// with OpenFrameServer map and read in place. The server never waits for a
+// reader; a frame overwritten while held is reported by ReleaseServerFrame.
+// Serving runs on its own thread, which takes over the handle's frames, so
+// don't also call WindowCapture, WindowCaptureEx or WaitForFrame while it
+// runs. Sizes are as for StartRecording; slots is 2 to 255, 0 for 4. Frames
+// are in the output format at the start. Fails if another live server
+// already has the name.
+DLLEXPORT bool StartFrameServer(WNDCAP_HANDLE wndcap_handle, const char* name, unsigned int max_width, unsigned int max_height, unsigned int slots);
+DLLEXPORT bool StopFrameServer(WNDCAP_HANDLE wndcap_handle);
+// overwrites counts frames reused while a reader still held them.
+DLLEXPORT bool GetFrameServerStats(WNDCAP_HANDLE wndcap_handle, unsigned long long& frames_published, unsigned long long& frames_dropped, unsigned long long& overwrites);
+// Read a frame server, from any process; needs no window or GPU.
+DLLEXPORT WNDCAP_FRAME_CLIENT OpenFrameServer(const char* name);
+DLLEXPORT bool CloseFrameServer(WNDCAP_FRAME_CLIENT client);
+// The newest frame, if newer than the last one acquired, waiting up to
+// timeout_ms for one. One frame can be held at a time. Returns WNDCAP_CLOSED
+// once the server is gone, after which the client only needs closing.
+DLLEXPORT WNDCAP_RESULT AcquireServerFrame(WNDCAP_FRAME_CLIENT client, unsigned int timeout_ms, WNDCAP_SERVER_FRAME* frame);
+// Returns false if the frame was overwritten while held, in which case
+// whatever was read from it must be thrown away.
+DLLEXPORT bool ReleaseServerFrame(WNDCAP_FRAME_CLIENT client, const WNDCAP_SERVER_FRAME* frame);
+// A cached list of top level windows, kept current from window events on a
+// thread of its own, so listing them doesn't walk every window again.
+DLLEXPORT WNDCAP_WINDOWS OpenWindowRegistry();
+DLLEXPORT bool CloseWindowRegistry(WNDCAP_WINDOWS windows);
+// Changes whenever a window comes, goes or changes; a picker polling the list
+// only has to redraw when it does.
+DLLEXPORT unsigned long long GetWindowRegistryVersion(WNDCAP_WINDOWS windows);
+// Copy up to capacity windows matching query, nullptr for all, into list in
+// the order they appeared. Returns how many match, which may be more than
+// capacity; list may be nullptr to only count.
+DLLEXPORT unsigned int ListWindows(WNDCAP_WINDOWS windows, const WNDCAP_WINDOW_QUERY* query, WNDCAP_WINDOW_INFO* list, unsigned int capacity);
+// Zero-copy alternative to WindowCapture. At most two frames can be held at once;
+// call both from the thread that calls WindowCapture.
+DLLEXPORT bool AcquireFrame(WNDCAP_HANDLE wndcap_handle, WNDCAP_FRAME_VIEW* view);
+DLLEXPORT bool ReleaseFrame(WNDCAP_HANDLE wndcap_handle, const WNDCAP_FRAME_VIEW* view);
 
 #ifdef __cplusplus
 }
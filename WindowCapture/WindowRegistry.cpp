@@ -0,0 +1,244 @@
+#include "WindowRegistry.h"
+#include <algorithm>
+#include <cwctype>
+
+bool IsAltTabWindow(WindowInfo const& window)
+{
+    return !window.Shell &&
+        !window.Title.empty() &&
+        window.Visible &&
+        window.Root &&
+        (window.Style & (WindowStyleDisabled | WindowStyleChild)) == 0 &&
+        (window.ExStyle & WindowExStyleToolWindow) == 0 &&
+        !window.Cloaked;
+}
+
+bool ContainsIgnoreCase(std::wstring const& text, std::wstring const& part)
+{
+    auto it = std::search(text.begin(), text.end(), part.begin(), part.end(),
+        [](wchar_t a, wchar_t b) { return std::towlower(a) == std::towlower(b); });
+    return it != text.end() || part.empty();
+}
+
+static bool SameWindow(WindowInfo const& a, WindowInfo const& b)
+{
+    return a.Title == b.Title && a.ClassName == b.ClassName && a.ProcessId == b.ProcessId &&
+        a.Style == b.Style && a.ExStyle == b.ExStyle && a.Visible == b.Visible &&
+        a.Cloaked == b.Cloaked && a.Root == b.Root && a.Shell == b.Shell;
+}
+
+void WindowRegistry::Refresh()
+{
+    uint64_t since = BeginRead();
+    std::vector<uint64_t> handles;
+    m_source.Enumerate(handles);
+    std::vector<WindowInfo> windows;
+    windows.reserve(handles.size());
+    for (auto handle : handles)
+    {
+        WindowInfo info;
+        if (m_source.Read(handle, info))
+            windows.push_back(std::move(info));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<uint64_t, Entry> fresh;
+    fresh.reserve(windows.size());
+    bool changed = false;
+    for (auto& info : windows)
+    {
+        if (DestroyedSinceLocked(info.Handle, since))
+            continue;
+        Entry entry;
+        auto old = m_windows.find(info.Handle);
+        if (old != m_windows.end())
+        {
+            entry.Order = old->second.Order;
+            changed = changed || !SameWindow(old->second.Info, info);
+        }
+        else
+        {
+            entry.Order = ++m_order;
+            changed = true;
+        }
+        entry.Info = std::move(info);
+        fresh[entry.Info.Handle] = std::move(entry);
+    }
+    EndReadLocked();
+    changed = changed || fresh.size() != m_windows.size();
+    m_windows.swap(fresh);
+    if (changed)
+        m_version++;
+}
+
+void WindowRegistry::OnEvent(WindowEvent event, uint64_t handle)
+{
+    if (event == WindowEvent::Destroyed)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_destroys++;
+        if (m_reads != 0)
+            m_tombstones[handle] = m_destroys;
+        if (m_windows.erase(handle) != 0)
+            m_version++;
+        return;
+    }
+
+    // Read outside the lock; these go to the window manager.
+    uint64_t since = BeginRead();
+    WindowInfo info;
+    bool known = event != WindowEvent::Created && Get(handle, info);
+    bool title = event == WindowEvent::TitleChanged;
+    bool read;
+    if (!known)
+        read = m_source.Read(handle, info);
+    else
+        read = title ? m_source.ReadTitle(handle, info.Title) : m_source.ReadState(handle, info);
+
+    // Other events may have landed meanwhile. A window destroyed meanwhile
+    // stays gone, and if its handle has been reused, the event that saw the
+    // new window has read it already.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool destroyed = DestroyedSinceLocked(handle, since);
+    EndReadLocked();
+    if (destroyed)
+        return;
+    if (!known)
+    {
+        info.Handle = handle;
+        UpdateLocked(handle, read, info);
+        return;
+    }
+
+    // Take only what was read here over to the entry as it is now.
+    auto it = m_windows.find(handle);
+    if (it == m_windows.end())
+        return;
+    if (!read)
+    {
+        UpdateLocked(handle, false, info);
+        return;
+    }
+    WindowInfo merged = it->second.Info;
+    if (title)
+    {
+        merged.Title = std::move(info.Title);
+    }
+    else
+    {
+        merged.Style = info.Style;
+        merged.ExStyle = info.ExStyle;
+        merged.Visible = info.Visible;
+        merged.Cloaked = info.Cloaked;
+        merged.Root = info.Root;
+        merged.Shell = info.Shell;
+    }
+    UpdateLocked(handle, true, merged);
+}
+
+void WindowRegistry::UpdateLocked(uint64_t handle, bool read, WindowInfo const& info)
+{
+    auto it = m_windows.find(handle);
+    if (!read)
+    {
+        if (it != m_windows.end())
+        {
+            m_windows.erase(it);
+            m_version++;
+        }
+        return;
+    }
+    if (it == m_windows.end())
+    {
+        Entry entry;
+        entry.Info = info;
+        entry.Order = ++m_order;
+        m_windows.emplace(handle, std::move(entry));
+        m_version++;
+    }
+    else if (!SameWindow(it->second.Info, info))
+    {
+        it->second.Info = info;
+        m_version++;
+    }
+}
+
+uint64_t WindowRegistry::BeginRead()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_reads++;
+    return m_destroys;
+}
+
+bool WindowRegistry::DestroyedSinceLocked(uint64_t handle, uint64_t since) const
+{
+    auto it = m_tombstones.find(handle);
+    return it != m_tombstones.end() && it->second > since;
+}
+
+void WindowRegistry::EndReadLocked()
+{
+    if (--m_reads == 0)
+        m_tombstones.clear();
+}
+
+bool WindowRegistry::Get(uint64_t handle, WindowInfo& info) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_windows.find(handle);
+    if (it == m_windows.end())
+        return false;
+    info = it->second.Info;
+    return true;
+}
+
+std::vector<WindowInfo> WindowRegistry::Query(Filter const& filter) const
+{
+    std::vector<Entry const*> matches;
+    std::vector<WindowInfo> windows;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    matches.reserve(m_windows.size());
+    for (auto const& window : m_windows)
+    {
+        if (!filter || filter(window.second.Info))
+            matches.push_back(&window.second);
+    }
+    std::sort(matches.begin(), matches.end(),
+        [](Entry const* a, Entry const* b) { return a->Order < b->Order; });
+    windows.reserve(matches.size());
+    for (auto entry : matches)
+        windows.push_back(entry->Info);
+    return windows;
+}
+
+std::vector<WindowInfo> WindowRegistry::AltTabWindows() const
+{
+    return Query([](WindowInfo const& window) { return IsAltTabWindow(window); });
+}
+
+std::vector<WindowInfo> WindowRegistry::FindByTitle(std::wstring const& text) const
+{
+    return Query([&text](WindowInfo const& window) { return ContainsIgnoreCase(window.Title, text); });
+}
+
+std::vector<WindowInfo> WindowRegistry::FindByClass(std::wstring const& className) const
+{
+    return Query([&className](WindowInfo const& window) { return window.ClassName == className; });
+}
+
+std::vector<WindowInfo> WindowRegistry::FindByProcess(uint32_t processId) const
+{
+    return Query([processId](WindowInfo const& window) { return window.ProcessId == processId; });
+}
+
+size_t WindowRegistry::Count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_windows.size();
+}
+
+uint64_t WindowRegistry::Version() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_version;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Style bits IsAltTabWindow looks at, with their Win32 values.
+constexpr uint32_t WindowStyleDisabled = 0x08000000;   // WS_DISABLED
+constexpr uint32_t WindowStyleChild = 0x40000000;      // WS_CHILD
+constexpr uint32_t WindowExStyleToolWindow = 0x00000080; // WS_EX_TOOLWINDOW
+
+// What is known about a top level window. Class and process never change for
+// the life of a window, so they are read once; the rest is kept current from
+// window events.
+struct WindowInfo
+{
+    uint64_t Handle = 0;        // HWND
+    std::wstring Title;
+    std::wstring ClassName;
+    uint32_t ProcessId = 0;
+    uint32_t Style = 0;         // GWL_STYLE
+    uint32_t ExStyle = 0;       // GWL_EXSTYLE
+    bool Visible = false;
+    bool Cloaked = false;       // DWMWA_CLOAKED, e.g. on another virtual desktop
+    bool Root = false;          // its own GA_ROOT ancestor
+    bool Shell = false;         // the shell's desktop window
+};
+
+// Whether the window would show up in Alt+Tab, which is what a window picker
+// lists.
+bool IsAltTabWindow(WindowInfo const& window);
+
+enum class WindowEvent
+{
+    Created,
+    Destroyed,
+    Shown,
+    Hidden,
+    TitleChanged,
+    StateChanged,   // styles, parent or cloaking
+};
+
+// Where WindowRegistry reads window attributes from. Reads return false for
+// windows that are gone or aren't top level.
+class IWindowSource
+{
+public:
+    virtual ~IWindowSource() = default;
+
+    virtual void Enumerate(std::vector<uint64_t>& handles) = 0;
+    // Everything, for a window seen for the first time.
+    virtual bool Read(uint64_t handle, WindowInfo& info) = 0;
+    virtual bool ReadTitle(uint64_t handle, std::wstring& title) = 0;
+    // Style, ExStyle, Visible, Cloaked, Root and Shell.
+    virtual bool ReadState(uint64_t handle, WindowInfo& info) = 0;
+};
+
+// Top level windows, cached and kept up to date one event at a time, so
+// listing them costs no calls into the window manager. Events may come from
+// any thread, as may queries.
+class WindowRegistry
+{
+public:
+    using Filter = std::function<bool(WindowInfo const&)>;
+
+    explicit WindowRegistry(IWindowSource& source) : m_source(source) {}
+
+    WindowRegistry(WindowRegistry const&) = delete;
+    WindowRegistry& operator=(WindowRegistry const&) = delete;
+
+    // Rebuild from a full enumeration, for the start and for when events may
+    // have been missed.
+    void Refresh();
+    // Apply one event, reading only what it can have changed. Events for
+    // windows not yet known read them in full. A read that a Destroyed event
+    // for the same window overtook is thrown away, even if the handle was
+    // reused meanwhile.
+    void OnEvent(WindowEvent event, uint64_t handle);
+
+    bool Get(uint64_t handle, WindowInfo& info) const;
+    // Windows for which filter is true, nullptr for all, in the order they
+    // were first seen. filter runs under the registry's lock and must not
+    // call back into it.
+    std::vector<WindowInfo> Query(Filter const& filter) const;
+    std::vector<WindowInfo> AltTabWindows() const;
+    // Titles containing text, ignoring case.
+    std::vector<WindowInfo> FindByTitle(std::wstring const& text) const;
+    std::vector<WindowInfo> FindByClass(std::wstring const& className) const;
+    std::vector<WindowInfo> FindByProcess(uint32_t processId) const;
+
+    size_t Count() const;
+    // Bumped by every change to a window, so a picker can skip redrawing a
+    // list that is still the same.
+    uint64_t Version() const;
+
+private:
+    struct Entry
+    {
+        WindowInfo Info;
+        uint64_t Order = 0;
+    };
+
+    // Store info for handle, or drop the window if read failed.
+    void UpdateLocked(uint64_t handle, bool read, WindowInfo const& info);
+    // Reads made outside the lock are bracketed by these: BeginRead returns
+    // the destroy count to check the window against once the read is done.
+    uint64_t BeginRead();
+    bool DestroyedSinceLocked(uint64_t handle, uint64_t since) const;
+    void EndReadLocked();
+
+    IWindowSource& m_source;
+    mutable std::mutex m_mutex;
+    std::unordered_map<uint64_t, Entry> m_windows;
+    uint64_t m_order = 0;
+    uint64_t m_version = 0;
+    // Windows destroyed while reads were in flight, with the destroy count
+    // when they were; cleared once no read is.
+    std::unordered_map<uint64_t, uint64_t> m_tombstones;
+    uint64_t m_destroys = 0;
+    uint32_t m_reads = 0;
+};
+
+// Substring match ignoring case, as FindByTitle uses.
+bool ContainsIgnoreCase(std::wstring const& text, std::wstring const& part);
@@ -1,8 +1,27 @@
 #pragma once
+#include <winrt/Windows.System.h>
 #include <winrt/Windows.UI.Composition.h>
 #include <windows.ui.composition.interop.h>
+#include <DispatcherQueue.h>
 #include <d2d1_1.h>
 
+// Direct3D11CaptureFramePool requires a DispatcherQueue
+inline auto CreateDispatcherQueueController()
+{
+    namespace abi = ABI::Windows::System;
+
+    DispatcherQueueOptions options
+    {
+        sizeof(DispatcherQueueOptions),
+        DQTYPE_THREAD_CURRENT,
+        DQTAT_COM_STA
+    };
+
+    winrt::Windows::System::DispatcherQueueController controller{ nullptr };
+    winrt::check_hresult(CreateDispatcherQueueController(options, reinterpret_cast<abi::IDispatcherQueueController**>(winrt::put_abi(controller))));
+    return controller;
+}
+
 inline auto CreateCompositionGraphicsDevice(
     winrt::Windows::UI::Composition::Compositor const& compositor,
     ::IUnknown* device)
@@ -36,7 +36,8 @@ public:
     }
     ~D3D11DeviceLock()
     {
-        m_multithread->Leave();
+        if (m_multithread)
+            m_multithread->Leave();
         m_multithread = nullptr;
     }
 private:
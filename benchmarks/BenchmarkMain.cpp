@@ -0,0 +1,223 @@
+// Runs the CaptureBenchmark suites outside the DLL and writes their results
+// as one JSON object keyed by suite, to stdout or to --out.
+//
+//   WindowCaptureBenchmark [--quick] [--out path] [suite...]
+//
+// No suite named runs them all. --quick cuts every suite down to a few
+// frames at one resolution, for checking the driver rather than measuring.
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "CaptureBenchmark.h"
+
+namespace
+{
+    struct Suite
+    {
+        const char* Name;
+        std::function<std::string(bool quick)> Run;
+    };
+
+    BenchmarkResolution const QuickResolution{ "720p", 1280, 720 };
+
+    std::string RunCapture(bool quick)
+    {
+        CaptureBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.ConsumerRates = { 0, 60 };
+            config.FramesPerCase = 10;
+            config.WarmupFrames = 2;
+        }
+        return CaptureBenchmarkToJson(config, RunCaptureBenchmark(config));
+    }
+
+    std::string RunRowCopy(bool quick)
+    {
+        RowCopyBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.Iterations = 3;
+        }
+        return RowCopyBenchmarkToJson(config, RunRowCopyBenchmark(config));
+    }
+
+    std::string RunConvert(bool quick)
+    {
+        ConvertBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.Iterations = 3;
+        }
+        return ConvertBenchmarkToJson(config, RunConvertBenchmark(config));
+    }
+
+    std::string RunTileDiff(bool quick)
+    {
+        TileDiffBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.Frames = 5;
+        }
+        return TileDiffBenchmarkToJson(config, RunTileDiffBenchmark(config));
+    }
+
+    std::string RunScale(bool quick)
+    {
+        ScaleBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { { "1080p", 1920, 1080 } };
+            config.Outputs = { QuickResolution, { "360p", 640, 360 } };
+            config.Iterations = 3;
+        }
+        return ScaleBenchmarkToJson(config, RunScaleBenchmark(config));
+    }
+
+    std::string RunRecording(bool quick)
+    {
+        RecordingBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.Frames = 10;
+        }
+        return RecordingBenchmarkToJson(config, RunRecordingBenchmark(config));
+    }
+
+    std::string RunCodec(bool quick)
+    {
+        CodecBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.Frames = 5;
+        }
+        return CodecBenchmarkToJson(config, RunCodecBenchmark(config));
+    }
+
+    std::string RunBatch(bool quick)
+    {
+        BatchBenchmarkConfig config;
+        if (quick)
+        {
+            config.SourceCounts = { 1, 4 };
+            config.Rounds = 5;
+            config.WarmupRounds = 1;
+        }
+        return BatchBenchmarkToJson(config, RunBatchBenchmark(config));
+    }
+
+    std::string RunBufferPool(bool quick)
+    {
+        BufferPoolBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.Iterations = 3;
+        }
+        return BufferPoolBenchmarkToJson(config, RunBufferPoolBenchmark(config));
+    }
+
+    std::string RunStrip(bool quick)
+    {
+        StripBenchmarkConfig config;
+        if (quick)
+        {
+            config.Resolutions = { QuickResolution };
+            config.ThreadCounts = { 1, 2 };
+            config.Frames = 3;
+        }
+        return StripBenchmarkToJson(config, RunStripBenchmark(config));
+    }
+
+    std::vector<Suite> Suites()
+    {
+        return {
+            { "capture", RunCapture },
+            { "rowcopy", RunRowCopy },
+            { "convert", RunConvert },
+            { "tilediff", RunTileDiff },
+            { "scale", RunScale },
+            { "recording", RunRecording },
+            { "codec", RunCodec },
+            { "batch", RunBatch },
+            { "bufferpool", RunBufferPool },
+            { "strip", RunStrip },
+        };
+    }
+
+    int Usage()
+    {
+        std::fprintf(stderr, "usage: WindowCaptureBenchmark [--quick] [--out path] [suite...]\nsuites:");
+        for (auto const& suite : Suites())
+            std::fprintf(stderr, " %s", suite.Name);
+        std::fprintf(stderr, "\n");
+        return 2;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = false;
+    const char* outPath = nullptr;
+    std::vector<Suite> selected;
+    auto suites = Suites();
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0)
+        {
+            quick = true;
+        }
+        else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+        {
+            outPath = argv[++i];
+        }
+        else
+        {
+            bool found = false;
+            for (auto const& suite : suites)
+            {
+                if (std::strcmp(argv[i], suite.Name) == 0)
+                {
+                    selected.push_back(suite);
+                    found = true;
+                }
+            }
+            if (!found)
+                return Usage();
+        }
+    }
+    if (selected.empty())
+        selected = suites;
+
+    std::string out = "{";
+    for (size_t i = 0; i < selected.size(); i++)
+    {
+        std::fprintf(stderr, "%s...\n", selected[i].Name);
+        if (i != 0)
+            out += ',';
+        out += '"';
+        out += selected[i].Name;
+        out += "\":";
+        out += selected[i].Run(quick);
+    }
+    out += "}\n";
+
+    std::FILE* file = outPath != nullptr ? std::fopen(outPath, "w") : stdout;
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "can't write %s\n", outPath);
+        return 1;
+    }
+    bool written = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    if (file != stdout)
+        written = std::fclose(file) == 0 && written;
+    return written ? 0 : 1;
+}
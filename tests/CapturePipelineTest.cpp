@@ -0,0 +1,195 @@
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "CapturePipeline.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    constexpr uint32_t Width = 300;
+    constexpr uint32_t Height = 200;
+    constexpr uint32_t BoxSize = 64;
+
+    SyntheticSourceConfig OnDemand()
+    {
+        SyntheticSourceConfig config;
+        config.Width = Width;
+        config.Height = Height;
+        config.BoxSize = BoxSize;
+        return config;
+    }
+
+    std::vector<uint8_t> Rendered(uint32_t width, uint32_t height, uint64_t frameIndex)
+    {
+        std::vector<uint8_t> frame(static_cast<size_t>(width) * 4 * height);
+        SyntheticCaptureSource::RenderFrame(frame.data(), static_cast<size_t>(width) * 4, width, height, BoxSize, frameIndex);
+        return frame;
+    }
+
+    // Whether buf holds frame frameIndex in BGRA rows stride bytes apart.
+    bool HoldsFrame(std::vector<uint8_t> const& buf, size_t stride, uint32_t width, uint32_t height, uint64_t frameIndex)
+    {
+        auto expected = Rendered(width, height, frameIndex);
+        size_t rowBytes = static_cast<size_t>(width) * 4;
+        for (uint32_t y = 0; y < height; y++)
+        {
+            if (std::memcmp(buf.data() + y * stride, expected.data() + y * rowBytes, rowBytes) != 0)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST(CopiesHoldTheRenderedFrames)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 1);
+    std::vector<uint8_t> buf(Width * 4 * Height);
+    uint64_t last = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        REQUIRE(pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok);
+        CHECK(width == Width && height == Height);
+        auto const& timing = pipeline.GetFrameTiming();
+        CHECK(i == 0 || timing.FrameIndex > last);
+        last = timing.FrameIndex;
+        CHECK(HoldsFrame(buf, Width * 4, Width, Height, timing.FrameIndex));
+        CHECK(timing.FrameId == static_cast<uint64_t>(i + 1));
+        CHECK(timing.CopyStartNs <= timing.CopyEndNs && timing.CopyEndNs <= timing.DeliveryTimeNs);
+    }
+    auto snapshot = stats.Snapshot();
+    CHECK(snapshot.Frames == 5);
+    CHECK(snapshot.BytesCopied == 5ull * Width * 4 * Height);
+    CHECK(snapshot.Stages[static_cast<size_t>(CaptureStage::RowCopy)].Count == 5);
+}
+
+TEST(PaddedDestinationRowsAreLeftAlone)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 1);
+    constexpr size_t Stride = Width * 4 + 40;
+    std::vector<uint8_t> buf(Stride * Height, 0xCD);
+    uint32_t width = 0;
+    uint32_t height = 0;
+    REQUIRE(pipeline.CopyImage(buf.data(), buf.size(), Stride, width, height) == CopyResult::Ok);
+    CHECK(HoldsFrame(buf, Stride, Width, Height, pipeline.GetFrameTiming().FrameIndex));
+    bool padding = true;
+    for (uint32_t y = 0; y < Height; y++)
+    {
+        for (size_t x = Width * 4; x < Stride; x++)
+            padding = padding && buf[y * Stride + x] == 0xCD;
+    }
+    CHECK(padding);
+    // A stride narrower than a row is refused like a short buffer.
+    CHECK(pipeline.CopyImage(buf.data(), buf.size(), Width * 4 - 4, width, height) == CopyResult::BufferTooSmall);
+}
+
+TEST(ShortBuffersKeepTheFrameForARetry)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 1);
+    std::vector<uint8_t> buf(Width * 4 * Height);
+    uint32_t width = 0;
+    uint32_t height = 0;
+    REQUIRE(pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok);
+    auto first = pipeline.GetFrameTiming().FrameIndex;
+
+    // The size needed comes back with the refusal.
+    CHECK(pipeline.CopyImage(buf.data(), 100, 0, width, height) == CopyResult::BufferTooSmall);
+    CHECK(width == Width && height == Height);
+    REQUIRE(pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok);
+    auto retried = pipeline.GetFrameTiming().FrameIndex;
+    CHECK(retried == first + 1);
+    CHECK(HoldsFrame(buf, Width * 4, Width, Height, retried));
+    CHECK(stats.Snapshot().Frames == 2);
+}
+
+TEST(CopiesAreConvertedToTheOutputFormat)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 1);
+    for (auto format : { OutputFormat::Rgba, OutputFormat::Rgb24, OutputFormat::Nv12, OutputFormat::I420 })
+    {
+        ConvertParams params;
+        params.Format = format;
+        pipeline.SetOutputFormat(params);
+        std::vector<uint8_t> buf(GetOutputFrameSize(format, Width, Height, 0));
+        uint32_t width = 0;
+        uint32_t height = 0;
+        REQUIRE(pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok);
+
+        auto frame = Rendered(Width, Height, pipeline.GetFrameTiming().FrameIndex);
+        std::vector<uint8_t> expected(buf.size());
+        ConvertFrame(expected.data(), GetOutputRowBytes(format, Width), frame.data(), Width * 4, Width, Height, params);
+        CHECK(buf == expected);
+    }
+}
+
+TEST(UnstartedSourcesHaveNoFrames)
+{
+    SyntheticSourceConfig config = OnDemand();
+    config.FrameRate = 100;
+    CaptureStats stats;
+    SyntheticCaptureSource source(config, &stats);
+    CapturePipeline pipeline(source, stats, 1);
+    std::vector<uint8_t> buf(Width * 4 * Height);
+    uint32_t width = 0;
+    uint32_t height = 0;
+    CHECK(pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::NoFrame);
+    FrameLease lease;
+    CHECK(!pipeline.LeaseFrame(lease));
+    auto snapshot = stats.Snapshot();
+    CHECK(snapshot.NullFrames == 2);
+    CHECK(snapshot.Frames == 0);
+}
+
+TEST(ProducedFramesArriveInOrder)
+{
+    // A source composing on its own thread, polled faster than it produces.
+    SyntheticSourceConfig config = OnDemand();
+    config.FrameRate = 200;
+    CaptureStats stats;
+    SyntheticCaptureSource source(config, &stats);
+    CapturePipeline pipeline(source, stats, 1);
+    source.StartCapture();
+    std::vector<uint8_t> buf(Width * 4 * Height);
+    std::vector<uint64_t> delivered;
+    bool matched = true;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (delivered.size() < 10 && std::chrono::steady_clock::now() < deadline)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) != CopyResult::Ok)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        auto const& timing = pipeline.GetFrameTiming();
+        delivered.push_back(timing.FrameIndex);
+        matched = matched && HoldsFrame(buf, Width * 4, Width, Height, timing.FrameIndex);
+        matched = matched && timing.CaptureTimeNs != 0 && timing.CaptureTimeNs <= timing.AcquireTimeNs;
+    }
+    source.Close();
+    REQUIRE(delivered.size() == 10);
+    CHECK(matched);
+    bool ordered = true;
+    for (size_t i = 1; i < delivered.size(); i++)
+        ordered = ordered && delivered[i] > delivered[i - 1];
+    CHECK(ordered);
+    auto snapshot = stats.Snapshot();
+    CHECK(snapshot.Frames == 10);
+    CHECK(snapshot.Stages[static_cast<size_t>(CaptureStage::Delivery)].Count == 10);
+    // Closed sources hand out nothing more.
+    uint32_t width = 0;
+    uint32_t height = 0;
+    CHECK(pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::NoFrame);
+}
@@ -0,0 +1,168 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "CaptureStats.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // Whether a percentile read back lies within the histogram's promised
+    // precision above the exact value.
+    bool Close(uint64_t reported, uint64_t exact)
+    {
+        return reported >= exact && reported - exact <= exact / LatencyHistogram::SubBuckets + 1;
+    }
+}
+
+TEST(SmallValuesHaveABucketEach)
+{
+    for (uint64_t ns = 0; ns < LatencyHistogram::LinearLimit; ns++)
+    {
+        CHECK(LatencyHistogram::BucketOf(ns) == ns);
+        CHECK(LatencyHistogram::BucketUpperBound(static_cast<uint32_t>(ns)) == ns);
+    }
+}
+
+TEST(BucketsTileTheRangeWithoutGaps)
+{
+    for (uint32_t bucket = 0; bucket + 1 < LatencyHistogram::BucketCount; bucket++)
+    {
+        uint64_t bound = LatencyHistogram::BucketUpperBound(bucket);
+        CHECK(LatencyHistogram::BucketOf(bound) == bucket);
+        CHECK(LatencyHistogram::BucketOf(bound + 1) == bucket + 1);
+    }
+    // Beyond the last exponent everything shares the last bucket.
+    CHECK(LatencyHistogram::BucketOf(UINT64_MAX) == LatencyHistogram::BucketCount - 1);
+    CHECK(LatencyHistogram::BucketOf(uint64_t(1) << 50) == LatencyHistogram::BucketCount - 1);
+}
+
+TEST(EmptyHistogramReadsZero)
+{
+    LatencyHistogram histogram;
+    CHECK(histogram.Count() == 0);
+    CHECK(histogram.Mean() == 0);
+    CHECK(histogram.Max() == 0);
+    CHECK(histogram.Percentile(50) == 0);
+    CHECK(histogram.Percentile(100) == 0);
+}
+
+TEST(PercentilesAreWithinOneSubBucket)
+{
+    LatencyHistogram histogram;
+    constexpr uint64_t Samples = 100000;
+    for (uint64_t ns = 1; ns <= Samples; ns++)
+        histogram.Record(ns * 1000);
+    CHECK(histogram.Count() == Samples);
+    CHECK(histogram.Max() == Samples * 1000);
+    CHECK(histogram.Mean() == (Samples + 1) * 1000 / 2);
+    CHECK(Close(histogram.Percentile(50), 50000 * 1000));
+    CHECK(Close(histogram.Percentile(95), 95000 * 1000));
+    CHECK(Close(histogram.Percentile(99), 99000 * 1000));
+    // The top is capped at the largest sample rather than its bucket's bound.
+    CHECK(histogram.Percentile(100) == Samples * 1000);
+    CHECK(histogram.Percentile(250) == Samples * 1000);
+    CHECK(Close(histogram.Percentile(0), 1000));
+    CHECK(Close(histogram.Percentile(-5), 1000));
+}
+
+TEST(OutliersShowInTheTailOnly)
+{
+    // A steady 2 ms with one frame in a hundred at 40 ms.
+    LatencyHistogram histogram;
+    for (int i = 0; i < 1000; i++)
+        histogram.Record(i % 100 == 99 ? 40000000 : 2000000);
+    CHECK(Close(histogram.Percentile(50), 2000000));
+    CHECK(Close(histogram.Percentile(95), 2000000));
+    CHECK(histogram.Percentile(99.5) == 40000000);
+    CHECK(histogram.Max() == 40000000);
+}
+
+TEST(ResetStartsOver)
+{
+    LatencyHistogram histogram;
+    histogram.Record(500);
+    histogram.Record(70000);
+    histogram.Reset();
+    CHECK(histogram.Count() == 0);
+    CHECK(histogram.Max() == 0);
+    CHECK(histogram.Percentile(99) == 0);
+    histogram.Record(300);
+    CHECK(histogram.Count() == 1);
+    CHECK(Close(histogram.Percentile(50), 300));
+}
+
+TEST(ConcurrentRecordsAreAllCounted)
+{
+    LatencyHistogram histogram;
+    constexpr uint64_t Threads = 4;
+    constexpr uint64_t PerThread = 50000;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < Threads; t++)
+    {
+        threads.emplace_back([&histogram, t] {
+            for (uint64_t i = 0; i < PerThread; i++)
+                histogram.Record(t * PerThread + i);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    CHECK(histogram.Count() == Threads * PerThread);
+    CHECK(histogram.Max() == Threads * PerThread - 1);
+    CHECK(histogram.Mean() == (Threads * PerThread - 1) / 2);
+}
+
+TEST(SnapshotReportsEachStage)
+{
+    CaptureStats stats;
+    stats.Record(CaptureStage::Copy, 1000);
+    stats.Record(CaptureStage::Copy, 3000);
+    stats.Record(CaptureStage::Map, -50);
+    stats.AddFrame();
+    stats.AddFrame();
+    stats.AddNullFrame();
+    stats.AddBytesCopied(4096);
+    auto snapshot = stats.Snapshot();
+    auto const& copy = snapshot.Stages[static_cast<size_t>(CaptureStage::Copy)];
+    CHECK(copy.Count == 2);
+    CHECK(copy.MeanNs == 2000);
+    CHECK(copy.MaxNs == 3000);
+    CHECK(Close(copy.P50Ns, 1000));
+    CHECK(copy.P99Ns == 3000);
+    // Clock hiccups going backwards count as zero rather than wrapping.
+    auto const& map = snapshot.Stages[static_cast<size_t>(CaptureStage::Map)];
+    CHECK(map.Count == 1 && map.MaxNs == 0);
+    CHECK(snapshot.Stages[static_cast<size_t>(CaptureStage::Scale)].Count == 0);
+    CHECK(snapshot.Frames == 2);
+    CHECK(snapshot.NullFrames == 1);
+    CHECK(snapshot.BytesCopied == 4096);
+}
+
+TEST(SnapshotWithResetStartsANewWindow)
+{
+    CaptureStats stats;
+    stats.Record(CaptureStage::Acquire, 10000);
+    stats.AddResize();
+    stats.AddDecimated();
+    auto first = stats.Snapshot(true);
+    CHECK(first.Stages[static_cast<size_t>(CaptureStage::Acquire)].Count == 1);
+    CHECK(first.Resizes == 1 && first.Decimated == 1);
+    auto second = stats.Snapshot();
+    CHECK(second.Stages[static_cast<size_t>(CaptureStage::Acquire)].Count == 0);
+    CHECK(second.Resizes == 0 && second.Decimated == 0);
+    // Without reset the totals keep running.
+    stats.AddResizeEvent();
+    stats.Snapshot();
+    CHECK(stats.Snapshot().ResizeEvents == 1);
+}
+
+TEST(ScopedTimerTimesItsScope)
+{
+    CaptureStats stats;
+    {
+        CaptureStats::ScopedTimer timer(stats, CaptureStage::RowCopy);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    auto const& rowCopy = stats.Snapshot().Stages[static_cast<size_t>(CaptureStage::RowCopy)];
+    CHECK(rowCopy.Count == 1);
+    CHECK(rowCopy.MaxNs >= 5000000);
+}
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <vector>
+#include "CapturePipeline.h"
+#include "CursorCompositor.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // A BGRA image with padded rows, every pixel different.
+    struct Image
+    {
+        uint32_t Width;
+        uint32_t Height;
+        size_t Stride;
+        std::vector<uint8_t> Pixels;
+
+        Image(uint32_t width, uint32_t height)
+            : Width(width), Height(height), Stride(width * 4 + 16), Pixels(Stride * height)
+        {
+            for (size_t i = 0; i < Pixels.size(); i++)
+                Pixels[i] = static_cast<uint8_t>(i * 31 + 7);
+        }
+
+        uint8_t* At(uint32_t x, uint32_t y) { return Pixels.data() + y * Stride + x * 4; }
+    };
+
+    // Straight from the definition: premultiplied source over destination,
+    // rounded like Div255, then invert where the mask says so.
+    void ReferenceBlend(Image& image, CursorShape const& shape, int32_t x, int32_t y, bool swapRedBlue)
+    {
+        for (uint32_t sy = 0; sy < shape.Height; sy++)
+        {
+            for (uint32_t sx = 0; sx < shape.Width; sx++)
+            {
+                int64_t dx = static_cast<int64_t>(x) - shape.HotspotX + sx;
+                int64_t dy = static_cast<int64_t>(y) - shape.HotspotY + sy;
+                if (dx < 0 || dy < 0 || dx >= image.Width || dy >= image.Height)
+                    continue;
+                uint8_t* out = image.At(static_cast<uint32_t>(dx), static_cast<uint32_t>(dy));
+                const uint8_t* src = &shape.Pixels[(sy * shape.Width + sx) * 4];
+                uint8_t ordered[4] = { src[swapRedBlue ? 2 : 0], src[1], src[swapRedBlue ? 0 : 2], src[3] };
+                for (int c = 0; c < 4; c++)
+                {
+                    uint32_t scaled = out[c] * (255u - src[3]) + 128;
+                    scaled = (scaled + (scaled >> 8)) >> 8;
+                    out[c] = static_cast<uint8_t>(std::min<uint32_t>(255, ordered[c] + scaled));
+                }
+                if (!shape.Invert.empty() && shape.Invert[sy * shape.Width + sx] != 0)
+                {
+                    for (int c = 0; c < 3; c++)
+                        out[c] = static_cast<uint8_t>(255 - out[c]);
+                }
+            }
+        }
+    }
+
+    // A width x height cursor whose alpha sweeps every value; with invert,
+    // every seventh pixel inverts too. Only for drawing: the hash is left
+    // as it was before the mask went in.
+    CursorShape Gradient(uint32_t width, uint32_t height, bool invert)
+    {
+        std::vector<uint32_t> argb(width * height);
+        for (uint32_t i = 0; i < argb.size(); i++)
+            argb[i] = (i * 37 % 256) << 24 | (i * 11 % 256) << 16 | (i * 5 % 256) << 8 | (i * 3 % 256);
+        auto shape = MakeAlphaCursor(width, height, 2, 3, argb.data());
+        if (invert)
+        {
+            shape.Invert.assign(width * height, 0);
+            for (uint32_t i = 0; i < shape.Invert.size(); i += 7)
+                shape.Invert[i] = 1;
+        }
+        return shape;
+    }
+}
+
+TEST(AlphaCursorsArePremultiplied)
+{
+    uint32_t const argb[] = { 0xFFFF8000, 0x80FF8000, 0x00FFFFFF, 0x40204060 };
+    auto shape = MakeAlphaCursor(2, 2, 1, 0, argb);
+    CHECK(shape.Width == 2 && shape.Height == 2 && shape.HotspotX == 1);
+    CHECK(shape.Invert.empty());
+    uint8_t const expected[] = { 0x00, 0x80, 0xFF, 0xFF, 0x00, 0x40, 0x80, 0x80, 0, 0, 0, 0, 0x18, 0x10, 0x08, 0x40 };
+    CHECK(std::equal(shape.Pixels.begin(), shape.Pixels.end(), expected));
+}
+
+TEST(MonochromeCursorsFollowTheMaskTable)
+{
+    // and/xor: 0/0 black, 0/1 white, 1/0 transparent, 1/1 invert.
+    uint32_t const andMask[] = { 0, 0, 0xFFFFFF, 0xFFFFFF };
+    uint32_t const xorMask[] = { 0, 0xFFFFFF, 0, 0xFFFFFF };
+    auto shape = MakeMonochromeCursor(4, 1, 0, 0, andMask, xorMask);
+    uint8_t const expected[] = { 0, 0, 0, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0 };
+    CHECK(std::equal(shape.Pixels.begin(), shape.Pixels.end(), expected));
+    REQUIRE(shape.Invert.size() == 4);
+    CHECK(shape.Invert[0] == 0 && shape.Invert[2] == 0 && shape.Invert[3] == 1);
+}
+
+TEST(MaskedCursorsInvertUnderTheirColor)
+{
+    uint32_t const rgb[] = { 0x102030, 0x000000, 0xFFFFFF };
+    uint32_t const andMask[] = { 0, 0xFFFFFF, 0xFFFFFF };
+    auto shape = MakeMaskedCursor(3, 1, 0, 0, rgb, andMask);
+    uint8_t const expected[] = { 0x30, 0x20, 0x10, 255, 0, 0, 0, 0, 0, 0, 0, 0 };
+    CHECK(std::equal(shape.Pixels.begin(), shape.Pixels.end(), expected));
+    REQUIRE(shape.Invert.size() == 3);
+    CHECK(shape.Invert[1] == 0 && shape.Invert[2] == 1);
+    // Without any inverting pixel the mask is dropped.
+    uint32_t const opaque[] = { 0, 0, 0 };
+    CHECK(MakeMaskedCursor(3, 1, 0, 0, rgb, opaque).Invert.empty());
+}
+
+TEST(BlendMatchesTheReference)
+{
+    // Widths around the four pixel vector step, both channel orders.
+    for (uint32_t width : { 1u, 3u, 4u, 5u, 8u, 13u, 32u })
+    {
+        for (bool invert : { false, true })
+        {
+            for (bool swap : { false, true })
+            {
+                auto shape = Gradient(width, 9, invert);
+                Image image(40, 30);
+                Image expected = image;
+                BlendCursor(image.Pixels.data(), image.Stride, image.Width, image.Height, shape, 5, 6, swap);
+                ReferenceBlend(expected, shape, 5, 6, swap);
+                CHECK(image.Pixels == expected.Pixels);
+            }
+        }
+    }
+}
+
+TEST(BlendIsClippedToTheImage)
+{
+    auto shape = Gradient(16, 16, true);
+    int32_t const positions[][2] = { { 0, 0 }, { -10, 5 }, { 35, 25 }, { 39, 29 }, { 2, -14 }, { -100, -100 }, { 500, 10 } };
+    for (auto const& position : positions)
+    {
+        Image image(40, 30);
+        Image expected = image;
+        BlendCursor(image.Pixels.data(), image.Stride, image.Width, image.Height, shape, position[0], position[1]);
+        ReferenceBlend(expected, shape, position[0], position[1], false);
+        // Row padding is never touched, so the whole buffer must match.
+        CHECK(image.Pixels == expected.Pixels);
+    }
+}
+
+TEST(ScaledShapesKeepTheirHotspotAndMask)
+{
+    uint32_t const andMask[] = { 0, 0, 0xFFFFFF, 0xFFFFFF };
+    uint32_t const xorMask[] = { 0xFFFFFF, 0, 0, 0xFFFFFF };
+    auto shape = MakeMonochromeCursor(2, 2, 1, 1, andMask, xorMask);
+    auto doubled = ScaleCursorShape(shape, 4, 4);
+    CHECK(doubled.Width == 4 && doubled.Height == 4);
+    CHECK(doubled.HotspotX == 2 && doubled.HotspotY == 2);
+    REQUIRE(doubled.Invert.size() == 16);
+    CHECK(doubled.Invert[15] == 1 && doubled.Invert[10] == 1 && doubled.Invert[0] == 0 && doubled.Invert[8] == 0);
+    // Fully opaque and fully transparent corners stay that way.
+    CHECK(doubled.Pixels[3] == 255 && doubled.Pixels[0] == 255);
+    CHECK(doubled.Pixels[(3 * 4 + 0) * 4 + 3] == 0);
+
+    auto same = ScaleCursorShape(shape, 2, 2);
+    CHECK(same.Hash == shape.Hash);
+    auto empty = ScaleCursorShape(CursorShape(), 0, 0);
+    CHECK(empty.Width == 1 && empty.Height == 1 && empty.Pixels[3] == 0);
+}
+
+TEST(HashesTellShapesApart)
+{
+    auto a = Gradient(8, 8, false);
+    auto b = Gradient(8, 8, false);
+    CHECK(a.Hash == b.Hash);
+    CHECK(Gradient(8, 7, false).Hash != a.Hash);
+    uint32_t const argb[] = { 0xFF000000 };
+    CHECK(MakeAlphaCursor(1, 1, 0, 0, argb).Hash != MakeAlphaCursor(1, 1, 0, 1, argb).Hash);
+    // Transparent and inverting pixels both have no color; only the mask
+    // tells them apart.
+    uint32_t const set[] = { 0xFFFFFF };
+    uint32_t const clear[] = { 0 };
+    CHECK(MakeMonochromeCursor(1, 1, 0, 0, set, set).Hash != MakeMonochromeCursor(1, 1, 0, 0, set, clear).Hash);
+}
+
+TEST(CacheSharesIdenticalShapes)
+{
+    CursorShapeCache cache;
+    CHECK(cache.Find(1) == nullptr);
+    auto first = cache.Insert(1, Gradient(8, 8, false));
+    auto second = cache.Insert(2, Gradient(8, 8, false));
+    auto other = cache.Insert(3, Gradient(4, 4, false));
+    CHECK(first == second);
+    CHECK(first != other);
+    CHECK(cache.Size() == 3);
+    CHECK(cache.Find(2) == first);
+    CHECK(cache.Hits() == 1 && cache.Misses() == 1);
+    // A handle that comes back with a new image takes the new shape.
+    auto replaced = cache.Insert(1, Gradient(4, 4, false));
+    CHECK(replaced == other);
+    CHECK(cache.Find(1) == other);
+    CHECK(cache.Size() == 3);
+    cache.Clear();
+    CHECK(cache.Size() == 0 && cache.Find(2) == nullptr);
+}
+
+TEST(CacheDropsTheLeastRecentlyUsed)
+{
+    CursorShapeCache cache(3);
+    for (uint64_t handle = 1; handle <= 3; handle++)
+        cache.Insert(handle, Gradient(static_cast<uint32_t>(handle), 2, false));
+    cache.Find(1);
+    cache.Insert(4, Gradient(4, 2, false));
+    CHECK(cache.Size() == 3);
+    CHECK(cache.Find(2) == nullptr);
+    CHECK(cache.Find(1) != nullptr && cache.Find(3) != nullptr && cache.Find(4) != nullptr);
+    // Capacity 0 still holds the current cursor.
+    CursorShapeCache tiny(0);
+    tiny.Insert(9, Gradient(2, 2, false));
+    CHECK(tiny.Find(9) != nullptr);
+}
+
+TEST(PipelineDrawsTheCursorOnlyWhereItIs)
+{
+    // Two identical on-demand sources, one copied with the cursor drawn:
+    // the frames differ only under the cursor, and both report it.
+    SyntheticSourceConfig config;
+    config.Width = 320;
+    config.Height = 240;
+    config.Cursor = true;
+    CaptureStats stats;
+    SyntheticCaptureSource plainSource(config);
+    SyntheticCaptureSource drawnSource(config);
+    CapturePipeline plain(plainSource, stats, 1);
+    CapturePipeline drawn(drawnSource, stats, 1);
+    drawn.SetDrawCursor(true);
+    std::vector<uint8_t> without(320 * 4 * 240);
+    std::vector<uint8_t> with(320 * 4 * 240);
+    for (int frame = 0; frame < 5; frame++)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        REQUIRE(plain.CopyImage(without.data(), without.size(), 0, width, height) == CopyResult::Ok);
+        REQUIRE(drawn.CopyImage(with.data(), with.size(), 0, width, height) == CopyResult::Ok);
+        auto const& cursor = drawn.GetCursorState();
+        auto sample = SyntheticCaptureSource::CursorFor(320, 240, drawn.GetFrameTiming().FrameIndex);
+        CHECK(cursor.Visible && cursor.X == sample.X && cursor.Y == sample.Y);
+        CHECK(plain.GetCursorState().X == cursor.X && plain.GetCursorState().Y == cursor.Y);
+
+        bool outsideSame = true;
+        bool insideChanged = false;
+        for (uint32_t y = 0; y < 240; y++)
+        {
+            for (uint32_t x = 0; x < 320; x++)
+            {
+                bool inside = static_cast<int32_t>(x) >= cursor.X && static_cast<int32_t>(x) < cursor.X + 12 &&
+                    static_cast<int32_t>(y) >= cursor.Y && static_cast<int32_t>(y) < cursor.Y + 19;
+                bool same = std::equal(with.begin() + (y * 320 + x) * 4, with.begin() + (y * 320 + x) * 4 + 4,
+                    without.begin() + (y * 320 + x) * 4);
+                if (inside)
+                    insideChanged = insideChanged || !same;
+                else
+                    outsideSame = outsideSame && same;
+            }
+        }
+        CHECK(outsideSame);
+        CHECK(insideChanged);
+    }
+}
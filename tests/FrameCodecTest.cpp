@@ -0,0 +1,264 @@
+#include <cstring>
+#include <vector>
+#include "FrameCodec.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // Frame frameIndex of a width x height synthetic source in format, with
+    // rows stride bytes apart, 0 for packed.
+    std::vector<uint8_t> Frame(OutputFormat format, uint32_t width, uint32_t height, uint64_t frameIndex, size_t stride = 0)
+    {
+        if (stride == 0)
+            stride = GetOutputRowBytes(format, width);
+        size_t bgraStride = static_cast<size_t>(width) * 4;
+        std::vector<uint8_t> bgra(bgraStride * height);
+        SyntheticCaptureSource::RenderFrame(bgra.data(), bgraStride, width, height, 24, frameIndex);
+        std::vector<uint8_t> frame(GetOutputFrameSize(format, width, height, stride), 0x3C);
+        ConvertParams params;
+        params.Format = format;
+        ConvertFrame(frame.data(), stride, bgra.data(), bgraStride, width, height, params);
+        return frame;
+    }
+
+    // Bytes no run can cover, the worst case for the codec.
+    std::vector<uint8_t> Noise(size_t bytes, uint32_t seed)
+    {
+        std::vector<uint8_t> noise(bytes);
+        uint32_t state = seed * 2654435761u + 1;
+        for (auto& byte : noise)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            byte = static_cast<uint8_t>(state);
+        }
+        return noise;
+    }
+
+    bool Decodes(FrameDecoder& decoder, std::vector<uint8_t> const& packet, std::vector<uint8_t> const& expected)
+    {
+        if (decoder.Decode(packet.data(), packet.size()) != DecodeResult::Ok)
+            return false;
+        std::vector<uint8_t> decoded(expected.size());
+        return decoder.CopyFrame(decoded.data(), decoded.size(), 0) && decoded == expected;
+    }
+}
+
+TEST(EveryFormatRoundTrips)
+{
+    // Odd sizes leave a tail that isn't a whole word, and padded source
+    // rows must not leak into the coded frame.
+    for (auto format : { OutputFormat::Bgra, OutputFormat::Rgba, OutputFormat::Rgb24, OutputFormat::Nv12, OutputFormat::I420 })
+    {
+        FrameEncoder encoder;
+        FrameDecoder decoder;
+        uint32_t const width = 157;
+        uint32_t const height = 93;
+        size_t stride = GetOutputRowBytes(format, width) + 28;
+        bool matched = true;
+        for (uint64_t i = 0; i < 6; i++)
+        {
+            auto frame = Frame(format, width, height, i, stride);
+            std::vector<uint8_t> packet;
+            REQUIRE(encoder.Encode(frame.data(), stride, format, width, height, packet));
+            CHECK(packet.size() <= GetMaxEncodedSize(format, width, height));
+            matched = matched && Decodes(decoder, packet, Frame(format, width, height, i));
+            matched = matched && decoder.Format() == format && decoder.Width() == width && decoder.Height() == height;
+        }
+        CHECK(matched);
+        CHECK(encoder.Frames() == 6 && encoder.Keyframes() == 1);
+    }
+}
+
+TEST(KeyframesComeAtTheInterval)
+{
+    FrameEncoder encoder;
+    encoder.SetKeyframeInterval(4);
+    std::vector<bool> keys;
+    for (uint64_t i = 0; i < 10; i++)
+    {
+        auto frame = Frame(OutputFormat::Bgra, 64, 48, i);
+        std::vector<uint8_t> packet;
+        REQUIRE(encoder.Encode(frame.data(), 64 * 4, OutputFormat::Bgra, 64, 48, packet));
+        EncodedFrameHeader header;
+        REQUIRE(FrameDecoder::ReadHeader(packet.data(), packet.size(), header));
+        CHECK(header.Sequence == i);
+        keys.push_back((header.Flags & EncodedKeyframe) != 0);
+    }
+    CHECK(keys == std::vector<bool>({ true, false, false, false, true, false, false, false, true, false }));
+    CHECK(encoder.Keyframes() == 3);
+}
+
+TEST(SizeChangesAndRequestsForceKeyframes)
+{
+    FrameEncoder encoder;
+    encoder.SetKeyframeInterval(0);
+    FrameDecoder decoder;
+    std::vector<uint8_t> packet;
+    auto small = Frame(OutputFormat::Bgra, 40, 30, 0);
+    auto large = Frame(OutputFormat::Bgra, 80, 60, 1);
+    auto nv12 = Frame(OutputFormat::Nv12, 80, 60, 2);
+
+    REQUIRE(encoder.Encode(small.data(), 40 * 4, OutputFormat::Bgra, 40, 30, packet));
+    CHECK(Decodes(decoder, packet, small) && decoder.Keyframe());
+    REQUIRE(encoder.Encode(small.data(), 40 * 4, OutputFormat::Bgra, 40, 30, packet));
+    CHECK(Decodes(decoder, packet, small) && !decoder.Keyframe());
+    REQUIRE(encoder.Encode(large.data(), 80 * 4, OutputFormat::Bgra, 80, 60, packet));
+    CHECK(Decodes(decoder, packet, large) && decoder.Keyframe());
+    REQUIRE(encoder.Encode(nv12.data(), 80, OutputFormat::Nv12, 80, 60, packet));
+    CHECK(Decodes(decoder, packet, nv12) && decoder.Keyframe());
+    encoder.RequestKeyframe();
+    REQUIRE(encoder.Encode(nv12.data(), 80, OutputFormat::Nv12, 80, 60, packet));
+    CHECK(Decodes(decoder, packet, nv12) && decoder.Keyframe());
+    CHECK(encoder.Keyframes() == 4);
+}
+
+TEST(UnchangedFramesCostAlmostNothing)
+{
+    FrameEncoder encoder;
+    auto frame = Frame(OutputFormat::Bgra, 1280, 720, 0);
+    std::vector<uint8_t> key;
+    std::vector<uint8_t> delta;
+    REQUIRE(encoder.Encode(frame.data(), 1280 * 4, OutputFormat::Bgra, 1280, 720, key));
+    REQUIRE(encoder.Encode(frame.data(), 1280 * 4, OutputFormat::Bgra, 1280, 720, delta));
+    // One run of zeros and the end marker.
+    CHECK(delta.size() <= sizeof(EncodedFrameHeader) + 16);
+    CHECK(key.size() <= GetMaxEncodedSize(OutputFormat::Bgra, 1280, 720));
+
+    // The moving box alone changes between frames.
+    auto next = Frame(OutputFormat::Bgra, 1280, 720, 1);
+    REQUIRE(encoder.Encode(next.data(), 1280 * 4, OutputFormat::Bgra, 1280, 720, delta));
+    CHECK(delta.size() < frame.size() / 50);
+}
+
+TEST(KeyframesPredictFromTheRowAbove)
+{
+    // Flat panels split by vertical edges, as much of a desktop is: every
+    // row but the first is the same as the one above.
+    uint32_t const width = 640;
+    uint32_t const height = 480;
+    std::vector<uint8_t> frame(static_cast<size_t>(width) * 4 * height);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            uint8_t* px = frame.data() + (static_cast<size_t>(y) * width + x) * 4;
+            px[0] = x < 200 ? 0x30 : 0xF0;
+            px[1] = x < 200 ? 0x30 : 0xF0;
+            px[2] = x < 450 ? 0x30 : 0x90;
+            px[3] = 0xFF;
+        }
+    }
+    FrameEncoder encoder;
+    std::vector<uint8_t> packet;
+    REQUIRE(encoder.Encode(frame.data(), width * 4, OutputFormat::Bgra, width, height, packet));
+    CHECK(packet.size() < 128);
+    FrameDecoder decoder;
+    CHECK(Decodes(decoder, packet, frame));
+}
+
+TEST(NoiseStaysWithinTheBound)
+{
+    FrameEncoder encoder;
+    FrameDecoder decoder;
+    uint32_t const width = 333;
+    uint32_t const height = 77;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        auto frame = Noise(static_cast<size_t>(width) * 4 * height, i);
+        std::vector<uint8_t> packet;
+        REQUIRE(encoder.Encode(frame.data(), width * 4, OutputFormat::Bgra, width, height, packet));
+        CHECK(packet.size() <= GetMaxEncodedSize(OutputFormat::Bgra, width, height));
+        CHECK(Decodes(decoder, packet, frame));
+    }
+}
+
+TEST(DeltasNeedTheFrameBefore)
+{
+    FrameEncoder encoder;
+    std::vector<std::vector<uint8_t>> packets(4);
+    for (uint64_t i = 0; i < packets.size(); i++)
+    {
+        auto frame = Frame(OutputFormat::Bgra, 64, 64, i);
+        REQUIRE(encoder.Encode(frame.data(), 64 * 4, OutputFormat::Bgra, 64, 64, packets[i]));
+    }
+
+    FrameDecoder decoder;
+    CHECK(decoder.Decode(packets[1].data(), packets[1].size()) == DecodeResult::NeedKeyframe);
+    CHECK(Decodes(decoder, packets[0], Frame(OutputFormat::Bgra, 64, 64, 0)));
+    // A frame skipped.
+    CHECK(decoder.Decode(packets[2].data(), packets[2].size()) == DecodeResult::NeedKeyframe);
+    CHECK(!decoder.Valid());
+    CHECK(decoder.Decode(packets[3].data(), packets[3].size()) == DecodeResult::NeedKeyframe);
+    // Starting over from the keyframe catches up.
+    CHECK(Decodes(decoder, packets[0], Frame(OutputFormat::Bgra, 64, 64, 0)));
+    CHECK(Decodes(decoder, packets[1], Frame(OutputFormat::Bgra, 64, 64, 1)));
+    CHECK(decoder.Sequence() == 1);
+}
+
+TEST(CorruptPacketsAreRefused)
+{
+    FrameEncoder encoder;
+    auto frame = Frame(OutputFormat::Bgra, 100, 60, 0);
+    std::vector<uint8_t> packet;
+    REQUIRE(encoder.Encode(frame.data(), 100 * 4, OutputFormat::Bgra, 100, 60, packet));
+    FrameDecoder decoder;
+
+    CHECK(decoder.Decode(packet.data(), sizeof(EncodedFrameHeader) - 1) == DecodeResult::Corrupt);
+    CHECK(decoder.Decode(packet.data(), packet.size() - 1) == DecodeResult::Corrupt);
+    auto badMagic = packet;
+    badMagic[0] ^= 0xFF;
+    CHECK(decoder.Decode(badMagic.data(), badMagic.size()) == DecodeResult::Corrupt);
+    auto badStride = packet;
+    EncodedFrameHeader header;
+    std::memcpy(&header, badStride.data(), sizeof(header));
+    header.Stride += 4;
+    std::memcpy(badStride.data(), &header, sizeof(header));
+    CHECK(decoder.Decode(badStride.data(), badStride.size()) == DecodeResult::Corrupt);
+    // A payload cut short, with the header saying so.
+    auto truncated = packet;
+    std::memcpy(&header, truncated.data(), sizeof(header));
+    header.PayloadBytes /= 2;
+    std::memcpy(truncated.data(), &header, sizeof(header));
+    truncated.resize(sizeof(header) + header.PayloadBytes);
+    CHECK(decoder.Decode(truncated.data(), truncated.size()) == DecodeResult::Corrupt);
+    CHECK(!decoder.Valid());
+    std::vector<uint8_t> out(frame.size());
+    CHECK(!decoder.CopyFrame(out.data(), out.size(), 0));
+
+    CHECK(Decodes(decoder, packet, frame));
+}
+
+TEST(EncoderRefusesBadInput)
+{
+    FrameEncoder encoder;
+    std::vector<uint8_t> packet;
+    auto frame = Frame(OutputFormat::Bgra, 16, 16, 0);
+    CHECK(!encoder.Encode(nullptr, 64, OutputFormat::Bgra, 16, 16, packet));
+    CHECK(!encoder.Encode(frame.data(), 64, OutputFormat::Bgra, 0, 16, packet));
+    CHECK(!encoder.Encode(frame.data(), 60, OutputFormat::Bgra, 16, 16, packet));
+    CHECK(!encoder.Encode(frame.data(), 64, static_cast<OutputFormat>(99), 16, 16, packet));
+    CHECK(encoder.Frames() == 0);
+}
+
+TEST(DecodedFramesCopyToAnyStride)
+{
+    FrameEncoder encoder;
+    FrameDecoder decoder;
+    auto frame = Frame(OutputFormat::I420, 35, 21, 0);
+    std::vector<uint8_t> packet;
+    REQUIRE(encoder.Encode(frame.data(), 35, OutputFormat::I420, 35, 21, packet));
+    REQUIRE(decoder.Decode(packet.data(), packet.size()) == DecodeResult::Ok);
+    CHECK(decoder.Stride() == GetCodedStride(OutputFormat::I420, 35));
+
+    size_t stride = 64;
+    std::vector<uint8_t> padded(GetOutputFrameSize(OutputFormat::I420, 35, 21, stride));
+    CHECK(!decoder.CopyFrame(padded.data(), padded.size() - 1, stride));
+    CHECK(!decoder.CopyFrame(padded.data(), padded.size(), 34));
+    REQUIRE(decoder.CopyFrame(padded.data(), padded.size(), stride));
+    std::vector<uint8_t> packed(frame.size());
+    CopyOutputFrame(packed.data(), 0, padded.data(), stride, OutputFormat::I420, 35, 21);
+    CHECK(packed == frame);
+}
@@ -0,0 +1,161 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "CapturePipeline.h"
+#include "FrameDispatcher.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // Notify count times, a frame interval apart, from a thread of its own
+    // as the frame arrived handler would.
+    std::thread Producer(FrameDispatcher& dispatcher, uint32_t count, std::chrono::microseconds interval)
+    {
+        return std::thread([&dispatcher, count, interval] {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                std::this_thread::sleep_for(interval);
+                dispatcher.Notify();
+            }
+        });
+    }
+
+    // Spin until done() or about five seconds have passed.
+    template <typename Done>
+    bool Eventually(Done done)
+    {
+        for (int i = 0; i < 5000 && !done(); i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return done();
+    }
+}
+
+TEST(WaitTimesOutWithoutFrames)
+{
+    FrameDispatcher dispatcher;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!dispatcher.Wait(20));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+}
+
+TEST(WaitCoalescesPendingFrames)
+{
+    FrameDispatcher dispatcher;
+    for (int i = 0; i < 5; i++)
+        dispatcher.Notify();
+    CHECK(dispatcher.Posted() == 5);
+    // One wakeup for all five, then nothing is pending.
+    CHECK(dispatcher.Wait(0));
+    CHECK(!dispatcher.Wait(0));
+    dispatcher.Notify();
+    CHECK(dispatcher.Wait(0));
+}
+
+TEST(WaitWakesOnAProducerThread)
+{
+    FrameDispatcher dispatcher;
+    constexpr uint32_t Frames = 50;
+    auto producer = Producer(dispatcher, Frames, std::chrono::microseconds(500));
+    uint32_t wakeups = 0;
+    while (dispatcher.Wait(1000))
+    {
+        wakeups++;
+        if (dispatcher.Posted() == Frames && !dispatcher.Wait(0))
+            break;
+    }
+    producer.join();
+    CHECK(dispatcher.Posted() == Frames);
+    CHECK(wakeups >= 1 && wakeups <= Frames);
+}
+
+TEST(CallbackRunsOnTheDispatchThread)
+{
+    FrameDispatcher dispatcher;
+    std::atomic<uint32_t> calls{ 0 };
+    std::thread::id callbackThread;
+    dispatcher.SetCallback([&] {
+        callbackThread = std::this_thread::get_id();
+        calls++;
+    });
+    auto producer = Producer(dispatcher, 20, std::chrono::microseconds(200));
+    auto producerThread = producer.get_id();
+    producer.join();
+    CHECK(Eventually([&] { return calls.load() != 0; }));
+    dispatcher.SetCallback(nullptr);
+    CHECK(callbackThread != std::this_thread::get_id());
+    CHECK(callbackThread != producerThread);
+    CHECK(calls.load() <= 20);
+}
+
+TEST(SlowCallbacksCoalesceFrames)
+{
+    FrameDispatcher dispatcher;
+    std::atomic<uint32_t> calls{ 0 };
+    dispatcher.SetCallback([&] {
+        calls++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    // Frames land far faster than the callback gets through them.
+    auto producer = Producer(dispatcher, 100, std::chrono::microseconds(100));
+    producer.join();
+    CHECK(Eventually([&] { return calls.load() != 0; }));
+    dispatcher.SetCallback(nullptr);
+    CHECK(dispatcher.Posted() == 100);
+    CHECK(calls.load() < 100);
+}
+
+TEST(RemovedCallbacksStopRunning)
+{
+    FrameDispatcher dispatcher;
+    std::atomic<uint32_t> calls{ 0 };
+    dispatcher.SetCallback([&] { calls++; });
+    dispatcher.Notify();
+    CHECK(Eventually([&] { return calls.load() == 1; }));
+    dispatcher.SetCallback(nullptr);
+    dispatcher.Notify();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(calls.load() == 1);
+    // Frames posted before a callback is installed aren't replayed to it.
+    dispatcher.SetCallback([&] { calls++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(calls.load() == 1);
+}
+
+TEST(NotifyHookSeesEveryFrame)
+{
+    FrameDispatcher dispatcher;
+    uint32_t hooked = 0;
+    dispatcher.SetNotifyHook([&] { hooked++; });
+    auto producer = Producer(dispatcher, 30, std::chrono::microseconds(0));
+    producer.join();
+    CHECK(hooked == 30);
+}
+
+TEST(CallbackCopiesFromASyntheticSource)
+{
+    // The callback mode as the export wires it: a source producing at a
+    // frame rate notifies, the callback copies the newest frame out.
+    FrameDispatcher dispatcher;
+    SyntheticSourceConfig config;
+    config.Width = 320;
+    config.Height = 240;
+    config.FrameRate = 200;
+    CaptureStats stats;
+    SyntheticCaptureSource source(config, &stats, &dispatcher);
+    CapturePipeline pipeline(source, stats, 1);
+    std::vector<uint8_t> buf(320 * 4 * 240);
+    std::atomic<uint32_t> copied{ 0 };
+    dispatcher.SetCallback([&] {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok)
+            copied++;
+    });
+    source.StartCapture();
+    CHECK(Eventually([&] { return copied.load() >= 10; }));
+    dispatcher.SetCallback(nullptr);
+    source.Close();
+    CHECK(copied.load() <= dispatcher.Posted());
+}
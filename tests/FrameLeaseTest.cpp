@@ -0,0 +1,135 @@
+#include <cstring>
+#include <vector>
+#include "CapturePipeline.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    constexpr uint32_t Width = 300;
+    constexpr uint32_t Height = 200;
+    constexpr uint32_t BoxSize = 128;
+
+    SyntheticSourceConfig OnDemand()
+    {
+        SyntheticSourceConfig config;
+        config.Width = Width;
+        config.Height = Height;
+        config.BoxSize = BoxSize;
+        return config;
+    }
+
+    // Whether the leased rows hold frame frameIndex as the source draws it.
+    bool HoldsFrame(FrameLease const& lease, uint64_t frameIndex)
+    {
+        size_t rowBytes = static_cast<size_t>(lease.Width) * 4;
+        std::vector<uint8_t> expected(rowBytes * lease.Height);
+        SyntheticCaptureSource::RenderFrame(expected.data(), rowBytes, lease.Width, lease.Height, BoxSize, frameIndex);
+        for (uint32_t y = 0; y < lease.Height; y++)
+        {
+            if (std::memcmp(lease.Data + static_cast<size_t>(y) * lease.RowPitch, expected.data() + y * rowBytes, rowBytes) != 0)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST(LeasesHandOutMappedRowsInPlace)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 2);
+    FrameLease lease;
+    REQUIRE(pipeline.LeaseFrame(lease));
+    CHECK(lease.Width == Width);
+    CHECK(lease.Height == Height);
+    CHECK(lease.Format == SourceFormatBgra8);
+    // Rows as the source's pool lays them out, padded like staging rows.
+    CHECK(lease.RowPitch >= Width * 4);
+    CHECK(lease.RowPitch % 256 == 0);
+    // The padding after the last row is left out.
+    CHECK(lease.Size == static_cast<uint64_t>(lease.RowPitch) * (Height - 1) + Width * 4);
+    CHECK(HoldsFrame(lease, lease.FrameIndex));
+    CHECK(lease.DeliveryTimeNs != 0);
+    CHECK(pipeline.ReturnFrame(lease.FrameIndex));
+}
+
+TEST(LeasesAreCappedAndReturnedOnce)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 2);
+    FrameLease first;
+    FrameLease second;
+    FrameLease third;
+    REQUIRE(pipeline.LeaseFrame(first));
+    REQUIRE(pipeline.LeaseFrame(second));
+    CHECK(first.FrameIndex != second.FrameIndex);
+    CHECK(!pipeline.LeaseFrame(third));
+
+    CHECK(pipeline.ReturnFrame(first.FrameIndex));
+    CHECK(!pipeline.ReturnFrame(first.FrameIndex));
+    CHECK(!pipeline.ReturnFrame(12345));
+    REQUIRE(pipeline.LeaseFrame(third));
+    CHECK(pipeline.ReturnFrame(second.FrameIndex));
+    CHECK(pipeline.ReturnFrame(third.FrameIndex));
+}
+
+TEST(LeasedFramesSurviveLaterCopies)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 1);
+    FrameLease lease;
+    REQUIRE(pipeline.LeaseFrame(lease));
+
+    std::vector<uint8_t> buf(Width * 4 * Height);
+    for (int i = 0; i < 20; i++)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        REQUIRE(pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok);
+        CHECK(width == Width && height == Height);
+    }
+    CHECK(HoldsFrame(lease, lease.FrameIndex));
+    CHECK(pipeline.ReturnFrame(lease.FrameIndex));
+}
+
+TEST(ResetReturnsEveryLease)
+{
+    SyntheticCaptureSource source(OnDemand());
+    CaptureStats stats;
+    CapturePipeline pipeline(source, stats, 2);
+    FrameLease lease;
+    REQUIRE(pipeline.LeaseFrame(lease));
+    REQUIRE(pipeline.LeaseFrame(lease));
+    pipeline.Reset();
+    CHECK(!pipeline.ReturnFrame(lease.FrameIndex));
+    // Both slots are back with the source, so two more can be leased.
+    CHECK(pipeline.LeaseFrame(lease));
+    CHECK(pipeline.LeaseFrame(lease));
+}
+
+TEST(FrameLeasePoolBookkeeping)
+{
+    FrameLeasePool pool(3);
+    MappedSlot slot;
+    static uint8_t pixels[64 * 4 * 2];
+    slot.Data = pixels;
+    slot.RowPitch = 64 * 4;
+    slot.Desc.Width = 10;
+    slot.Desc.Height = 2;
+    slot.FrameIndex = 7;
+    auto lease = pool.Lease(slot, 99);
+    CHECK(lease.Size == 64 * 4 + 10 * 4);
+    CHECK(lease.DeliveryTimeNs == 99);
+    CHECK(pool.Outstanding() == 1);
+    slot.FrameIndex = 8;
+    pool.Lease(slot, 100);
+    int released = 0;
+    pool.ReturnAll([&](MappedSlot const&) { released++; });
+    CHECK(released == 2);
+    CHECK(pool.Outstanding() == 0);
+    MappedSlot returned;
+    CHECK(!pool.Return(7, returned));
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "CapturePipeline.h"
+#include "FramePacer.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    using Clock = FramePacer::Clock;
+    using std::chrono::microseconds;
+
+    // Frames from a source at sourceFps for seconds, each moved by jitter(i)
+    // microseconds, through a pacer at targetFps on a fake clock. Returns the
+    // times of the frames let through.
+    template <typename Jitter>
+    std::vector<microseconds> Pace(double sourceFps, double targetFps, double seconds, Jitter jitter)
+    {
+        FramePacer pacer;
+        pacer.SetTargetFrameRate(targetFps);
+        std::vector<microseconds> admitted;
+        auto frames = static_cast<uint64_t>(sourceFps * seconds);
+        for (uint64_t i = 0; i < frames; i++)
+        {
+            auto t = microseconds(static_cast<int64_t>(i * 1000000 / sourceFps) + jitter(i) + 1000000);
+            if (pacer.Admit(Clock::time_point(t)))
+                admitted.push_back(t);
+        }
+        return admitted;
+    }
+
+    std::vector<microseconds> Pace(double sourceFps, double targetFps, double seconds)
+    {
+        return Pace(sourceFps, targetFps, seconds, [](uint64_t) { return int64_t(0); });
+    }
+
+    std::vector<microseconds> Gaps(std::vector<microseconds> const& times)
+    {
+        std::vector<microseconds> gaps;
+        for (size_t i = 1; i < times.size(); i++)
+            gaps.push_back(times[i] - times[i - 1]);
+        return gaps;
+    }
+}
+
+TEST(UnlimitedLetsEverythingThrough)
+{
+    FramePacer pacer;
+    CHECK(!pacer.Limited());
+    for (int i = 0; i < 10; i++)
+        CHECK(pacer.Admit(Clock::time_point(microseconds(i))));
+    pacer.SetTargetFrameRate(-5);
+    CHECK(!pacer.Limited());
+    CHECK(pacer.Admit(Clock::time_point()));
+    CHECK(pacer.Admitted() == 11 && pacer.Decimated() == 0);
+}
+
+TEST(HalvingTakesEveryOtherFrame)
+{
+    auto admitted = Pace(60, 30, 10);
+    CHECK(admitted.size() == 300);
+    auto gaps = Gaps(admitted);
+    // 60 -> 30 never alternates unevenly: every gap is two source frames.
+    CHECK(std::all_of(gaps.begin(), gaps.end(), [](microseconds gap) { return gap >= microseconds(33332) && gap <= microseconds(33334); }));
+}
+
+TEST(UnevenRatiosHoldTheRateWithoutDrift)
+{
+    // 144 -> 60 can't be even; gaps alternate between two and three frames
+    // and the count over ten seconds comes out at the target.
+    auto admitted = Pace(144, 60, 10);
+    CHECK(admitted.size() >= 599 && admitted.size() <= 601);
+    auto gaps = Gaps(admitted);
+    CHECK(std::all_of(gaps.begin(), gaps.end(), [](microseconds gap) { return gap >= microseconds(13888) && gap <= microseconds(20834); }));
+}
+
+TEST(JitterDoesNotDriftTheRate)
+{
+    // A 60 fps source whose frames land up to 3 ms early or late.
+    auto admitted = Pace(60, 30, 10, [](uint64_t i) { return static_cast<int64_t>((i * 7919) % 6001) - 3000; });
+    CHECK(admitted.size() >= 299 && admitted.size() <= 301);
+    auto gaps = Gaps(admitted);
+    auto longest = *std::max_element(gaps.begin(), gaps.end());
+    auto shortest = *std::min_element(gaps.begin(), gaps.end());
+    // Never a frame dropped on top of the halving, nor two kept in a row.
+    CHECK(longest <= microseconds(33334 + 6000));
+    CHECK(shortest >= microseconds(33333 - 6000));
+}
+
+TEST(SlowerSourcesLoseNothing)
+{
+    auto admitted = Pace(24, 30, 5);
+    CHECK(admitted.size() == 120);
+    // Slightly below the target still keeps every frame.
+    CHECK(Pace(59.5, 60, 5).size() == static_cast<size_t>(59.5 * 5));
+}
+
+TEST(AGapRestartsTheGrid)
+{
+    FramePacer pacer;
+    pacer.SetTargetFrameRate(30);
+    auto at = [](int64_t ms) { return Clock::time_point(std::chrono::milliseconds(ms)); };
+    CHECK(pacer.Admit(at(1000)));
+    CHECK(!pacer.Admit(at(1010)));
+    // A second of nothing, then a burst: one frame, not a second's worth.
+    CHECK(pacer.Admit(at(2000)));
+    CHECK(!pacer.Admit(at(2001)));
+    CHECK(!pacer.Admit(at(2002)));
+    CHECK(pacer.Admit(at(2034)));
+    CHECK(pacer.Admitted() == 3 && pacer.Decimated() == 3);
+}
+
+TEST(ChangingTheRateStartsOver)
+{
+    FramePacer pacer;
+    pacer.SetTargetFrameRate(10);
+    auto at = [](int64_t ms) { return Clock::time_point(std::chrono::milliseconds(ms)); };
+    CHECK(pacer.Admit(at(0)));
+    CHECK(!pacer.Admit(at(20)));
+    pacer.SetTargetFrameRate(60);
+    CHECK(pacer.TargetFrameRate() == 60);
+    CHECK(pacer.Admit(at(21)));
+    CHECK(pacer.Admit(at(38)));
+    pacer.Reset();
+    CHECK(pacer.Admit(at(39)));
+}
+
+TEST(SyntheticSourcePacesOnFrameTime)
+{
+    // On demand, the synthetic source stamps frames at 60 fps of frame time,
+    // so a 20 fps target keeps exactly every third however fast it's polled.
+    SyntheticSourceConfig config;
+    config.Width = 64;
+    config.Height = 48;
+    CaptureStats stats;
+    SyntheticCaptureSource source(config, &stats);
+    CapturePipeline pipeline(source, stats, 1);
+    pipeline.SetTargetFrameRate(20);
+    CHECK(pipeline.GetTargetFrameRate() == 20);
+    std::vector<uint8_t> buf(64 * 4 * 48);
+    std::vector<uint64_t> indices;
+    for (int poll = 0; poll < 90; poll++)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok)
+            indices.push_back(pipeline.GetFrameTiming().FrameIndex);
+    }
+    REQUIRE(indices.size() == 30);
+    bool everyThird = true;
+    for (size_t i = 0; i < indices.size(); i++)
+        everyThird = everyThird && indices[i] == i * 3;
+    CHECK(everyThird);
+    CHECK(stats.Snapshot().Decimated == 60);
+}
@@ -0,0 +1,270 @@
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include "FrameQueue.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // Stands in for a captured frame: only its index matters here. The queue
+    // needs to construct an empty one from nullptr, as WinRT objects allow.
+    struct Frame
+    {
+        Frame() = default;
+        Frame(std::nullptr_t) {}
+        explicit Frame(uint64_t index) : Index(index) {}
+        uint64_t Index = 0;
+    };
+
+    struct Simulation
+    {
+        std::vector<uint64_t> Delivered;
+        // For each delivered frame, how many newer frames had arrived by then.
+        std::vector<uint64_t> Behind;
+        uint64_t EmptyPolls = 0;
+        FrameQueueStats Stats;
+        uint64_t Discarded = 0;
+        // Source frames lost because every pool buffer was taken.
+        uint64_t Starved = 0;
+        // What was still queued at the end of the second.
+        std::vector<uint64_t> Left;
+    };
+
+    // One simulated second, on one thread: the source renders producerRate
+    // frames and the consumer pops consumerRate times, interleaved in time
+    // order, a frame first when both fall on the same tick. As with a capture
+    // frame pool, the source renders into one of poolBuffers buffers, which
+    // comes back once the frame is delivered, discarded or rejected; with none
+    // free the frame is lost. poolBuffers defaults to what SimpleCapture
+    // allocates for the policy and depth.
+    Simulation Simulate(FramePolicy policy, uint32_t depth, uint32_t producerRate, uint32_t consumerRate, uint32_t poolBuffers = 0)
+    {
+        BoundedFrameQueue<Frame> queue(depth, policy);
+        if (poolBuffers == 0)
+            poolBuffers = (policy == FramePolicy::LatestWins ? 1 : depth) + 1;
+        Simulation sim;
+        uint32_t free = poolBuffers;
+        auto recycle = [&](Frame&&) { sim.Discarded++; free++; };
+        constexpr uint64_t Second = 1000000;
+        uint64_t rendered = 0;
+        uint64_t popped = 0;
+        while (rendered < producerRate || popped < consumerRate)
+        {
+            uint64_t nextFrame = rendered < producerRate ? (rendered + 1) * Second / producerRate : UINT64_MAX;
+            uint64_t nextPop = popped < consumerRate ? (popped + 1) * Second / consumerRate : UINT64_MAX;
+            if (nextFrame <= nextPop)
+            {
+                uint64_t index = rendered++;
+                if (free == 0)
+                {
+                    sim.Starved++;
+                    continue;
+                }
+                free--;
+                if (!queue.Push(Frame(index), recycle))
+                    free++;
+                continue;
+            }
+            popped++;
+            Frame frame;
+            if (queue.Pop(frame, recycle))
+            {
+                sim.Delivered.push_back(frame.Index);
+                sim.Behind.push_back(rendered - 1 - frame.Index);
+                free++;
+            }
+            else
+            {
+                sim.EmptyPolls++;
+            }
+        }
+        sim.Stats = queue.Stats();
+        Frame frame;
+        while (queue.Pop(frame))
+            sim.Left.push_back(frame.Index);
+        return sim;
+    }
+
+    bool InOrder(std::vector<uint64_t> const& frames)
+    {
+        for (size_t i = 1; i < frames.size(); i++)
+        {
+            if (frames[i] <= frames[i - 1])
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t MaxOf(std::vector<uint64_t> const& values)
+    {
+        uint64_t max = 0;
+        for (auto v : values)
+            max = v > max ? v : max;
+        return max;
+    }
+}
+
+TEST(LatestWinsAlwaysDeliversTheNewest)
+{
+    // A 120 fps source read at 30 fps.
+    auto sim = Simulate(FramePolicy::LatestWins, 1, 120, 30);
+    CHECK(sim.Delivered.size() == 30);
+    CHECK(MaxOf(sim.Behind) == 0);
+    CHECK(InOrder(sim.Delivered));
+    CHECK(sim.Stats.Arrived == 120);
+    CHECK(sim.Stats.Delivered == 30);
+    CHECK(sim.Stats.Dropped == 0);
+    CHECK(sim.Stats.Coalesced == 90);
+    CHECK(sim.Discarded == sim.Stats.Coalesced);
+    CHECK(sim.Starved == 0);
+}
+
+TEST(FifoKeepsTheOldestAndDropsArrivals)
+{
+    auto sim = Simulate(FramePolicy::Fifo, 4, 120, 30);
+    CHECK(sim.Delivered.size() == 30);
+    CHECK(InOrder(sim.Delivered));
+    // The queue stays full, so what's delivered is as old as the queue is deep.
+    CHECK(sim.Behind.back() >= 3);
+    CHECK(sim.Stats.Coalesced == 0);
+    CHECK(sim.Stats.Dropped + sim.Stats.Delivered + 4 >= sim.Stats.Arrived);
+    CHECK(sim.Discarded == 0);
+    CHECK(sim.Starved == 0);
+}
+
+TEST(DropOldestKeepsTheNewestDepth)
+{
+    auto sim = Simulate(FramePolicy::DropOldest, 4, 120, 30);
+    CHECK(sim.Delivered.size() == 30);
+    CHECK(InOrder(sim.Delivered));
+    // Evicted on push down to depth: the frame delivered is depth - 1 behind.
+    CHECK(MaxOf(sim.Behind) == 3);
+    CHECK(sim.Stats.Coalesced == 0);
+    CHECK(sim.Discarded == sim.Stats.Dropped);
+    CHECK(sim.Starved == 0);
+}
+
+TEST(StalledConsumersDontStarveThePool)
+{
+    // The consumer never pops: superseded frames must still go back to the
+    // pool, or a depth + 1 pool runs dry after a couple of frames and the
+    // newest frames are never rendered.
+    auto latest = Simulate(FramePolicy::LatestWins, 1, 120, 0);
+    CHECK(latest.Starved == 0);
+    CHECK(latest.Stats.Coalesced == 119);
+    CHECK(latest.Discarded == 119);
+    CHECK(latest.Left == std::vector<uint64_t>({ 119 }));
+
+    auto oldest = Simulate(FramePolicy::DropOldest, 4, 120, 0);
+    CHECK(oldest.Starved == 0);
+    CHECK(oldest.Stats.Dropped == 116);
+    CHECK(oldest.Discarded == 116);
+    CHECK(oldest.Left == std::vector<uint64_t>({ 116, 117, 118, 119 }));
+
+    // A pool smaller than the queue is deep does run dry.
+    auto small = Simulate(FramePolicy::DropOldest, 4, 120, 0, 2);
+    CHECK(small.Starved == 118);
+    CHECK(small.Left == std::vector<uint64_t>({ 0, 1 }));
+}
+
+TEST(SlowProducersLoseNothing)
+{
+    for (auto policy : { FramePolicy::LatestWins, FramePolicy::Fifo, FramePolicy::DropOldest })
+    {
+        auto sim = Simulate(policy, 3, 30, 120);
+        CHECK(sim.Delivered.size() == 30);
+        CHECK(MaxOf(sim.Behind) == 0);
+        CHECK(sim.EmptyPolls == 90);
+        CHECK(sim.Stats.Dropped == 0 && sim.Stats.Coalesced == 0);
+    }
+}
+
+TEST(MatchedRatesLoseNothing)
+{
+    for (auto policy : { FramePolicy::LatestWins, FramePolicy::Fifo, FramePolicy::DropOldest })
+    {
+        auto sim = Simulate(policy, 2, 60, 60);
+        CHECK(sim.Delivered.size() == 60);
+        CHECK(sim.Stats.Dropped == 0 && sim.Stats.Coalesced == 0);
+    }
+}
+
+TEST(DeeperQueuesDropLessOnJitter)
+{
+    // A consumer at 59 fps against 60 fps falls one frame behind per second:
+    // a single slot may lose that frame, a deeper Fifo queue absorbs it.
+    auto shallow = Simulate(FramePolicy::Fifo, 1, 60, 59);
+    auto deep = Simulate(FramePolicy::Fifo, 4, 60, 59);
+    CHECK(shallow.Stats.Dropped <= 1);
+    CHECK(deep.Stats.Dropped == 0);
+    CHECK(deep.Delivered.size() == 59);
+}
+
+TEST(ShrinkingTheDepthDropsOnTheNextPop)
+{
+    BoundedFrameQueue<Frame> queue(8, FramePolicy::DropOldest);
+    for (uint64_t i = 0; i < 8; i++)
+        CHECK(queue.Push(Frame(i)));
+    queue.Configure(2, FramePolicy::DropOldest);
+    Frame frame;
+    REQUIRE(queue.Pop(frame));
+    CHECK(frame.Index == 6);
+    CHECK(queue.Stats().Dropped == 6);
+    REQUIRE(queue.Pop(frame));
+    CHECK(frame.Index == 7);
+    CHECK(!queue.Pop(frame));
+}
+
+TEST(DepthIsClamped)
+{
+    BoundedFrameQueue<Frame> queue(100, FramePolicy::Fifo);
+    uint32_t accepted = 0;
+    for (uint64_t i = 0; i < 100; i++)
+        accepted += queue.Push(Frame(i)) ? 1 : 0;
+    CHECK(accepted == BoundedFrameQueue<Frame>::MaxDepth);
+    queue.Configure(0, FramePolicy::Fifo);
+    queue.Clear();
+    CHECK(queue.Push(Frame(uint64_t(0))));
+    CHECK(!queue.Push(Frame(uint64_t(1))));
+}
+
+TEST(ThreadedProducerAndConsumerAccountForEveryFrame)
+{
+    for (auto policy : { FramePolicy::LatestWins, FramePolicy::Fifo, FramePolicy::DropOldest })
+    {
+        BoundedFrameQueue<Frame> queue(4, policy);
+        constexpr uint64_t Frames = 20000;
+        uint64_t rejected = 0;
+        uint64_t superseded = 0;
+        std::thread producer([&] {
+            for (uint64_t i = 0; i < Frames; i++)
+            {
+                if (!queue.Push(Frame(i), [&](Frame&&) { superseded++; }))
+                    rejected++;
+                if (i % 64 == 0)
+                    std::this_thread::yield();
+            }
+        });
+        std::vector<uint64_t> delivered;
+        uint64_t discarded = 0;
+        Frame frame;
+        while (queue.Stats().Arrived < Frames)
+        {
+            if (queue.Pop(frame, [&](Frame&&) { discarded++; }))
+                delivered.push_back(frame.Index);
+        }
+        producer.join();
+        while (queue.Pop(frame, [&](Frame&&) { discarded++; }))
+            delivered.push_back(frame.Index);
+
+        auto stats = queue.Stats();
+        CHECK(InOrder(delivered));
+        CHECK(stats.Arrived == Frames);
+        CHECK(stats.Delivered == delivered.size());
+        CHECK(stats.Delivered + stats.Dropped + stats.Coalesced == Frames);
+        // Whatever the policy threw away, on either side, went to discard.
+        CHECK(superseded + discarded + rejected == stats.Dropped + stats.Coalesced);
+        if (policy == FramePolicy::Fifo)
+            CHECK(superseded == 0);
+    }
+}
@@ -0,0 +1,267 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "FrameRecording.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // A file in the temporary directory, deleted when done with.
+    struct TempPath
+    {
+        std::string Path;
+
+        explicit TempPath(const char* name)
+        {
+            std::error_code error;
+            Path = (std::filesystem::temp_directory_path(error) / name).string();
+            std::filesystem::remove(Path, error);
+        }
+
+        ~TempPath()
+        {
+            std::error_code error;
+            std::filesystem::remove(Path, error);
+        }
+    };
+
+    // Frame frameIndex of a width x height synthetic source in format, with
+    // rows stride bytes apart, 0 for packed.
+    std::vector<uint8_t> Frame(OutputFormat format, uint32_t width, uint32_t height, uint64_t frameIndex, size_t stride)
+    {
+        if (stride == 0)
+            stride = GetOutputRowBytes(format, width);
+        size_t bgraStride = static_cast<size_t>(width) * 4;
+        std::vector<uint8_t> bgra(bgraStride * height);
+        SyntheticCaptureSource::RenderFrame(bgra.data(), bgraStride, width, height, 16, frameIndex);
+        std::vector<uint8_t> frame(GetOutputFrameSize(format, width, height, stride), 0xA5);
+        ConvertParams params;
+        params.Format = format;
+        ConvertFrame(frame.data(), stride, bgra.data(), bgraStride, width, height, params);
+        return frame;
+    }
+
+    FrameTiming Timing(uint64_t frameIndex)
+    {
+        FrameTiming timing;
+        timing.FrameIndex = frameIndex;
+        timing.CaptureTimeNs = 1000000 + frameIndex * 16666667;
+        timing.DeliveryTimeNs = timing.CaptureTimeNs + 2000000;
+        return timing;
+    }
+
+    struct Size
+    {
+        uint32_t Width;
+        uint32_t Height;
+    };
+
+    // Record frames of the given sizes in format, then read every one back
+    // in reverse and compare. Returns whether all matched.
+    bool RoundTrip(OutputFormat format, uint32_t maxWidth, uint32_t maxHeight, std::vector<Size> const& sizes)
+    {
+        TempPath file("FrameRecordingTest.wcaprec");
+        RecordingConfig config;
+        config.Format = format;
+        config.MaxWidth = maxWidth;
+        config.MaxHeight = maxHeight;
+        config.MaxFrames = 64;
+        FrameRecorder recorder;
+        if (!recorder.Open(file.Path, config))
+            return false;
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            // Source rows padded, as they come out of a staging texture.
+            size_t stride = GetOutputRowBytes(format, sizes[i].Width) + 40;
+            auto frame = Frame(format, sizes[i].Width, sizes[i].Height, i, stride);
+            if (!recorder.Append(frame.data(), stride, format, sizes[i].Width, sizes[i].Height, Timing(i * 3), static_cast<uint32_t>(i % 2)))
+                return false;
+        }
+        if (!recorder.Close())
+            return false;
+
+        FrameRecordingReader reader;
+        if (!reader.Open(file.Path) || !reader.Complete() || reader.FrameCount() != sizes.size())
+            return false;
+        for (size_t i = sizes.size(); i-- > 0;)
+        {
+            auto expected = Frame(format, sizes[i].Width, sizes[i].Height, i, 0);
+            std::vector<uint8_t> copied(expected.size());
+            RecordingIndexEntry entry;
+            if (!reader.CopyFrame(i, copied.data(), copied.size(), 0, entry) || copied != expected)
+                return false;
+            auto timing = Timing(i * 3);
+            if (entry.FrameIndex != timing.FrameIndex || entry.CaptureTimeNs != timing.CaptureTimeNs ||
+                entry.DeliveryTimeNs != timing.DeliveryTimeNs || entry.Width != sizes[i].Width ||
+                entry.Height != sizes[i].Height || entry.Flags != i % 2)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST(BgraFramesRoundTrip)
+{
+    // Full size frames and smaller ones, as while a window is resized.
+    CHECK(RoundTrip(OutputFormat::Bgra, 320, 200, { { 320, 200 }, { 100, 50 }, { 320, 1 }, { 1, 200 }, { 320, 200 } }));
+}
+
+TEST(EveryFormatRoundTrips)
+{
+    // Odd sizes too, where the chroma planes round up.
+    for (auto format : { OutputFormat::Rgba, OutputFormat::Rgb24, OutputFormat::Nv12, OutputFormat::I420 })
+        CHECK(RoundTrip(format, 301, 201, { { 301, 201 }, { 160, 90 }, { 3, 3 } }));
+}
+
+TEST(ClosedFilesAreTrimmed)
+{
+    TempPath file("FrameRecordingTrim.wcaprec");
+    RecordingConfig config;
+    config.MaxWidth = 64;
+    config.MaxHeight = 64;
+    FrameRecorder recorder;
+    REQUIRE(recorder.Open(file.Path, config));
+    auto frame = Frame(OutputFormat::Bgra, 64, 64, 0, 0);
+    for (uint64_t i = 0; i < 3; i++)
+        CHECK(recorder.Append(frame.data(), 0, OutputFormat::Bgra, 64, 64, Timing(i), RecordedFrameDirty));
+    CHECK(recorder.Close());
+    CHECK(!recorder.IsOpen());
+
+    FrameRecordingReader reader;
+    REQUIRE(reader.Open(file.Path));
+    auto header = reader.Header();
+    CHECK(header.IndexCapacity == FrameRecorder::DefaultMaxFrames);
+    CHECK(std::filesystem::file_size(file.Path) == header.DataOffset + 3 * header.SlotBytes);
+    RecordedFrameView view;
+    REQUIRE(reader.ReadFrame(2, view));
+    CHECK(view.Entry.FrameIndex == 2 && view.Entry.Flags == RecordedFrameDirty);
+    CHECK(view.Stride == header.Stride && view.Stride % 64 == 0);
+    CHECK(!reader.ReadFrame(3, view));
+}
+
+TEST(FramesThatDontFitAreDropped)
+{
+    TempPath file("FrameRecordingDrop.wcaprec");
+    RecordingConfig config;
+    config.MaxWidth = 32;
+    config.MaxHeight = 32;
+    config.MaxFrames = 2;
+    FrameRecorder recorder;
+    auto frame = Frame(OutputFormat::Bgra, 64, 64, 0, 0);
+    CHECK(!recorder.Append(frame.data(), 0, OutputFormat::Bgra, 32, 32, Timing(0), 0));
+    REQUIRE(recorder.Open(file.Path, config));
+    CHECK(!recorder.Append(frame.data(), 0, OutputFormat::Bgra, 64, 32, Timing(0), 0));
+    CHECK(!recorder.Append(frame.data(), 0, OutputFormat::Nv12, 32, 32, Timing(0), 0));
+    CHECK(!recorder.Append(nullptr, 0, OutputFormat::Bgra, 32, 32, Timing(0), 0));
+    CHECK(recorder.Append(frame.data(), 256, OutputFormat::Bgra, 32, 32, Timing(0), 0));
+    CHECK(recorder.Append(frame.data(), 256, OutputFormat::Bgra, 32, 32, Timing(1), 0));
+    // The index is full.
+    CHECK(!recorder.Append(frame.data(), 256, OutputFormat::Bgra, 32, 32, Timing(2), 0));
+    CHECK(recorder.Recorded() == 2);
+    CHECK(recorder.Dropped() == 4);
+    CHECK(recorder.Close());
+}
+
+TEST(ReadersFollowALiveRecording)
+{
+    TempPath file("FrameRecordingLive.wcaprec");
+    RecordingConfig config;
+    config.MaxWidth = 48;
+    config.MaxHeight = 32;
+    FrameRecorder recorder;
+    REQUIRE(recorder.Open(file.Path, config));
+    FrameRecordingReader reader;
+    REQUIRE(reader.Open(file.Path));
+    CHECK(reader.FrameCount() == 0);
+    CHECK(!reader.Complete());
+
+    bool matched = true;
+    for (uint64_t i = 0; i < 5; i++)
+    {
+        auto frame = Frame(OutputFormat::Bgra, 48, 32, i, 0);
+        CHECK(recorder.Append(frame.data(), 0, OutputFormat::Bgra, 48, 32, Timing(i), 0));
+        std::vector<uint8_t> copied(frame.size());
+        RecordingIndexEntry entry;
+        matched = matched && reader.FrameCount() == i + 1 &&
+            reader.CopyFrame(i, copied.data(), copied.size(), 0, entry) && copied == frame;
+    }
+    CHECK(matched);
+    CHECK(recorder.Close());
+    CHECK(reader.Complete());
+}
+
+TEST(ShortBuffersReportTheFrame)
+{
+    TempPath file("FrameRecordingShort.wcaprec");
+    RecordingConfig config;
+    config.Format = OutputFormat::Nv12;
+    config.MaxWidth = 64;
+    config.MaxHeight = 48;
+    FrameRecorder recorder;
+    REQUIRE(recorder.Open(file.Path, config));
+    auto frame = Frame(OutputFormat::Nv12, 64, 48, 0, 0);
+    CHECK(recorder.Append(frame.data(), 0, OutputFormat::Nv12, 64, 48, Timing(9), 0));
+    CHECK(recorder.Close());
+
+    FrameRecordingReader reader;
+    REQUIRE(reader.Open(file.Path));
+    std::vector<uint8_t> copied(frame.size() - 1);
+    RecordingIndexEntry entry;
+    CHECK(!reader.CopyFrame(0, copied.data(), copied.size(), 0, entry));
+    CHECK(entry.FrameIndex == 9 && entry.Width == 64 && entry.Height == 48);
+    CHECK(!reader.CopyFrame(1, copied.data(), copied.size(), 0, entry));
+    CHECK(entry.Width == 0);
+}
+
+TEST(ChunksAreFlushedAndRemapped)
+{
+    // Enough 1 MB frames to fill a chunk and carry on into the next.
+    TempPath file("FrameRecordingChunks.wcaprec");
+    RecordingConfig config;
+    config.MaxWidth = 512;
+    config.MaxHeight = 512;
+    config.MaxFrames = 80;
+    FrameRecorder recorder;
+    REQUIRE(recorder.Open(file.Path, config));
+    auto even = Frame(OutputFormat::Bgra, 512, 512, 0, 0);
+    auto odd = Frame(OutputFormat::Bgra, 512, 512, 1, 0);
+    uint64_t frames = FrameRecorder::ChunkBytes / even.size() + 10;
+    REQUIRE(frames <= config.MaxFrames);
+    for (uint64_t i = 0; i < frames; i++)
+        CHECK(recorder.Append((i % 2 ? odd : even).data(), 0, OutputFormat::Bgra, 512, 512, Timing(i), 0));
+    CHECK(recorder.Close());
+
+    FrameRecordingReader reader;
+    REQUIRE(reader.Open(file.Path));
+    REQUIRE(reader.FrameCount() == frames);
+    bool matched = true;
+    std::vector<uint8_t> copied(even.size());
+    for (uint64_t i = 0; i < frames; i += 7)
+    {
+        RecordingIndexEntry entry;
+        matched = matched && reader.CopyFrame(i, copied.data(), copied.size(), 0, entry) && copied == (i % 2 ? odd : even);
+    }
+    CHECK(matched);
+}
+
+TEST(OtherFilesAreRefused)
+{
+    TempPath file("FrameRecordingBad.wcaprec");
+    FrameRecordingReader reader;
+    CHECK(!reader.Open(file.Path));
+    std::FILE* out = std::fopen(file.Path.c_str(), "wb");
+    REQUIRE(out != nullptr);
+    std::vector<uint8_t> junk(4096, 0x5A);
+    std::fwrite(junk.data(), 1, junk.size(), out);
+    std::fclose(out);
+    CHECK(!reader.Open(file.Path));
+    CHECK(!reader.IsOpen());
+    CHECK(reader.FrameCount() == 0);
+
+    FrameRecorder recorder;
+    RecordingConfig config;
+    CHECK(!recorder.Open(file.Path, config));
+}
@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "FrameScaler.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // A BGRA frame with padded rows.
+    struct Frame
+    {
+        uint32_t Width;
+        uint32_t Height;
+        size_t Stride;
+        std::vector<uint8_t> Pixels;
+
+        Frame(uint32_t width, uint32_t height, uint8_t fill = 0)
+            : Width(width), Height(height), Stride(width * 4 + 24), Pixels(Stride * height, fill)
+        {
+        }
+
+        uint8_t* Row(uint32_t y) { return Pixels.data() + y * Stride; }
+        const uint8_t* Row(uint32_t y) const { return Pixels.data() + y * Stride; }
+        uint8_t At(uint32_t x, uint32_t y, uint32_t c) const { return Row(y)[x * 4 + c]; }
+    };
+
+    Frame Synthetic(uint32_t width, uint32_t height)
+    {
+        Frame frame(width, height);
+        SyntheticCaptureSource::RenderFrame(frame.Pixels.data(), frame.Stride, width, height, height / 3, 5);
+        return frame;
+    }
+
+    Frame Scaled(Frame const& src, uint32_t width, uint32_t height, ScaleFilter filter)
+    {
+        Frame dst(width, height, 0xEE);
+        FrameScaler scaler;
+        scaler.Scale(dst.Pixels.data(), dst.Stride, width, height, src.Pixels.data(), src.Stride, src.Width, src.Height, filter);
+        return dst;
+    }
+
+    // The box filter averages whole pixels: output i covers source
+    // [i * src / dst, (i + 1) * src / dst), at least one pixel.
+    void BoxSpan(uint32_t i, uint32_t dst, uint32_t src, uint32_t& start, uint32_t& end)
+    {
+        start = static_cast<uint32_t>(static_cast<uint64_t>(i) * src / dst);
+        end = static_cast<uint32_t>(static_cast<uint64_t>(i + 1) * src / dst);
+        if (end <= start)
+            end = start + 1;
+    }
+
+    // Largest difference from the exact average over each box span; 0.5 is
+    // correctly rounded.
+    double BoxError(Frame const& src, Frame const& dst)
+    {
+        double worst = 0;
+        for (uint32_t y = 0; y < dst.Height; y++)
+        {
+            uint32_t y0, y1;
+            BoxSpan(y, dst.Height, src.Height, y0, y1);
+            for (uint32_t x = 0; x < dst.Width; x++)
+            {
+                uint32_t x0, x1;
+                BoxSpan(x, dst.Width, src.Width, x0, x1);
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    double sum = 0;
+                    for (uint32_t sy = y0; sy < y1; sy++)
+                    {
+                        for (uint32_t sx = x0; sx < x1; sx++)
+                            sum += src.At(sx, sy, c);
+                    }
+                    double exact = sum / ((x1 - x0) * (y1 - y0));
+                    worst = std::max(worst, std::fabs(dst.At(x, y, c) - exact));
+                }
+            }
+        }
+        return worst;
+    }
+
+    // Largest difference from a double precision bilinear sample at the
+    // aligned pixel centres.
+    double BilinearError(Frame const& src, Frame const& dst)
+    {
+        auto position = [](uint32_t i, uint32_t dstSize, uint32_t srcSize)
+        {
+            double pos = (i + 0.5) * srcSize / dstSize - 0.5;
+            return std::min(std::max(pos, 0.0), static_cast<double>(srcSize - 1));
+        };
+        double worst = 0;
+        for (uint32_t y = 0; y < dst.Height; y++)
+        {
+            double py = position(y, dst.Height, src.Height);
+            auto y0 = static_cast<uint32_t>(py);
+            uint32_t y1 = std::min(y0 + 1, src.Height - 1);
+            for (uint32_t x = 0; x < dst.Width; x++)
+            {
+                double px = position(x, dst.Width, src.Width);
+                auto x0 = static_cast<uint32_t>(px);
+                uint32_t x1 = std::min(x0 + 1, src.Width - 1);
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    double top = src.At(x0, y0, c) + (src.At(x1, y0, c) - src.At(x0, y0, c)) * (px - x0);
+                    double bottom = src.At(x0, y1, c) + (src.At(x1, y1, c) - src.At(x0, y1, c)) * (px - x0);
+                    double exact = top + (bottom - top) * (py - y0);
+                    worst = std::max(worst, std::fabs(dst.At(x, y, c) - exact));
+                }
+            }
+        }
+        return worst;
+    }
+
+    bool PaddingUntouched(Frame const& frame)
+    {
+        for (uint32_t y = 0; y < frame.Height; y++)
+        {
+            for (size_t i = frame.Width * 4; i < frame.Stride; i++)
+            {
+                if (frame.Row(y)[i] != 0xEE)
+                    return false;
+            }
+        }
+        return true;
+    }
+}
+
+TEST(SameSizeIsACopy)
+{
+    auto src = Synthetic(97, 61);
+    for (auto filter : { ScaleFilter::Box, ScaleFilter::Bilinear })
+    {
+        auto dst = Scaled(src, 97, 61, filter);
+        CHECK(BoxError(src, dst) == 0);
+        CHECK(PaddingUntouched(dst));
+    }
+}
+
+TEST(HalvingAveragesEachQuad)
+{
+    // The 2:1 fast path, with a width that leaves a scalar tail.
+    auto src = Synthetic(2 * 133, 2 * 71);
+    auto dst = Scaled(src, 133, 71, ScaleFilter::Box);
+    CHECK(BoxError(src, dst) <= 0.5);
+    CHECK(PaddingUntouched(dst));
+}
+
+TEST(BoxMatchesTheExactSpanAverage)
+{
+    auto src = Synthetic(640, 360);
+    // Non-integer ratios, odd sizes, tall spans needing 32 bit totals, and
+    // a reduction too large for the reciprocal table.
+    uint32_t const sizes[][2] = { { 427, 240 }, { 213, 119 }, { 640, 1 }, { 33, 360 }, { 5, 3 }, { 1, 1 } };
+    for (auto const& size : sizes)
+    {
+        auto dst = Scaled(src, size[0], size[1], ScaleFilter::Box);
+        CHECK(BoxError(src, dst) <= 0.5);
+        CHECK(PaddingUntouched(dst));
+    }
+}
+
+TEST(BilinearMatchesTheExactSample)
+{
+    auto src = Synthetic(640, 360);
+    uint32_t const sizes[][2] = { { 320, 180 }, { 427, 240 }, { 213, 119 }, { 1000, 500 }, { 3, 2 } };
+    for (auto const& size : sizes)
+    {
+        // Weights rounded to 1/128 and truncating shifts cost up to about
+        // three levels across a hard edge.
+        auto dst = Scaled(src, size[0], size[1], ScaleFilter::Bilinear);
+        CHECK(BilinearError(src, dst) <= 3);
+        CHECK(PaddingUntouched(dst));
+    }
+}
+
+TEST(FlatColorStaysFlat)
+{
+    Frame src(300, 200);
+    for (uint32_t y = 0; y < src.Height; y++)
+    {
+        for (uint32_t x = 0; x < src.Width; x++)
+        {
+            uint8_t* px = src.Row(y) + x * 4;
+            px[0] = 10;
+            px[1] = 128;
+            px[2] = 250;
+            px[3] = 255;
+        }
+    }
+    for (auto filter : { ScaleFilter::Box, ScaleFilter::Bilinear })
+    {
+        for (uint32_t width : { 150u, 97u, 450u })
+        {
+            auto dst = Scaled(src, width, width * 2 / 3, filter);
+            bool flat = true;
+            for (uint32_t y = 0; y < dst.Height; y++)
+            {
+                for (uint32_t x = 0; x < dst.Width; x++)
+                    flat = flat && dst.At(x, y, 0) == 10 && dst.At(x, y, 1) == 128 && dst.At(x, y, 2) == 250 && dst.At(x, y, 3) == 255;
+            }
+            CHECK(flat);
+        }
+    }
+}
+
+TEST(BoxUpscalingTakesTheNearestPixel)
+{
+    auto src = Synthetic(50, 40);
+    auto dst = Scaled(src, 150, 120, ScaleFilter::Box);
+    CHECK(BoxError(src, dst) == 0);
+    CHECK(dst.At(149, 119, 1) == src.At(49, 39, 1));
+}
+
+TEST(ReusedScalerMatchesAFreshOne)
+{
+    // Filter tables are kept between calls; switching sizes and filters
+    // must rebuild them.
+    auto src = Synthetic(320, 240);
+    FrameScaler scaler;
+    uint32_t const sizes[][2] = { { 160, 120 }, { 200, 150 }, { 200, 150 }, { 107, 80 }, { 160, 120 } };
+    for (auto filter : { ScaleFilter::Box, ScaleFilter::Bilinear, ScaleFilter::Box })
+    {
+        for (auto const& size : sizes)
+        {
+            Frame dst(size[0], size[1], 0xEE);
+            scaler.Scale(dst.Pixels.data(), dst.Stride, dst.Width, dst.Height, src.Pixels.data(), src.Stride, src.Width, src.Height, filter);
+            CHECK(dst.Pixels == Scaled(src, size[0], size[1], filter).Pixels);
+        }
+    }
+}
+
+TEST(CropsAreClampedToTheFrame)
+{
+    auto whole = ClampCrop(CropRect(), 640, 480);
+    CHECK(whole.X == 0 && whole.Y == 0 && whole.Width == 640 && whole.Height == 480);
+    auto inside = ClampCrop({ 10, 20, 100, 50 }, 640, 480);
+    CHECK(inside.X == 10 && inside.Y == 20 && inside.Width == 100 && inside.Height == 50);
+    auto clipped = ClampCrop({ 600, 400, 100, 100 }, 640, 480);
+    CHECK(clipped.X == 600 && clipped.Y == 400 && clipped.Width == 40 && clipped.Height == 80);
+    auto outside = ClampCrop({ 700, 0, 10, 10 }, 640, 480);
+    CHECK(outside.X == 0 && outside.Width == 640 && outside.Height == 480);
+}
+
+TEST(ScaledSizeKeepsTheAspectOfAMissingAxis)
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    ScaleParams params;
+    GetScaledSize(params, 1920, 1080, width, height);
+    CHECK(width == 1920 && height == 1080);
+    params.Width = 1280;
+    GetScaledSize(params, 1920, 1080, width, height);
+    CHECK(width == 1280 && height == 720);
+    params.Width = 0;
+    params.Height = 360;
+    GetScaledSize(params, 1920, 1080, width, height);
+    CHECK(width == 640 && height == 360);
+    params.Width = 1;
+    params.Height = 0;
+    GetScaledSize(params, 1920, 10, width, height);
+    CHECK(width == 1 && height == 1);
+}
+
+TEST(LetterboxCentresTheFrame)
+{
+    auto stretch = GetFitRect(ScaleFit::Stretch, 1280, 720, 1000, 1000);
+    CHECK(stretch.X == 0 && stretch.Y == 0 && stretch.Width == 1280 && stretch.Height == 720);
+    auto pillars = GetFitRect(ScaleFit::Letterbox, 1280, 720, 1000, 1000);
+    CHECK(pillars.X == 280 && pillars.Y == 0 && pillars.Width == 720 && pillars.Height == 720);
+    auto bars = GetFitRect(ScaleFit::Letterbox, 1280, 720, 2000, 500);
+    CHECK(bars.X == 0 && bars.Y == 200 && bars.Width == 1280 && bars.Height == 320);
+}
+
+TEST(ReductionStopsAtTheTarget)
+{
+    CHECK(GetReductionLevels(3840, 2160, 1280, 720, 8) == 1);
+    CHECK(GetReductionLevels(3840, 2160, 640, 0, 8) == 2);
+    CHECK(GetReductionLevels(3840, 2160, 0, 0, 8) == 0);
+    CHECK(GetReductionLevels(3840, 2160, 1, 1, 3) == 3);
+    CHECK(GetReductionLevels(4, 4, 1, 1, 8) == 2);
+}
@@ -0,0 +1,268 @@
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FrameTrace.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // A file in the temporary directory, deleted when done with.
+    struct TempPath
+    {
+        std::string Path;
+
+        explicit TempPath(const char* name)
+        {
+            std::error_code error;
+            Path = (std::filesystem::temp_directory_path(error) / name).string();
+            std::filesystem::remove(Path, error);
+        }
+
+        ~TempPath()
+        {
+            std::error_code error;
+            std::filesystem::remove(Path, error);
+        }
+    };
+
+    FrameTraceRecord Record(uint32_t track, uint64_t frameId)
+    {
+        FrameTraceRecord record;
+        record.Track = track;
+        record.Width = 1280;
+        record.Height = 720;
+        record.Timing.FrameId = frameId;
+        record.Timing.FrameIndex = frameId + 100;
+        record.Timing.CaptureTimeNs = 1000000 + frameId * 16666667;
+        record.Timing.AcquireTimeNs = record.Timing.CaptureTimeNs + 500000;
+        record.Timing.CopyStartNs = record.Timing.AcquireTimeNs + 1500000;
+        record.Timing.CopyEndNs = record.Timing.CopyStartNs + 800000;
+        record.Timing.DeliveryTimeNs = record.Timing.CopyEndNs + 1234;
+        return record;
+    }
+
+    size_t Count(std::string const& text, std::string const& part)
+    {
+        size_t count = 0;
+        for (size_t at = text.find(part); at != std::string::npos; at = text.find(part, at + part.size()))
+            count++;
+        return count;
+    }
+
+    std::string ReadFile(std::string const& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream text;
+        text << in.rdbuf();
+        return text.str();
+    }
+}
+
+TEST(BufferIsFirstInFirstOut)
+{
+    FrameTraceBuffer buffer(5);
+    CHECK(buffer.Capacity() == 8);
+    FrameTraceRecord record;
+    CHECK(!buffer.TryPop(record));
+    // Several laps, each filling the buffer and emptying it again.
+    bool ordered = true;
+    for (uint64_t lap = 0; lap < 4; lap++)
+    {
+        for (uint64_t i = 0; i < 8; i++)
+            ordered = buffer.TryPush(Record(0, lap * 8 + i)) && ordered;
+        for (uint64_t i = 0; i < 8; i++)
+            ordered = buffer.TryPop(record) && record.Timing.FrameId == lap * 8 + i && ordered;
+        ordered = !buffer.TryPop(record) && ordered;
+    }
+    CHECK(ordered);
+    CHECK(buffer.Dropped() == 0);
+}
+
+TEST(FullBufferDropsNewRecords)
+{
+    FrameTraceBuffer buffer(4);
+    for (uint64_t i = 0; i < 4; i++)
+        CHECK(buffer.TryPush(Record(0, i)));
+    CHECK(!buffer.TryPush(Record(0, 4)));
+    CHECK(!buffer.TryPush(Record(0, 5)));
+    CHECK(buffer.Dropped() == 2);
+    // The records already in are kept; space frees up as they are read.
+    FrameTraceRecord record;
+    REQUIRE(buffer.TryPop(record));
+    CHECK(record.Timing.FrameId == 0);
+    CHECK(buffer.TryPush(Record(0, 6)));
+    std::vector<uint64_t> ids;
+    while (buffer.TryPop(record))
+        ids.push_back(record.Timing.FrameId);
+    CHECK(ids == std::vector<uint64_t>({ 1, 2, 3, 6 }));
+}
+
+TEST(ProducersRaceTheReader)
+{
+    // Every record pushed is read once, whole and in its producer's order,
+    // or counted as dropped.
+    constexpr uint32_t Producers = 4;
+    constexpr uint64_t PerProducer = 20000;
+    FrameTraceBuffer buffer(64);
+    std::atomic<uint64_t> pushed{ 0 };
+    std::vector<std::thread> threads;
+    for (uint32_t track = 0; track < Producers; track++)
+    {
+        threads.emplace_back([&, track] {
+            for (uint64_t i = 0; i < PerProducer; i++)
+            {
+                if (buffer.TryPush(Record(track, i)))
+                    pushed.fetch_add(1, std::memory_order_relaxed);
+                if (i % 64 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+    std::vector<int64_t> last(Producers, -1);
+    uint64_t popped = 0;
+    bool intact = true;
+    auto drain = [&] {
+        FrameTraceRecord record;
+        while (buffer.TryPop(record))
+        {
+            auto expected = Record(record.Track, record.Timing.FrameId);
+            intact = intact && record.Track < Producers && record.Width == expected.Width &&
+                record.Timing.CaptureTimeNs == expected.Timing.CaptureTimeNs &&
+                record.Timing.DeliveryTimeNs == expected.Timing.DeliveryTimeNs &&
+                static_cast<int64_t>(record.Timing.FrameId) > last[record.Track];
+            if (record.Track < Producers)
+                last[record.Track] = static_cast<int64_t>(record.Timing.FrameId);
+            popped++;
+        }
+    };
+    while (pushed.load() + buffer.Dropped() < Producers * PerProducer)
+        drain();
+    for (auto& thread : threads)
+        thread.join();
+    drain();
+    CHECK(intact);
+    CHECK(popped == pushed.load());
+    CHECK(popped + buffer.Dropped() == Producers * PerProducer);
+}
+
+TEST(FramesBecomeNestedSlices)
+{
+    std::string out;
+    bool first = true;
+    AppendTraceEvents(out, Record(3, 7), "game \"main\"", first);
+    CHECK(!first);
+    // The frame and four stages, each a begin and an end.
+    CHECK(Count(out, "\"ph\":\"b\"") == 5);
+    CHECK(Count(out, "\"ph\":\"e\"") == 5);
+    CHECK(Count(out, "\"id\":\"3:7\"") == 10);
+    CHECK(Count(out, "\"tid\":3") == 10);
+    for (auto stage : { "queue", "readback", "copy", "deliver" })
+        CHECK(Count(out, std::string("\"name\":\"") + stage + "\"") == 2);
+    CHECK(Count(out, "\"name\":\"game \\\"main\\\"\"") == 2);
+    CHECK(out.find("\"frame_id\":7,\"frame_index\":107,\"width\":1280,\"height\":720") != std::string::npos);
+    // Microseconds with the nanoseconds after the point.
+    auto record = Record(3, 7);
+    auto ts = "\"ts\":" + std::to_string(record.Timing.DeliveryTimeNs / 1000) + "." +
+        std::to_string(record.Timing.DeliveryTimeNs % 1000);
+    CHECK(out.find(ts) != std::string::npos);
+    CHECK(out.compare(0, 1, "{") == 0);
+
+    // A second frame is separated from the first.
+    size_t length = out.size();
+    AppendTraceEvents(out, Record(3, 8), "game", first);
+    CHECK(out.compare(length, 2, ",\n") == 0);
+}
+
+TEST(UnknownStagesAreLeftOut)
+{
+    // Delivered from a lease: no copy, and no capture time.
+    auto record = Record(0, 1);
+    record.Timing.CaptureTimeNs = 0;
+    record.Timing.CopyStartNs = 0;
+    record.Timing.CopyEndNs = 0;
+    std::string out;
+    bool first = true;
+    AppendTraceEvents(out, record, "lease", first);
+    CHECK(Count(out, "\"ph\":\"b\"") == 1);
+    CHECK(Count(out, "\"name\":\"queue\"") == 0);
+    CHECK(Count(out, "\"name\":\"copy\"") == 0);
+
+    // Nothing to place the frame at, or delivered before it started.
+    record.Timing.AcquireTimeNs = 0;
+    out.clear();
+    first = true;
+    AppendTraceEvents(out, record, "none", first);
+    CHECK(out.empty() && first);
+    record = Record(0, 2);
+    record.Timing.DeliveryTimeNs = record.Timing.CaptureTimeNs - 1;
+    AppendTraceEvents(out, record, "backwards", first);
+    CHECK(out.empty());
+
+    AppendTrackName(out, 5, "tab\t", first);
+    CHECK(out == "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":5,\"args\":{\"name\":\"tab\\u0009\"}}");
+}
+
+TEST(WriterProducesACompleteTrace)
+{
+    TempPath file("FrameTraceTest.json");
+    FrameTraceWriter writer;
+    CHECK(!writer.Record(Record(0, 0)));
+    REQUIRE(writer.Open(file.Path, 256));
+    CHECK(writer.IsOpen());
+    auto main = writer.AddTrack("main");
+    auto second = writer.AddTrack("second");
+    CHECK(main == 0 && second == 1);
+    // Records from two threads, some before the writer thread's first flush
+    // and some after.
+    std::thread other([&] {
+        for (uint64_t i = 0; i < 50; i++)
+            writer.Record(Record(second, i));
+    });
+    for (uint64_t i = 0; i < 50; i++)
+        writer.Record(Record(main, i));
+    other.join();
+    std::this_thread::sleep_for(FrameTraceWriter::FlushInterval * 2);
+    for (uint64_t i = 50; i < 60; i++)
+        writer.Record(Record(main, i));
+    CHECK(writer.Close());
+    CHECK(!writer.IsOpen());
+    CHECK(!writer.Close());
+    CHECK(!writer.Record(Record(main, 60)));
+    CHECK(writer.Written() == 110);
+    CHECK(writer.Dropped() == 0);
+
+    auto text = ReadFile(file.Path);
+    CHECK(text.compare(0, 39, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+    CHECK(text.size() > 4 && text.compare(text.size() - 4, 4, "\n]}\n") == 0);
+    CHECK(Count(text, "\"thread_name\"") == 2);
+    CHECK(Count(text, "\"name\":\"main\"") == 2 * 60 + 1);
+    CHECK(Count(text, "\"name\":\"second\"") == 2 * 50 + 1);
+    // One event per line, separated by commas, the last without one.
+    CHECK(Count(text, "},\n{") == 2 + 110 * 10 - 1);
+    CHECK(text.find(",\n\n]}") == std::string::npos);
+}
+
+TEST(WriterCountsWhatItDrops)
+{
+    TempPath file("FrameTraceDrop.json");
+    FrameTraceWriter writer;
+    CHECK(!writer.Open(""));
+    REQUIRE(writer.Open(file.Path, 4));
+    // Quicker than the writer thread wakes up.
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < 20; i++)
+        kept += writer.Record(Record(0, i)) ? 1 : 0;
+    CHECK(kept >= 4 && kept < 20);
+    CHECK(writer.Dropped() == 20 - kept);
+    CHECK(writer.Close());
+    CHECK(writer.Written() == kept);
+    CHECK(writer.Dropped() == 20 - kept);
+    // Reopening starts the counts over.
+    REQUIRE(writer.Open(file.Path));
+    CHECK(writer.Written() == 0 && writer.Dropped() == 0);
+    CHECK(writer.Close());
+}
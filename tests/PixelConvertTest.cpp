@@ -0,0 +1,313 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "PixelConvert.h"
+#include "RowCopy.h"
+#include "TestHarness.h"
+
+namespace
+{
+    struct Rgb
+    {
+        uint8_t R, G, B;
+    };
+
+    struct Yuv
+    {
+        uint8_t Y, U, V;
+    };
+
+    constexpr uint32_t Colors = 8;
+    const Rgb Bars[Colors] = {
+        { 255, 255, 255 }, { 0, 0, 0 }, { 255, 0, 0 }, { 0, 255, 0 },
+        { 0, 0, 255 }, { 255, 255, 0 }, { 0, 255, 255 }, { 255, 0, 255 },
+    };
+
+    // The bars above through the BT.601 and BT.709 equations in floating
+    // point, rounded: white, black, red, green, blue, yellow, cyan, magenta.
+    const Yuv Bt601Limited[Colors] = {
+        { 235, 128, 128 }, { 16, 128, 128 }, { 81, 90, 240 }, { 145, 54, 34 },
+        { 41, 240, 110 }, { 210, 16, 146 }, { 170, 166, 16 }, { 106, 202, 222 },
+    };
+    const Yuv Bt601Full[Colors] = {
+        { 255, 128, 128 }, { 0, 128, 128 }, { 76, 85, 255 }, { 150, 44, 21 },
+        { 29, 255, 107 }, { 226, 0, 149 }, { 179, 171, 0 }, { 105, 212, 235 },
+    };
+    const Yuv Bt709Limited[Colors] = {
+        { 235, 128, 128 }, { 16, 128, 128 }, { 63, 102, 240 }, { 173, 42, 26 },
+        { 32, 240, 118 }, { 219, 16, 138 }, { 188, 154, 16 }, { 78, 214, 230 },
+    };
+    const Yuv Bt709Full[Colors] = {
+        { 255, 128, 128 }, { 0, 128, 128 }, { 54, 99, 255 }, { 182, 30, 12 },
+        { 18, 255, 116 }, { 237, 0, 140 }, { 201, 157, 0 }, { 73, 226, 244 },
+    };
+
+    // Two rows of 2x2 blocks, the bars left to right and then right to left,
+    // so every chroma sample averages one colour and the luma rows are long
+    // enough for the vector kernels.
+    constexpr uint32_t BlockSize = 2;
+    constexpr uint32_t GoldenWidth = Colors * BlockSize;
+    constexpr uint32_t GoldenHeight = 2 * BlockSize;
+    constexpr uint8_t Guard = 0xA5;
+
+    uint32_t ColorAt(uint32_t x, uint32_t y)
+    {
+        uint32_t bar = x / BlockSize;
+        return y / BlockSize == 0 ? bar : Colors - 1 - bar;
+    }
+
+    std::vector<uint8_t> GoldenImage(size_t srcStride)
+    {
+        std::vector<uint8_t> image(srcStride * GoldenHeight, Guard);
+        for (uint32_t y = 0; y < GoldenHeight; y++)
+        {
+            for (uint32_t x = 0; x < GoldenWidth; x++)
+            {
+                auto const& rgb = Bars[ColorAt(x, y)];
+                uint8_t* px = image.data() + y * srcStride + x * 4;
+                px[0] = rgb.B;
+                px[1] = rgb.G;
+                px[2] = rgb.R;
+                px[3] = 255;
+            }
+        }
+        return image;
+    }
+
+    // The converters work in 8.8 fixed point, so allow one step either way.
+    bool Near(uint8_t actual, uint8_t expected)
+    {
+        return std::abs(static_cast<int>(actual) - static_cast<int>(expected)) <= 1;
+    }
+
+    // Convert the golden image into format with a padded stride and compare
+    // every sample, and every padding byte, with the table.
+    bool MatchesGolden(OutputFormat format, YuvMatrix matrix, YuvRange range, Yuv const* golden)
+    {
+        size_t srcStride = GoldenWidth * 4 + 12;
+        auto src = GoldenImage(srcStride);
+        size_t stride = GoldenWidth + 6;
+        size_t size = GetOutputFrameSize(format, GoldenWidth, GoldenHeight, stride);
+        std::vector<uint8_t> dst(size + 16, Guard);
+
+        ConvertParams params;
+        params.Format = format;
+        params.Matrix = matrix;
+        params.Range = range;
+        ConvertFrame(dst.data(), stride, src.data(), srcStride, GoldenWidth, GoldenHeight, params);
+
+        bool ok = true;
+        for (uint32_t y = 0; y < GoldenHeight; y++)
+        {
+            for (uint32_t x = 0; x < GoldenWidth; x++)
+                ok = Near(dst[y * stride + x], golden[ColorAt(x, y)].Y) && ok;
+            for (size_t x = GoldenWidth; x < stride; x++)
+                ok = dst[y * stride + x] == Guard && ok;
+        }
+
+        const uint8_t* chroma = dst.data() + stride * GoldenHeight;
+        for (uint32_t cy = 0; cy < GoldenHeight / 2; cy++)
+        {
+            for (uint32_t cx = 0; cx < GoldenWidth / 2; cx++)
+            {
+                auto const& expected = golden[ColorAt(cx * 2, cy * 2)];
+                uint8_t u = 0;
+                uint8_t v = 0;
+                if (format == OutputFormat::Nv12)
+                {
+                    u = chroma[cy * stride + cx * 2];
+                    v = chroma[cy * stride + cx * 2 + 1];
+                }
+                else
+                {
+                    size_t chromaStride = (stride + 1) / 2;
+                    u = chroma[cy * chromaStride + cx];
+                    v = chroma[chromaStride * (GoldenHeight / 2) + cy * chromaStride + cx];
+                }
+                ok = Near(u, expected.U) && Near(v, expected.V) && ok;
+            }
+        }
+        for (size_t i = size; i < dst.size(); i++)
+            ok = dst[i] == Guard && ok;
+        return ok;
+    }
+
+    // Every planar format, range and kernel against one matrix's tables.
+    void CheckMatrix(YuvMatrix matrix, Yuv const* limited, Yuv const* full)
+    {
+        auto active = GetRowCopyKernel();
+        for (auto kernel : { RowCopyKernel::Scalar, RowCopyKernel::Avx2 })
+        {
+            auto used = SetRowCopyKernel(kernel);
+            for (auto format : { OutputFormat::Nv12, OutputFormat::I420 })
+            {
+                for (auto range : { YuvRange::Limited, YuvRange::Full })
+                {
+                    if (!CHECK(MatchesGolden(format, matrix, range, range == YuvRange::Full ? full : limited)))
+                    {
+                        std::fprintf(stderr, "  %s, %s range, kernel %s\n",
+                            format == OutputFormat::Nv12 ? "nv12" : "i420",
+                            range == YuvRange::Full ? "full" : "limited",
+                            GetRowCopyKernelName(used));
+                    }
+                }
+            }
+        }
+        SetRowCopyKernel(active);
+    }
+
+    std::vector<uint8_t> Noise(size_t bytes, uint32_t seed)
+    {
+        std::vector<uint8_t> noise(bytes);
+        for (auto& b : noise)
+        {
+            seed = seed * 1664525 + 1013904223;
+            b = static_cast<uint8_t>(seed >> 24);
+        }
+        return noise;
+    }
+
+    std::vector<uint8_t> Convert(std::vector<uint8_t> const& src, size_t srcStride, uint32_t width, uint32_t height,
+        ConvertParams const& params)
+    {
+        std::vector<uint8_t> dst(GetOutputFrameSize(params.Format, width, height, 0));
+        ConvertFrame(dst.data(), 0, src.data(), srcStride, width, height, params);
+        return dst;
+    }
+
+    const OutputFormat AllFormats[] = {
+        OutputFormat::Bgra, OutputFormat::Rgba, OutputFormat::Rgb24, OutputFormat::Nv12, OutputFormat::I420,
+    };
+}
+
+TEST(GoldenBt601)
+{
+    CheckMatrix(YuvMatrix::Bt601, Bt601Limited, Bt601Full);
+}
+
+TEST(GoldenBt709)
+{
+    CheckMatrix(YuvMatrix::Bt709, Bt709Limited, Bt709Full);
+}
+
+TEST(PackedFormatsReorderChannels)
+{
+    size_t srcStride = GoldenWidth * 4;
+    auto src = GoldenImage(srcStride);
+    ConvertParams params;
+    params.Format = OutputFormat::Rgba;
+    auto rgba = Convert(src, srcStride, GoldenWidth, GoldenHeight, params);
+    params.Format = OutputFormat::Rgb24;
+    auto rgb = Convert(src, srcStride, GoldenWidth, GoldenHeight, params);
+    params.Format = OutputFormat::Bgra;
+    auto bgra = Convert(src, srcStride, GoldenWidth, GoldenHeight, params);
+    CHECK(bgra == src);
+
+    bool ok = true;
+    for (uint32_t i = 0; i < GoldenWidth * GoldenHeight; i++)
+    {
+        auto const& expected = Bars[ColorAt(i % GoldenWidth, i / GoldenWidth)];
+        ok = rgba[i * 4] == expected.R && rgba[i * 4 + 1] == expected.G && rgba[i * 4 + 2] == expected.B && rgba[i * 4 + 3] == 255 && ok;
+        ok = rgb[i * 3] == expected.R && rgb[i * 3 + 1] == expected.G && rgb[i * 3 + 2] == expected.B && ok;
+    }
+    CHECK(ok);
+}
+
+TEST(VectorKernelsMatchScalar)
+{
+    auto active = GetRowCopyKernel();
+    for (uint32_t width : { 1u, 5u, 7u, 8u, 9u, 31u, 64u, 333u })
+    {
+        uint32_t height = 5;
+        size_t srcStride = width * 4 + 20;
+        auto src = Noise(srcStride * height, width);
+        for (auto format : AllFormats)
+        {
+            ConvertParams params;
+            params.Format = format;
+            params.Matrix = YuvMatrix::Bt709;
+            SetRowCopyKernel(RowCopyKernel::Scalar);
+            auto scalar = Convert(src, srcStride, width, height, params);
+            SetRowCopyKernel(RowCopyKernel::Avx2);
+            auto vector = Convert(src, srcStride, width, height, params);
+            if (!CHECK(scalar == vector))
+                std::fprintf(stderr, "  width %u, format %d\n", width, static_cast<int>(format));
+        }
+    }
+    SetRowCopyKernel(active);
+}
+
+TEST(OddSizesRepeatTheLastPixel)
+{
+    // A 5x3 frame of one colour: the last chroma column and row average the
+    // edge pixel with itself, so every sample still holds the colour.
+    uint32_t width = 5;
+    uint32_t height = 3;
+    std::vector<uint8_t> src(width * 4 * height);
+    for (size_t i = 0; i < src.size(); i += 4)
+    {
+        src[i] = Bars[2].B;
+        src[i + 1] = Bars[2].G;
+        src[i + 2] = Bars[2].R;
+        src[i + 3] = 255;
+    }
+    ConvertParams params;
+    params.Format = OutputFormat::I420;
+    auto i420 = Convert(src, width * 4, width, height, params);
+    CHECK(i420.size() == 5 * 3 + 3 * 2 * 2);
+    bool ok = true;
+    for (size_t i = 0; i < 15; i++)
+        ok = Near(i420[i], Bt601Limited[2].Y) && ok;
+    for (size_t i = 0; i < 6; i++)
+        ok = Near(i420[15 + i], Bt601Limited[2].U) && Near(i420[21 + i], Bt601Limited[2].V) && ok;
+    CHECK(ok);
+
+    // NV12 rows round up to 6 bytes, so the two UV rows of 3 pairs each
+    // don't overlap.
+    params.Format = OutputFormat::Nv12;
+    CHECK(GetOutputRowBytes(OutputFormat::Nv12, width) == 6);
+    auto nv12 = Convert(src, width * 4, width, height, params);
+    CHECK(nv12.size() == 6 * 3 + 6 * 2);
+    ok = true;
+    for (size_t i = 0; i < 6; i++)
+        ok = Near(nv12[18 + i * 2], Bt601Limited[2].U) && Near(nv12[19 + i * 2], Bt601Limited[2].V) && ok;
+    CHECK(ok);
+}
+
+TEST(StripsMatchTheWholeFrame)
+{
+    uint32_t width = 37;
+    uint32_t height = 11;
+    size_t srcStride = width * 4;
+    auto src = Noise(srcStride * height, 99);
+    for (auto format : AllFormats)
+    {
+        ConvertParams params;
+        params.Format = format;
+        auto whole = Convert(src, srcStride, width, height, params);
+        std::vector<uint8_t> strips(whole.size());
+        for (uint32_t row = 0; row < height; row += 4)
+            ConvertFrameRows(strips.data(), 0, src.data(), srcStride, width, height, row, 4, params);
+        CHECK(strips == whole);
+    }
+}
+
+TEST(CopyOutputFrameRestrides)
+{
+    uint32_t width = 9;
+    uint32_t height = 5;
+    auto src = Noise(width * 4 * height, 7);
+    for (auto format : AllFormats)
+    {
+        ConvertParams params;
+        params.Format = format;
+        auto packed = Convert(src, width * 4, width, height, params);
+        size_t padded = GetOutputRowBytes(format, width) + 10;
+        std::vector<uint8_t> wide(GetOutputFrameSize(format, width, height, padded));
+        CopyOutputFrame(wide.data(), padded, packed.data(), 0, format, width, height);
+        std::vector<uint8_t> back(packed.size());
+        CopyOutputFrame(back.data(), 0, wide.data(), padded, format, width, height);
+        CHECK(back == packed);
+    }
+}
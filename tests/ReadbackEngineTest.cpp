@@ -0,0 +1,345 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CapturePipeline.h"
+#include "ReadbackEngine.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    using std::chrono::milliseconds;
+
+    // A capture session as the engine sees it. Arrive stands in for the frame
+    // arrived handler; Step copies the newest frame, which is read back after
+    // CopyPolls more steps report it Pending.
+    class FakeJob : public IReadbackJob
+    {
+    public:
+        explicit FakeJob(uint32_t copyPolls = 0) : m_copyPolls(copyPolls) {}
+
+        void Arrive()
+        {
+            m_arrived.fetch_add(1);
+        }
+
+        ReadbackStep Step() override
+        {
+            if (m_inStep.exchange(true))
+                m_overlaps.fetch_add(1);
+            m_steps.fetch_add(1);
+            if (m_delay.count() != 0)
+                std::this_thread::sleep_for(m_delay);
+
+            ReadbackStep step = ReadbackStep::Idle;
+            uint64_t arrived = m_arrived.load();
+            if (m_copying == 0 && arrived != m_copied)
+            {
+                m_copied = arrived;
+                m_copying = m_copyPolls + 1;
+            }
+            if (m_copying != 0)
+            {
+                if (--m_copying == 0)
+                {
+                    m_read.store(m_copied);
+                    m_completed.fetch_add(1);
+                    step = ReadbackStep::Completed;
+                }
+                else
+                {
+                    step = ReadbackStep::Pending;
+                }
+            }
+            m_inStep.store(false);
+            return step;
+        }
+
+        void SetDelay(milliseconds delay) { m_delay = delay; }
+        uint64_t Arrived() const { return m_arrived.load(); }
+        uint64_t Read() const { return m_read.load(); }
+        uint64_t Steps() const { return m_steps.load(); }
+        uint64_t Completed() const { return m_completed.load(); }
+        uint64_t Overlaps() const { return m_overlaps.load(); }
+        bool InStep() const { return m_inStep.load(); }
+
+    private:
+        uint32_t m_copyPolls;
+        milliseconds m_delay{ 0 };
+        std::atomic<uint64_t> m_arrived{ 0 };
+        std::atomic<uint64_t> m_read{ 0 };
+        std::atomic<uint64_t> m_steps{ 0 };
+        std::atomic<uint64_t> m_completed{ 0 };
+        std::atomic<uint64_t> m_overlaps{ 0 };
+        std::atomic<bool> m_inStep{ false };
+        // Only touched from Step, which the engine never runs twice at once.
+        uint64_t m_copied = 0;
+        uint32_t m_copying = 0;
+    };
+
+    // A synthetic source read back the way SimpleCapture::Step does it: the
+    // pipeline copies into a back buffer without waiting on the copy, and a
+    // completed frame is swapped to the front for the consumer.
+    class SyntheticJob : public IReadbackJob
+    {
+    public:
+        SyntheticJob(uint32_t width, uint32_t height, std::chrono::microseconds latency) :
+            m_source(Config(width, height, latency), &m_stats),
+            m_pipeline(m_source, m_stats, 1),
+            m_back(static_cast<size_t>(width) * 4 * height),
+            m_front(m_back.size())
+        {
+            m_source.SetNonBlocking(true);
+        }
+
+        ReadbackStep Step() override
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            if (m_pipeline.CopyImage(m_back.data(), m_back.size(), 0, width, height) != CopyResult::Ok)
+                return m_source.MapPending() ? ReadbackStep::Pending : ReadbackStep::Idle;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::swap(m_back, m_front);
+            m_frontIndex = m_pipeline.GetFrameTiming().FrameIndex;
+            m_frontWidth = width;
+            m_frontHeight = height;
+            return ReadbackStep::Completed;
+        }
+
+        // Whether the front buffer holds the frame it claims to, and comes
+        // after the last one checked.
+        bool CheckFront(uint32_t width, uint32_t height)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_frontWidth != width || m_frontHeight != height)
+                return false;
+            if (m_checked != 0 && m_frontIndex + 1 <= m_checked)
+                return false;
+            m_checked = m_frontIndex + 1;
+            std::vector<uint8_t> expected(m_front.size());
+            SyntheticCaptureSource::RenderFrame(expected.data(), static_cast<size_t>(width) * 4, width, height, BoxSize, m_frontIndex);
+            return std::memcmp(expected.data(), m_front.data(), expected.size()) == 0;
+        }
+
+        CaptureStats& Stats() { return m_stats; }
+
+    private:
+        static constexpr uint32_t BoxSize = 32;
+
+        static SyntheticSourceConfig Config(uint32_t width, uint32_t height, std::chrono::microseconds latency)
+        {
+            SyntheticSourceConfig config;
+            config.Width = width;
+            config.Height = height;
+            config.BoxSize = BoxSize;
+            config.ReadbackLatency = latency;
+            return config;
+        }
+
+        CaptureStats m_stats;
+        SyntheticCaptureSource m_source;
+        CapturePipeline m_pipeline;
+        std::vector<uint8_t> m_back;
+        std::mutex m_mutex;
+        std::vector<uint8_t> m_front;
+        uint64_t m_frontIndex = 0;
+        uint32_t m_frontWidth = 0;
+        uint32_t m_frontHeight = 0;
+        uint64_t m_checked = 0;
+    };
+
+    template <typename Done>
+    bool Eventually(Done done)
+    {
+        for (int i = 0; i < 5000 && !done(); i++)
+            std::this_thread::sleep_for(milliseconds(1));
+        return done();
+    }
+}
+
+TEST(KickedJobsAreReadBack)
+{
+    ReadbackEngine engine(2);
+    FakeJob job;
+    std::atomic<uint32_t> callbacks{ 0 };
+    engine.Add(3, job, [&](uint32_t id) {
+        if (id == 3)
+            callbacks++;
+    });
+    job.Arrive();
+    engine.Kick(3);
+    CHECK(Eventually([&] { return job.Read() == 1; }));
+    CHECK(Eventually([&] { return callbacks.load() == 1; }));
+    engine.Remove(3);
+}
+
+TEST(PendingCopiesArePolledWithoutKicks)
+{
+    ReadbackEngine engine(1, std::chrono::microseconds(100));
+    FakeJob job(5);
+    engine.Add(1, job);
+    job.Arrive();
+    engine.Kick(1);
+    CHECK(Eventually([&] { return job.Read() == 1; }));
+    engine.Remove(1);
+    CHECK(engine.Stats().Polls >= 5);
+}
+
+TEST(KicksOfAnIdleJobAreHarmless)
+{
+    ReadbackEngine engine(1);
+    FakeJob job;
+    engine.Add(1, job);
+    for (int i = 0; i < 100; i++)
+        engine.Kick(1);
+    engine.Kick(99);
+    CHECK(Eventually([&] { return job.Steps() != 0 && !job.InStep(); }));
+    engine.Remove(1);
+    CHECK(job.Completed() == 0);
+}
+
+TEST(RemoveWaitsForTheRunningStep)
+{
+    ReadbackEngine engine(1);
+    FakeJob job;
+    job.SetDelay(milliseconds(30));
+    engine.Add(1, job);
+    job.Arrive();
+    engine.Kick(1);
+    REQUIRE(Eventually([&] { return job.InStep(); }));
+    engine.Remove(1);
+    CHECK(!job.InStep());
+    auto steps = job.Steps();
+    job.Arrive();
+    engine.Kick(1);
+    std::this_thread::sleep_for(milliseconds(20));
+    CHECK(job.Steps() == steps);
+}
+
+TEST(ManyJobsFromManyThreads)
+{
+    // Sixteen sessions, four kicking threads standing in for frame arrived
+    // handlers, copies taking a few polls each, and sessions coming and
+    // going meanwhile. Every frame must be read back once the kicks stop,
+    // and no session stepped by two workers at once.
+    constexpr uint32_t Jobs = 16;
+    constexpr uint32_t Kickers = 4;
+    ReadbackEngine engine(4, std::chrono::microseconds(50));
+    std::vector<std::unique_ptr<FakeJob>> jobs;
+    for (uint32_t i = 0; i < Jobs; i++)
+    {
+        jobs.push_back(std::make_unique<FakeJob>(i % 3));
+        engine.Add(i, *jobs[i]);
+    }
+
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> kickers;
+    for (uint32_t k = 0; k < Kickers; k++)
+    {
+        kickers.emplace_back([&, k] {
+            uint32_t i = k;
+            while (!stop.load())
+            {
+                auto id = i++ % Jobs;
+                // A session's frames come from one thread, as from one pool.
+                if (id % Kickers == k)
+                {
+                    jobs[id]->Arrive();
+                    engine.Kick(id);
+                }
+                if (i % 8 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    }
+    // CHECK isn't thread safe, so the other threads only count.
+    std::atomic<uint32_t> steppedAfterRemove{ 0 };
+    std::thread churn([&] {
+        for (int round = 0; round < 50 && !stop.load(); round++)
+        {
+            auto id = static_cast<uint32_t>(round % Jobs);
+            engine.Remove(id);
+            if (jobs[id]->InStep())
+                steppedAfterRemove++;
+            engine.Add(id, *jobs[id]);
+            engine.Kick(id);
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+    });
+    std::this_thread::sleep_for(milliseconds(200));
+    stop.store(true);
+    for (auto& kicker : kickers)
+        kicker.join();
+    churn.join();
+    CHECK(steppedAfterRemove.load() == 0);
+
+    // One last kick each catches frames that landed while a session was out.
+    for (uint32_t i = 0; i < Jobs; i++)
+        engine.Kick(i);
+    for (uint32_t i = 0; i < Jobs; i++)
+    {
+        auto& job = *jobs[i];
+        CHECK(Eventually([&] { return job.Read() == job.Arrived(); }));
+        CHECK(job.Overlaps() == 0);
+    }
+    auto stats = engine.Stats();
+    CHECK(stats.MaxConcurrent <= 4);
+    for (uint32_t i = 0; i < Jobs; i++)
+        engine.Remove(i);
+}
+
+TEST(SourcesOfDifferentSizesAreReadBackIntact)
+{
+    // Twelve synthetic sessions of odd sizes from 64x48 up past 720p, each
+    // copy taking a different while. Frames complete on the workers in any
+    // order across sessions; each must be whole, the size of its session,
+    // and newer than the last one seen from it.
+    constexpr uint32_t Jobs = 12;
+    constexpr uint32_t Frames = 10;
+    ReadbackEngine engine(3, std::chrono::microseconds(100));
+    std::vector<std::unique_ptr<SyntheticJob>> jobs;
+    std::vector<uint32_t> widths;
+    std::vector<uint32_t> heights;
+    std::atomic<uint32_t> broken{ 0 };
+    std::vector<std::unique_ptr<std::atomic<uint32_t>>> completed;
+    for (uint32_t i = 0; i < Jobs; i++)
+    {
+        widths.push_back(64 + i * 113);
+        heights.push_back(48 + i * 61);
+        jobs.push_back(std::make_unique<SyntheticJob>(widths[i], heights[i], std::chrono::microseconds(200 + i * 150)));
+        completed.push_back(std::make_unique<std::atomic<uint32_t>>(0));
+        engine.Add(i, *jobs[i], [&](uint32_t id) {
+            if (!jobs[id]->CheckFront(widths[id], heights[id]))
+                broken++;
+            completed[id]->fetch_add(1);
+        });
+    }
+
+    auto done = [&] {
+        for (auto& count : completed)
+        {
+            if (count->load() < Frames)
+                return false;
+        }
+        return true;
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (!done() && std::chrono::steady_clock::now() < deadline)
+    {
+        // Frames arrive for every session at once, as from many windows.
+        for (uint32_t i = 0; i < Jobs; i++)
+            engine.Kick(i);
+        std::this_thread::sleep_for(milliseconds(1));
+    }
+    for (uint32_t i = 0; i < Jobs; i++)
+        engine.Remove(i);
+    CHECK(done());
+    CHECK(broken.load() == 0);
+    for (auto& job : jobs)
+        CHECK(job->Stats().Snapshot().NullFrames == 0);
+    CHECK(engine.Stats().Polls != 0);
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "ReadbackRing.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // A frame as the fake device sees it: every byte holds Value.
+    struct FakeFrame
+    {
+        uint8_t Value = 0;
+    };
+
+    // Staging surfaces in memory on a simulated clock. A copy completes
+    // Latency ticks after it is issued; Map waits the clock out to there and
+    // adds the wait to WaitTicks. Each Submit is one tick of frame time.
+    struct FakeBackend
+    {
+        using Texture = int;
+
+        struct Surface
+        {
+            StagingDesc Desc;
+            std::vector<uint8_t> Pixels;
+            uint64_t ReadyAt = 0;
+            bool Mapped = false;
+        };
+
+        uint64_t Latency = 0;
+        uint64_t Now = 0;
+        uint64_t WaitTicks = 0;
+        uint32_t Maps = 0;
+        std::vector<Surface> Surfaces;
+
+        Texture CreateStaging(StagingDesc const& desc)
+        {
+            Surface surface;
+            surface.Desc = desc;
+            surface.Pixels.resize(static_cast<size_t>(desc.Width) * desc.Height * 4);
+            Surfaces.push_back(surface);
+            return static_cast<Texture>(Surfaces.size() - 1);
+        }
+
+        void Copy(Texture const& dst, FakeFrame const& src)
+        {
+            auto& surface = Surfaces[dst];
+            std::fill(surface.Pixels.begin(), surface.Pixels.end(), src.Value);
+            surface.ReadyAt = Now + Latency;
+        }
+
+        bool Map(Texture const& tex, const uint8_t*& data, uint32_t& rowPitch)
+        {
+            auto& surface = Surfaces[tex];
+            if (surface.ReadyAt > Now)
+            {
+                WaitTicks += surface.ReadyAt - Now;
+                Now = surface.ReadyAt;
+            }
+            return MapNow(surface, data, rowPitch);
+        }
+
+        MapStatus TryMap(Texture const& tex, const uint8_t*& data, uint32_t& rowPitch)
+        {
+            auto& surface = Surfaces[tex];
+            if (surface.ReadyAt > Now)
+                return MapStatus::Pending;
+            return MapNow(surface, data, rowPitch) ? MapStatus::Mapped : MapStatus::Failed;
+        }
+
+        void Unmap(Texture const& tex)
+        {
+            Surfaces[tex].Mapped = false;
+        }
+
+        bool MapNow(Surface& surface, const uint8_t*& data, uint32_t& rowPitch)
+        {
+            surface.Mapped = true;
+            data = surface.Pixels.data();
+            rowPitch = surface.Desc.Width * 4;
+            Maps++;
+            return true;
+        }
+    };
+
+    StagingDesc Desc(uint32_t width, uint32_t height)
+    {
+        StagingDesc desc;
+        desc.Width = width;
+        desc.Height = height;
+        desc.Format = 87;
+        return desc;
+    }
+
+    // Submit frames 1..frames one tick apart, acquiring and releasing after
+    // each, then drain. Returns the values seen, in order.
+    std::vector<uint8_t> Stream(FakeBackend& backend, ReadbackRing<FakeBackend>& ring, uint32_t frames)
+    {
+        std::vector<uint8_t> seen;
+        MappedSlot mapped;
+        for (uint32_t i = 1; i <= frames; i++)
+        {
+            backend.Now++;
+            CHECK(ring.Submit(Desc(64, 32), FakeFrame{ static_cast<uint8_t>(i) }));
+            if (ring.Acquire(mapped))
+            {
+                seen.push_back(mapped.Data[0]);
+                ring.Release(mapped);
+            }
+        }
+        while (ring.Acquire(mapped, true))
+        {
+            seen.push_back(mapped.Data[0]);
+            ring.Release(mapped);
+        }
+        return seen;
+    }
+}
+
+TEST(AllocatesOnceForSteadySize)
+{
+    FakeBackend backend;
+    ReadbackRing<FakeBackend> ring(backend, 3);
+    auto seen = Stream(backend, ring, 100);
+    CHECK(ring.Stats().Allocations == 3);
+    CHECK(backend.Surfaces.size() == 3);
+    CHECK(ring.Stats().Submitted == 100);
+    CHECK(ring.Stats().Mapped == 100);
+    CHECK(ring.Stats().Discarded == 0);
+    REQUIRE(seen.size() == 100);
+    for (uint32_t i = 0; i < seen.size(); i++)
+        CHECK(seen[i] == static_cast<uint8_t>(i + 1));
+}
+
+TEST(MapsDepthMinusOneFramesBehind)
+{
+    FakeBackend backend;
+    ReadbackRing<FakeBackend> ring(backend, 3);
+    MappedSlot mapped;
+    CHECK(ring.Submit(Desc(64, 32), FakeFrame{ 1 }));
+    CHECK(!ring.Acquire(mapped));
+    CHECK(ring.Submit(Desc(64, 32), FakeFrame{ 2 }));
+    CHECK(!ring.Acquire(mapped));
+    CHECK(ring.Submit(Desc(64, 32), FakeFrame{ 3 }));
+    REQUIRE(ring.Acquire(mapped));
+    CHECK(mapped.FrameIndex == 1);
+    CHECK(mapped.Data[0] == 1);
+    CHECK(mapped.Desc == Desc(64, 32));
+    CHECK(mapped.RowPitch >= 64 * 4);
+    ring.Release(mapped);
+}
+
+TEST(PipeliningHidesCopyLatency)
+{
+    // A copy takes two frames: mapping right behind it waits both out every
+    // frame, mapping two frames behind it never waits.
+    FakeBackend direct;
+    direct.Latency = 2;
+    ReadbackRing<FakeBackend> directRing(direct, 1);
+    Stream(direct, directRing, 50);
+
+    FakeBackend pipelined;
+    pipelined.Latency = 2;
+    ReadbackRing<FakeBackend> pipelinedRing(pipelined, 3);
+    Stream(pipelined, pipelinedRing, 50);
+
+    CHECK(direct.WaitTicks >= 50 * 2 - 2);
+    CHECK(pipelined.WaitTicks <= 2);
+    CHECK(pipelinedRing.Stats().Mapped == 50);
+}
+
+TEST(SmallResizesKeepTheSlots)
+{
+    FakeBackend backend;
+    ReadbackRing<FakeBackend> ring(backend, 2);
+    MappedSlot mapped;
+    CHECK(ring.Submit(Desc(640, 480), FakeFrame{ 1 }));
+    auto allocated = ring.AllocatedDesc();
+    CHECK(allocated.Width >= 640 && allocated.Height >= 480);
+    CHECK(ring.Submit(Desc(650, 490), FakeFrame{ 2 }));
+    CHECK(ring.Submit(Desc(600, 470), FakeFrame{ 3 }));
+    CHECK(ring.Stats().Allocations == 2);
+    REQUIRE(ring.Acquire(mapped));
+    CHECK(mapped.Desc == Desc(650, 490));
+    ring.Release(mapped);
+
+    // Outgrowing the headroom, or shrinking to under half, rebuilds.
+    CHECK(ring.Submit(Desc(1280, 960), FakeFrame{ 4 }));
+    CHECK(ring.Stats().Allocations == 4);
+    CHECK(ring.Submit(Desc(64, 64), FakeFrame{ 5 }));
+    CHECK(ring.Stats().Allocations == 6);
+}
+
+TEST(NeverRebuildsUnderAMapping)
+{
+    FakeBackend backend;
+    ReadbackRing<FakeBackend> ring(backend, 1, 1);
+    MappedSlot first;
+    MappedSlot second;
+    CHECK(ring.Submit(Desc(64, 32), FakeFrame{ 1 }));
+    REQUIRE(ring.Acquire(first));
+    CHECK(!ring.Submit(Desc(4096, 4096), FakeFrame{ 2 }));
+    CHECK(ring.Submit(Desc(64, 32), FakeFrame{ 3 }));
+    REQUIRE(ring.Acquire(second));
+    CHECK(second.Data[0] == 3);
+    // Both slots are mapped: nowhere to copy to.
+    CHECK(!ring.Submit(Desc(64, 32), FakeFrame{ 4 }));
+    CHECK(first.Data[0] == 1);
+    ring.Release(first);
+    CHECK(ring.Submit(Desc(64, 32), FakeFrame{ 5 }));
+    ring.Release(second);
+    ring.Reset();
+    for (auto const& surface : backend.Surfaces)
+        CHECK(!surface.Mapped);
+}
+
+TEST(CountsCopiesOverwrittenBeforeMapping)
+{
+    FakeBackend backend;
+    ReadbackRing<FakeBackend> ring(backend, 2);
+    for (uint8_t i = 1; i <= 5; i++)
+        CHECK(ring.Submit(Desc(64, 32), FakeFrame{ i }));
+    CHECK(ring.Stats().Discarded == 3);
+    MappedSlot mapped;
+    REQUIRE(ring.Acquire(mapped));
+    CHECK(mapped.Data[0] == 4);
+    ring.Release(mapped);
+}
+
+TEST(TryAcquireReportsCopiesInFlight)
+{
+    FakeBackend backend;
+    backend.Latency = 3;
+    ReadbackRing<FakeBackend> ring(backend, 1);
+    MappedSlot mapped;
+    CHECK(ring.TryAcquire(mapped) == MapStatus::None);
+    CHECK(ring.Submit(Desc(64, 32), FakeFrame{ 7 }, 1000, 2000));
+    CHECK(ring.TryAcquire(mapped) == MapStatus::Pending);
+    backend.Now += 2;
+    CHECK(ring.TryAcquire(mapped) == MapStatus::Pending);
+    backend.Now += 1;
+    REQUIRE(ring.TryAcquire(mapped) == MapStatus::Mapped);
+    CHECK(mapped.Data[0] == 7);
+    CHECK(mapped.CaptureTimeNs == 1000);
+    CHECK(mapped.AcquireTimeNs == 2000);
+    CHECK(backend.WaitTicks == 0);
+    ring.Release(mapped);
+    CHECK(ring.TryAcquire(mapped) == MapStatus::None);
+}
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "CapturePipeline.h"
+#include "ResizeCoalescer.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    using Clock = ResizeCoalescer::Clock;
+    using std::chrono::milliseconds;
+
+    Clock::time_point At(milliseconds t)
+    {
+        return Clock::time_point(t);
+    }
+
+    bool Is(SourceSize size, uint32_t width, uint32_t height)
+    {
+        return size.Width == width && size.Height == height;
+    }
+
+    // Drag from start by step per frame for steps frames, a frame every
+    // 16 ms from startAt, polling after each. Returns the recreates.
+    std::vector<SourceSize> Drag(ResizeCoalescer& coalescer, SourceSize start, int32_t step, uint32_t steps,
+        milliseconds startAt = milliseconds(0))
+    {
+        std::vector<SourceSize> recreated;
+        SourceSize size = start;
+        for (uint32_t i = 0; i < steps; i++)
+        {
+            size.Width = static_cast<uint32_t>(static_cast<int32_t>(size.Width) + step);
+            auto now = At(startAt + milliseconds(16 * i));
+            coalescer.Observe(size, now);
+            SourceSize pool;
+            if (coalescer.Poll(now, pool))
+                recreated.push_back(pool);
+        }
+        return recreated;
+    }
+}
+
+TEST(ResetAllocatesHeadroom)
+{
+    ResizeCoalescer coalescer;
+    auto pool = coalescer.Reset({ 1000, 600 });
+    CHECK(Is(pool, WithResizeHeadroom(1000), WithResizeHeadroom(600)));
+    CHECK(pool.Width >= 1000 + 1000 / 8 && pool.Width % ResizeGranularity == 0);
+    CHECK(Is(coalescer.PoolSize(), pool.Width, pool.Height));
+    CHECK(!coalescer.Settling());
+}
+
+TEST(ResizesWithinTheHeadroomCostNothing)
+{
+    ResizeCoalescer coalescer;
+    auto pool = coalescer.Reset({ 1000, 600 });
+    // Growing into the headroom and shrinking a little both fit.
+    auto recreated = Drag(coalescer, { 1000, 600 }, 4, 30);
+    recreated = Drag(coalescer, { 1120, 600 }, -10, 30, milliseconds(1000));
+    CHECK(recreated.empty());
+    CHECK(!coalescer.Settling());
+    CHECK(Is(coalescer.PoolSize(), pool.Width, pool.Height));
+}
+
+TEST(ADragStormEndsInOneRecreate)
+{
+    ResizeCoalescer coalescer(milliseconds(100), milliseconds(10000));
+    coalescer.Reset({ 800, 600 });
+    // Two seconds of dragging the edge out 20 px a frame, then stillness.
+    auto recreated = Drag(coalescer, { 800, 600 }, 20, 120);
+    CHECK(recreated.empty());
+    CHECK(coalescer.Settling());
+    SourceSize pool;
+    CHECK(!coalescer.Poll(At(milliseconds(16 * 119 + 99)), pool));
+    REQUIRE(coalescer.Poll(At(milliseconds(16 * 119 + 100)), pool));
+    CHECK(Is(pool, WithResizeHeadroom(800 + 20 * 120), WithResizeHeadroom(600)));
+    CHECK(!coalescer.Settling());
+    CHECK(!coalescer.Poll(At(milliseconds(5000)), pool));
+}
+
+TEST(MaxDelayBoundsAContinuousDrag)
+{
+    ResizeCoalescer coalescer(milliseconds(100), milliseconds(500));
+    coalescer.Reset({ 800, 600 });
+    // Three seconds of dragging: a recreate every half second or so, each
+    // sized for the content of its time.
+    auto recreated = Drag(coalescer, { 800, 600 }, 20, 190);
+    CHECK(recreated.size() >= 3 && recreated.size() <= 6);
+    for (size_t i = 1; i < recreated.size(); i++)
+        CHECK(recreated[i].Width > recreated[i - 1].Width);
+}
+
+TEST(ReturningInsideThePoolCancelsARecreate)
+{
+    ResizeCoalescer coalescer;
+    auto pool = coalescer.Reset({ 800, 600 });
+    coalescer.Observe({ 2000, 600 }, At(milliseconds(0)));
+    CHECK(coalescer.Settling());
+    coalescer.Observe({ 820, 600 }, At(milliseconds(30)));
+    CHECK(!coalescer.Settling());
+    SourceSize recreated;
+    CHECK(!coalescer.Poll(At(milliseconds(1000)), recreated));
+    CHECK(Is(coalescer.PoolSize(), pool.Width, pool.Height));
+}
+
+TEST(MinimizedWindowsKeepThePool)
+{
+    ResizeCoalescer coalescer;
+    auto pool = coalescer.Reset({ 800, 600 });
+    coalescer.Observe({ 0, 0 }, At(milliseconds(0)));
+    coalescer.Observe({ 800, 0 }, At(milliseconds(16)));
+    SourceSize recreated;
+    CHECK(!coalescer.Settling());
+    CHECK(!coalescer.Poll(At(milliseconds(1000)), recreated));
+    CHECK(Is(coalescer.PoolSize(), pool.Width, pool.Height));
+}
+
+TEST(ShrinkingFarGivesMemoryBack)
+{
+    ResizeCoalescer coalescer(milliseconds(100));
+    coalescer.Reset({ 1920, 1080 });
+    coalescer.Observe({ 640, 480 }, At(milliseconds(0)));
+    SourceSize pool;
+    CHECK(!coalescer.Poll(At(milliseconds(50)), pool));
+    REQUIRE(coalescer.Poll(At(milliseconds(100)), pool));
+    CHECK(Is(pool, WithResizeHeadroom(640), WithResizeHeadroom(480)));
+}
+
+TEST(SyntheticStormKeepsFramesFlowing)
+{
+    // A 60 fps source dragged from 640x360 out to 1280x720 over a second,
+    // then left alone. Frames keep coming at every step, clipped to the old
+    // pool, and the pool is recreated once after the drag has settled.
+    SyntheticSourceConfig config;
+    config.Width = 640;
+    config.Height = 360;
+    config.BoxSize = 32;
+    for (uint64_t frame = 1; frame <= 60; frame++)
+        config.Resizes.push_back({ frame, 640 + static_cast<uint32_t>(frame) * 32 / 3, 360 + static_cast<uint32_t>(frame) * 6 });
+    config.ResizeSettle = milliseconds(100);
+    config.ResizeMaxDelay = milliseconds(10000);
+    CaptureStats stats;
+    SyntheticCaptureSource source(config, &stats);
+    CapturePipeline pipeline(source, stats, 1);
+
+    std::vector<uint8_t> buf(1280 * 4 * 720);
+    uint32_t copied = 0;
+    bool clipped = true;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    for (uint32_t frame = 0; frame < 90; frame++)
+    {
+        if (pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) != CopyResult::Ok)
+            continue;
+        copied++;
+        auto size = source.GetSourceSize();
+        clipped = clipped && width <= size.Width && height <= size.Height;
+    }
+    CHECK(copied == 90);
+    CHECK(clipped);
+    CHECK(source.GetPoolResizes() == 1);
+    CHECK(source.GetStarvedFrames() == 0);
+    CHECK(width == 1280 && height == 720);
+    auto snapshot = stats.Snapshot();
+    CHECK(snapshot.ResizeEvents == 60);
+    CHECK(snapshot.Resizes == 1);
+    CHECK(snapshot.NullFrames == 0);
+}
+
+TEST(FixedOutputSizeSurvivesTheStorm)
+{
+    // Letterboxed into a fixed 320x180 whatever the source does.
+    SyntheticSourceConfig config;
+    config.Width = 400;
+    config.Height = 300;
+    for (uint64_t frame = 1; frame <= 40; frame++)
+        config.Resizes.push_back({ frame, 400 + static_cast<uint32_t>(frame) * 10, 300 - static_cast<uint32_t>(frame) * 3 });
+    CaptureStats stats;
+    SyntheticCaptureSource source(config, &stats);
+    CapturePipeline pipeline(source, stats, 1);
+    ScaleParams scale;
+    scale.Width = 320;
+    scale.Height = 180;
+    scale.Fit = ScaleFit::Letterbox;
+    pipeline.SetScale(scale);
+
+    std::vector<uint8_t> buf(320 * 4 * 180);
+    bool fixed = true;
+    uint32_t copied = 0;
+    for (uint32_t frame = 0; frame < 60; frame++)
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (pipeline.CopyImage(buf.data(), buf.size(), 0, width, height) != CopyResult::Ok)
+            continue;
+        copied++;
+        fixed = fixed && width == 320 && height == 180;
+    }
+    CHECK(copied == 60);
+    CHECK(fixed);
+    // 800x180 letterboxed into 320x180: bars above and below, opaque black.
+    uint8_t const* corner = buf.data();
+    CHECK(corner[0] == 0 && corner[1] == 0 && corner[2] == 0 && corner[3] == 255);
+}
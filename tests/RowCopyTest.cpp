@@ -0,0 +1,88 @@
+#include <cstring>
+#include <vector>
+#include "RowCopy.h"
+#include "TestHarness.h"
+
+namespace
+{
+    constexpr uint8_t Guard = 0xA5;
+
+    // Copy rows of rowBytes at every source misalignment up to 32 bytes, into
+    // rows with guard bytes around them, and compare with memcpy.
+    bool CopiesLikeMemcpy(size_t rowBytes, size_t rows)
+    {
+        bool ok = true;
+        for (size_t offset = 0; offset < 32; offset += 7)
+        {
+            size_t srcStride = rowBytes + 64 + offset;
+            size_t dstStride = rowBytes + 19;
+            std::vector<uint8_t> src(srcStride * rows + offset + 64);
+            for (size_t i = 0; i < src.size(); i++)
+                src[i] = static_cast<uint8_t>(i * 31 + 7);
+            std::vector<uint8_t> dst(dstStride * rows + 64, Guard);
+
+            const uint8_t* from = src.data() + offset;
+            uint8_t* to = dst.data() + 1;
+            CopyRows(to, dstStride, from, srcStride, rowBytes, rows);
+            for (size_t y = 0; y < rows; y++)
+            {
+                if (std::memcmp(to + y * dstStride, from + y * srcStride, rowBytes) != 0)
+                    ok = false;
+                for (size_t x = rowBytes; x < dstStride; x++)
+                {
+                    if (to[y * dstStride + x] != Guard)
+                        ok = false;
+                }
+            }
+            if (dst[0] != Guard)
+                ok = false;
+        }
+        return ok;
+    }
+}
+
+TEST(EveryKernelCopiesLikeMemcpy)
+{
+    auto active = GetRowCopyKernel();
+    for (auto kernel : { RowCopyKernel::Scalar, RowCopyKernel::Sse41, RowCopyKernel::Avx2 })
+    {
+        if (SetRowCopyKernel(kernel) != kernel)
+            continue;
+        for (size_t rowBytes : { 1, 3, 4, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128, 129, 1000, 7680 })
+        {
+            if (!CHECK(CopiesLikeMemcpy(rowBytes, 5)))
+                std::fprintf(stderr, "  kernel %s, %zu bytes per row\n", GetRowCopyKernelName(kernel), rowBytes);
+        }
+    }
+    SetRowCopyKernel(active);
+}
+
+TEST(PackedRowsCopyAsOneBlock)
+{
+    std::vector<uint8_t> src(256 * 10);
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = static_cast<uint8_t>(i);
+    std::vector<uint8_t> dst(src.size());
+    CopyRows(dst.data(), 256, src.data(), 256, 256, 10);
+    CHECK(dst == src);
+}
+
+TEST(NothingToCopy)
+{
+    uint8_t dst[4] = { Guard, Guard, Guard, Guard };
+    uint8_t src[4] = {};
+    CopyRows(dst, 4, src, 4, 0, 1);
+    CopyRows(dst, 4, src, 4, 4, 0);
+    CHECK(dst[0] == Guard && dst[3] == Guard);
+}
+
+TEST(UnsupportedKernelsFallBack)
+{
+    auto active = GetRowCopyKernel();
+    CHECK(SetRowCopyKernel(RowCopyKernel::Scalar) == RowCopyKernel::Scalar);
+    CHECK(GetRowCopyKernel() == RowCopyKernel::Scalar);
+    auto best = SetRowCopyKernel(RowCopyKernel::Avx2);
+    CHECK(best == GetRowCopyKernel());
+    CHECK(std::strlen(GetRowCopyKernelName(best)) != 0);
+    SetRowCopyKernel(active);
+}
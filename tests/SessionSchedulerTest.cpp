@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "CapturePipeline.h"
+#include "SessionScheduler.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    using Clock = SessionScheduler::Clock;
+    using std::chrono::milliseconds;
+    using std::chrono::microseconds;
+
+    Clock::time_point At(microseconds t)
+    {
+        return Clock::time_point(t);
+    }
+
+    // A source on a simulated clock that signals a frame every Interval.
+    struct FakeSource
+    {
+        uint32_t Id;
+        microseconds Interval;
+        microseconds NextFrame;
+        uint64_t Served = 0;
+        // Longest a frame waited between being signalled and served.
+        microseconds MaxWait{ 0 };
+        microseconds ReadySince{ -1 };
+    };
+
+    // Run the sources for duration, the server taking one session every
+    // serveEvery, and return them with their counts.
+    std::vector<FakeSource> Simulate(std::vector<microseconds> const& intervals, microseconds serveEvery,
+        microseconds duration, microseconds minInterval = microseconds(0))
+    {
+        SessionScheduler scheduler;
+        std::vector<FakeSource> sources;
+        for (uint32_t i = 0; i < intervals.size(); i++)
+        {
+            scheduler.Add(i, minInterval);
+            sources.push_back({ i, intervals[i], intervals[i] });
+        }
+        for (microseconds now(0); now < duration; now += microseconds(100))
+        {
+            for (auto& source : sources)
+            {
+                if (now >= source.NextFrame)
+                {
+                    source.NextFrame += source.Interval;
+                    scheduler.MarkReady(source.Id, At(now));
+                    if (source.ReadySince.count() < 0)
+                        source.ReadySince = now;
+                }
+            }
+            if (now.count() % serveEvery.count() != 0)
+                continue;
+            uint32_t id = 0;
+            if (scheduler.Next(At(now), id))
+            {
+                auto& source = sources[id];
+                source.Served++;
+                source.MaxWait = std::max(source.MaxWait, now - source.ReadySince);
+                source.ReadySince = microseconds(-1);
+            }
+        }
+        return sources;
+    }
+}
+
+TEST(ServesTheLongestWaitingFirst)
+{
+    SessionScheduler scheduler;
+    for (uint32_t id = 1; id <= 3; id++)
+        scheduler.Add(id, milliseconds(0));
+    scheduler.MarkReady(2, At(microseconds(10)));
+    scheduler.MarkReady(3, At(microseconds(5)));
+    scheduler.MarkReady(1, At(microseconds(10)));
+    // Marking again doesn't move a session back in line.
+    scheduler.MarkReady(3, At(microseconds(20)));
+    uint32_t id = 0;
+    REQUIRE(scheduler.Next(At(microseconds(30)), id));
+    CHECK(id == 3);
+    // Equal waits go by id.
+    REQUIRE(scheduler.Next(At(microseconds(30)), id));
+    CHECK(id == 1);
+    REQUIRE(scheduler.Next(At(microseconds(30)), id));
+    CHECK(id == 2);
+    CHECK(!scheduler.Next(At(microseconds(30)), id));
+}
+
+TEST(MinimumIntervalHoldsSessionsBack)
+{
+    SessionScheduler scheduler;
+    scheduler.Add(7, milliseconds(10));
+    uint32_t id = 0;
+    scheduler.MarkReady(7, At(milliseconds(0)));
+    REQUIRE(scheduler.Next(At(milliseconds(0)), id));
+    scheduler.MarkReady(7, At(milliseconds(1)));
+    CHECK(!scheduler.Next(At(milliseconds(9)), id));
+    CHECK(scheduler.Next(At(milliseconds(10)), id));
+}
+
+TEST(RemovedSessionsAreNotServed)
+{
+    SessionScheduler scheduler;
+    scheduler.Add(1, milliseconds(0));
+    scheduler.Add(2, milliseconds(0));
+    scheduler.MarkReady(1, At(milliseconds(0)));
+    scheduler.MarkReady(2, At(milliseconds(1)));
+    scheduler.Remove(1);
+    scheduler.MarkReady(1, At(milliseconds(2)));
+    CHECK(scheduler.Count() == 1);
+    uint32_t id = 0;
+    REQUIRE(scheduler.Next(At(milliseconds(3)), id));
+    CHECK(id == 2);
+    CHECK(!scheduler.Next(At(milliseconds(3)), id));
+}
+
+TEST(EverySourceIsServedWithRoomToSpare)
+{
+    // Sixteen sources from 30 to 240 fps, about 1900 frames a second, and a
+    // server that can take 5000.
+    std::vector<microseconds> intervals;
+    for (uint32_t i = 0; i < 16; i++)
+        intervals.push_back(microseconds(1000000 / (30 + i * 14)));
+    auto sources = Simulate(intervals, microseconds(200), microseconds(1000000));
+    for (auto const& source : sources)
+    {
+        uint64_t frames = 1000000 / source.Interval.count();
+        CHECK(source.Served + 1 >= frames);
+        CHECK(source.MaxWait <= milliseconds(4));
+    }
+}
+
+TEST(OverloadIsSharedEvenly)
+{
+    // Sixteen 120 fps sources and room for 500 reads a second: each gets
+    // about a sixteenth, and none waits much longer than a round. The first
+    // rounds, before every source has signalled, favour the early ones a bit.
+    std::vector<microseconds> intervals(16, microseconds(8300));
+    auto sources = Simulate(intervals, microseconds(2000), microseconds(1000000));
+    uint64_t least = UINT64_MAX;
+    uint64_t most = 0;
+    for (auto const& source : sources)
+    {
+        least = std::min(least, source.Served);
+        most = std::max(most, source.Served);
+        CHECK(source.MaxWait <= milliseconds(16 * 2 + 10));
+    }
+    CHECK(most - least <= 8);
+    CHECK(least >= 28);
+}
+
+TEST(RateLimitedSourcesDontCrowdOthersOut)
+{
+    // A 1000 fps source capped at 60 reads a second next to a 30 fps one.
+    auto sources = Simulate({ microseconds(1000), microseconds(33333) }, microseconds(100), microseconds(1000000),
+        microseconds(16667));
+    CHECK(sources[0].Served >= 58 && sources[0].Served <= 61);
+    CHECK(sources[1].Served >= 29);
+}
+
+TEST(WaitNextWakesOnMarkReady)
+{
+    SessionScheduler scheduler;
+    scheduler.Add(4, milliseconds(0));
+    uint32_t id = 0;
+    CHECK(!scheduler.WaitNext(id, milliseconds(5)));
+    std::thread producer([&] {
+        std::this_thread::sleep_for(milliseconds(5));
+        scheduler.MarkReady(4, Clock::now());
+    });
+    CHECK(scheduler.WaitNext(id, milliseconds(5000)));
+    CHECK(id == 4);
+    producer.join();
+}
+
+TEST(WaitNextWakesWhenARateLimitExpires)
+{
+    SessionScheduler scheduler;
+    scheduler.Add(1, milliseconds(20));
+    uint32_t id = 0;
+    scheduler.MarkReady(1, Clock::now());
+    REQUIRE(scheduler.WaitNext(id, milliseconds(0)));
+    auto served = Clock::now();
+    scheduler.MarkReady(1, Clock::now());
+    REQUIRE(scheduler.WaitNext(id, milliseconds(5000)));
+    CHECK(Clock::now() - served >= milliseconds(20));
+}
+
+TEST(ServesSyntheticSourcesThroughTheirDispatchers)
+{
+    // As CaptureManager wires it: each source's dispatcher marks its session
+    // ready, and one thread serves whichever is due.
+    constexpr uint32_t Sources = 4;
+    SessionScheduler scheduler;
+    CaptureStats stats[Sources];
+    FrameDispatcher dispatchers[Sources];
+    std::vector<std::unique_ptr<SyntheticCaptureSource>> sources;
+    std::vector<std::unique_ptr<CapturePipeline>> pipelines;
+    for (uint32_t i = 0; i < Sources; i++)
+    {
+        scheduler.Add(i, milliseconds(0));
+        dispatchers[i].SetNotifyHook([&scheduler, i] { scheduler.MarkReady(i, Clock::now()); });
+        SyntheticSourceConfig config;
+        config.Width = 160 + i * 40;
+        config.Height = 120 + i * 30;
+        config.FrameRate = 100 + i * 50;
+        sources.push_back(std::make_unique<SyntheticCaptureSource>(config, &stats[i], &dispatchers[i]));
+        pipelines.push_back(std::make_unique<CapturePipeline>(*sources.back(), stats[i], 1));
+    }
+    for (auto& source : sources)
+        source->StartCapture();
+
+    std::vector<uint8_t> buf(280 * 4 * 210);
+    uint64_t copied[Sources] = {};
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (Clock::now() < deadline && *std::min_element(copied, copied + Sources) < 5)
+    {
+        uint32_t id = 0;
+        if (!scheduler.WaitNext(id, milliseconds(100)))
+            continue;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (pipelines[id]->CopyImage(buf.data(), buf.size(), 0, width, height) == CopyResult::Ok)
+        {
+            CHECK(width == 160 + id * 40 && height == 120 + id * 30);
+            copied[id]++;
+        }
+    }
+    for (auto& source : sources)
+        source->Close();
+    for (uint32_t i = 0; i < Sources; i++)
+        CHECK(copied[i] >= 5);
+}
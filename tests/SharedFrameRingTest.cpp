@@ -0,0 +1,365 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SharedFrameRing.h"
+#include "TestHarness.h"
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t Width = 64;
+    constexpr uint32_t Height = 40;
+
+    // Names are per process, so runs side by side don't meet.
+    std::string RingName(const char* test)
+    {
+#ifdef _WIN32
+        return std::string("Local\\WindowCaptureTest") + test;
+#else
+        return "/WindowCaptureTest" + std::string(test) + std::to_string(::getpid());
+#endif
+    }
+
+    SharedRingConfig Config(uint32_t slots = 4, uint32_t maxReaders = 4)
+    {
+        SharedRingConfig config;
+        config.MaxWidth = Width;
+        config.MaxHeight = Height;
+        config.Slots = slots;
+        config.MaxReaders = maxReaders;
+        return config;
+    }
+
+    // A BGRA frame every byte of which says which frame it is, so a frame
+    // torn between two writes shows.
+    std::vector<uint8_t> Frame(uint64_t number, uint32_t width = Width, uint32_t height = Height)
+    {
+        std::vector<uint8_t> frame(static_cast<size_t>(width) * 4 * height);
+        for (size_t i = 0; i < frame.size(); i++)
+            frame[i] = static_cast<uint8_t>(number * 31 + i / 4);
+        return frame;
+    }
+
+    bool Holds(SharedFrameView const& view, uint64_t number)
+    {
+        auto expected = Frame(number, view.Width, view.Height);
+        size_t rowBytes = static_cast<size_t>(view.Width) * 4;
+        for (uint32_t y = 0; y < view.Height; y++)
+        {
+            if (std::memcmp(view.Data + y * view.Stride, expected.data() + y * rowBytes, rowBytes) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    FrameTiming Timing(uint64_t frameIndex)
+    {
+        FrameTiming timing;
+        timing.FrameIndex = frameIndex;
+        timing.CaptureTimeNs = frameIndex * 1000;
+        timing.DeliveryTimeNs = frameIndex * 1000 + 500;
+        return timing;
+    }
+
+    bool Publish(SharedFrameWriter& writer, uint64_t number)
+    {
+        auto frame = Frame(number);
+        return writer.Publish(frame.data(), Width * 4, OutputFormat::Bgra, Width, Height, Timing(number + 100));
+    }
+}
+
+TEST(RingSizesAreChecked)
+{
+    CHECK(GetSharedRingSize(Config()) != 0);
+    CHECK(GetSharedRingSize(Config(1)) == 0);
+    CHECK(GetSharedRingSize(Config(256)) == 0);
+    CHECK(GetSharedRingSize(Config(4, 0)) == 0);
+    auto config = Config();
+    config.MaxWidth = 0;
+    CHECK(GetSharedRingSize(config) == 0);
+    // Frames start page aligned, after the headers.
+    CHECK(GetSharedRingSize(Config(2)) % 4096 == 0);
+    CHECK(GetSharedRingSize(Config(3)) > GetSharedRingSize(Config(2)));
+}
+
+TEST(FramesAreReadInPlaceByName)
+{
+    auto name = RingName("InPlace");
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(name, Config()));
+    SharedFrameReader reader;
+    REQUIRE(reader.Open(name));
+
+    SharedFrameView view;
+    CHECK(reader.Acquire(view) == SharedReadResult::NoFrame);
+    REQUIRE(Publish(writer, 1));
+    REQUIRE(reader.Acquire(view) == SharedReadResult::Ok);
+    CHECK(view.FrameNumber == 1 && view.Width == Width && view.Height == Height);
+    CHECK(view.Timing.FrameIndex == 101 && view.Timing.CaptureTimeNs == 101000 && view.Timing.DeliveryTimeNs == 101500);
+    CHECK(view.Stride % 64 == 0 && view.Format == OutputFormat::Bgra);
+    CHECK(Holds(view, 1));
+    CHECK(reader.Release(view));
+    // Nothing newer yet.
+    CHECK(reader.Acquire(view) == SharedReadResult::NoFrame);
+
+    // A reader behind by several frames gets the newest.
+    for (uint64_t i = 2; i <= 5; i++)
+        REQUIRE(Publish(writer, i));
+    REQUIRE(reader.Acquire(view) == SharedReadResult::Ok);
+    CHECK(view.FrameNumber == 5 && Holds(view, 5));
+    CHECK(reader.Release(view));
+    CHECK(writer.Published() == 5 && writer.Overwrites() == 0);
+}
+
+TEST(FramesThatDontFitAreDropped)
+{
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(RingName("Drop"), Config()));
+    auto frame = Frame(1, Width * 2, Height);
+    CHECK(!writer.Publish(frame.data(), Width * 8, OutputFormat::Bgra, Width * 2, Height, Timing(0)));
+    CHECK(!writer.Publish(frame.data(), Width * 4, OutputFormat::Nv12, Width, Height, Timing(0)));
+    CHECK(!writer.Publish(nullptr, Width * 4, OutputFormat::Bgra, Width, Height, Timing(0)));
+    SharedWriteSlot slot;
+    REQUIRE(writer.BeginWrite(slot));
+    CHECK(slot.Capacity >= GetOutputFrameSize(OutputFormat::Bgra, Width, Height, slot.Stride));
+    CHECK(!writer.CommitWrite(slot, Width, Height + 1, Timing(0)));
+    CHECK(writer.Dropped() == 4 && writer.Published() == 0);
+}
+
+TEST(SmallerFramesUseTheTopLeft)
+{
+    auto name = RingName("Smaller");
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(name, Config()));
+    SharedFrameReader reader;
+    REQUIRE(reader.Open(name));
+    auto frame = Frame(7, 20, 10);
+    REQUIRE(writer.Publish(frame.data(), 20 * 4, OutputFormat::Bgra, 20, 10, Timing(7)));
+    SharedFrameView view;
+    REQUIRE(reader.Acquire(view) == SharedReadResult::Ok);
+    CHECK(view.Width == 20 && view.Height == 10);
+    CHECK(view.Bytes == GetOutputFrameSize(OutputFormat::Bgra, 20, 10, view.Stride));
+    CHECK(Holds(view, 7));
+    CHECK(reader.Release(view));
+}
+
+TEST(PinnedFramesSurviveTheWriter)
+{
+    auto name = RingName("Pinned");
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(name, Config(3)));
+    SharedFrameReader reader;
+    REQUIRE(reader.Open(name));
+    REQUIRE(Publish(writer, 1));
+    SharedFrameView view;
+    REQUIRE(reader.Acquire(view) == SharedReadResult::Ok);
+
+    // Three slots: the held frame, the newest and one to write into.
+    for (uint64_t i = 2; i <= 20; i++)
+        REQUIRE(Publish(writer, i));
+    CHECK(writer.Overwrites() == 0);
+    CHECK(Holds(view, 1));
+    CHECK(reader.Release(view));
+}
+
+TEST(OverwrittenFramesFailRelease)
+{
+    // Two slots leave nowhere to write but the held frame once another is
+    // the newest.
+    auto name = RingName("Overwritten");
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(name, Config(2)));
+    SharedFrameReader reader;
+    REQUIRE(reader.Open(name));
+    REQUIRE(Publish(writer, 1));
+    SharedFrameView view;
+    REQUIRE(reader.Acquire(view) == SharedReadResult::Ok);
+    REQUIRE(Publish(writer, 2));
+    CHECK(writer.Overwrites() == 0);
+    REQUIRE(Publish(writer, 3));
+    CHECK(writer.Overwrites() == 1);
+    CHECK(!reader.Release(view));
+
+    // The next acquire goes on from the newest.
+    REQUIRE(reader.Acquire(view) == SharedReadResult::Ok);
+    CHECK(view.FrameNumber == 3 && Holds(view, 3));
+    CHECK(reader.Release(view));
+}
+
+TEST(ReadersBeyondTheTableStillRead)
+{
+    auto name = RingName("Table");
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(name, Config(4, 1)));
+    SharedFrameReader first;
+    SharedFrameReader second;
+    REQUIRE(first.Open(name));
+    REQUIRE(second.Open(name));
+    REQUIRE(Publish(writer, 1));
+    SharedFrameView a;
+    SharedFrameView b;
+    REQUIRE(first.Acquire(a) == SharedReadResult::Ok);
+    REQUIRE(second.Acquire(b) == SharedReadResult::Ok);
+    CHECK(Holds(a, 1) && Holds(b, 1));
+    CHECK(first.Release(a));
+    CHECK(second.Release(b));
+    // The entry frees up when its reader closes.
+    first.Close();
+    SharedFrameReader third;
+    REQUIRE(third.Open(name));
+    REQUIRE(Publish(writer, 2));
+    REQUIRE(third.Acquire(a) == SharedReadResult::Ok);
+    CHECK(third.Release(a));
+}
+
+TEST(ClosingTellsReadersAndFreesTheName)
+{
+    auto name = RingName("Close");
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(name, Config()));
+    // A live writer's ring isn't taken over.
+    SharedFrameWriter rival;
+    CHECK(!rival.Create(name, Config()));
+
+    SharedFrameReader reader;
+    REQUIRE(reader.Open(name));
+    REQUIRE(Publish(writer, 1));
+    writer.Close();
+    SharedFrameView view;
+    CHECK(reader.Acquire(view) == SharedReadResult::Closed);
+
+    SharedFrameReader late;
+    CHECK(!late.Open(name));
+    REQUIRE(rival.Create(name, Config()));
+    CHECK(late.Open(name));
+    CHECK(late.Acquire(view) == SharedReadResult::NoFrame);
+}
+
+TEST(ReinitializingBumpsTheGeneration)
+{
+    std::vector<uint8_t> memory(GetSharedRingSize(Config()));
+    SharedFrameWriter writer;
+    REQUIRE(writer.Initialize(memory.data(), memory.size(), Config()));
+    SharedFrameReader reader;
+    REQUIRE(reader.Attach(memory.data(), memory.size()));
+    REQUIRE(Publish(writer, 1));
+    SharedFrameView view;
+    REQUIRE(reader.Acquire(view) == SharedReadResult::Ok);
+    CHECK(reader.Release(view));
+
+    SharedFrameWriter replacement;
+    REQUIRE(replacement.Initialize(memory.data(), memory.size(), Config()));
+    CHECK(reader.Acquire(view) == SharedReadResult::Closed);
+    SharedFrameReader fresh;
+    REQUIRE(fresh.Attach(memory.data(), memory.size()));
+    CHECK(fresh.Acquire(view) == SharedReadResult::NoFrame);
+    // Too small, or not a ring at all.
+    CHECK(!fresh.Attach(memory.data(), memory.size() - 1));
+    std::vector<uint8_t> zeros(memory.size());
+    CHECK(!fresh.Attach(zeros.data(), zeros.size()));
+}
+
+TEST(TornReadsAreCaughtOnRelease)
+{
+    // A writer publishing flat out into two slots and a reader holding each
+    // frame a while: frames overwritten under the reader must fail Release,
+    // and every frame that passes must be whole.
+    std::vector<uint8_t> memory(GetSharedRingSize(Config(2)));
+    SharedFrameWriter writer;
+    REQUIRE(writer.Initialize(memory.data(), memory.size(), Config(2)));
+    SharedFrameReader reader;
+    REQUIRE(reader.Attach(memory.data(), memory.size()));
+
+    std::atomic<bool> stop{ false };
+    std::thread producer([&] {
+        std::vector<std::vector<uint8_t>> frames;
+        for (uint64_t i = 0; i < 8; i++)
+            frames.push_back(Frame(i));
+        for (uint64_t i = 1; !stop.load(); i++)
+            writer.Publish(frames[i % 8].data(), Width * 4, OutputFormat::Bgra, Width, Height, Timing(i));
+    });
+
+    uint32_t reads = 0;
+    uint32_t intact = 0;
+    uint32_t torn = 0;
+    bool whole = true;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((intact < 200 || torn == 0) && std::chrono::steady_clock::now() < deadline)
+    {
+        SharedFrameView view;
+        if (reader.Acquire(view, 10) != SharedReadResult::Ok)
+            continue;
+        std::vector<uint8_t> copy(view.Bytes);
+        std::memcpy(copy.data(), view.Data, copy.size());
+        // Every fourth frame held long enough for the writer to come round.
+        if (reads++ % 4 == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        if (!reader.Release(view))
+        {
+            torn++;
+            continue;
+        }
+        intact++;
+        SharedFrameView copied = view;
+        copied.Data = copy.data();
+        whole = whole && Holds(copied, view.Timing.FrameIndex % 8);
+    }
+    stop.store(true);
+    producer.join();
+    CHECK(whole);
+    CHECK(intact >= 200);
+    CHECK(torn != 0);
+}
+
+#ifndef _WIN32
+TEST(AnotherProcessReadsTheRing)
+{
+    // The reader in a child process, over shm_open, as a consumer of the
+    // DLL would be. It exits 0 once it has seen 50 whole frames in order.
+    auto name = RingName("Process");
+    SharedFrameWriter writer;
+    REQUIRE(writer.Create(name, Config()));
+    pid_t child = ::fork();
+    REQUIRE(child >= 0);
+    if (child == 0)
+    {
+        SharedFrameReader reader;
+        if (!reader.Open(name))
+            ::_exit(2);
+        uint64_t last = 0;
+        uint32_t seen = 0;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (seen < 50 && std::chrono::steady_clock::now() < deadline)
+        {
+            SharedFrameView view;
+            if (reader.Acquire(view, 10) != SharedReadResult::Ok)
+                continue;
+            bool whole = Holds(view, view.Timing.FrameIndex - 100);
+            if (!reader.Release(view))
+                continue;
+            if (!whole || view.FrameNumber <= last)
+                ::_exit(3);
+            last = view.FrameNumber;
+            seen++;
+        }
+        ::_exit(seen == 50 ? 0 : 4);
+    }
+
+    int status = 0;
+    pid_t waited = 0;
+    for (uint64_t i = 1; waited == 0; i++)
+    {
+        Publish(writer, i);
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        waited = ::waitpid(child, &status, WNOHANG);
+    }
+    REQUIRE(waited == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+#endif
@@ -0,0 +1,127 @@
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "SpscRing.h"
+#include "TestHarness.h"
+
+TEST(KeepsOrderAcrossThreads)
+{
+    // Strings, so a slot handed over before it is fully written shows up
+    // under a race detector and in the comparison.
+    SpscRing<std::string> ring(8);
+    constexpr uint64_t Values = 200000;
+    std::atomic<bool> oversized{ false };
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < Values;)
+        {
+            if (ring.ProducerSize() > ring.Capacity())
+                oversized.store(true);
+            if (ring.TryPush(std::to_string(i)))
+                i++;
+            else
+                std::this_thread::yield();
+        }
+    });
+    uint64_t expected = 0;
+    bool ordered = true;
+    while (expected < Values)
+    {
+        std::string value;
+        uint64_t sequence = 0;
+        if (!ring.TryPop(value, &sequence))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && sequence == expected && value == std::to_string(expected);
+        expected++;
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(!oversized.load());
+    CHECK(ring.Size() == 0);
+    CHECK(ring.ProducerSize() == 0);
+}
+
+TEST(RefusesWhenFull)
+{
+    SpscRing<int> ring(3);
+    CHECK(ring.Capacity() == 4);
+    for (int i = 0; i < 4; i++)
+        CHECK(ring.TryPush(i));
+    CHECK(!ring.TryPush(4));
+    CHECK(ring.Size() == 4 && ring.ProducerSize() == 4);
+    int value = 0;
+    CHECK(ring.TryPop(value) && value == 0);
+    CHECK(ring.TryPush(4));
+}
+
+TEST(EvictTakesBackWhatThePopperHasNotClaimed)
+{
+    SpscRing<std::string> ring(8);
+    for (int i = 0; i < 5; i++)
+        CHECK(ring.TryPush(std::to_string(i)));
+    std::vector<std::string> evicted;
+    CHECK(ring.Evict(2, [&](std::string&& value) { evicted.push_back(value); }) == 3);
+    CHECK(evicted == std::vector<std::string>({ "0", "1", "2" }));
+    // The tail was stepped over them, so the ring has room again.
+    CHECK(ring.ProducerSize() == 2);
+    CHECK(ring.Evict(2, [&](std::string&&) {}) == 0);
+    std::string value;
+    uint64_t sequence = 0;
+    CHECK(ring.TryPop(value, &sequence) && value == "3" && sequence == 3);
+    CHECK(ring.TryPush("5"));
+    CHECK(ring.Drop(1, [&](std::string&& dropped) { evicted.push_back(dropped); }) == 1);
+    CHECK(evicted.back() == "4");
+    CHECK(ring.TryPop(value, &sequence) && value == "5" && sequence == 5);
+    CHECK(!ring.TryPop(value));
+}
+
+TEST(EvictAndPopRaceForEveryValue)
+{
+    // The producer keeps only the newest value while the consumer pops: each
+    // value goes to exactly one side, and the consumer's stay in order.
+    SpscRing<std::string> ring(8);
+    constexpr uint64_t Values = 200000;
+    uint64_t evicted = 0;
+    bool intact = true;
+    std::atomic<bool> done{ false };
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < Values;)
+        {
+            if (!ring.TryPush(std::to_string(i)))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            i++;
+            evicted += ring.Evict(1, [&](std::string&& value) { intact = intact && !value.empty(); });
+        }
+        done.store(true);
+    });
+    uint64_t popped = 0;
+    uint64_t last = 0;
+    bool ordered = true;
+    for (;;)
+    {
+        bool finished = done.load();
+        std::string value;
+        uint64_t sequence = 0;
+        if (!ring.TryPop(value, &sequence))
+        {
+            if (finished)
+                break;
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && value == std::to_string(sequence) && (popped == 0 || sequence > last);
+        last = sequence;
+        popped++;
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(intact);
+    CHECK(popped + evicted == Values);
+    CHECK(last == Values - 1);
+}
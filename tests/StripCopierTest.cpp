@@ -0,0 +1,180 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "StripCopier.h"
+#include "SyntheticCaptureSource.h"
+#include "TestHarness.h"
+
+namespace
+{
+    // Everything split into strips, however small.
+    StripCopierConfig Parallel(uint32_t threads)
+    {
+        StripCopierConfig config;
+        config.Threads = threads;
+        config.MinParallelBytes = 0;
+        config.MinStripRows = 4;
+        return config;
+    }
+
+    std::vector<uint8_t> Source(uint32_t width, uint32_t height, size_t stride, uint64_t frameIndex)
+    {
+        std::vector<uint8_t> bgra(stride * height, 0x3C);
+        SyntheticCaptureSource::RenderFrame(bgra.data(), stride, width, height, 16, frameIndex);
+        return bgra;
+    }
+
+    // Whether copier converts a width x height frame exactly as ConvertFrame
+    // does in one go, padding between rows untouched.
+    bool ConvertsLikeOneGo(StripCopier& copier, OutputFormat format, uint32_t width, uint32_t height)
+    {
+        size_t srcStride = static_cast<size_t>(width) * 4 + 64;
+        auto src = Source(width, height, srcStride, width + height);
+        size_t dstStride = GetOutputRowBytes(format, width) + 24;
+        size_t size = GetOutputFrameSize(format, width, height, dstStride);
+        ConvertParams params;
+        params.Format = format;
+        std::vector<uint8_t> expected(size, 0xA5);
+        ConvertFrame(expected.data(), dstStride, src.data(), srcStride, width, height, params);
+        std::vector<uint8_t> stripped(size, 0xA5);
+        copier.Convert(stripped.data(), dstStride, src.data(), srcStride, width, height, params);
+        return stripped == expected;
+    }
+
+    // Run rows through copier, returning how many times each row was worked
+    // on, or an empty vector if a strip started off alignment.
+    std::vector<uint32_t> Coverage(StripCopier& copier, uint32_t rows, uint32_t alignment)
+    {
+        std::vector<std::atomic<uint32_t>> visits(rows);
+        std::atomic<bool> aligned{ true };
+        copier.Run(rows, alignment, SIZE_MAX, [&](uint32_t first, uint32_t count)
+        {
+            if (alignment != 0 && first % alignment != 0)
+                aligned = false;
+            for (uint32_t row = first; row < first + count && row < rows; row++)
+                visits[row].fetch_add(1, std::memory_order_relaxed);
+        });
+        std::vector<uint32_t> counts;
+        if (!aligned)
+            return counts;
+        for (auto& visit : visits)
+            counts.push_back(visit.load());
+        return counts;
+    }
+}
+
+TEST(StripsConvertLikeOneGo)
+{
+    for (uint32_t threads : { 1u, 2u, 4u })
+    {
+        StripCopier copier(Parallel(threads));
+        CHECK(copier.Threads() == threads);
+        for (auto format : { OutputFormat::Bgra, OutputFormat::Rgba, OutputFormat::Rgb24, OutputFormat::Nv12, OutputFormat::I420 })
+        {
+            CHECK(ConvertsLikeOneGo(copier, format, 320, 240));
+            // Odd sizes, where the last chroma row has one luma row.
+            CHECK(ConvertsLikeOneGo(copier, format, 301, 203));
+            CHECK(ConvertsLikeOneGo(copier, format, 17, 5));
+        }
+    }
+}
+
+TEST(EveryRowIsWorkedOnOnce)
+{
+    StripCopier copier(Parallel(4));
+    for (uint32_t rows : { 1u, 7u, 64u, 100u, 1081u })
+    {
+        for (uint32_t alignment : { 0u, 1u, 2u, 16u })
+        {
+            auto counts = Coverage(copier, rows, alignment);
+            CHECK(counts == std::vector<uint32_t>(rows, 1));
+        }
+    }
+    // No rows, no work.
+    bool called = false;
+    copier.Run(0, 1, SIZE_MAX, [&](uint32_t, uint32_t) { called = true; });
+    CHECK(!called);
+}
+
+TEST(SmallFramesStayOnTheCaller)
+{
+    StripCopierConfig config;
+    config.Threads = 4;
+    StripCopier copier(config);
+    auto caller = std::this_thread::get_id();
+    bool onCaller = true;
+    uint32_t calls = 0;
+    copier.Run(720, 1, config.MinParallelBytes - 1, [&](uint32_t first, uint32_t count)
+    {
+        onCaller = onCaller && std::this_thread::get_id() == caller && first == 0 && count == 720;
+        calls++;
+    });
+    CHECK(onCaller && calls == 1);
+    auto stats = copier.Stats();
+    CHECK(stats.Frames == 1 && stats.ParallelFrames == 0 && stats.Strips == 1);
+
+    // Large ones are split, twice the threads' worth.
+    std::atomic<uint32_t> strips{ 0 };
+    copier.Run(2160, 1, config.MinParallelBytes, [&](uint32_t, uint32_t) { strips++; });
+    CHECK(strips.load() == 8);
+    stats = copier.Stats();
+    CHECK(stats.Frames == 2 && stats.ParallelFrames == 1 && stats.Strips == 9);
+    CHECK(!stats.Affinity);
+
+    // Strips are never cut below MinStripRows.
+    strips = 0;
+    copier.Run(40, 1, SIZE_MAX, [&](uint32_t, uint32_t) { strips++; });
+    CHECK(strips.load() == 1);
+}
+
+TEST(OneThreadNeverSplits)
+{
+    StripCopier copier(Parallel(1));
+    uint32_t calls = 0;
+    copier.Run(4096, 1, SIZE_MAX, [&](uint32_t first, uint32_t count) { calls += first == 0 && count == 4096 ? 1 : 100; });
+    CHECK(calls == 1);
+    CHECK(copier.Stats().ParallelFrames == 0);
+}
+
+TEST(RunsFromSeveralThreadsTakeTurns)
+{
+    // Back to back runs from three callers at once: each run's strips must
+    // all go to its own work, none to a run that came before or after.
+    StripCopier copier(Parallel(4));
+    constexpr uint32_t Rows = 96;
+    constexpr uint32_t Runs = 300;
+    std::atomic<uint32_t> wrong{ 0 };
+    std::vector<std::thread> callers;
+    for (uint32_t caller = 0; caller < 3; caller++)
+    {
+        callers.emplace_back([&] {
+            for (uint32_t i = 0; i < Runs; i++)
+            {
+                auto counts = Coverage(copier, Rows, 2);
+                if (counts != std::vector<uint32_t>(Rows, 1))
+                    wrong++;
+            }
+        });
+    }
+    for (auto& thread : callers)
+        thread.join();
+    CHECK(wrong.load() == 0);
+    auto stats = copier.Stats();
+    CHECK(stats.Frames == 3 * Runs && stats.ParallelFrames == 3 * Runs);
+}
+
+TEST(PinnedWorkersStillCopy)
+{
+    // Whether pinning takes effect depends on the machine; the copies must
+    // come out right either way.
+    auto config = Parallel(3);
+    config.PinWorkers = true;
+    StripCopier pinned(config);
+    CHECK(ConvertsLikeOneGo(pinned, OutputFormat::Nv12, 640, 360));
+    config.PinWorkers = false;
+    config.NumaNode = 4096;
+    StripCopier missing(config);
+    CHECK(ConvertsLikeOneGo(missing, OutputFormat::Bgra, 640, 360));
+    CHECK(!missing.Stats().Affinity);
+}
@@ -0,0 +1,48 @@
+#pragma once
+// Just enough of a test framework for the portable core. TEST defines a
+// case; CHECK records a failure and carries on, REQUIRE ends the case.
+// Every test executable links TestMain.cpp, which runs the cases whose name
+// contains the first argument, or all of them.
+#include <cstdio>
+#include <vector>
+
+struct TestCase
+{
+    const char* Name;
+    void (*Run)();
+};
+
+inline std::vector<TestCase>& TestCases()
+{
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline int& TestFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+struct TestRegistration
+{
+    TestRegistration(const char* name, void (*run)()) { TestCases().push_back({ name, run }); }
+};
+
+inline bool TestFailed(const char* file, int line, const char* expression)
+{
+    std::fprintf(stderr, "%s:%d: failed: %s\n", file, line, expression);
+    TestFailures()++;
+    return false;
+}
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    ((condition) ? true : TestFailed(__FILE__, __LINE__, #condition))
+
+#define REQUIRE(condition) \
+    do { if (!CHECK(condition)) return; } while (0)
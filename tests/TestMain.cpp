@@ -0,0 +1,19 @@
+#include <cstring>
+#include "TestHarness.h"
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+    int run = 0;
+    for (auto const& test : TestCases())
+    {
+        if (std::strstr(test.Name, filter) == nullptr)
+            continue;
+        int before = TestFailures();
+        test.Run();
+        std::printf("%s %s\n", TestFailures() == before ? "pass" : "FAIL", test.Name);
+        run++;
+    }
+    std::printf("%d cases, %d failed checks\n", run, TestFailures());
+    return TestFailures() == 0 && run != 0 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <vector>
+#include "TileDiff.h"
+#include "TestHarness.h"
+
+namespace
+{
+    constexpr uint32_t Tile = TileDiffer::TileSize;
+
+    // A BGRA frame with padded rows, so the differ has to honour the stride.
+    struct Frame
+    {
+        uint32_t Width;
+        uint32_t Height;
+        size_t Stride;
+        std::vector<uint8_t> Pixels;
+
+        Frame(uint32_t width, uint32_t height)
+            : Width(width), Height(height), Stride(width * 4 + 32), Pixels(Stride * height)
+        {
+            for (size_t i = 0; i < Pixels.size(); i++)
+                Pixels[i] = static_cast<uint8_t>(i * 7);
+        }
+
+        void Touch(uint32_t x, uint32_t y)
+        {
+            Pixels[y * Stride + x * 4 + 1] ^= 0xFF;
+        }
+
+        bool Update(TileDiffer& differ) const
+        {
+            return differ.Update(Pixels.data(), Stride, Width, Height);
+        }
+    };
+
+    bool Is(DirtyRect const& rect, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+    {
+        return rect.X == x && rect.Y == y && rect.Width == width && rect.Height == height;
+    }
+}
+
+TEST(FirstFrameIsAllDirty)
+{
+    Frame frame(300, 200);
+    TileDiffer differ;
+    CHECK(!frame.Update(differ));
+    CHECK(!differ.Identical());
+    CHECK(differ.DirtyTileCount() == 5 * 4);
+    REQUIRE(differ.DirtyRects().size() == 1);
+    CHECK(Is(differ.DirtyRects()[0], 0, 0, 300, 200));
+}
+
+TEST(UnchangedFramesAreIdentical)
+{
+    Frame frame(300, 200);
+    TileDiffer differ;
+    frame.Update(differ);
+    CHECK(frame.Update(differ));
+    CHECK(differ.Identical());
+    CHECK(differ.DirtyTileCount() == 0);
+    CHECK(differ.DirtyRects().empty());
+}
+
+TEST(OnePixelDirtiesItsTile)
+{
+    Frame frame(300, 200);
+    TileDiffer differ;
+    frame.Update(differ);
+    frame.Touch(130, 70);
+    CHECK(!frame.Update(differ));
+    CHECK(differ.DirtyTileCount() == 1);
+    REQUIRE(differ.DirtyRects().size() == 1);
+    CHECK(Is(differ.DirtyRects()[0], 2 * Tile, Tile, Tile, Tile));
+    // The reference took the change, so the same frame again is identical.
+    CHECK(frame.Update(differ));
+}
+
+TEST(EdgeTilesAreClipped)
+{
+    Frame frame(300, 200);
+    TileDiffer differ;
+    frame.Update(differ);
+    frame.Touch(299, 199);
+    frame.Update(differ);
+    REQUIRE(differ.DirtyRects().size() == 1);
+    CHECK(Is(differ.DirtyRects()[0], 4 * Tile, 3 * Tile, 300 - 4 * Tile, 200 - 3 * Tile));
+}
+
+TEST(RowPaddingIsIgnored)
+{
+    Frame frame(300, 200);
+    TileDiffer differ;
+    frame.Update(differ);
+    frame.Pixels[frame.Stride * 10 + 300 * 4 + 3] ^= 0xFF;
+    CHECK(frame.Update(differ));
+}
+
+TEST(AdjacentTilesMergeIntoRects)
+{
+    Frame frame(640, 480);
+    TileDiffer differ;
+    frame.Update(differ);
+    // A 2x2 block of tiles, and one tile apart from it.
+    frame.Touch(0, 0);
+    frame.Touch(Tile, 0);
+    frame.Touch(0, Tile);
+    frame.Touch(Tile + 5, Tile + 5);
+    frame.Touch(5 * Tile, 3 * Tile);
+    frame.Update(differ);
+    CHECK(differ.DirtyTileCount() == 5);
+    REQUIRE(differ.DirtyRects().size() == 2);
+    CHECK(Is(differ.DirtyRects()[0], 0, 0, 2 * Tile, 2 * Tile));
+    CHECK(Is(differ.DirtyRects()[1], 5 * Tile, 3 * Tile, Tile, Tile));
+}
+
+TEST(RunsOfDifferentSpansStaySeparate)
+{
+    Frame frame(640, 480);
+    TileDiffer differ;
+    frame.Update(differ);
+    frame.Touch(0, 0);
+    frame.Touch(Tile, 0);
+    frame.Touch(0, Tile);
+    frame.Update(differ);
+    REQUIRE(differ.DirtyRects().size() == 2);
+    CHECK(Is(differ.DirtyRects()[0], 0, 0, 2 * Tile, Tile));
+    CHECK(Is(differ.DirtyRects()[1], 0, Tile, Tile, Tile));
+}
+
+TEST(ResizeAndResetDirtyTheWholeFrame)
+{
+    Frame frame(300, 200);
+    TileDiffer differ;
+    frame.Update(differ);
+    Frame smaller(200, 100);
+    CHECK(!smaller.Update(differ));
+    CHECK(differ.DirtyTileCount() == 4 * 2);
+    CHECK(smaller.Update(differ));
+    differ.Reset();
+    CHECK(!smaller.Update(differ));
+    REQUIRE(differ.DirtyRects().size() == 1);
+    CHECK(Is(differ.DirtyRects()[0], 0, 0, 200, 100));
+}
+
+TEST(MarkDirtyAddsClippedRects)
+{
+    Frame frame(300, 200);
+    TileDiffer differ;
+    frame.Update(differ);
+    frame.Update(differ);
+    differ.MarkDirty({ 500, 10, 20, 20 });
+    CHECK(differ.Identical());
+    differ.MarkDirty({ 290, 190, 32, 32 });
+    CHECK(!differ.Identical());
+    REQUIRE(differ.DirtyRects().size() == 1);
+    CHECK(Is(differ.DirtyRects()[0], 290, 190, 10, 10));
+}
@@ -0,0 +1,397 @@
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TestHarness.h"
+#include "WindowRegistry.h"
+
+namespace
+{
+    // A scripted window manager: windows live in a map the test edits, and
+    // the reads the registry makes are counted. OnRead runs in the middle of
+    // a read, standing in for an event handled on another thread meanwhile.
+    class FakeWindowSource : public IWindowSource
+    {
+    public:
+        std::map<uint64_t, WindowInfo> Windows;
+        std::vector<uint64_t> Order;
+        uint32_t Reads = 0;
+        uint32_t TitleReads = 0;
+        uint32_t StateReads = 0;
+        std::function<void()> OnRead;
+
+        WindowInfo& Open(uint64_t handle, std::wstring title, std::wstring className = L"App", uint32_t processId = 1)
+        {
+            WindowInfo info;
+            info.Handle = handle;
+            info.Title = std::move(title);
+            info.ClassName = std::move(className);
+            info.ProcessId = processId;
+            info.Visible = true;
+            info.Root = true;
+            Order.push_back(handle);
+            return Windows[handle] = info;
+        }
+
+        void Destroy(uint64_t handle)
+        {
+            Windows.erase(handle);
+        }
+
+        void Enumerate(std::vector<uint64_t>& handles) override
+        {
+            for (auto handle : Order)
+            {
+                if (Windows.count(handle) != 0)
+                    handles.push_back(handle);
+            }
+        }
+
+        bool Read(uint64_t handle, WindowInfo& info) override
+        {
+            Reads++;
+            auto it = Windows.find(handle);
+            if (it == Windows.end())
+                return false;
+            info = it->second;
+            Interrupt();
+            return true;
+        }
+
+        bool ReadTitle(uint64_t handle, std::wstring& title) override
+        {
+            TitleReads++;
+            auto it = Windows.find(handle);
+            if (it == Windows.end())
+                return false;
+            title = it->second.Title;
+            Interrupt();
+            return true;
+        }
+
+        bool ReadState(uint64_t handle, WindowInfo& info) override
+        {
+            StateReads++;
+            auto it = Windows.find(handle);
+            if (it == Windows.end())
+                return false;
+            auto const& window = it->second;
+            info.Style = window.Style;
+            info.ExStyle = window.ExStyle;
+            info.Visible = window.Visible;
+            info.Cloaked = window.Cloaked;
+            info.Root = window.Root;
+            info.Shell = window.Shell;
+            Interrupt();
+            return true;
+        }
+
+    private:
+        void Interrupt()
+        {
+            if (OnRead)
+            {
+                auto run = std::move(OnRead);
+                OnRead = nullptr;
+                run();
+            }
+        }
+    };
+
+    std::vector<uint64_t> Handles(std::vector<WindowInfo> const& windows)
+    {
+        std::vector<uint64_t> handles;
+        for (auto const& window : windows)
+            handles.push_back(window.Handle);
+        return handles;
+    }
+
+    // Whether the registry holds exactly what the source does.
+    bool Matches(WindowRegistry const& registry, FakeWindowSource const& source)
+    {
+        if (registry.Count() != source.Windows.size())
+            return false;
+        for (auto const& window : source.Windows)
+        {
+            WindowInfo info;
+            if (!registry.Get(window.first, info))
+                return false;
+            auto const& real = window.second;
+            if (info.Handle != real.Handle || info.Title != real.Title || info.ClassName != real.ClassName ||
+                info.ProcessId != real.ProcessId || info.Style != real.Style || info.ExStyle != real.ExStyle ||
+                info.Visible != real.Visible || info.Cloaked != real.Cloaked || info.Root != real.Root || info.Shell != real.Shell)
+                return false;
+        }
+        return true;
+    }
+}
+
+TEST(AltTabRulesFollowWin32)
+{
+    WindowInfo window;
+    window.Title = L"Editor";
+    window.Visible = true;
+    window.Root = true;
+    CHECK(IsAltTabWindow(window));
+    auto tool = window;
+    tool.ExStyle = WindowExStyleToolWindow;
+    CHECK(!IsAltTabWindow(tool));
+    auto child = window;
+    child.Style = WindowStyleChild;
+    CHECK(!IsAltTabWindow(child));
+    auto cloaked = window;
+    cloaked.Cloaked = true;
+    CHECK(!IsAltTabWindow(cloaked));
+    auto untitled = window;
+    untitled.Title.clear();
+    CHECK(!IsAltTabWindow(untitled));
+    auto shell = window;
+    shell.Shell = true;
+    CHECK(!IsAltTabWindow(shell));
+    CHECK(ContainsIgnoreCase(L"Untitled - Notepad", L"NOTEPAD"));
+    CHECK(!ContainsIgnoreCase(L"Notepad", L"Paint"));
+    CHECK(ContainsIgnoreCase(L"Anything", L""));
+}
+
+TEST(ScriptedEventsKeepTheRegistryCurrent)
+{
+    FakeWindowSource source;
+    source.Open(10, L"Mail");
+    source.Open(20, L"Terminal", L"Console", 2);
+    WindowRegistry registry(source);
+    registry.Refresh();
+    CHECK(Matches(registry, source));
+    auto version = registry.Version();
+
+    // Each step changes the source the way the window manager would, then
+    // delivers the event it raises.
+    struct Step
+    {
+        std::function<void()> Change;
+        WindowEvent Event;
+        uint64_t Handle;
+    };
+    std::vector<Step> script = {
+        { [&] { source.Open(30, L"Browser", L"Chrome", 3); }, WindowEvent::Created, 30 },
+        { [&] { source.Windows[10].Title = L"Mail - 3 unread"; }, WindowEvent::TitleChanged, 10 },
+        { [&] { source.Windows[20].Visible = false; }, WindowEvent::Hidden, 20 },
+        { [&] { source.Windows[30].Cloaked = true; }, WindowEvent::StateChanged, 30 },
+        { [&] { source.Windows[20].Visible = true; }, WindowEvent::Shown, 20 },
+        { [&] { source.Windows[30].ExStyle = WindowExStyleToolWindow; source.Windows[30].Cloaked = false; }, WindowEvent::StateChanged, 30 },
+        { [&] { source.Destroy(10); }, WindowEvent::Destroyed, 10 },
+        { [&] { source.Open(40, L"Player", L"Media", 4); }, WindowEvent::Shown, 40 },
+        { [&] { source.Windows[20].Root = false; }, WindowEvent::StateChanged, 20 },
+        { [&] { source.Destroy(30); }, WindowEvent::Destroyed, 30 },
+    };
+    bool current = true;
+    bool bumped = true;
+    for (auto const& step : script)
+    {
+        step.Change();
+        registry.OnEvent(step.Event, step.Handle);
+        current = current && Matches(registry, source);
+        bumped = bumped && registry.Version() > version;
+        version = registry.Version();
+    }
+    CHECK(current);
+    CHECK(bumped);
+    // First seen order survives the churn; 40 was first seen on an event.
+    CHECK(Handles(registry.Query(nullptr)) == std::vector<uint64_t>({ 20, 40 }));
+    CHECK(Handles(registry.AltTabWindows()) == std::vector<uint64_t>({ 40 }));
+}
+
+TEST(EventsReadOnlyWhatTheyChange)
+{
+    FakeWindowSource source;
+    source.Open(1, L"One");
+    WindowRegistry registry(source);
+    registry.Refresh();
+    CHECK(source.Reads == 1);
+
+    source.Windows[1].Title = L"Uno";
+    registry.OnEvent(WindowEvent::TitleChanged, 1);
+    CHECK(source.Reads == 1 && source.TitleReads == 1 && source.StateReads == 0);
+    registry.OnEvent(WindowEvent::Hidden, 1);
+    registry.OnEvent(WindowEvent::StateChanged, 1);
+    CHECK(source.Reads == 1 && source.StateReads == 2);
+    // Unknown windows are read in full whatever the event.
+    source.Open(2, L"Two");
+    registry.OnEvent(WindowEvent::TitleChanged, 2);
+    CHECK(source.Reads == 2 && source.TitleReads == 1);
+    CHECK(Matches(registry, source));
+
+    // Nothing changed: no new version.
+    auto version = registry.Version();
+    registry.OnEvent(WindowEvent::StateChanged, 1);
+    registry.Refresh();
+    CHECK(registry.Version() == version);
+}
+
+TEST(WindowsGoneBeforeTheReadAreDropped)
+{
+    FakeWindowSource source;
+    source.Open(1, L"One");
+    source.Open(2, L"Two");
+    WindowRegistry registry(source);
+    registry.Refresh();
+    // The window closed before its event was handled.
+    source.Destroy(1);
+    registry.OnEvent(WindowEvent::TitleChanged, 1);
+    WindowInfo info;
+    CHECK(!registry.Get(1, info));
+    // Never known and already gone.
+    registry.OnEvent(WindowEvent::Created, 3);
+    CHECK(registry.Count() == 1);
+    CHECK(Matches(registry, source));
+}
+
+TEST(DestroyedWhileReadingStaysGone)
+{
+    // A title change read while the window is destroyed and its Destroyed
+    // event handled on another thread must not bring the window back.
+    FakeWindowSource source;
+    source.Open(1, L"One");
+    WindowRegistry registry(source);
+    registry.Refresh();
+    source.Windows[1].Title = L"Closing";
+    source.OnRead = [&] {
+        source.Destroy(1);
+        registry.OnEvent(WindowEvent::Destroyed, 1);
+    };
+    registry.OnEvent(WindowEvent::TitleChanged, 1);
+    CHECK(registry.Count() == 0);
+
+    source.Open(2, L"Two");
+    registry.Refresh();
+    source.OnRead = [&] {
+        source.Destroy(2);
+        registry.OnEvent(WindowEvent::Destroyed, 2);
+    };
+    registry.OnEvent(WindowEvent::Hidden, 2);
+    CHECK(registry.Count() == 0);
+}
+
+TEST(CreatedReadsOvertakenByDestroyedAreDropped)
+{
+    // The read for a Created event blocks, having looked at the window, while
+    // another thread handles its Destroyed event, and the second time a
+    // Created for a new window that was given the same handle.
+    FakeWindowSource source;
+    WindowRegistry registry(source);
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool reading = false;
+    bool release = false;
+    auto interleave = [&](std::function<void()> const& meanwhile) {
+        reading = false;
+        release = false;
+        source.OnRead = [&] {
+            std::unique_lock<std::mutex> lock(mutex);
+            reading = true;
+            cv.notify_all();
+            cv.wait(lock, [&] { return release; });
+        };
+        std::thread reader([&] { registry.OnEvent(WindowEvent::Created, 5); });
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return reading; });
+        }
+        meanwhile();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            release = true;
+        }
+        cv.notify_all();
+        reader.join();
+    };
+
+    source.Open(5, L"Splash");
+    interleave([&] {
+        source.Destroy(5);
+        registry.OnEvent(WindowEvent::Destroyed, 5);
+    });
+    CHECK(registry.Count() == 0);
+
+    source.Open(5, L"Old", L"OldClass", 1);
+    interleave([&] {
+        source.Destroy(5);
+        registry.OnEvent(WindowEvent::Destroyed, 5);
+        source.Open(5, L"New", L"NewClass", 2);
+        registry.OnEvent(WindowEvent::Created, 5);
+    });
+    WindowInfo info;
+    REQUIRE(registry.Get(5, info));
+    CHECK(info.Title == L"New" && info.ProcessId == 2);
+    CHECK(Matches(registry, source));
+
+    // Destroyed events with no read in flight leave nothing behind.
+    registry.OnEvent(WindowEvent::Destroyed, 5);
+    source.Destroy(5);
+    source.Open(5, L"Again");
+    registry.OnEvent(WindowEvent::Created, 5);
+    CHECK(Matches(registry, source));
+}
+
+TEST(OverlappingEventsKeepEachOthersFields)
+{
+    // A state change read while the title changes and that event is handled
+    // meanwhile: neither may undo the other.
+    FakeWindowSource source;
+    source.Open(1, L"Before");
+    WindowRegistry registry(source);
+    registry.Refresh();
+    source.Windows[1].Cloaked = true;
+    source.OnRead = [&] {
+        source.Windows[1].Title = L"After";
+        registry.OnEvent(WindowEvent::TitleChanged, 1);
+    };
+    registry.OnEvent(WindowEvent::StateChanged, 1);
+    WindowInfo info;
+    REQUIRE(registry.Get(1, info));
+    CHECK(info.Title == L"After");
+    CHECK(info.Cloaked);
+
+    // And the other way round.
+    source.Windows[1].Title = L"Later";
+    source.OnRead = [&] {
+        source.Windows[1].Visible = false;
+        registry.OnEvent(WindowEvent::Hidden, 1);
+    };
+    registry.OnEvent(WindowEvent::TitleChanged, 1);
+    REQUIRE(registry.Get(1, info));
+    CHECK(info.Title == L"Later");
+    CHECK(!info.Visible);
+    CHECK(Matches(registry, source));
+}
+
+TEST(RecycledHandlesAreReadAfresh)
+{
+    FakeWindowSource source;
+    source.Open(7, L"Old", L"OldClass", 1);
+    WindowRegistry registry(source);
+    registry.Refresh();
+    // Windows reuses handles; Created means a different window.
+    source.Open(7, L"New", L"NewClass", 2);
+    registry.OnEvent(WindowEvent::Created, 7);
+    WindowInfo info;
+    REQUIRE(registry.Get(7, info));
+    CHECK(info.ClassName == L"NewClass" && info.ProcessId == 2);
+}
+
+TEST(QueriesFindByTitleClassAndProcess)
+{
+    FakeWindowSource source;
+    source.Open(1, L"Report.docx - Word", L"OpusApp", 5);
+    source.Open(2, L"Inbox - Outlook", L"rctrl_renwnd32", 6);
+    source.Open(3, L"Budget.xlsx - Excel", L"XLMAIN", 5);
+    WindowRegistry registry(source);
+    registry.Refresh();
+    CHECK(Handles(registry.FindByTitle(L"word")) == std::vector<uint64_t>({ 1 }));
+    CHECK(Handles(registry.FindByTitle(L" - ")) == std::vector<uint64_t>({ 1, 2, 3 }));
+    CHECK(Handles(registry.FindByClass(L"XLMAIN")) == std::vector<uint64_t>({ 3 }));
+    CHECK(Handles(registry.FindByProcess(5)) == std::vector<uint64_t>({ 1, 3 }));
+    CHECK(registry.FindByProcess(9).empty());
+}